@@ -15,6 +15,7 @@
 
 #include <medActionsToolBox.h>
 #include <medDatabaseCompactWidget.h>
+#include <medDatabaseController.h>
 #include <medDatabaseExporter.h>
 #include <medDatabaseModel.h>
 #include <medDatabasePreview.h>
@@ -41,6 +42,7 @@ public:
     QList<medToolBox*> toolBoxes;
     medDatabaseSearchPanel *searchPanel;
     medDatabaseSearchPanel *compactSearchPanel;
+    QHash<medDatabaseProxyModel*, QHash<int, QString> > activeFilters;
     medActionsToolBox* actionsToolBox;
 };
 
@@ -52,6 +54,11 @@ medDatabaseDataSource::medDatabaseDataSource( QWidget* parent ): medAbstractData
 
     d->compactProxy = new medDatabaseProxyModel(this);
     d->compactProxy->setSourceModel(d->model);
+
+    // search results are snapshots of the database
+    connect(medDataManager::instance(), SIGNAL(dataImported(medDataIndex,QUuid)), this, SLOT(refreshFilters()), Qt::QueuedConnection);
+    connect(medDataManager::instance(), SIGNAL(dataRemoved(medDataIndex)), this, SLOT(refreshFilters()), Qt::QueuedConnection);
+    connect(medDataManager::instance(), SIGNAL(metadataModified(medDataIndex,QString,QString)), this, SLOT(refreshFilters()), Qt::QueuedConnection);
 }
 
 medDatabaseDataSource::~medDatabaseDataSource()
@@ -181,17 +188,47 @@ QString medDatabaseDataSource::description(void) const
 
 void medDatabaseDataSource::onFilter( const QString &text, int column )
 {
-    // adding or overriding filter on column
-    d->proxy->setFilterRegExpWithColumn(QRegExp(text, Qt::CaseInsensitive, QRegExp::Wildcard), column);
+    applyFilter(d->proxy, text, column);
 }
 
 void medDatabaseDataSource::compactFilter( const QString &text, int column )
 {
+    applyFilter(d->compactProxy, text, column);
+}
+
+void medDatabaseDataSource::applyFilter(medDatabaseProxyModel *proxy, const QString &text, int column)
+{
+    QRegExp regExp(text, Qt::CaseInsensitive, QRegExp::Wildcard);
+
     // adding or overriding filter on column
-    d->compactProxy->setFilterRegExpWithColumn(QRegExp(text, Qt::CaseInsensitive, QRegExp::Wildcard), column);
+    if (text.isEmpty())
+    {
+        d->activeFilters[proxy].remove(column);
+        proxy->setFilterRegExpWithColumn(regExp, column);
+        return;
+    }
+    d->activeFilters[proxy][column] = text;
+
+    // the persistent database is searched through its indexes rather than row by row,
+    // the non-persistent data still match the expression
+    medDatabaseController *db = medDatabaseController::instance();
+    QList<medDataIndex> matchingSeries = db->search(d->model->columnAttributes(column), text);
+    proxy->setFilterWithColumn(regExp, column, db->dataSourceId(), matchingSeries);
 }
 
 void medDatabaseDataSource::onOpeningFailed(const medDataIndex& index, QUuid)
 {
     d->largeView->onOpeningFailed(index);
 }
+
+void medDatabaseDataSource::refreshFilters()
+{
+    for (medDatabaseProxyModel *proxy : d->activeFilters.keys())
+    {
+        const QHash<int, QString> filters = d->activeFilters.value(proxy);
+        for (auto it = filters.constBegin(); it != filters.constEnd(); ++it)
+        {
+            applyFilter(proxy, it.value(), it.key());
+        }
+    }
+}
@@ -16,6 +16,7 @@
 #include <medDataIndex.h>
 
 class medDatabaseDataSourcePrivate;
+class medDatabaseProxyModel;
 
 /**
 * Not a classical data source per se, as it does not import data
@@ -49,7 +50,10 @@ signals:
 protected slots:
     void onFilter(const QString &text, int column);
     void compactFilter(const QString &text, int column);
+    void refreshFilters();
 
 private:
+    void applyFilter(medDatabaseProxyModel *proxy, const QString &text, int column);
+
     medDatabaseDataSourcePrivate* d;
 };
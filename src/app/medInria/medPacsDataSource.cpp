@@ -22,6 +22,7 @@
 #include <medToolBox.h>
 
 #include <medPacsWidget.h>
+#include <medPacsImportQueue.h>
 #include <medPacsMover.h>
 
 class medPacsDataSourcePrivate
@@ -105,6 +106,10 @@ void medPacsDataSource::onPacsMove( const QVector<medMoveCommandItem>& cmdList)
 {
     medPacsMover* mover = new medPacsMover(cmdList);
     connect(mover, SIGNAL(import(QString)), this, SIGNAL(dataReceived(QString)));
+    connect(mover, SIGNAL(requestStarted(medMoveCommandItem)),
+            d->pacsWidget->importQueue(), SLOT(onRequestStarted(medMoveCommandItem)), Qt::QueuedConnection);
+    connect(mover, SIGNAL(requestFinished(medMoveCommandItem, bool)),
+            d->pacsWidget->importQueue(), SLOT(onRequestFinished(medMoveCommandItem, bool)), Qt::QueuedConnection);
     medJobManagerL::instance()->registerJobItem(mover, tr("Moving"));
     QThreadPool::globalInstance()->start(mover);
 }
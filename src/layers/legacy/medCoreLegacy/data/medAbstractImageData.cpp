@@ -21,12 +21,23 @@
 
 const char* medAbstractImageData::PixelMeaningMetaData = "PixelMeaning";
 
+medAbstractImageData::TypedView::~TypedView()
+{
+}
+
 medAbstractImageData::medAbstractImageData(void) : medAbstractData()
 {
+    clearScalarRange();
+    connect(this, SIGNAL(dataModified(medAbstractData*)), this, SLOT(clearScalarRange()));
+    connect(this, SIGNAL(dataModified(medAbstractData*)), this, SLOT(clearTypedViews()));
 }
 
 medAbstractImageData::medAbstractImageData(const medAbstractImageData& other): medAbstractData(other)
 {
+    // the copy may get other pixels, its range and views are computed again
+    clearScalarRange();
+    connect(this, SIGNAL(dataModified(medAbstractData*)), this, SLOT(clearScalarRange()));
+    connect(this, SIGNAL(dataModified(medAbstractData*)), this, SLOT(clearTypedViews()));
 }
 
 void *medAbstractImageData::image(void)
@@ -118,3 +129,92 @@ int medAbstractImageData::scalarValueMaxCount(void)
 
     return 0;
 }
+
+/**
+ * @brief A copy with its own pixel buffer and the same metadata, which the
+ * caller owns. Null when the data type can not copy its pixels.
+ */
+medAbstractImageData* medAbstractImageData::deepCopy()
+{
+    return nullptr;
+}
+
+/**
+ * @brief Modification time of the pixels, which changes whenever they are
+ * written. 0 when the data type does not track it.
+ */
+unsigned long medAbstractImageData::modificationTime()
+{
+    return 0;
+}
+
+/**
+ * @brief Whether the scalar range of the pixels was computed and is still valid.
+ */
+bool medAbstractImageData::hasScalarRange() const
+{
+    return m_hasScalarRange;
+}
+
+/**
+ * @brief Scalar range over all the volumes, as computed for display.
+ */
+void medAbstractImageData::scalarRange(double range[2]) const
+{
+    range[0] = m_scalarRange[0];
+    range[1] = m_scalarRange[1];
+}
+
+/**
+ * @brief Minimum and maximum of each volume, one after the other. Can be empty.
+ */
+QVector<double> medAbstractImageData::frameScalarRanges() const
+{
+    return m_frameScalarRanges;
+}
+
+/**
+ * @brief Keep the scalar range of the pixels, so that it is not computed again
+ * by other views. It is cleared when the data is modified.
+ */
+void medAbstractImageData::setScalarRange(const double range[2], const QVector<double>& frameRanges)
+{
+    m_scalarRange[0] = range[0];
+    m_scalarRange[1] = range[1];
+    m_frameScalarRanges = frameRanges;
+    m_hasScalarRange = true;
+}
+
+void medAbstractImageData::clearScalarRange()
+{
+    m_hasScalarRange = false;
+    m_scalarRange[0] = 0;
+    m_scalarRange[1] = 0;
+    m_frameScalarRanges.clear();
+}
+
+/**
+ * @brief The view kept under this key, or null. Views can be requested from
+ * any thread.
+ */
+QSharedPointer<medAbstractImageData::TypedView> medAbstractImageData::typedView(const QByteArray& key) const
+{
+    QMutexLocker locker(&m_typedViewsMutex);
+    return m_typedViews.value(key);
+}
+
+/**
+ * @brief Keep a view of the pixels, so that it is not converted again by the
+ * next process. It is dropped when the data is modified.
+ */
+void medAbstractImageData::setTypedView(const QByteArray& key, QSharedPointer<TypedView> view)
+{
+    QMutexLocker locker(&m_typedViewsMutex);
+    m_typedViews.insert(key, view);
+}
+
+void medAbstractImageData::clearTypedViews()
+{
+    QMutexLocker locker(&m_typedViewsMutex);
+    m_typedViews.clear();
+}
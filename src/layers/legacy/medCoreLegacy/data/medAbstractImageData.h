@@ -15,6 +15,12 @@
 #include <typeinfo>
 #include <vector>
 
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
 #include <medAbstractData.h>
 #include <medCoreLegacyExport.h>
 
@@ -26,6 +32,16 @@ public:
     typedef std::type_info PixId;
     typedef std::vector < std::vector <double> > MatrixType;
 
+    /**
+     * Pixels of the data seen in another type, kept with the data until it is
+     * modified. See medImageTypedView in medUtilities.
+     */
+    class MEDCORELEGACY_EXPORT TypedView
+    {
+    public:
+        virtual ~TypedView();
+    };
+
     medAbstractImageData();
     medAbstractImageData(const medAbstractImageData& other);
     ~medAbstractImageData() override = default;
@@ -50,7 +66,30 @@ public:
 
     virtual void deleteHistogram(){}
 
+    virtual medAbstractImageData* deepCopy();
+    virtual unsigned long modificationTime();
+
+    bool hasScalarRange() const;
+    void scalarRange(double range[2]) const;
+    QVector<double> frameScalarRanges() const;
+    void setScalarRange(const double range[2], const QVector<double>& frameRanges = QVector<double>());
+
+    QSharedPointer<TypedView> typedView(const QByteArray& key) const;
+    void setTypedView(const QByteArray& key, QSharedPointer<TypedView> view);
+
     static const char* PixelMeaningMetaData;
+
+public slots:
+    void clearScalarRange();
+    void clearTypedViews();
+
+private:
+    bool m_hasScalarRange;
+    double m_scalarRange[2];
+    QVector<double> m_frameScalarRanges;
+
+    mutable QMutex m_typedViewsMutex;
+    QHash<QByteArray, QSharedPointer<TypedView> > m_typedViews;
 };
 
 Q_DECLARE_METATYPE(medAbstractImageData)
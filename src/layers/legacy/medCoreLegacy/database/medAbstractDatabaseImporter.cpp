@@ -384,6 +384,9 @@ void medAbstractDatabaseImporter::importFile ( void )
                 emit showError (tr ( "Could not save data file: " ) + filesPaths[0], 5000 );
                 continue;
             }
+
+            // re-imported or shared data is stored once
+            medStorage::deduplicate ( fileInfo.filePath() );
         }
         atLeastOneImportSucceeded = true;
 
@@ -495,6 +498,9 @@ void medAbstractDatabaseImporter::importData()
         else
         {
             d->data->setMetaData ( "FileName", imageFileName );
+
+            // re-imported or shared data is stored once
+            medStorage::deduplicate ( medStorage::dataLocation() + imageFileName );
         }
 
          QFileInfo   seriesInfo ( imageFileName );
@@ -13,10 +13,13 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 #include <medAbstractDataFactory.h>
 #include <medDatabaseController.h>
 #include <medDatabaseNonPersistentController.h>
 #include <medDataManager.h>
+#include <medDataPrefetcher.h>
 #include <medGlobalDefs.h>
 #include <medJobManagerL.h>
 #include <medMessageController.h>
@@ -66,6 +69,43 @@ public:
         }
     }
 
+    /**
+     * Prefetch the series next to this one in its study, alternating between
+     * the following and preceding ones, as they are the likely next to open.
+     */
+    void prefetchNeighbours(const medDataIndex& index)
+    {
+        int count = prefetcher.budgetSeries();
+        if (count <= 0)
+        {
+            return;
+        }
+
+        medDataIndex study = medDataIndex::makeStudyIndex(index.dataSourceId(), index.patientId(), index.studyId());
+        QList<medDataIndex> series = dbController->series(study);
+        std::sort(series.begin(), series.end());
+
+        int position = series.indexOf(index);
+        if (position < 0)
+        {
+            return;
+        }
+
+        QList<medDataIndex> neighbours;
+        for (int offset = 1; neighbours.size() < count && offset < series.size(); ++offset)
+        {
+            for (int neighbour : {position + offset, position - offset})
+            {
+                if (neighbour >= 0 && neighbour < series.size() && neighbours.size() < count
+                        && !loadedDataObjectTracker.contains(series[neighbour]))
+                {
+                    neighbours << series[neighbour];
+                }
+            }
+        }
+        prefetcher.prefetch(neighbours);
+    }
+
     Q_DECLARE_PUBLIC(medDataManager)
 
     medDataManager * const q_ptr;
@@ -75,6 +115,7 @@ public:
     medAbstractDbController * nonPersDbController;
     QTimer timer;
     QHash<QUuid, medDataIndex> makePersistentJobs;
+    medDataPrefetcher prefetcher;
 };
 
 // ------------------------- medDataManager -----------------------------------
@@ -97,20 +138,46 @@ medDataManager * medDataManager::instance()
 medAbstractData* medDataManager::retrieveData(const medDataIndex& index)
 {
     Q_D(medDataManager);
+    {
+        QMutexLocker locker(&(d->mutex));
+
+        // If nothing in the tracker, we'll get a null weak pointer, thus a null shared pointer
+        medAbstractData *dataObjRef = d->loadedDataObjectTracker.value(index);
+
+        if(dataObjRef)
+        {
+            // we found an existing instance of that object
+            return dataObjRef;
+        }
+    }
+
+    // Wait for a series being prefetched without blocking the other callers
+    dtkSmartPointer<medAbstractData> prefetched;
+    if (d->dbController->contains(index)) {
+        prefetched = d->prefetcher.take(index);
+    }
+
     QMutexLocker locker(&(d->mutex));
 
-    // If nothing in the tracker, we'll get a null weak pointer, thus a null shared pointer
+    // It may have been loaded by another caller meanwhile
     medAbstractData *dataObjRef = d->loadedDataObjectTracker.value(index);
-
     if(dataObjRef)
     {
-        // we found an existing instance of that object
         return dataObjRef;
     }
 
     // No existing ref, we need to load from the file DB, then the non-persistent DB
     if (d->dbController->contains(index)) {
-        dataObjRef = d->dbController->retrieve(index);
+        if (prefetched) {
+            // keep it referenced until the tracker does
+            d->loadedDataObjectTracker.insert(index, prefetched);
+            dataObjRef = prefetched;
+        } else {
+            dataObjRef = d->dbController->retrieve(index);
+        }
+        if (dataObjRef) {
+            d->prefetchNeighbours(index);
+        }
     } else if(d->nonPersDbController->contains(index)) {
         dataObjRef = d->nonPersDbController->retrieve(index);
     }
@@ -313,6 +380,7 @@ QList<medDataIndex> medDataManager::moveStudy(const medDataIndex& indexStudy, co
     if(dbc->dataSourceId() != toPatient.dataSourceId()) {
         qWarning() << "medDataManager: Moving data accross controllers is not supported.";
     } else {
+        d->prefetcher.clear();
         newIndexList = dbc->moveStudy(indexStudy,toPatient);
     }
 
@@ -332,6 +400,7 @@ medDataIndex medDataManager::moveSeries(const medDataIndex& indexSeries, const m
     if(dbc->dataSourceId() != toStudy.dataSourceId()) {
         qWarning() << "medDataManager: Moving data accross controllers is not supported.";
     } else {
+        d->prefetcher.clear();
         newIndex = dbc->moveSeries(indexSeries,toStudy);
     }
 
@@ -448,6 +517,7 @@ void medDataManager::removeData(const medDataIndex& index)
     Q_D(medDataManager);
     medAbstractDbController * dbc = d->controllerForDataSource(index.dataSourceId());
     if (dbc) {
+        d->prefetcher.clear();
         dbc->remove(index);
     }
 }
@@ -0,0 +1,297 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QRunnable>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <medAbstractData.h>
+#include <medDatabaseController.h>
+#include <medDatabaseReader.h>
+#include <medDataPrefetcher.h>
+#include <medSettingsManager.h>
+
+class medDataPrefetcherPrivate
+{
+public:
+    QMutex mutex;
+    QWaitCondition loaded;
+    QThreadPool pool;
+
+    QList<medDataIndex> queued;  // requested, not started yet
+    QSet<medDataIndex> loading;  // being read
+    QSet<medDataIndex> wanted;   // of the last request
+    QHash<medDataIndex, dtkSmartPointer<medAbstractData> > data;
+    QHash<medDataIndex, qint64> sizes; // of loading and data
+
+    qint64 used;
+    qint64 budgetBytes;
+    int budgetSeries;
+
+    void release(const medDataIndex& index)
+    {
+        used -= sizes.take(index);
+    }
+};
+
+// /////////////////////////////////////////////////////////////////
+// medDataPrefetchTask
+// /////////////////////////////////////////////////////////////////
+
+class medDataPrefetchTask : public QRunnable
+{
+public:
+    medDataPrefetchTask(medDataPrefetcherPrivate *d, const medDataIndex& index, const QString& databaseName)
+        : d(d), index(index), databaseName(databaseName) {}
+
+    void run()
+    {
+        QThread::currentThread()->setPriority(QThread::LowestPriority);
+
+        {
+            QMutexLocker locker(&d->mutex);
+            if (!d->queued.removeOne(index)
+                    || d->data.size() + d->loading.size() >= d->budgetSeries)
+            {
+                return;
+            }
+            d->loading.insert(index);
+        }
+
+        // Qt SQL connections can only be used by the thread which opened
+        // them, the task reads through its own.
+        const QString connectionName = QString("medDataPrefetcher_%1").arg(reinterpret_cast<quintptr>(QThread::currentThread()));
+        dtkSmartPointer<medAbstractData> result;
+        {
+            QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            database.setDatabaseName(databaseName);
+            if (database.open())
+            {
+                result = read(database);
+                database.close();
+            }
+            else
+            {
+                qDebug() << "medDataPrefetcher: cannot open database" << databaseName;
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+
+        QMutexLocker locker(&d->mutex);
+        d->loading.remove(index);
+        if (result && d->wanted.contains(index))
+        {
+            d->data.insert(index, result);
+        }
+        else
+        {
+            d->release(index);
+        }
+        d->loaded.wakeAll();
+    }
+
+private:
+    dtkSmartPointer<medAbstractData> read(const QSqlDatabase& database)
+    {
+        medDatabaseReader reader(index);
+        reader.setDatabase(database);
+        qint64 size = reader.getDataSize();
+
+        {
+            QMutexLocker locker(&d->mutex);
+            if (!d->wanted.contains(index) || d->used + size > d->budgetBytes)
+            {
+                return nullptr;
+            }
+            d->sizes.insert(index, size);
+            d->used += size;
+        }
+
+        dtkSmartPointer<medAbstractData> result = reader.run();
+        if (result)
+        {
+            result->moveToThread(QCoreApplication::instance()->thread());
+        }
+        return result;
+    }
+
+    medDataPrefetcherPrivate *d;
+    medDataIndex index;
+    QString databaseName;
+};
+
+// /////////////////////////////////////////////////////////////////
+// medDataPrefetcher
+// /////////////////////////////////////////////////////////////////
+
+medDataPrefetcher::medDataPrefetcher() : d(new medDataPrefetcherPrivate)
+{
+    medSettingsManager *settings = medSettingsManager::instance();
+    d->budgetSeries = settings->value("database", "prefetch_series", 2).toInt();
+    d->budgetBytes = settings->value("database", "prefetch_budget_mb", 1024).toLongLong() << 20;
+    d->used = 0;
+
+    d->pool.setMaxThreadCount(1);
+}
+
+medDataPrefetcher::~medDataPrefetcher()
+{
+    clear();
+    d->pool.waitForDone();
+
+    delete d;
+    d = nullptr;
+}
+
+/**
+ * @brief Read these series in the background, in this order.
+ *
+ * Series of a previous request that are not part of this one are dropped,
+ * whether they are still queued or already in memory.
+ */
+void medDataPrefetcher::prefetch(const QList<medDataIndex>& indexes)
+{
+    QMutexLocker locker(&d->mutex);
+
+    d->queued.clear();
+    d->wanted = QSet<medDataIndex>::fromList(indexes);
+
+    for (const medDataIndex& index : d->data.keys())
+    {
+        if (!d->wanted.contains(index))
+        {
+            d->data.remove(index);
+            d->release(index);
+        }
+    }
+
+    if (d->budgetSeries <= 0)
+    {
+        return;
+    }
+
+    const QString databaseName = medDatabaseController::instance()->database().databaseName();
+    for (const medDataIndex& index : indexes)
+    {
+        if (d->data.contains(index) || d->loading.contains(index) || d->queued.contains(index))
+        {
+            continue;
+        }
+        d->queued << index;
+        d->pool.start(new medDataPrefetchTask(d, index, databaseName));
+    }
+}
+
+/**
+ * @brief Drop the requests that have not started yet.
+ */
+void medDataPrefetcher::cancel()
+{
+    QMutexLocker locker(&d->mutex);
+    d->queued.clear();
+}
+
+/**
+ * @brief Drop all requests and prefetched series.
+ */
+void medDataPrefetcher::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->queued.clear();
+    d->wanted.clear();
+    for (const medDataIndex& index : d->data.keys())
+    {
+        d->release(index);
+    }
+    d->data.clear();
+}
+
+/**
+ * @brief Return the prefetched series, or null if it was not requested or
+ * could not be read. Waits if it is being read.
+ */
+dtkSmartPointer<medAbstractData> medDataPrefetcher::take(const medDataIndex& index)
+{
+    QMutexLocker locker(&d->mutex);
+
+    // the caller reads it itself rather than waiting for the queue
+    d->queued.removeOne(index);
+
+    while (d->loading.contains(index))
+    {
+        d->loaded.wait(&d->mutex);
+    }
+
+    d->wanted.remove(index);
+
+    dtkSmartPointer<medAbstractData> result = d->data.take(index);
+    if (result)
+    {
+        d->release(index);
+    }
+    return result;
+}
+
+void medDataPrefetcher::remove(const medDataIndex& index)
+{
+    QMutexLocker locker(&d->mutex);
+    d->queued.removeOne(index);
+    d->wanted.remove(index);
+    if (d->data.remove(index))
+    {
+        d->release(index);
+    }
+}
+
+int medDataPrefetcher::budgetSeries() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->budgetSeries;
+}
+
+/**
+ * @brief Number of series kept or being read at once. 0 disables prefetching.
+ */
+void medDataPrefetcher::setBudgetSeries(int count)
+{
+    {
+        QMutexLocker locker(&d->mutex);
+        d->budgetSeries = count;
+    }
+    medSettingsManager::instance()->setValue("database", "prefetch_series", count);
+}
+
+qint64 medDataPrefetcher::budgetBytes() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->budgetBytes;
+}
+
+/**
+ * @brief Size on disk of the series kept or being read at once.
+ */
+void medDataPrefetcher::setBudgetBytes(qint64 bytes)
+{
+    {
+        QMutexLocker locker(&d->mutex);
+        d->budgetBytes = bytes;
+    }
+    medSettingsManager::instance()->setValue("database", "prefetch_budget_mb", bytes >> 20);
+}
@@ -0,0 +1,56 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <dtkCoreSupport/dtkSmartPointer.h>
+
+#include <QList>
+
+#include <medCoreLegacyExport.h>
+#include <medDataIndex.h>
+
+class medAbstractData;
+class medDataPrefetcherPrivate;
+
+/**
+ * Reads series of the persistent database ahead of time, on a low-priority
+ * background thread, so that they are already in memory when opened.
+ *
+ * At most budgetSeries() series and budgetBytes() bytes of files are kept or
+ * being read at once. Each call to prefetch() cancels the requests that have
+ * not started yet; take() hands a prefetched series over, waiting for it if
+ * it is being read.
+ */
+class MEDCORELEGACY_EXPORT medDataPrefetcher
+{
+public:
+    medDataPrefetcher();
+    ~medDataPrefetcher();
+
+    void prefetch(const QList<medDataIndex>& indexes);
+    void cancel();
+    void clear();
+
+    dtkSmartPointer<medAbstractData> take(const medDataIndex& index);
+    void remove(const medDataIndex& index);
+
+    int budgetSeries() const;
+    void setBudgetSeries(int count);
+
+    qint64 budgetBytes() const;
+    void setBudgetBytes(qint64 bytes);
+
+private:
+    friend class medDataPrefetchTask;
+    medDataPrefetcherPrivate *d;
+};
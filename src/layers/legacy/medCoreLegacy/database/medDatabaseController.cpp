@@ -15,8 +15,11 @@
 #include "medDatabaseImporter.h"
 #include "medDatabaseReader.h"
 #include "medDatabaseRemover.h"
+#include "medDatabaseWriteBatch.h"
 #include "medStorage.h"
 
+#include <QScopedPointer>
+
 #include <medJobManagerL.h>
 #include <medMessageController.h>
 
@@ -25,6 +28,11 @@ class medDatabaseControllerPrivate
 public:
     void buildMetaDataLookup();
     bool isConnected;
+    bool hasFullTextSearch;
+
+    // Prepared statements of the edits made from the browser, each one
+    // committed on its own.
+    QScopedPointer<medDatabaseWriteBatch> writes;
     struct TableEntry {
         TableEntry( QString t, QString c, bool isPath_ = false ) : table(t), column(c), isPath(isPath_) {}
         QString table;
@@ -170,6 +178,9 @@ bool medDatabaseController::createConnection(void)
         return false;
     }
 
+    createIndexes();
+    d->hasFullTextSearch = createSearchTable();
+
     // optimize speed of sqlite db
     QSqlQuery query(m_database);
     if (!(query.prepare(QLatin1String("PRAGMA synchronous = 0"))
@@ -186,6 +197,7 @@ bool medDatabaseController::createConnection(void)
 
 bool medDatabaseController::closeConnection(void)
 {
+    d->writes.reset();
     m_database.close();
     QSqlDatabase::removeDatabase("QSQLITE");
     d->isConnected = false;
@@ -475,6 +487,146 @@ bool medDatabaseController::createSeriesTable()
     return true;
 }
 
+/**
+ * Indexes of the columns used to look up patients, studies and series, which
+ * would otherwise be found by scanning their table.
+ */
+bool medDatabaseController::createIndexes()
+{
+    QSqlQuery query(this->database());
+
+    bool result = true;
+    for (const QString& index : QStringList()
+         << "patient_name ON patient (name, birthdate)"
+         << "study_patient ON study (patient, name)"
+         << "study_uid ON study (uid)"
+         << "series_study ON series (study, name)"
+         << "series_uid ON series (uid)")
+    {
+        result = query.prepare("CREATE INDEX IF NOT EXISTS " + index) && EXEC_QUERY(query) && result;
+    }
+    return result;
+}
+
+namespace
+{
+    // Descriptive columns indexed in the full-text search table, named
+    // <table>_<column> there.
+    const QStringList searchColumns = QStringList()
+            << "patient.name" << "patient.birthdate" << "patient.gender" << "patient.patientId"
+            << "study.name" << "study.uid"
+            << "series.name" << "series.uid" << "series.size" << "series.age" << "series.description"
+            << "series.modality" << "series.protocol" << "series.comments" << "series.acquisitiondate"
+            << "series.importationdate" << "series.referee" << "series.performer" << "series.institution"
+            << "series.report";
+
+    QString searchColumnName(const QString& column)
+    {
+        return QString(column).replace('.', '_');
+    }
+
+    /** Fill the search table from the series matching this condition. */
+    QString searchInsert(const QString& condition)
+    {
+        QStringList names;
+        for (const QString& column : searchColumns)
+        {
+            names << searchColumnName(column);
+        }
+
+        return "INSERT INTO search (rowid, patient, study, " + names.join(", ") + ") "
+               "SELECT series.id, patient.id, study.id, " + searchColumns.join(", ") + " "
+               "FROM series JOIN study ON series.study = study.id JOIN patient ON study.patient = patient.id "
+               "WHERE " + condition;
+    }
+}
+
+/**
+ * Full-text search table over the descriptive metadata of the patients,
+ * studies and series, with one row per series (its rowid is the series id).
+ * It is indexed by trigrams, so that any part of a value can be searched,
+ * and kept up to date by triggers on the tables.
+ * Returns false if SQLite was built without FTS5 or its trigram tokenizer.
+ */
+bool medDatabaseController::createSearchTable()
+{
+    QSqlQuery query(this->database());
+
+    const QStringList triggerNames = QStringList()
+            << "search_series_insert" << "search_series_update" << "search_series_delete"
+            << "search_study_update" << "search_patient_update";
+
+    if (!query.exec("SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'search'"))
+    {
+        return false;
+    }
+    bool exists = query.first();
+
+    // tables of previous versions are indexed by words, which only matches their beginning
+    if (exists && !query.value(0).toString().contains("trigram"))
+    {
+        for (const QString& trigger : triggerNames)
+        {
+            query.exec("DROP TRIGGER IF EXISTS " + trigger);
+        }
+        if (!query.exec("DROP TABLE search"))
+        {
+            qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
+            return false;
+        }
+        exists = false;
+    }
+
+    QStringList names;
+    for (const QString& column : searchColumns)
+    {
+        names << searchColumnName(column);
+    }
+
+    if (!exists && !query.exec("CREATE VIRTUAL TABLE search USING fts5("
+                               "patient UNINDEXED, study UNINDEXED, " + names.join(", ") + ", "
+                               "tokenize = 'trigram')"))
+    {
+        qDebug() << "medDatabaseController: full-text search is not available:" << query.lastError().text();
+        return false;
+    }
+
+    const QString seriesOfStudy = "SELECT id FROM series WHERE study = OLD.id";
+    const QString seriesOfPatient = "SELECT series.id FROM series JOIN study ON series.study = study.id WHERE study.patient = OLD.id";
+
+    QStringList triggers = QStringList()
+            << "search_series_insert AFTER INSERT ON series BEGIN "
+               + searchInsert("series.id = NEW.id") + "; END"
+            << "search_series_update AFTER UPDATE ON series BEGIN "
+               "DELETE FROM search WHERE rowid = OLD.id; "
+               + searchInsert("series.id = NEW.id") + "; END"
+            << "search_series_delete AFTER DELETE ON series BEGIN "
+               "DELETE FROM search WHERE rowid = OLD.id; END"
+            << "search_study_update AFTER UPDATE ON study BEGIN "
+               "DELETE FROM search WHERE rowid IN (" + seriesOfStudy + "); "
+               + searchInsert("study.id = NEW.id") + "; END"
+            << "search_patient_update AFTER UPDATE ON patient BEGIN "
+               "DELETE FROM search WHERE rowid IN (" + seriesOfPatient + "); "
+               + searchInsert("patient.id = NEW.id") + "; END";
+
+    for (const QString& trigger : triggers)
+    {
+        if (!query.exec("CREATE TRIGGER IF NOT EXISTS " + trigger))
+        {
+            qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
+            return false;
+        }
+    }
+
+    if (!exists && !query.exec(searchInsert("1")))
+    {
+        qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
+        return false;
+    }
+
+    return true;
+}
+
 void medDatabaseController::addTextColumnToSeriesTableIfNeeded(QSqlQuery query, QString columnName)
 {
     bool isColumnThere = false;
@@ -634,6 +786,7 @@ medDatabaseController::medDatabaseController() : d(new medDatabaseControllerPriv
 {
     d->buildMetaDataLookup();
     d->isConnected = false;
+    d->hasFullTextSearch = false;
 }
 
 medDatabaseController::~medDatabaseController()
@@ -663,19 +816,21 @@ void medDatabaseController::remove( const medDataIndex& index )
  */
 QList<medDataIndex> medDatabaseController::moveStudy( const medDataIndex& indexStudy, const medDataIndex& toPatient)
 {
-    QSqlQuery query(this->database());
-
     bool result = false;
     QList<medDataIndex> newIndexList;
     medDataIndex newIndex;
 
     if(indexStudy.isValidForStudy() && toPatient.isValidForPatient())
     {
-        query.prepare("UPDATE study SET patient=:patientId WHERE id=:studyId");
+        medDatabaseWriteBatch& batch = writeBatch();
+        batch.beginItem();
+
+        QSqlQuery& query = batch.query("UPDATE study SET patient=:patientId WHERE id=:studyId");
         query.bindValue(":patientId", toPatient.patientId());
         query.bindValue(":studyId", indexStudy.studyId());
 
-        result = EXEC_QUERY(query);
+        batch.exec(query, __FILE__, __LINE__);
+        result = batch.endItem() && batch.commit();
 
         if(result)
         {
@@ -710,18 +865,20 @@ QList<medDataIndex> medDatabaseController::moveStudy( const medDataIndex& indexS
  */
 medDataIndex medDatabaseController::moveSeries( const medDataIndex& indexSeries, const medDataIndex& toStudy)
 {
-    QSqlQuery query(this->database());
-
     bool result = false;
     medDataIndex newIndex;
 
     if(indexSeries.isValidForSeries() && toStudy.isValidForStudy())
     {
-        query.prepare("UPDATE series SET study=:studyId  WHERE id=:seriesId");
+        medDatabaseWriteBatch& batch = writeBatch();
+        batch.beginItem();
+
+        QSqlQuery& query = batch.query("UPDATE series SET study=:studyId  WHERE id=:seriesId");
         query.bindValue(":studyId", toStudy.studyId());
         query.bindValue(":seriesId", indexSeries.seriesId());
 
-        result = EXEC_QUERY(query);
+        batch.exec(query, __FILE__, __LINE__);
+        result = batch.endItem() && batch.commit();
 
         if(result)
         {
@@ -737,6 +894,85 @@ medDataIndex medDatabaseController::moveSeries( const medDataIndex& indexSeries,
     return newIndex;
 }
 
+/**
+ * Series of which one of the metadata of these keys contains the text,
+ * ignoring the case. '*' and '?' are wildcards. The full-text search table
+ * is used for texts of at least 3 characters without wildcards (its trigrams
+ * can not match shorter ones), a LIKE pattern is matched otherwise.
+ */
+QList<medDataIndex> medDatabaseController::search(const QStringList& keys, const QString& text) const
+{
+    typedef medDatabaseControllerPrivate::TableEntryList TableEntryList;
+
+    QStringList columns;
+    for (const QString& key : keys)
+    {
+        for (const auto& entry : d->metaDataLookup.value(key, TableEntryList()))
+        {
+            if (!entry.isPath)
+            {
+                columns << entry.table + "." + entry.column;
+            }
+        }
+    }
+    columns.removeDuplicates();
+
+    QList<medDataIndex> ret;
+    if (columns.isEmpty())
+    {
+        return ret;
+    }
+
+    bool indexed = d->hasFullTextSearch;
+    QStringList names;
+    for (const QString& column : columns)
+    {
+        indexed = indexed && searchColumns.contains(column);
+        names << searchColumnName(column);
+    }
+
+    indexed = indexed && text.length() >= 3 && !text.contains(QRegExp("[*?]"));
+
+    QSqlQuery query(this->database());
+    if (indexed)
+    {
+        // a phrase of trigrams matches the text anywhere in a value
+        query.prepare("SELECT rowid, patient, study FROM search WHERE search MATCH :match");
+        query.bindValue(":match", "{" + names.join(" ") + "} : \"" + QString(text).replace("\"", "\"\"") + "\"");
+    }
+    else
+    {
+        QString pattern = "%" + QString(text).replace('*', '%').replace('?', '_') + "%";
+
+        QStringList conditions;
+        for (const QString& column : columns)
+        {
+            conditions << column + " LIKE :pattern";
+        }
+        query.prepare("SELECT series.id, patient.id, study.id "
+                      "FROM series JOIN study ON series.study = study.id JOIN patient ON study.patient = patient.id "
+                      "WHERE " + conditions.join(" OR "));
+        query.bindValue(":pattern", pattern);
+    }
+
+    if (!EXEC_QUERY(query))
+    {
+        return ret;
+    }
+
+    while (query.next())
+    {
+        ret << medDataIndex::makeSeriesIndex(this->dataSourceId(), query.value(1).toInt(),
+                                             query.value(2).toInt(), query.value(0).toInt());
+    }
+    return ret;
+}
+
+bool medDatabaseController::hasFullTextSearch() const
+{
+    return d->hasFullTextSearch;
+}
+
 /** Get metadata for specific item. Return uninitialized string if not present. */
 QString medDatabaseController::metaData(const medDataIndex& index,const QString& key) const
 {
@@ -800,14 +1036,14 @@ bool medDatabaseController::setMetaData( const medDataIndex& index, const QStrin
     typedef medDatabaseControllerPrivate::MetaDataMap MetaDataMap;
     typedef medDatabaseControllerPrivate::TableEntryList TableEntryList;
 
-    QSqlQuery query(this->database());
-
     // Attempt to translate the desired metadata into a table / column entry.
     MetaDataMap::const_iterator it(d->metaDataLookup.find(key));
     if (it == d->metaDataLookup.end() ) {
         return false;
     }
 
+    medDatabaseWriteBatch& batch = writeBatch();
+
     bool success (false);
 
     for ( TableEntryList::const_iterator entryIt(it.value().begin() ); entryIt != it.value().end(); ++entryIt ) {
@@ -831,11 +1067,13 @@ bool medDatabaseController::setMetaData( const medDataIndex& index, const QStrin
         }
         if ( id != -1 )
         {
-            query.prepare(QString("UPDATE %1 SET %2 = :value WHERE id = :id")
+            batch.beginItem();
+            QSqlQuery& query = batch.query(QString("UPDATE %1 SET %2 = :value WHERE id = :id")
                 .arg(tableName).arg(columnName) );
             query.bindValue(":value", value);
             query.bindValue(":id", id);
-            success = EXEC_QUERY(query);
+            batch.exec(query, __FILE__, __LINE__);
+            success = batch.endItem() && batch.commit();
             if ( success )
             {
                 break;
@@ -934,6 +1172,20 @@ bool medDatabaseController::isPersistent(  ) const
     return true;
 }
 
+/**
+ * Batch used for the edits of the database (metadata changes, moves): its
+ * statements are prepared once per connection and each edit is committed
+ * with its own transaction, rolled back if it fails.
+ */
+medDatabaseWriteBatch& medDatabaseController::writeBatch()
+{
+    if (!d->writes)
+    {
+        d->writes.reset(new medDatabaseWriteBatch(this->database(), 1));
+    }
+    return *d->writes;
+}
+
 bool medDatabaseController::execQuery(QSqlQuery& query, const char* file, int line) const
 {
     if (!query.exec())
@@ -22,6 +22,7 @@
 
 class medAbstractData;
 class medDatabaseControllerPrivate;
+class medDatabaseWriteBatch;
 class medJobItemL;
 
 /**
@@ -66,8 +67,13 @@ public:
 
     virtual bool isPersistent() const;
 
+    QList<medDataIndex> search(const QStringList& keys, const QString& text) const;
+    bool hasFullTextSearch() const;
+
     bool execQuery(QSqlQuery& query, const char* file = nullptr, int line = -1) const;
 
+    medDatabaseWriteBatch& writeBatch();
+
     void addTextColumnToSeriesTableIfNeeded(QSqlQuery query, QString columnName);
 
 public slots:
@@ -98,6 +104,9 @@ private:
     bool   createStudyTable();
     bool  createSeriesTable();
 
+    bool createIndexes();
+    bool createSearchTable();
+
     bool updateFromNoVersionToVersion1();
 
     QSqlDatabase m_database;
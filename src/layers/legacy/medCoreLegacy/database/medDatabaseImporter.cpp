@@ -19,6 +19,7 @@
 #include <medAbstractImageData.h>
 #include <medDatabaseImporter.h>
 #include <medDatabaseController.h>
+#include <medDatabaseWriteBatch.h>
 #include <medMetaDataKeys.h>
 #include <medStorage.h>
 
@@ -67,6 +68,25 @@ QString medDatabaseImporter::getPatientID(QString patientName, QString birthDate
     return patientID;
 }
 
+//-----------------------------------------------------------------------------------------------------------
+
+medDatabaseImporter::~medDatabaseImporter()
+{
+}
+
+//-----------------------------------------------------------------------------------------------------------
+
+void medDatabaseImporter::internalRun ( void )
+{
+    medAbstractDatabaseImporter::internalRun();
+
+    if ( m_batch )
+    {
+        m_batch->commit();
+        m_batch.reset();
+    }
+}
+
 //-----------------------------------------------------------------------------------------------------------
 /**
 * Populates database tables and generates thumbnails.
@@ -76,15 +96,28 @@ QString medDatabaseImporter::getPatientID(QString patientName, QString birthDate
 **/
 medDataIndex medDatabaseImporter::populateDatabaseAndGenerateThumbnails ( medAbstractData* medData, QString pathToStoreThumbnail )
 {
-    QSqlDatabase db = medDatabaseController::instance()->database();
-
     generateThumbnail ( medData, pathToStoreThumbnail );
 
-    int patientDbId = getOrCreatePatient ( medData, db );
+    // the rows of all the series of this import are written in a few transactions
+    if ( !m_batch )
+    {
+        m_batch.reset ( new medDatabaseWriteBatch ( medDatabaseController::instance()->database() ) );
+    }
+    medDatabaseWriteBatch& batch = *m_batch;
 
-    int studyDbId = getOrCreateStudy ( medData, db, patientDbId );
+    batch.beginItem();
 
-    int seriesDbId = getOrCreateSeries ( medData, db, studyDbId );
+    int patientDbId = getOrCreatePatient ( medData, batch );
+
+    int studyDbId = getOrCreateStudy ( medData, batch, patientDbId );
+
+    int seriesDbId = getOrCreateSeries ( medData, batch, studyDbId );
+
+    if ( !batch.endItem() )
+    {
+        // the patient, study and series rows were rolled back together
+        return medDataIndex();
+    }
 
     medDataIndex index = medDataIndex ( medDatabaseController::instance()->dataSourceId(), patientDbId, studyDbId, seriesDbId );
     return index;
@@ -95,24 +128,19 @@ medDataIndex medDatabaseImporter::populateDatabaseAndGenerateThumbnails ( medAbs
  * Retrieves the patient id of the existent (or newly created)
  * patient record in the patient table.
  */
-int medDatabaseImporter::getOrCreatePatient ( const medAbstractData* medData, QSqlDatabase db )
+int medDatabaseImporter::getOrCreatePatient ( const medAbstractData* medData, medDatabaseWriteBatch& batch )
 {
     int patientDbId = -1;
 
-    QSqlQuery query ( db );
-
     QString patientName = medMetaDataKeys::PatientName.getFirstValue(medData).simplified();
     QString birthDate = medMetaDataKeys::BirthDate.getFirstValue(medData);
     QString patientId = medMetaDataKeys::PatientID.getFirstValue(medData);
 
-    query.prepare ( "SELECT id FROM patient WHERE name = :name AND birthdate = :birthdate" );
+    QSqlQuery& query = batch.query ( "SELECT id FROM patient WHERE name = :name AND birthdate = :birthdate" );
     query.bindValue ( ":name", patientName );
     query.bindValue ( ":birthdate", birthDate );
 
-    if ( !query.exec() )
-    {
-        qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
-    }
+    batch.exec ( query, __FILE__, __LINE__ );
 
     if ( query.first() )
     {
@@ -123,15 +151,15 @@ int medDatabaseImporter::getOrCreatePatient ( const medAbstractData* medData, QS
         QString birthdate      = medMetaDataKeys::BirthDate.getFirstValue(medData);
         QString gender         = medMetaDataKeys::Gender.getFirstValue(medData);
 
-        query.prepare ( "INSERT INTO patient (name, thumbnail, birthdate, gender, patientId) VALUES (:name, :thumbnail, :birthdate, :gender, :patientId)" );
-        query.bindValue ( ":name", patientName );
-        query.bindValue ( ":thumbnail", QString("") );
-        query.bindValue ( ":birthdate", birthdate );
-        query.bindValue ( ":gender",    gender );
-        query.bindValue ( ":patientId", patientId);
-        query.exec();
+        QSqlQuery& insert = batch.query ( "INSERT INTO patient (name, thumbnail, birthdate, gender, patientId) VALUES (:name, :thumbnail, :birthdate, :gender, :patientId)" );
+        insert.bindValue ( ":name", patientName );
+        insert.bindValue ( ":thumbnail", QString("") );
+        insert.bindValue ( ":birthdate", birthdate );
+        insert.bindValue ( ":gender",    gender );
+        insert.bindValue ( ":patientId", patientId);
+        batch.exec ( insert, __FILE__, __LINE__ );
 
-        patientDbId = query.lastInsertId().toInt();
+        patientDbId = insert.lastInsertId().toInt();
     }
 
     return patientDbId;
@@ -142,12 +170,10 @@ int medDatabaseImporter::getOrCreatePatient ( const medAbstractData* medData, QS
  * Retrieves the study id of the existent (or newly created)
  * study record in the study table.
  */
-int medDatabaseImporter::getOrCreateStudy ( const medAbstractData* medData, QSqlDatabase db, int patientDbId )
+int medDatabaseImporter::getOrCreateStudy ( const medAbstractData* medData, medDatabaseWriteBatch& batch, int patientDbId )
 {
     int studyDbId = -1;
 
-    QSqlQuery query ( db );
-
     QString studyName   = medMetaDataKeys::StudyDescription.getFirstValue(medData).simplified();
     QString studyUid    = medMetaDataKeys::StudyInstanceUID.getFirstValue(medData);
     QString studyId     = medMetaDataKeys::StudyID.getFirstValue(medData);
@@ -158,15 +184,12 @@ int medDatabaseImporter::getOrCreateStudy ( const medAbstractData* medData, QSql
         return studyDbId;
     }
 
-    query.prepare ( "SELECT id FROM study WHERE patient = :patient AND name = :studyName AND uid = :studyUid" );
+    QSqlQuery& query = batch.query ( "SELECT id FROM study WHERE patient = :patient AND name = :studyName AND uid = :studyUid" );
     query.bindValue ( ":patient", patientDbId );
     query.bindValue ( ":studyName", studyName );
     query.bindValue ( ":studyUid", studyUid );
 
-    if ( !query.exec() )
-    {
-        qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
-    }
+    batch.exec ( query, __FILE__, __LINE__ );
 
     if ( query.first() )
     {
@@ -176,17 +199,17 @@ int medDatabaseImporter::getOrCreateStudy ( const medAbstractData* medData, QSql
     {
         QString refThumbPath = medMetaDataKeys::ThumbnailPath.getFirstValue(medData);
 
-        query.prepare ( "INSERT INTO study (patient, name, uid, thumbnail, studyId) "
+        QSqlQuery& insert = batch.query ( "INSERT INTO study (patient, name, uid, thumbnail, studyId) "
                         "VALUES (:patient, :studyName, :studyUid, :thumbnail, :studyId)" );
-        query.bindValue ( ":patient", patientDbId );
-        query.bindValue ( ":studyName", studyName );
-        query.bindValue ( ":studyUid", studyUid );
-        query.bindValue ( ":thumbnail", refThumbPath );
-        query.bindValue ( ":studyId", studyId);
+        insert.bindValue ( ":patient", patientDbId );
+        insert.bindValue ( ":studyName", studyName );
+        insert.bindValue ( ":studyUid", studyUid );
+        insert.bindValue ( ":thumbnail", refThumbPath );
+        insert.bindValue ( ":studyId", studyId);
 
-        query.exec();
+        batch.exec ( insert, __FILE__, __LINE__ );
 
-        studyDbId = query.lastInsertId().toInt();
+        studyDbId = insert.lastInsertId().toInt();
     }
 
     return studyDbId;
@@ -197,12 +220,10 @@ int medDatabaseImporter::getOrCreateStudy ( const medAbstractData* medData, QSql
  * Retrieves the series id of the existent (or newly created)
  * series record in the series table.
  */
-int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, QSqlDatabase db, int studyDbId )
+int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, medDatabaseWriteBatch& batch, int studyDbId )
 {
     int seriesDbId = -1;
 
-    QSqlQuery query ( db );
-
     QString seriesName     = medMetaDataKeys::SeriesDescription.getFirstValue(medData).simplified();
     QString seriesUid      = medMetaDataKeys::SeriesInstanceUID.getFirstValue(medData);
     QString seriesId       = medMetaDataKeys::SeriesID.getFirstValue(medData);
@@ -217,7 +238,7 @@ int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, QSq
     if( seriesName=="EmptySeries" )
         return seriesDbId;
 
-    query.prepare ( "SELECT * FROM series WHERE study = :study AND name = :seriesName AND uid = :seriesUid AND orientation = :orientation AND seriesNumber = :seriesNumber AND sequenceName = :sequenceName AND sliceThickness = :sliceThickness AND rows = :rows AND columns = :columns" );
+    QSqlQuery& query = batch.query ( "SELECT * FROM series WHERE study = :study AND name = :seriesName AND uid = :seriesUid AND orientation = :orientation AND seriesNumber = :seriesNumber AND sequenceName = :sequenceName AND sliceThickness = :sliceThickness AND rows = :rows AND columns = :columns" );
     query.bindValue ( ":study", studyDbId );
     query.bindValue ( ":seriesName", seriesName );
     query.bindValue ( ":seriesUid", seriesUid );
@@ -231,10 +252,7 @@ int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, QSq
     if( seriesName=="EmptySeries" )
         return seriesDbId;
 
-    if ( !query.exec() )
-    {
-        qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
-    }
+    batch.exec ( query, __FILE__, __LINE__ );
 
     if ( query.first() )
     {
@@ -271,7 +289,7 @@ int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, QSq
         QString repetitionTime  = medMetaDataKeys::RepetitionTime.getFirstValue(medData);
         QString acquisitionTime = medMetaDataKeys::AcquisitionTime.getFirstValue(medData);
 
-        query.prepare ( "INSERT INTO series (study, seriesId, size, name, path, uid, "
+        QSqlQuery& insert = batch.query ( "INSERT INTO series (study, seriesId, size, name, path, uid, "
                         "orientation, seriesNumber, sequenceName, sliceThickness, rows, columns, "
                         "thumbnail, age, description, modality, protocol, comments, "
                         "status, acquisitiondate, importationdate, referee, performer, institution, report, "
@@ -282,43 +300,40 @@ int medDatabaseImporter::getOrCreateSeries ( const medAbstractData* medData, QSq
                         ":status, :acquisitiondate, :importationdate, :referee, :performer, :institution, :report, "
                         ":origin, :flipAngle, :echoTime, :repetitionTime, :acquisitionTime)" );
 
-        query.bindValue ( ":study",          studyDbId );
-        query.bindValue ( ":seriesId",       seriesId );
-        query.bindValue ( ":size",           size );
-        query.bindValue ( ":seriesName",     seriesName );
-        query.bindValue ( ":seriesPath",     seriesPath );
-        query.bindValue ( ":seriesUid",      seriesUid );
-        query.bindValue ( ":orientation",    orientation );
-        query.bindValue ( ":seriesNumber",   seriesNumber );
-        query.bindValue ( ":sequenceName",   sequenceName );
-        query.bindValue ( ":sliceThickness", sliceThickness );
-        query.bindValue ( ":rows",           rows );
-        query.bindValue ( ":columns",        columns );
-        query.bindValue ( ":thumbnail",      refThumbPath );
-        query.bindValue ( ":age",            age );
-        query.bindValue ( ":description",    description );
-        query.bindValue ( ":modality",       modality );
-        query.bindValue ( ":protocol",       protocol );
-        query.bindValue ( ":comments",       comments );
-        query.bindValue ( ":status",         status );
-        query.bindValue ( ":acquisitiondate",acqdate );
-        query.bindValue ( ":importationdate",importdate );
-        query.bindValue ( ":referee",        referee );
-        query.bindValue ( ":performer",      performer );
-        query.bindValue ( ":institution",    institution );
-        query.bindValue ( ":report",         report );
-        query.bindValue ( ":origin",           origin );
-        query.bindValue ( ":flipAngle",        flipAngle );
-        query.bindValue ( ":echoTime",         echoTime );
-        query.bindValue ( ":repetitionTime",   repetitionTime );
-        query.bindValue ( ":acquisitionTime",  acquisitionTime );
-
-        if ( !query.exec() )
-        {
-            qDebug() << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
-        }
-
-        seriesDbId = query.lastInsertId().toInt();
+        insert.bindValue ( ":study",          studyDbId );
+        insert.bindValue ( ":seriesId",       seriesId );
+        insert.bindValue ( ":size",           size );
+        insert.bindValue ( ":seriesName",     seriesName );
+        insert.bindValue ( ":seriesPath",     seriesPath );
+        insert.bindValue ( ":seriesUid",      seriesUid );
+        insert.bindValue ( ":orientation",    orientation );
+        insert.bindValue ( ":seriesNumber",   seriesNumber );
+        insert.bindValue ( ":sequenceName",   sequenceName );
+        insert.bindValue ( ":sliceThickness", sliceThickness );
+        insert.bindValue ( ":rows",           rows );
+        insert.bindValue ( ":columns",        columns );
+        insert.bindValue ( ":thumbnail",      refThumbPath );
+        insert.bindValue ( ":age",            age );
+        insert.bindValue ( ":description",    description );
+        insert.bindValue ( ":modality",       modality );
+        insert.bindValue ( ":protocol",       protocol );
+        insert.bindValue ( ":comments",       comments );
+        insert.bindValue ( ":status",         status );
+        insert.bindValue ( ":acquisitiondate",acqdate );
+        insert.bindValue ( ":importationdate",importdate );
+        insert.bindValue ( ":referee",        referee );
+        insert.bindValue ( ":performer",      performer );
+        insert.bindValue ( ":institution",    institution );
+        insert.bindValue ( ":report",         report );
+        insert.bindValue ( ":origin",           origin );
+        insert.bindValue ( ":flipAngle",        flipAngle );
+        insert.bindValue ( ":echoTime",         echoTime );
+        insert.bindValue ( ":repetitionTime",   repetitionTime );
+        insert.bindValue ( ":acquisitionTime",  acquisitionTime );
+
+        batch.exec ( insert, __FILE__, __LINE__ );
+
+        seriesDbId = insert.lastInsertId().toInt();
     }
 
     return seriesDbId;
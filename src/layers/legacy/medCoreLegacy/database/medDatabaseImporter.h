@@ -12,13 +12,14 @@
 
 =========================================================================*/
 
-#include <QtSql/QSqlDatabase>
+#include <QScopedPointer>
 
 #include <medAbstractDatabaseImporter.h>
 #include <medCoreLegacyExport.h>
 #include <medDataIndex.h>
 
 class medAbstractData;
+class medDatabaseWriteBatch;
 
 /**
 * @class medDatabaseImporter
@@ -38,16 +39,21 @@ class MEDCORELEGACY_EXPORT medDatabaseImporter : public medAbstractDatabaseImpor
 public:
     medDatabaseImporter ( const QString& file, const QUuid& uuid, bool indexWithoutImporting = false);
     medDatabaseImporter ( medAbstractData* medData, const QUuid& callerUuid );
-    ~medDatabaseImporter() override = default;
+    ~medDatabaseImporter() override;
+
+protected:
+    void internalRun() override;
 
 private:
     QString ensureUniqueSeriesName ( const QString seriesName );
 
     medDataIndex populateDatabaseAndGenerateThumbnails ( medAbstractData* medData, QString pathToStoreThumbnail );
 
-    int getOrCreatePatient ( const medAbstractData* medData, QSqlDatabase db );
-    int getOrCreateStudy ( const medAbstractData* medData, QSqlDatabase db, int patientId );
-    int getOrCreateSeries ( const medAbstractData* medData, QSqlDatabase db, int studyId );
+    int getOrCreatePatient ( const medAbstractData* medData, medDatabaseWriteBatch& batch );
+    int getOrCreateStudy ( const medAbstractData* medData, medDatabaseWriteBatch& batch, int patientId );
+    int getOrCreateSeries ( const medAbstractData* medData, medDatabaseWriteBatch& batch, int studyId );
 
     QString getPatientID(QString patientName, QString birthDate);
+
+    QScopedPointer<medDatabaseWriteBatch> m_batch;
 };
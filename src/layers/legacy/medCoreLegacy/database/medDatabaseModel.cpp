@@ -194,11 +194,14 @@ QVariant medDatabaseModel::data(const QModelIndex& index, int role) const
     if( role==Qt::TextAlignmentRole && index.column() > 0)
         return Qt::AlignHCenter;
 
+    medAbstractDatabaseItem *item = static_cast<medAbstractDatabaseItem *>(index.internalPointer());
+
+    if (role == DataIndexRole)
+        return QVariant::fromValue(item->dataIndex());
+
     if (role != Qt::DisplayRole && role != Qt::EditRole)
         return QVariant();
 
-    medAbstractDatabaseItem *item = static_cast<medAbstractDatabaseItem *>(index.internalPointer());
-
     return item->data(index.column());
 }
 
@@ -929,6 +932,23 @@ void medDatabaseModel::updatePatient(const medDataIndex& dataIndex, bool updateC
     }
 }
 
+/**
+ * Metadata keys displayed in this column, by patients, studies or series.
+ */
+QStringList medDatabaseModel::columnAttributes(int column) const
+{
+    QStringList ret;
+    if (column < 0 || column >= d->DataCount)
+        return ret;
+
+    for (const QVariant& attribute : {d->ptAttributes[column], d->stAttributes[column], d->seAttributes[column]})
+    {
+        if (!attribute.toString().isEmpty())
+            ret << attribute.toString();
+    }
+    return ret;
+}
+
 /**
  * return a list of strings that represents the currently shown columns
  */
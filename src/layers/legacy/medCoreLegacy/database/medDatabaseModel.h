@@ -26,6 +26,8 @@ class MEDCORELEGACY_EXPORT medDatabaseModel : public QAbstractItemModel
     Q_OBJECT
 
 public:
+    enum { DataIndexRole = Qt::UserRole + 1 };
+
      medDatabaseModel(QObject *parent = nullptr, bool justBringStudies = false);
     ~medDatabaseModel();
 
@@ -60,6 +62,7 @@ public:
     QMimeData *mimeData(const QModelIndexList &indexes) const;
 
     QStringList columnNames() const;
+    QStringList columnAttributes(int column) const;
 
     bool hasChildren ( const QModelIndex & parent = QModelIndex() ) const;
 
@@ -13,6 +13,7 @@
 
 #include <QtCore>
 
+#include <medDatabaseModel.h>
 #include <medDatabaseProxyModel.h>
 
 medDatabaseProxyModel::medDatabaseProxyModel( QObject *parent /*= 0*/ ):
@@ -52,18 +53,56 @@ bool medDatabaseProxyModel::filterAcceptsColumn( int source_column, const QModel
 void medDatabaseProxyModel::setFilterRegExpWithColumn( const QRegExp &regExp, int column )
 {
     filterVector[column] = regExp;
+    searchResults.remove(column);
+    invalidateFilter();
+}
+
+/**
+ * Filter a column with the result of a database search: the rows of this data
+ * source are accepted if they are (or contain) one of the matching series,
+ * the rows of the other data sources are matched against the expression.
+ */
+void medDatabaseProxyModel::setFilterWithColumn( const QRegExp &regExp, int column, int dataSourceId, const QList<medDataIndex>& matchingSeries )
+{
+    SearchResult result;
+    result.dataSourceId = dataSourceId;
+    for (const medDataIndex& index : matchingSeries)
+    {
+        result.series.insert(index.seriesId());
+        result.studies.insert(index.studyId());
+        result.patients.insert(index.patientId());
+    }
+
+    filterVector[column] = regExp;
+    searchResults[column] = result;
     invalidateFilter();
 }
 
 void medDatabaseProxyModel::clearAllFilters()
 {
     filterVector.clear();
+    searchResults.clear();
 }
 
 bool medDatabaseProxyModel::customFilterAcceptsRow( int source_row, const QModelIndex & source_parent ) const
 {
     // get the current model index
     QModelIndex current(sourceModel()->index(source_row, 0, source_parent));
+
+    // rows of a searched data source are answered by the search
+    QHash<int, SearchResult>::const_iterator result = searchResults.constFind(currentKey);
+    if (result != searchResults.constEnd() && current.isValid())
+    {
+        medDataIndex dataIndex = current.data(medDatabaseModel::DataIndexRole).value<medDataIndex>();
+        if (dataIndex.dataSourceId() == result->dataSourceId)
+        {
+            if (dataIndex.isValidForSeries())
+                return result->series.contains(dataIndex.seriesId());
+            if (dataIndex.isValidForStudy())
+                return result->studies.contains(dataIndex.studyId());
+            return result->patients.contains(dataIndex.patientId());
+        }
+    }
     // get the data we want to check
     QModelIndex index = sourceModel()->index(source_row, currentKey, source_parent);
 
@@ -17,6 +17,7 @@
 #include <QVector>
 
 #include <medCoreLegacyExport.h>
+#include <medDataIndex.h>
 
 /**
  * Proxy model that sits between a model and a view and filters + sorts items
@@ -29,6 +30,7 @@ public:
     ~medDatabaseProxyModel();
 
     void setFilterRegExpWithColumn(const QRegExp &regExp, int column);
+    void setFilterWithColumn(const QRegExp &regExp, int column, int dataSourceId, const QList<medDataIndex>& matchingSeries);
 
     void clearAllFilters();
 
@@ -37,9 +39,19 @@ protected slots:
     bool filterAcceptsRow ( int source_row, const QModelIndex & source_parent ) const;
     bool customFilterAcceptsRow ( int source_row, const QModelIndex & source_parent ) const;
 private:
+    /** Series found by a database search, and their studies and patients. */
+    struct SearchResult
+    {
+        int dataSourceId;
+        QSet<int> series;
+        QSet<int> studies;
+        QSet<int> patients;
+    };
+
     mutable unsigned int isCheckingChildren;
     mutable unsigned int isCheckingParents;
     QHash<int,QRegExp> filterVector;
+    QHash<int,SearchResult> searchResults;
     mutable int currentKey;
     mutable QRegExp currentValue;
 };
@@ -27,6 +27,12 @@ class medDatabaseReaderPrivate
 {
 public:
     medDataIndex index;
+    QSqlDatabase database; // invalid to use the connection of medDatabaseController
+
+    QSqlDatabase connection() const
+    {
+        return database.isValid() ? database : medDatabaseController::instance()->database();
+    }
 };
 
 medDatabaseReader::medDatabaseReader ( const medDataIndex& index ) : QObject(), d ( new medDatabaseReaderPrivate )
@@ -41,6 +47,15 @@ medDatabaseReader::~medDatabaseReader()
     d = nullptr;
 }
 
+/**
+ * @brief Read through this connection rather than the one of
+ * medDatabaseController, which only belongs to the main thread.
+ */
+void medDatabaseReader::setDatabase(const QSqlDatabase& database)
+{
+    d->database = database;
+}
+
 #define FAILURE(msg) do {qDebug() <<  "medDatabaseReader::run: "<<(msg);emit failure(this);return nullptr;} while(0)
 
 medAbstractData* medDatabaseReader::run()
@@ -49,7 +64,7 @@ medAbstractData* medDatabaseReader::run()
     QVariant   studyDbId = d->index.studyId();
     QVariant  seriesDbId = d->index.seriesId();
 
-    QSqlQuery query(medDatabaseController::instance()->database());
+    QSqlQuery query(d->connection());
 
     QString patientName, birthdate, gender, patientId;
     QString studyName, studyUid, studyId;
@@ -209,6 +224,43 @@ medAbstractData* medDatabaseReader::run()
     return medData;
 }
 
+/**
+ * @brief Full paths of the files of the series, separated by ';'.
+ */
+QString medDatabaseReader::getFilePath()
+{
+    QSqlQuery query(d->connection());
+    query.prepare("SELECT path, isIndexed FROM series WHERE id = :id");
+    query.bindValue(":id", d->index.seriesId());
+
+    if (!query.exec() || !query.first())
+    {
+        return QString();
+    }
+
+    bool indexed = query.value(1).toBool();
+    QStringList filePaths = query.value(0).toString().split(';', QString::SkipEmptyParts);
+    for (QString& filePath : filePaths)
+    {
+        // Non-indexed file paths are relative to the DB directory
+        filePath.prepend(indexed ? QString() : medStorage::dataLocation());
+    }
+    return filePaths.join(';');
+}
+
+/**
+ * @brief Size on disk of the files of the series.
+ */
+qint64 medDatabaseReader::getDataSize()
+{
+    qint64 size = 0;
+    for (const QString& filePath : getFilePath().split(';', QString::SkipEmptyParts))
+    {
+        size += QFileInfo(filePath).size();
+    }
+    return size;
+}
+
 medAbstractData *medDatabaseReader::readFile( const QStringList& filenames )
 {
     medAbstractData *medData = nullptr;
@@ -21,6 +21,7 @@
 class medAbstractData;
 class medDatabaseReaderPrivate;
 class medDataIndex;
+class QSqlDatabase;
 
 class MEDCORELEGACY_EXPORT medDatabaseReader : public QObject
 {
@@ -30,6 +31,8 @@ public:
     medDatabaseReader(const medDataIndex& index);
     ~medDatabaseReader();
 
+    void setDatabase(const QSqlDatabase& database);
+
     medAbstractData *run();
 
     QString getFilePath();
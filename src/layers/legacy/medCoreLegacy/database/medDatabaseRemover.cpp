@@ -11,305 +11,363 @@
 
 =========================================================================*/
 
+#include <QRunnable>
 #include <QSqlError>
+#include <QThreadPool>
+#include <QUuid>
 
-#include <medAbstractData.h>
-#include <medAbstractDataFactory.h>
-#include <medAbstractImageData.h>
 #include <medDatabaseController.h>
 #include <medDatabaseRemover.h>
+#include <medDatabaseWriteBatch.h>
 #include <medDataIndex.h>
-#include <medDataManager.h>
 #include <medStorage.h>
 
-class medDatabaseRemoverPrivate
-{
-public:
-    medDataIndex index;
-    QSqlDatabase db;
-    static const QString T_PATIENT;
-    static const QString T_STUDY;
-    static const QString T_SERIES;
-
-    bool isCancelled;
-};
-
-const QString medDatabaseRemoverPrivate::T_PATIENT = "patient";
-const QString medDatabaseRemoverPrivate::T_STUDY = "study";
-const QString medDatabaseRemoverPrivate::T_SERIES = "series";
-
-medDatabaseRemover::medDatabaseRemover ( const medDataIndex &index_ ) : medJobItemL(), d ( new medDatabaseRemoverPrivate )
-{
-    d->index = index_;
-    d->db = medDatabaseController::instance()->database();
-    d->isCancelled = false;
-}
-
-medDatabaseRemover::~medDatabaseRemover()
-{
-    delete d;
-    d = nullptr;
-}
+#include <limits>
 
-void medDatabaseRemover::internalRun()
+namespace
 {
-    QSqlDatabase db( d->db );
-    QSqlQuery ptQuery ( db );
-
-    // Is Patient
-    const medDataIndex index = d->index;
-    if ( index.isValidForPatient() )
+    QString idList(const QList<int>& ids)
     {
-        ptQuery.prepare ( "SELECT id FROM " + d->T_PATIENT + " WHERE id = :id" );
-        ptQuery.bindValue ( ":id", index.patientId() );
+        QStringList list;
+        for (int id : ids)
+        {
+            list << QString::number(id);
+        }
+        return list.join(", ");
     }
-    else
+
+    //! Directories of the files being removed, inside the data location
+    QString trashLocation()
     {
-        ptQuery.prepare ( "SELECT id FROM " + d->T_PATIENT );
+        return medStorage::dataLocation() + "/trash";
     }
 
-    EXEC_QUERY ( ptQuery );
-    while ( ptQuery.next() )
+    /**
+     * Files of removed rows, moved away while the removal is not committed.
+     * Their names are free again once moved, so that importing the same data
+     * at once is not undone by the deletion.
+     */
+    class medDatabaseTrash
     {
-        if ( d->isCancelled )
-            break;
-
-        int patientDbId = ptQuery.value ( 0 ).toInt();
-        QSqlQuery stQuery ( db );
-
-        // Is Study
-        if ( index.isValidForStudy() )
+    public:
+        medDatabaseTrash()
+            : directory(trashLocation() + "/" + QUuid::createUuid().toString().remove('{').remove('}'))
         {
-            stQuery.prepare ( "SELECT id FROM " + d->T_STUDY + " WHERE id = :id AND patient = :patient" );
-            stQuery.bindValue ( ":id", index.studyId() );
         }
-        else
-        {
-            stQuery.prepare ( "SELECT id FROM " + d->T_STUDY + " WHERE patient = :patient" );
-        }
-        stQuery.bindValue ( ":patient", patientDbId );
 
-        EXEC_QUERY ( stQuery );
-        while ( stQuery.next() )
+        //! Move a data image file. Includes special cases for some file types.
+        void moveDataFile(const QString& filename)
         {
-            if ( d->isCancelled )
-                break;
+            QFileInfo fi(filename);
+            const QString suffix = fi.suffix();
+            const QString mhd("mhd");
+            const QString mha("mha");
 
-            int studyDbId = stQuery.value ( 0 ).toInt();
-            QSqlQuery seQuery ( db );
+            if (suffix == mhd)
+            {
+                QString mhaFile(filename);
+                mhaFile.chop(mhd.length());
+                mhaFile += mha;
+                moveFile(mhaFile);
+            }
+            else if (suffix == mha)
+            {
+                QString mhdFile(filename);
+                mhdFile.chop(mha.length());
+                mhdFile += mhd;
+                moveFile(mhdFile);
+            }
+
+            moveFile(filename);
+        }
 
-            // Is Series
-            if ( index.isValidForSeries() )
+        //! Move a single file, relative to the data location
+        void moveFile(const QString& filename)
+        {
+            QString source = medStorage::dataLocation() + filename;
+            if (!QFile::exists(source))
             {
-                seQuery.prepare ( "SELECT id FROM " + d->T_SERIES + " WHERE id = :id AND study = :study" );
-                seQuery.bindValue ( ":id", index.seriesId() );
+                return;
             }
-            else
+
+            QString target = directory + filename;
+            if (!QDir().mkpath(QFileInfo(target).path()) || !QFile::rename(source, target))
             {
-                seQuery.prepare ( "SELECT id FROM " + d->T_SERIES + " WHERE study = :study" );
+                qWarning() << "medDatabaseRemover: could not remove" << source;
+                return;
             }
-            seQuery.bindValue ( ":study", studyDbId );
+            moved << qMakePair(source, target);
+        }
 
-            EXEC_QUERY ( seQuery );
-            while ( seQuery.next() )
+        //! Put the files back, when the removal was rolled back
+        void restore()
+        {
+            for (int i = moved.size() - 1; i >= 0; --i)
             {
-                if ( d->isCancelled )
-                    break;
+                QFile::rename(moved.at(i).second, moved.at(i).first);
+            }
+            moved.clear();
+            QDir(directory).removeRecursively();
+        }
 
-                int seriesDbId = seQuery.value ( 0 ).toInt();
+        QString directory;
 
-                // Remove Series
-                this->removeSeries ( patientDbId, studyDbId, seriesDbId );
+    private:
+        QList<QPair<QString, QString> > moved; // original path, path in the trash
+    };
 
-                emit progress (this, 50 );
-            } // seQuery.next
+    //! Deletes the files of removed rows. Runs in the background, one removal after the other.
+    class medDatabaseFileRemoval : public QRunnable
+    {
+    public:
+        medDatabaseFileRemoval(const QString& trashDirectory)
+            : trashDirectory(trashDirectory)
+        {
+        }
 
-            // After removal of series, test if study is empty, and remove it if it is
-            if ( this->isStudyEmpty ( studyDbId ) )
-            {
-                this->removeStudy ( patientDbId, studyDbId );
-            }
+        void run() override
+        {
+            QDir(trashDirectory).removeRecursively();
+            QDir().rmdir(trashLocation()); // only removes if empty
 
-        } // stQuery.next
+            // stored files whose last series was removed
+            medStorage::collectGarbage();
+        }
 
-        // After removal of study, test if patient is empty, and remove it if it is
-        if ( this->isPatientEmpty ( patientDbId ) )
+        //! Single thread queue, so that removals never compete for the disk
+        static QThreadPool* queue()
         {
-            this->removePatient ( patientDbId );
+            static QThreadPool pool;
+            static const bool initialized = (pool.setMaxThreadCount(1), true);
+            Q_UNUSED(initialized);
+            return &pool;
         }
 
-    } // ptQuery.next
-    emit progress (this, 100 );
+    private:
+        QString trashDirectory;
+    };
 
-    if ( d->isCancelled )
-        emit failure ( this );
-    else
-        emit success ( this );
+    //! Remove the directories of a thumbnail once empty
+    void removeThumbnailDirectories(const QString& thumbnail)
+    {
+        // we want to remove the directory if empty
+        QFileInfo seriesFi(medStorage::dataLocation() + thumbnail);
+        if (seriesFi.dir().exists())
+        {
+            bool res = seriesFi.dir().rmdir(seriesFi.absolutePath()); // only removes if empty
+
+            // the series's directory has been deleted, let's check if the patient directory is empty
+            // this can happen after moving series
+            if (res)
+            {
+                QDir parentDir = seriesFi.dir();
+                res = parentDir.cdUp();
 
-    return;
+                if (res && parentDir.exists())
+                {
+                    seriesFi.dir().rmdir(parentDir.absolutePath()); // only removes if empty
+                }
+            }
+        }
+    }
 }
 
-void medDatabaseRemover::removeSeries ( int patientDbId, int studyDbId, int seriesDbId )
+class medDatabaseRemoverPrivate
 {
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
+public:
+    medDataIndex index;
+    QSqlDatabase db;
 
-    query.prepare ( "SELECT thumbnail, path, name  FROM " + d->T_SERIES + " WHERE id = :series " );
-    query.bindValue ( ":series", seriesDbId );
-    EXEC_QUERY ( query );
+    bool isCancelled;
 
-    if ( query.next() )
+    //! Conditions on the study table selecting the studies under the index
+    QString studyCondition() const
     {
-        QString path = query.value (1).toString();
+        QStringList conditions;
+        if (index.isValidForPatient())
+        {
+            conditions << "study.patient = :patient";
+        }
+        if (index.isValidForStudy())
+        {
+            conditions << "study.id = :study";
+        }
+        return conditions.isEmpty() ? QString("1") : conditions.join(" AND ");
+    }
 
-        // if path is empty then it was an indexed series
-        if ( !path.isNull() && !path.isEmpty() )
+    void bindIndex(QSqlQuery& query) const
+    {
+        if (index.isValidForPatient())
         {
-            this->removeDataFile(path);
+            query.bindValue(":patient", index.patientId());
+        }
+        if (index.isValidForStudy())
+        {
+            query.bindValue(":study", index.studyId());
+        }
+        if (index.isValidForSeries())
+        {
+            query.bindValue(":series", index.seriesId());
         }
-        removeThumbnailIfNeeded(query);
     }
+};
 
-    if( removeTableRow ( d->T_SERIES, seriesDbId ) )
-        emit removed(medDataIndex(1, patientDbId, studyDbId, seriesDbId));
+medDatabaseRemover::medDatabaseRemover ( const medDataIndex &index_ ) : medJobItemL(), d ( new medDatabaseRemoverPrivate )
+{
+    d->index = index_;
+    d->db = medDatabaseController::instance()->database();
+    d->isCancelled = false;
 }
 
-bool medDatabaseRemover::isStudyEmpty ( int studyDbId )
+medDatabaseRemover::~medDatabaseRemover()
 {
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
-
-    query.prepare ( "SELECT id FROM " + d->T_SERIES + " WHERE study = :study " );
-    query.bindValue ( ":study", studyDbId );
-    EXEC_QUERY ( query );
-    return !query.next();
+    delete d;
+    d = nullptr;
 }
 
-void medDatabaseRemover::removeStudy ( int patientDbId, int studyDbId )
+void medDatabaseRemover::internalRun()
 {
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
+    if ( d->isCancelled )
+    {
+        emit failure ( this );
+        return;
+    }
 
-    query.prepare ( "SELECT thumbnail, name, uid FROM " + d->T_STUDY + " WHERE id = :id " );
-    query.bindValue ( ":id", studyDbId );
+    const medDataIndex index = d->index;
+
+    QList<medDataIndex> removedIndexes;
+    QStringList dataFiles;
+    QStringList thumbnails;
+
+    // the whole removal is one item of its own batch, committed or rolled back
+    // at once by the commit below rather than automatically by endItem()
+    medDatabaseWriteBatch batch(d->db, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    batch.beginItem();
+
+    // series under the index
+    QString seriesCondition = d->studyCondition();
+    if ( index.isValidForSeries() )
+    {
+        seriesCondition += " AND series.id = :series";
+    }
 
-    EXEC_QUERY ( query );
+    QSqlQuery& seQuery = batch.query ( "SELECT series.id, study.id, study.patient, series.path, series.thumbnail"
+                                       " FROM series INNER JOIN study ON series.study = study.id"
+                                       " WHERE " + seriesCondition );
+    d->bindIndex ( seQuery );
+    batch.exec ( seQuery, __FILE__, __LINE__ );
 
-    if ( query.next() )
+    QList<int> seriesIds;
+    while ( seQuery.next() )
     {
-        medAbstractDbController * dbc = medDataManager::instance()->controllerForDataSource(d->index.dataSourceId());
-        if (dbc->metaData(d->index,  medMetaDataKeys::StudyID.key()).toInt() == studyDbId)
+        int seriesDbId = seQuery.value ( 0 ).toInt();
+        seriesIds << seriesDbId;
+        removedIndexes << medDataIndex ( 1, seQuery.value ( 2 ).toInt(), seQuery.value ( 1 ).toInt(), seriesDbId );
+
+        // if path is empty then it was an indexed series
+        QString path = seQuery.value ( 3 ).toString();
+        if ( !path.isEmpty() )
         {
-            removeThumbnailIfNeeded(query);
+            dataFiles << path;
         }
+        thumbnails << seQuery.value ( 4 ).toString();
     }
 
-    if( removeTableRow ( d->T_STUDY, studyDbId ) )
-        emit removed(medDataIndex(1, patientDbId, studyDbId, -1));
-}
-
-bool medDatabaseRemover::isPatientEmpty ( int patientDbId )
-{
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
+    if ( !seriesIds.isEmpty() )
+    {
+        QSqlQuery& deleteSeries = batch.query ( "DELETE FROM series WHERE id IN (" + idList ( seriesIds ) + ")" );
+        batch.exec ( deleteSeries, __FILE__, __LINE__ );
+    }
 
-    query.prepare ( "SELECT id FROM " + d->T_STUDY + " WHERE patient = :patient " );
-    query.bindValue ( ":patient", patientDbId );
-    EXEC_QUERY ( query );
-    return !query.next();
-}
+    // studies left without series
+    QSqlQuery& stQuery = batch.query ( "SELECT id, patient, thumbnail FROM study"
+                                       " WHERE " + d->studyCondition() +
+                                       " AND NOT EXISTS (SELECT 1 FROM series WHERE series.study = study.id)" );
+    d->bindIndex ( stQuery );
+    batch.exec ( stQuery, __FILE__, __LINE__ );
 
-void medDatabaseRemover::removePatient ( int patientDbId )
-{
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
+    QList<int> studyIds;
+    while ( stQuery.next() )
+    {
+        int studyDbId = stQuery.value ( 0 ).toInt();
+        studyIds << studyDbId;
+        removedIndexes << medDataIndex ( 1, stQuery.value ( 1 ).toInt(), studyDbId, -1 );
+        thumbnails << stQuery.value ( 2 ).toString();
+    }
 
-    QString patientId;
+    if ( !studyIds.isEmpty() )
+    {
+        QSqlQuery& deleteStudies = batch.query ( "DELETE FROM study WHERE id IN (" + idList ( studyIds ) + ")" );
+        batch.exec ( deleteStudies, __FILE__, __LINE__ );
+    }
 
-    query.prepare ( "SELECT thumbnail, patientId  FROM " + d->T_PATIENT + " WHERE id = :patient " );
-    query.bindValue ( ":patient", patientDbId );
-    EXEC_QUERY ( query );
-    if ( query.next() )
+    // patients left without studies
+    QSqlQuery& ptQuery = batch.query ( QString ( "SELECT id, thumbnail FROM patient WHERE " ) +
+                                       ( index.isValidForPatient() ? "id = :patient" : "1" ) +
+                                       " AND NOT EXISTS (SELECT 1 FROM study WHERE study.patient = patient.id)" );
+    if ( index.isValidForPatient() )
     {
-        removeThumbnailIfNeeded(query);
-        patientId = query.value ( 1 ).toString();
+        ptQuery.bindValue ( ":patient", index.patientId() );
     }
-    if( removeTableRow ( d->T_PATIENT, patientDbId ) )
-        emit removed(medDataIndex(1, patientDbId, -1, -1));
-}
+    batch.exec ( ptQuery, __FILE__, __LINE__ );
 
-bool medDatabaseRemover::removeTableRow ( const QString &table, int id )
-{
-    QSqlDatabase db(d->db);
-    QSqlQuery query ( db );
-    query.prepare ( "DELETE FROM " + table + " WHERE id = :id" );
-    query.bindValue ( ":id", id );
-    EXEC_QUERY ( query );
+    QList<int> patientIds;
+    while ( ptQuery.next() )
+    {
+        int patientDbId = ptQuery.value ( 0 ).toInt();
+        patientIds << patientDbId;
+        removedIndexes << medDataIndex ( 1, patientDbId, -1, -1 );
+        thumbnails << ptQuery.value ( 1 ).toString();
+    }
 
-    return (query.numRowsAffected()==1);
-}
+    if ( !patientIds.isEmpty() )
+    {
+        QSqlQuery& deletePatients = batch.query ( "DELETE FROM patient WHERE id IN (" + idList ( patientIds ) + ")" );
+        batch.exec ( deletePatients, __FILE__, __LINE__ );
+    }
 
-//! Remove a single file
-void medDatabaseRemover::removeFile ( const QString & filename )
-{
-    QFile file ( medStorage::dataLocation() + filename );
-    file.remove();
-}
+    thumbnails.removeAll ( QString() );
 
-void medDatabaseRemover::removeThumbnailIfNeeded(QSqlQuery query)
-{
-    QString thumbnail = query.value(0).toString();
+    // the files are moved away before the rows are committed, then deleted
+    medDatabaseTrash trash;
+    for ( const QString& dataFile : dataFiles )
+    {
+        trash.moveDataFile ( dataFile );
+    }
+    for ( const QString& thumbnail : thumbnails )
+    {
+        trash.moveFile ( thumbnail );
+    }
 
-    this->removeFile ( thumbnail );
+    bool kept = batch.endItem();
+    if ( !batch.commit() || !kept )
+    {
+        qWarning() << "medDatabaseRemover: removal of" << index << "was rolled back";
+        trash.restore();
+        emit failure ( this );
+        return;
+    }
 
-    // we want to remove the directory if empty
-    QFileInfo seriesFi ( medStorage::dataLocation() + thumbnail );
-    if ( seriesFi.dir().exists() )
+    for ( const QString& thumbnail : thumbnails )
     {
-        bool res = seriesFi.dir().rmdir ( seriesFi.absolutePath() ); // only removes if empty
+        removeThumbnailDirectories ( thumbnail );
+    }
 
-        // the series's directory has been deleted, let's check if the patient directory is empty
-        // this can happen after moving series
-        if(res)
-        {
-            QDir parentDir = seriesFi.dir();
-            res = parentDir.cdUp();
+    emit progress ( this, 50 );
 
-            if ( res && parentDir.exists() )
-            {
-                res = seriesFi.dir().rmdir ( parentDir.absolutePath() ); // only removes if empty
-            }
-        }
+    // the rows are gone, the views can be updated while the files are deleted
+    for ( const medDataIndex& removedIndex : removedIndexes )
+    {
+        emit removed ( removedIndex );
     }
+
+    medDatabaseFileRemoval::queue()->start ( new medDatabaseFileRemoval ( trash.directory ) );
+
+    emit progress ( this, 100 );
+    emit success ( this );
 }
 
 void medDatabaseRemover::onCancel ( QObject* )
 {
     d->isCancelled = true;
 }
-
-//! Remove a data image file. Includes special cases for some file types.
-void medDatabaseRemover::removeDataFile(const QString & filename)
-{
-    QFileInfo fi ( filename );
-    const QString suffix = fi.suffix();
-    const QString mhd ( "mhd" );
-    const QString mha ( "mha" );
-
-    if ( suffix == mhd )
-    {
-        QString mhaFile ( filename );
-        mhaFile.chop ( mhd.length() );
-        mhaFile += mha;
-        this->removeFile ( mhaFile );
-    }
-    else if ( suffix == mha )
-    {
-        QString mhdFile ( filename );
-        mhdFile.chop ( mha.length() );
-        mhdFile += mhd;
-        this->removeFile ( mhdFile );
-    }
-
-    this->removeFile ( filename );
-}
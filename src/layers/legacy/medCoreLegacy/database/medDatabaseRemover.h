@@ -12,7 +12,6 @@
 
 =========================================================================*/
 
-#include <QSqlQuery>
 #include <QtCore/QObject>
 
 #include <medCoreLegacyExport.h>
@@ -24,6 +23,11 @@ class medDatabaseRemoverPrivate;
 /**
  * @class medDatabaseRemover
  * @brief Removes given data from the database.
+ *
+ * The series under the index, then the studies and patients left empty, are
+ * deleted with set-based statements in a single transaction. The files of the
+ * removed rows are deleted afterwards by a background queue, so that the
+ * removed() signals are emitted as soon as the transaction is committed.
  */
 class MEDCORELEGACY_EXPORT medDatabaseRemover : public medJobItemL
 {
@@ -47,19 +51,6 @@ public slots:
 protected:
     virtual void internalRun();
 
-    void removeSeries( int patientId, int studyId, int seriesId );
-
-    bool isStudyEmpty( int studyId );
-    void removeStudy( int patientId, int studyId );
-
-    bool isPatientEmpty( int patientId );
-    void removePatient( int patientId );
-
-    void removeFile( const QString & filename );
-    void removeThumbnailIfNeeded(QSqlQuery query);
-    void removeDataFile(const QString & filename );
-    bool removeTableRow( const QString &table, int id );
-
 private:
     medDatabaseRemoverPrivate *d;
 };
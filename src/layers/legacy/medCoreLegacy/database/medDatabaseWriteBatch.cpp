@@ -0,0 +1,408 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <medDatabaseWriteBatch.h>
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSqlError>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <dtkCoreSupport/dtkGlobal.h>
+
+class medDatabaseWriteBatchPrivate;
+
+namespace
+{
+    QAtomicInt s_batchCount;
+
+    /**
+     * State of a connection shared by the batches using it. At most one
+     * transaction of a batch is open on the connection at a time.
+     */
+    struct medDatabaseConnectionState
+    {
+        medDatabaseConnectionState() : owner(nullptr), waiting(0) {}
+
+        QMutex mutex; // guards the state and every statement of the batches
+        QWaitCondition itemEnded;
+        medDatabaseWriteBatchPrivate *owner; // batch whose transaction is open
+        int waiting; // batches of other threads waiting for the item of the owner
+    };
+
+    QMutex s_connectionsMutex;
+    QHash<QString, QSharedPointer<medDatabaseConnectionState> > s_connections;
+
+    QSharedPointer<medDatabaseConnectionState> connectionState(const QSqlDatabase& db)
+    {
+        QMutexLocker locker(&s_connectionsMutex);
+        QSharedPointer<medDatabaseConnectionState>& state = s_connections[db.connectionName()];
+        if (!state)
+        {
+            state.reset(new medDatabaseConnectionState);
+        }
+        return state;
+    }
+}
+
+class medDatabaseWriteBatchPrivate
+{
+public:
+    QSqlDatabase db;
+    QHash<QString, QSqlQuery> statements;
+    QSharedPointer<medDatabaseConnectionState> connection;
+    QThread *thread;
+
+    QString savepoint;
+    QString itemSavepoint;
+    int itemsPerTransaction;
+    int maximumTransactionTime;
+
+    bool inTransaction;
+    medDatabaseWriteBatchPrivate *outer; // batch whose item contains the transaction, if nested
+    bool inItem;
+    bool itemFailed;
+    bool commitFailed; // the transaction was closed by acquireConnection() of another batch
+    int itemsInTransaction;
+    QElapsedTimer transactionTimer;
+
+    medDatabaseWriteBatch::Statistics statistics;
+
+    void acquireConnection(QMutexLocker& locker);
+    bool commitTransaction();
+    bool execStatement(const QString& sql);
+};
+
+/**
+ * Wait until this batch can open its transaction, with the mutex of the
+ * connection held. Three cases, depending on the batch owning the open
+ * transaction:
+ * - it is writing an item from this thread (e.g. a slot called during that
+ *   item): this batch nests into the item;
+ * - it is writing an item from another thread: wait for the end of the item,
+ *   its owner then commits since a batch is waiting;
+ * - it is between two items: its owner may not write again before long, its
+ *   transaction is committed here. The owner learns the result from its next
+ *   commit().
+ */
+void medDatabaseWriteBatchPrivate::acquireConnection(QMutexLocker& locker)
+{
+    outer = nullptr;
+    while (connection->owner)
+    {
+        medDatabaseWriteBatchPrivate *owner = connection->owner;
+        if (owner->inItem && owner->thread == thread)
+        {
+            outer = owner;
+            return;
+        }
+        if (owner->inItem)
+        {
+            connection->waiting++;
+            connection->itemEnded.wait(locker.mutex());
+            connection->waiting--;
+        }
+        else if (!owner->commitTransaction())
+        {
+            owner->commitFailed = true;
+        }
+    }
+    connection->owner = this;
+}
+
+/**
+ * Commit the transaction, with the mutex of the connection held.
+ */
+bool medDatabaseWriteBatchPrivate::commitTransaction()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // pending reads would keep the transaction open
+    for (QSqlQuery& query : statements)
+    {
+        query.finish();
+    }
+
+    bool result = execStatement("RELEASE " + savepoint);
+    if (!result)
+    {
+        execStatement("ROLLBACK TO " + savepoint);
+        execStatement("RELEASE " + savepoint);
+        statistics.failedItems += itemsInTransaction;
+    }
+
+    statistics.commitTime += timer.nsecsElapsed();
+    statistics.transactions++;
+
+    inTransaction = false;
+    itemsInTransaction = 0;
+    if (connection->owner == this)
+    {
+        connection->owner = nullptr;
+        connection->itemEnded.wakeAll();
+    }
+    return result;
+}
+
+bool medDatabaseWriteBatchPrivate::execStatement(const QString& sql)
+{
+    QSqlQuery query(db);
+    if (!query.exec(sql))
+    {
+        qWarning() << "medDatabaseWriteBatch:" << sql << "failed";
+        qDebug() << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+// /////////////////////////////////////////////////////////////////
+// medDatabaseWriteBatch::Statistics
+// /////////////////////////////////////////////////////////////////
+
+medDatabaseWriteBatch::Statistics::Statistics()
+    : items(0), failedItems(0), statements(0), transactions(0), statementTime(0), commitTime(0)
+{
+}
+
+/**
+ * @brief Statement and commit time per item, in milliseconds.
+ */
+double medDatabaseWriteBatch::Statistics::averageItemTime() const
+{
+    return items ? (statementTime + commitTime) / 1.0e6 / items : 0.0;
+}
+
+// /////////////////////////////////////////////////////////////////
+// medDatabaseWriteBatch
+// /////////////////////////////////////////////////////////////////
+
+medDatabaseWriteBatch::medDatabaseWriteBatch(const QSqlDatabase& db, int itemsPerTransaction, int maximumTransactionTime)
+    : d(new medDatabaseWriteBatchPrivate)
+{
+    d->db = db;
+    d->connection = connectionState(db);
+    d->thread = QThread::currentThread();
+    d->savepoint = QString("batch_%1").arg(s_batchCount.fetchAndAddRelaxed(1));
+    d->itemSavepoint = d->savepoint + "_item";
+    d->itemsPerTransaction = qMax(1, itemsPerTransaction);
+    d->maximumTransactionTime = maximumTransactionTime;
+    d->inTransaction = false;
+    d->outer = nullptr;
+    d->inItem = false;
+    d->itemFailed = false;
+    d->commitFailed = false;
+    d->itemsInTransaction = 0;
+}
+
+medDatabaseWriteBatch::~medDatabaseWriteBatch()
+{
+    if (d->inItem)
+    {
+        // an unfinished item is an interrupted one
+        d->itemFailed = true;
+        endItem();
+    }
+    commit();
+
+    // statements must be finished before the connection is used elsewhere
+    {
+        QMutexLocker locker(&d->connection->mutex);
+        d->statements.clear();
+    }
+
+    delete d;
+    d = nullptr;
+}
+
+/**
+ * @brief Return the statement for this SQL, prepared the first time it is requested.
+ */
+QSqlQuery& medDatabaseWriteBatch::query(const QString& sql)
+{
+    auto it = d->statements.find(sql);
+    if (it == d->statements.end())
+    {
+        QMutexLocker locker(&d->connection->mutex);
+        it = d->statements.insert(sql, QSqlQuery(d->db));
+        if (!it->prepare(sql))
+        {
+            qDebug() << DTK_COLOR_FG_RED << it->lastError() << DTK_NO_COLOR;
+            qDebug() << "The query was: " << sql.simplified();
+        }
+    }
+    return it.value();
+}
+
+/**
+ * @brief Execute a statement. A failure marks the current item as failed.
+ */
+bool medDatabaseWriteBatch::exec(QSqlQuery& query, const char* file, int line)
+{
+    QMutexLocker locker(&d->connection->mutex);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool result = query.exec();
+
+    d->statistics.statementTime += timer.nsecsElapsed();
+    d->statistics.statements++;
+
+    if (!result)
+    {
+        qDebug() << file << "(" << line << ") :" << DTK_COLOR_FG_RED << query.lastError() << DTK_NO_COLOR;
+        qDebug() << "The query was: " << query.lastQuery().simplified();
+        d->itemFailed = true;
+    }
+    return result;
+}
+
+bool medDatabaseWriteBatch::beginItem()
+{
+    if (d->inItem)
+    {
+        qWarning() << "medDatabaseWriteBatch: item already begun";
+        return false;
+    }
+
+    QMutexLocker locker(&d->connection->mutex);
+
+    if (!d->inTransaction)
+    {
+        d->acquireConnection(locker);
+        if (!d->execStatement("SAVEPOINT " + d->savepoint))
+        {
+            if (d->connection->owner == d)
+            {
+                d->connection->owner = nullptr;
+                d->connection->itemEnded.wakeAll();
+            }
+            return false;
+        }
+        d->inTransaction = true;
+        d->itemsInTransaction = 0;
+        d->transactionTimer.start();
+    }
+
+    if (!d->execStatement("SAVEPOINT " + d->itemSavepoint))
+    {
+        return false;
+    }
+
+    d->inItem = true;
+    d->itemFailed = false;
+    return true;
+}
+
+/**
+ * @brief End the current item, rolling it back if one of its statements failed.
+ * @return true if the item was kept. It is only stored once commit() succeeds.
+ */
+bool medDatabaseWriteBatch::endItem()
+{
+    if (!d->inItem)
+    {
+        return false;
+    }
+    QMutexLocker locker(&d->connection->mutex);
+    d->inItem = false;
+
+    bool kept = !d->itemFailed;
+    if (!kept)
+    {
+        d->execStatement("ROLLBACK TO " + d->itemSavepoint);
+        d->statistics.failedItems++;
+    }
+    d->execStatement("RELEASE " + d->itemSavepoint);
+
+    d->statistics.items++;
+    d->itemsInTransaction++;
+
+    if (d->outer)
+    {
+        // the item is only stored with the one it is nested in
+        if (!kept)
+        {
+            d->outer->itemFailed = true;
+        }
+        return kept;
+    }
+
+    d->connection->itemEnded.wakeAll();
+
+    if (d->inTransaction &&
+            (d->itemsInTransaction >= d->itemsPerTransaction
+             || d->transactionTimer.elapsed() >= d->maximumTransactionTime
+             || d->connection->waiting > 0))
+    {
+        if (!d->commitTransaction())
+        {
+            d->commitFailed = true;
+        }
+    }
+    return kept;
+}
+
+/**
+ * @brief Commit the items written since the last commit.
+ * @return false if the items could not be stored, including when another
+ * batch committed them on this connection since the last call. The items of
+ * a nested batch are released into the item of the outer batch: false if
+ * that item already failed, and they are rolled back with it if it fails
+ * afterwards.
+ */
+bool medDatabaseWriteBatch::commit()
+{
+    if (d->inItem)
+    {
+        return false;
+    }
+
+    QMutexLocker locker(&d->connection->mutex);
+
+    bool result = !d->commitFailed;
+    d->commitFailed = false;
+
+    if (d->inTransaction)
+    {
+        result = d->commitTransaction() && result;
+    }
+    if (d->outer)
+    {
+        result = result && !d->outer->itemFailed;
+        d->outer = nullptr;
+    }
+    return result;
+}
+
+int medDatabaseWriteBatch::itemsPerTransaction() const
+{
+    return d->itemsPerTransaction;
+}
+
+int medDatabaseWriteBatch::maximumTransactionTime() const
+{
+    return d->maximumTransactionTime;
+}
+
+medDatabaseWriteBatch::Statistics medDatabaseWriteBatch::statistics() const
+{
+    return d->statistics;
+}
@@ -0,0 +1,78 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include <medCoreLegacyExport.h>
+
+class medDatabaseWriteBatchPrivate;
+
+/**
+* @class medDatabaseWriteBatch
+* @brief Groups database writes into explicit transactions and caches their prepared statements.
+*
+* Writes are grouped by item (e.g. the patient, study and series rows of one
+* imported series): beginItem() / endItem(). An item whose statements failed is
+* rolled back alone, through a SAVEPOINT, without losing the other items of the
+* transaction. The transaction is committed every itemsPerTransaction() items,
+* when it has been open for longer than maximumTransactionTime() milliseconds,
+* by commit(), or when the batch is destroyed.
+*
+* Batches sharing a connection, from any thread, never write into the
+* transaction of another one, and run their statements under the mutex of
+* the connection. A batch starting a transaction waits for the item being
+* written by another thread, and commits the transaction left open between
+* two items. A batch opened by the thread writing an item nests into that
+* item instead: its items succeed or fail with it.
+*
+* Statements returned by query() are prepared once per batch.
+**/
+class MEDCORELEGACY_EXPORT medDatabaseWriteBatch
+{
+public:
+    struct Statistics
+    {
+        Statistics();
+
+        qint64 items;
+        qint64 failedItems;
+        qint64 statements;
+        qint64 transactions;
+        qint64 statementTime; // nanoseconds
+        qint64 commitTime;    // nanoseconds
+
+        double averageItemTime() const; // milliseconds
+    };
+
+public:
+    medDatabaseWriteBatch(const QSqlDatabase& db, int itemsPerTransaction = 64, int maximumTransactionTime = 250);
+    ~medDatabaseWriteBatch();
+
+    QSqlQuery& query(const QString& sql);
+    bool exec(QSqlQuery& query, const char* file = nullptr, int line = -1);
+
+    bool beginItem();
+    bool endItem();
+
+    bool commit();
+
+    int itemsPerTransaction() const;
+    int maximumTransactionTime() const;
+
+    Statistics statistics() const;
+
+private:
+    medDatabaseWriteBatchPrivate *d;
+};
@@ -13,16 +13,93 @@
 
 #include <medStorage.h>
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
 #include <QtGui/QDesktopServices>
 
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
 #include <dtkLog>
 
 #include <medSettingsManager.h>
 
 QString medStorage::m_dataLocation = nullptr;
 
+namespace
+{
+    bool hardLink(const QString& target, const QString& link)
+    {
+#if defined(Q_OS_WIN)
+        return CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(link).utf16()),
+                               reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(target).utf16()),
+                               nullptr);
+#else
+        return ::link(QFile::encodeName(target).constData(), QFile::encodeName(link).constData()) == 0;
+#endif
+    }
+
+    //! Number of paths referring to this file, 0 if it cannot be read.
+    int linkCount(const QString& path)
+    {
+#if defined(Q_OS_WIN)
+        HANDLE handle = CreateFileW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(path).utf16()), 0,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            return 0;
+        }
+        BY_HANDLE_FILE_INFORMATION info;
+        int count = GetFileInformationByHandle(handle, &info) ? static_cast<int>(info.nNumberOfLinks) : 0;
+        CloseHandle(handle);
+        return count;
+#else
+        struct stat info;
+        if (::stat(QFile::encodeName(path).constData(), &info) != 0)
+        {
+            return 0;
+        }
+        return static_cast<int>(info.st_nlink);
+#endif
+    }
+
+    class medStorageCopyTask : public QRunnable
+    {
+    public:
+        medStorageCopyTask(const QString& source, const QString& destination, QAtomicInt *failures)
+            : source(source), destination(destination), failures(failures) {}
+
+        void run()
+        {
+            if (!medStorage::cloneFile(source, destination))
+            {
+                qWarning() << "[Failure] copying file: " << source << " to " << destination;
+                failures->ref();
+            }
+        }
+
+    private:
+        QString source;
+        QString destination;
+        QAtomicInt *failures;
+    };
+}
+
 medStorage::medStorage()
 {
 }
@@ -155,22 +232,52 @@ bool medStorage::createDestination(QStringList sourceList, QStringList& destList
     return res;
 }
 
+/**
+ * @brief Copy the files on several threads, setting "database/copy_threads" (4 by default).
+ * @return false if a file could not be copied.
+ */
 bool medStorage::copyFiles(QStringList sourceList, QStringList destList)
 {
     if (destList.count() != sourceList.count())
         return false;
 
-    // just copy not using a dialog
-    for (int i = 0; i < sourceList.count(); i++) {
-        // coping
-        if (!QFile::copy(sourceList.at(i), destList.at(i)))
+    QAtomicInt failures(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, medSettingsManager::instance()->value("database", "copy_threads", 4).toInt()));
+    for (int i = 0; i < sourceList.count(); i++)
+    {
+        pool.start(new medStorageCopyTask(sourceList.at(i), destList.at(i), &failures));
+    }
+    pool.waitForDone();
+
+    return failures.load() == 0;
+}
+
+/**
+ * @brief Copy a file, sharing its blocks with the source (reflink) when the
+ * filesystem supports it. Like QFile::copy, fails if the destination exists.
+ */
+bool medStorage::cloneFile(const QString& source, const QString& destination)
+{
+#if defined(FICLONE)
+    if (!QFile::exists(destination))
+    {
+        QFile in(source);
+        QFile out(destination);
+        if (in.open(QIODevice::ReadOnly) && out.open(QIODevice::WriteOnly))
         {
-            qWarning() << "[Failure] copying file: " << sourceList.at(i) << " to " << destList.at(i);
-            return false;
+            if (::ioctl(out.handle(), FICLONE, in.handle()) == 0)
+            {
+                out.setPermissions(in.permissions());
+                return true;
+            }
+            out.close();
+            out.remove();
         }
     }
-
-    return true;
+#endif
+    return QFile::copy(source, destination);
 }
 
 bool medStorage::removeDir(QString dirName)
@@ -195,3 +302,93 @@ bool medStorage::removeDir(QString dirName)
     }
     return result;
 }
+
+/**
+ * @brief Directory of the content-addressed store, where deduplicated files
+ * are kept under the SHA-256 of their content.
+ */
+QString medStorage::objectLocation()
+{
+    return dataLocation() + "/objects";
+}
+
+/**
+ * @brief Replace this file by a hard link to the stored file with the same
+ * content, or add it to the store if there is none yet.
+ *
+ * Does nothing when the setting "database/deduplicate_files" is false or the
+ * filesystem does not support hard links. Deduplicated files must not be
+ * modified in place: they are replaced, or removed and written again.
+ * @return true if the file now shares its content with the store.
+ */
+bool medStorage::deduplicate(const QString& filePath)
+{
+    if (!medSettingsManager::instance()->value("database", "deduplicate_files", true).toBool())
+    {
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file))
+    {
+        return false;
+    }
+    file.close();
+
+    QString digest = hash.result().toHex();
+    QString object = objectLocation() + "/" + digest.left(2) + "/" + digest.mid(2);
+
+    if (!QFile::exists(object))
+    {
+        // the first copy of this content becomes the stored one
+        return mkpath(QFileInfo(object).path()) && hardLink(filePath, object);
+    }
+
+    if (linkCount(filePath) > 1 && QFileInfo(object).size() == QFileInfo(filePath).size())
+    {
+        // already linked to the store, e.g. written by a previous run
+        return true;
+    }
+
+    // link first, so that the file is never lost if the object is collected meanwhile
+    QString temporary = filePath + ".dedup";
+    QFile::remove(temporary);
+    if (!hardLink(object, temporary))
+    {
+        return false;
+    }
+    if (!QFile::remove(filePath) || !QFile::rename(temporary, filePath))
+    {
+        qWarning() << "medStorage: could not replace" << filePath << "by its stored copy";
+        QFile::remove(temporary);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Remove the stored files that are not linked from the data location
+ * any more, i.e. whose only remaining link is the store's.
+ * @return the number of files removed.
+ */
+int medStorage::collectGarbage()
+{
+    int removed = 0;
+
+    QDirIterator it(objectLocation(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+        QString object = it.next();
+        if (linkCount(object) == 1 && QFile::remove(object))
+        {
+            removed++;
+            QDir().rmdir(QFileInfo(object).path()); // only removes if empty
+        }
+    }
+    return removed;
+}
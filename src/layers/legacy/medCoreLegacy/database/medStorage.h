@@ -32,10 +32,15 @@ public:
     static void setDataLocation(QString);
 
     static bool copyFiles(QStringList sourceList, QStringList destList);
+    static bool cloneFile(const QString& source, const QString& destination);
     static bool createDestination(QStringList sourceList, QStringList& destList, QString sourceDir, QString destDir);
     static void recurseAddDir(QDir d, QStringList & list);
     static bool removeDir(QString dirName);
 
+    static QString objectLocation();
+    static bool deduplicate(const QString& filePath);
+    static int collectGarbage();
+
 private:
     static QString m_dataLocation;
 };
@@ -22,6 +22,7 @@
 #include <medComboBox.h>
 #include <medDoubleParameterL.h>
 #include <medIntParameterL.h>
+#include <medSettingsManager.h>
 #include <medTriggerParameterL.h>
 
 class medTimeLineParameterLPrivate
@@ -42,9 +43,23 @@ public:
     medComboBox         *extensionShiftParameter;
     QString             currentDisplayedTime;
 
-    QTimeLine *timeLine;
+    // playback
+    QTimer *playTimer;
+    QElapsedTimer playClock;
+    double playStartTime;  // time shown when the clock was started
+    int playFrame;         // last frame due, even if the time line is locked
+    bool loop;
+    int framesAhead;
+
+    // achieved frame rate, over the last second
+    QElapsedTimer rateClock;
+    int shownFrames;
+    int droppedFrames;  // since playback started
+    double achievedFrameRate;
+
     QPointer<QLabel> frameLabel;
     QPointer<QLabel> numberOfFramesLabel;
+    QPointer<QLabel> frameRateLabel;
 
     unsigned int numberOfFrames;
     int currentFrame;
@@ -66,6 +81,9 @@ public:
 
         if(numberOfFramesLabel)
             delete numberOfFramesLabel;
+
+        if(frameRateLabel)
+            delete frameRateLabel;
     }
 };
 
@@ -77,6 +95,7 @@ medTimeLineParameterL::medTimeLineParameterL(QString name, QObject *parent):
     d->widget = nullptr;
     d->frameLabel = nullptr;
     d->numberOfFramesLabel = nullptr;
+    d->frameRateLabel = nullptr;
 
     d->speedFactorParameter = new medIntParameterL("Speed", this);
     d->speedFactorParameter->setToolTip("Speed factor of data display");
@@ -97,8 +116,15 @@ medTimeLineParameterL::medTimeLineParameterL(QString name, QObject *parent):
     d->previousFrameParameter = new medTriggerParameterL("PreviousFrame", this);
     d->previousFrameParameter->setToolTip("Go back to the previous frame");
 
-    d->timeLine = new QTimeLine(7000, this);
-    d->timeLine->setCurveShape (QTimeLine::LinearCurve);
+    d->playTimer = new QTimer(this);
+    d->playTimer->setTimerType(Qt::PreciseTimer);
+    d->playStartTime = 0;
+    d->playFrame = 0;
+    d->loop = true;
+    d->framesAhead = medSettingsManager::instance()->value("timeline", "frames_ahead", 2).toInt();
+    d->shownFrames = 0;
+    d->droppedFrames = 0;
+    d->achievedFrameRate = 0;
 
     // Choose if the time display is going to loop 
     d->loopParameter = new medBoolParameterL("Loop", this);
@@ -140,8 +166,7 @@ medTimeLineParameterL::medTimeLineParameterL(QString name, QObject *parent):
 
     this->clear();
 
-    connect(d->timeLine, SIGNAL(frameChanged(int)), this, SLOT(setFrame(int)));
-    connect(d->timeLine, SIGNAL(finished()), this, SLOT(reset()));
+    connect(d->playTimer, SIGNAL(timeout()), this, SLOT(advance()));
 
     connect(d->playParameter, SIGNAL(valueChanged(bool)), this, SLOT(play(bool)));
     connect(d->previousFrameParameter, SIGNAL(triggered()), this, SLOT(previousFrame()));
@@ -162,7 +187,7 @@ medTimeLineParameterL::~medTimeLineParameterL()
 
 void medTimeLineParameterL::clear()
 {
-    this->setSpeedFactor(1);
+    this->setSpeedFactor(100);
     this->setDuration(1);
     this->setNumberOfFrame(1);
     this->setFrame(0);
@@ -201,6 +226,33 @@ int medTimeLineParameterL::stepFrame() const
     return d->stepFrame;
 }
 
+/**
+ * @brief Frames per second shown at the current speed factor.
+ */
+double medTimeLineParameterL::targetFrameRate() const
+{
+    if (d->timeBetweenFrames <= 0)
+        return 0;
+
+    return this->speedFactor() / 100.0 / d->timeBetweenFrames;
+}
+
+/**
+ * @brief Frames per second actually shown during the last second of playback.
+ */
+double medTimeLineParameterL::achievedFrameRate() const
+{
+    return d->achievedFrameRate;
+}
+
+/**
+ * @brief Frames skipped since playback started, to keep to the speed.
+ */
+int medTimeLineParameterL::droppedFrames() const
+{
+    return d->droppedFrames;
+}
+
 unsigned int medTimeLineParameterL::mapTimeToFrame(const double &time)
 {
     return floor( (double)(time / d->timeBetweenFrames) + 0.5 );
@@ -213,7 +265,16 @@ double medTimeLineParameterL::mapFrameToTime (int frame)
 
 void medTimeLineParameterL::setSpeedFactor(int speedFactor)
 {
-    d->timeLine->setDuration((d->duration)*(1000/(speedFactor/100.0)));
+    if (speedFactor != d->speedFactorParameter->value())
+        d->speedFactorParameter->setValue(speedFactor);
+
+    if (d->playTimer->isActive())
+    {
+        // go on from the time shown, at the new speed
+        d->playStartTime = this->time();
+        d->playClock.restart();
+        d->playTimer->setInterval(qBound(5, static_cast<int>(500 / qMax(this->targetFrameRate(), 0.001)), 100));
+    }
 }
 
 void medTimeLineParameterL::unlockTimeLine()
@@ -230,22 +291,101 @@ void medTimeLineParameterL::play(bool play)
 {
     d->playParameter->setValue(play);
 
-    if((d->timeLine->state() == QTimeLine::Paused || d->timeLine->state() == QTimeLine::NotRunning) && play)
+    if(!d->playTimer->isActive() && play)
     {
-        d->timeLine->setCurrentTime(mapFrameToTime(d->currentFrame) * 1000);
-        d->timeLine->resume();
+        d->playStartTime = mapFrameToTime(d->currentFrame);
+        d->playFrame = d->currentFrame;
+        d->playClock.start();
+        d->rateClock.start();
+        d->shownFrames = 0;
+        d->droppedFrames = 0;
+
+        // ticks twice per frame, so that a frame is never shown late by more than half a period
+        d->playTimer->start(qBound(5, static_cast<int>(500 / qMax(this->targetFrameRate(), 0.001)), 100));
         d->playParameter->setIcon (QPixmap(":/icons/time_pause_white.svg"));
         emit playing(play);
     }
-    else if(d->timeLine->state() == QTimeLine::Running && !play)
+    else if(d->playTimer->isActive() && !play)
     {
-        d->timeLine->setPaused(true);
+        d->playTimer->stop();
+        d->achievedFrameRate = 0;
+        updateFrameRateLabel();
         d->playParameter->setIcon (QPixmap(":/icons/time_play_white.svg"));
     }
 
    this->lockTimeLine();
 }
 
+/**
+ * @brief Show the frame due at this time of the playback clock, dropping the
+ * ones that were not shown in time.
+ */
+void medTimeLineParameterL::advance()
+{
+    if (d->timeBetweenFrames <= 0 || d->numberOfFrames < 2)
+        return;
+
+    double cycle = d->timeBetweenFrames * d->numberOfFrames;
+    double time = d->playStartTime + d->playClock.elapsed() / 1000.0 * this->speedFactor() / 100.0;
+
+    bool finished = false;
+    if (time >= cycle)
+    {
+        if (d->loop)
+        {
+            time = fmod(time, cycle);
+        }
+        else
+        {
+            time = d->duration;
+            finished = true;
+        }
+    }
+
+    int frame = qMin(static_cast<int>(floor(time / d->timeBetweenFrames)), static_cast<int>(d->numberOfFrames) - 1);
+    if (frame != d->playFrame)
+    {
+        int steps = (frame - d->playFrame + d->numberOfFrames) % d->numberOfFrames;
+        d->droppedFrames += steps - 1;
+        d->shownFrames++;
+        d->playFrame = frame;
+
+        this->setFrame(frame);
+
+        if (d->framesAhead > 0)
+        {
+            QList<double> times;
+            for (int i = 1; i <= d->framesAhead; ++i)
+            {
+                int next = frame + i;
+                if (next >= static_cast<int>(d->numberOfFrames))
+                {
+                    if (!d->loop)
+                        break;
+                    next %= d->numberOfFrames;
+                }
+                times << mapFrameToTime(next);
+            }
+            emit framesAhead(times);
+        }
+    }
+
+    if (d->rateClock.elapsed() >= 1000)
+    {
+        d->achievedFrameRate = d->shownFrames * 1000.0 / d->rateClock.restart();
+        updateFrameRateLabel();
+        emit frameRateChanged(d->achievedFrameRate, this->targetFrameRate());
+
+        d->shownFrames = 0;
+    }
+
+    if (finished)
+    {
+        d->playTimer->stop();
+        this->reset();
+    }
+}
+
 void medTimeLineParameterL::reset()
 {
     d->playParameter->setValue(false);
@@ -263,8 +403,6 @@ void medTimeLineParameterL::setNumberOfFrame(int numberOfFrame)
     else
         d->timeBetweenFrames = 0;
 
-    d->timeLine->setFrameRange(0, d->numberOfFrames);
-
     updateNumberOfFrameLabel();
 }
 
@@ -285,8 +423,6 @@ void medTimeLineParameterL::setDuration(const double& timeDuration)
     else
         d->timeBetweenFrames = 0;
 
-    d->timeLine->setDuration(timeDuration*1000);
-
 }
 
 void medTimeLineParameterL::setFrame(int frame)
@@ -335,8 +471,7 @@ void medTimeLineParameterL::nextFrame()
 
 void medTimeLineParameterL::setLoop(bool loop)
 {
-    int loopCount = (loop == true)?0:1;
-    d->timeLine->setLoopCount(loopCount);
+    d->loop = loop;
 }
 
 void medTimeLineParameterL::computeDisplayedTime()
@@ -409,6 +544,14 @@ QWidget* medTimeLineParameterL::getWidget()
         indicatorLayout->addWidget(d->frameLabel, 0, Qt::AlignRight);
         indicatorLayout->addWidget(d->numberOfFramesLabel, 0, Qt::AlignRight);
 
+        if(d->frameRateLabel.isNull())
+        {
+            d->frameRateLabel = new QLabel;
+            d->frameRateLabel->setToolTip("Frames per second shown / requested");
+            this->updateFrameRateLabel();
+        }
+        indicatorLayout->addWidget(d->frameRateLabel, 0, Qt::AlignRight);
+
         // Time Shift
         QHBoxLayout *shiftLayout = new QHBoxLayout;
         shiftLayout->setAlignment(Qt::AlignLeft);
@@ -445,6 +588,23 @@ void medTimeLineParameterL::updateNumberOfFrameLabel()
     d->numberOfFramesLabel->setText("/ " + QString::number(d->numberOfFrames) + " frames");
 }
 
+void medTimeLineParameterL::updateFrameRateLabel()
+{
+    if(d->frameRateLabel.isNull())
+        return;
+
+    if (d->playTimer->isActive() && d->achievedFrameRate > 0)
+    {
+        d->frameRateLabel->setText(QString("%1 / %2 fps")
+                                   .arg(d->achievedFrameRate, 0, 'f', 1)
+                                   .arg(this->targetFrameRate(), 0, 'f', 1));
+    }
+    else
+    {
+        d->frameRateLabel->clear();
+    }
+}
+
 void medTimeLineParameterL::removeInternWidget()
 {
     this->removeFromInternWidgets(d->widget);
@@ -20,6 +20,15 @@ class QWidget;
 class medBoolParameterL;
 
 class medTimeLineParameterLPrivate;
+
+/**
+ * Time line of the views showing temporal data.
+ *
+ * Playback follows the wall clock: when a frame takes longer to show than the
+ * frame period, the next frames are dropped to keep to the requested speed.
+ * The times of the next frames are announced with framesAhead(), so that they
+ * can be prepared before they are shown.
+ */
 class MEDCORELEGACY_EXPORT medTimeLineParameterL : public medAbstractGroupParameterL
 {
     Q_OBJECT
@@ -38,6 +47,10 @@ public:
     double& duration() const;
     int stepFrame() const;
 
+    double targetFrameRate() const;
+    double achievedFrameRate() const;
+    int droppedFrames() const;
+
     unsigned int mapTimeToFrame(const double& time);
     double mapFrameToTime(int frame);
 
@@ -72,11 +85,15 @@ public slots:
 signals:
     void playing(bool isPlaying);
     void timeChanged(double time);
+    void frameRateChanged(double achieved, double target);
+    void framesAhead(const QList<double>& times);
 
 private slots:
+    void advance();
     void updateTime(double time);
     void updateFrameLabel();
     void updateNumberOfFrameLabel();
+    void updateFrameRateLabel();
     void removeInternWidget();
 
 private:
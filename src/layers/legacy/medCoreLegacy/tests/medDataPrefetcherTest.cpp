@@ -0,0 +1,165 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QtConcurrent>
+#include <QSqlQuery>
+
+#include <dtkCoreSupport/dtkAbstractDataReader.h>
+
+#include <medAbstractData.h>
+#include <medAbstractDataFactory.h>
+#include <medDatabaseController.h>
+#include <medDataManager.h>
+#include <medDataPrefetcher.h>
+#include <medDataPrefetcherTest.h>
+#include <medSettingsManager.h>
+#include <medStorage.h>
+
+namespace
+{
+    // Series of a database which is not connected, they can not be read
+    medDataIndex series(int id)
+    {
+        return medDataIndex::makeSeriesIndex(1, 1, 1, id);
+    }
+
+    // Reads the ".prefetch" files into empty data, recording the thread of each read
+    class testReader : public dtkAbstractDataReader
+    {
+    public:
+        static QMutex mutex;
+        static QHash<QString, QThread *> threads;
+        static QHash<QString, dtkAbstractData *> data;
+
+        QString identifier() const override { return "medDataPrefetcherTestReader"; }
+        QString description() const override { return "Reader of the prefetcher test"; }
+        QStringList handled() const override { return QStringList() << "medAbstractData"; }
+
+        bool canRead(const QString& path) override { return path.endsWith(".prefetch"); }
+        bool canRead(const QStringList& paths) override { return paths.size() == 1 && canRead(paths.first()); }
+
+        bool read(const QString& path) override
+        {
+            setData(new medAbstractData());
+
+            QMutexLocker locker(&mutex);
+            threads.insert(QFileInfo(path).fileName(), QThread::currentThread());
+            data.insert(QFileInfo(path).fileName(), this->data());
+            return true;
+        }
+        bool read(const QStringList& paths) override { return paths.size() == 1 && read(paths.first()); }
+    };
+
+    QMutex testReader::mutex;
+    QHash<QString, QThread *> testReader::threads;
+    QHash<QString, dtkAbstractData *> testReader::data;
+
+    dtkAbstractDataReader *createTestReader()
+    {
+        return new testReader();
+    }
+}
+
+void medDataPrefetcherTest::testTakeWithoutRequest()
+{
+    medDataPrefetcher prefetcher;
+
+    QVERIFY(prefetcher.take(series(1)).isNull());
+}
+
+void medDataPrefetcherTest::testTakeUnreadableSeries()
+{
+    medDataPrefetcher prefetcher;
+    prefetcher.prefetch(QList<medDataIndex>() << series(1) << series(2));
+
+    // waits for the reads in progress, which fail
+    QVERIFY(prefetcher.take(series(1)).isNull());
+    QVERIFY(prefetcher.take(series(2)).isNull());
+}
+
+void medDataPrefetcherTest::testTakeFromOtherThread()
+{
+    medDataPrefetcher prefetcher;
+    prefetcher.prefetch(QList<medDataIndex>() << series(1));
+
+    // the background read uses its own database connection, not the one of
+    // the main thread, so another thread can wait for it
+    QFuture<bool> taken = QtConcurrent::run([&prefetcher]()
+    {
+        return prefetcher.take(series(1)).isNull();
+    });
+    QVERIFY(taken.result());
+}
+
+void medDataPrefetcherTest::testRequestReplacesPrevious()
+{
+    medDataPrefetcher prefetcher;
+    prefetcher.prefetch(QList<medDataIndex>() << series(1) << series(2));
+    prefetcher.prefetch(QList<medDataIndex>() << series(3));
+    prefetcher.clear();
+
+    QVERIFY(prefetcher.take(series(1)).isNull());
+    QVERIFY(prefetcher.take(series(2)).isNull());
+    QVERIFY(prefetcher.take(series(3)).isNull());
+}
+
+void medDataPrefetcherTest::testRetrievePrefetchedSeries()
+{
+    QVERIFY(medAbstractDataFactory::instance()->registerDataReaderType("medDataPrefetcherTestReader",
+                                                                       QStringList() << "medAbstractData",
+                                                                       createTestReader));
+
+    QTemporaryDir storage;
+    medStorage::setDataLocation(storage.path());
+    QVERIFY(medDatabaseController::instance()->createConnection());
+
+    // two series of one study, stored as 1.prefetch and 2.prefetch
+    QSqlQuery query(medDatabaseController::instance()->database());
+    QVERIFY(query.exec("INSERT INTO patient (id, name) VALUES (1, 'patient')"));
+    QVERIFY(query.exec("INSERT INTO study (id, patient, name) VALUES (1, 1, 'study')"));
+    for (int id : {1, 2})
+    {
+        QString path = QString("/%1.prefetch").arg(id);
+        QVERIFY(query.exec(QString("INSERT INTO series (id, study, name, path, isIndexed) VALUES (%1, 1, 'series', '%2', 0)").arg(id).arg(path)));
+
+        QFile file(storage.path() + path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("data");
+    }
+
+    medSettingsManager::instance()->setValue("database", "prefetch_series", 2);
+    medDataManager::initialize();
+    medDataManager *manager = medDataManager::instance();
+
+    // opening the first series prefetches its neighbour
+    medAbstractData *first = manager->retrieveData(series(1));
+    QVERIFY(first);
+    QCOMPARE(testReader::threads.value("1.prefetch"), QThread::currentThread());
+
+    auto isRead = [](const QString& name)
+    {
+        QMutexLocker locker(&testReader::mutex);
+        return testReader::threads.contains(name);
+    };
+    QTRY_VERIFY(isRead("2.prefetch"));
+
+    medAbstractData *second = manager->retrieveData(series(2));
+    QVERIFY(second);
+
+    QMutexLocker locker(&testReader::mutex);
+    QVERIFY(testReader::threads.value("2.prefetch") != QThread::currentThread());
+    QCOMPARE(static_cast<dtkAbstractData *>(second), testReader::data.value("2.prefetch"));
+    QCOMPARE(second->thread(), QThread::currentThread());
+}
+
+QTEST_MAIN(medDataPrefetcherTest)
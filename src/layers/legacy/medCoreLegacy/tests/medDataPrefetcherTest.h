@@ -0,0 +1,29 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#pragma once
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class medDataPrefetcherTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testTakeWithoutRequest();
+    void testTakeUnreadableSeries();
+    void testTakeFromOtherThread();
+    void testRequestReplacesPrevious();
+    // connects the database, must run last
+    void testRetrievePrefetchedSeries();
+};
@@ -32,6 +32,7 @@ medAbstractImageViewInteractor::medAbstractImageViewInteractor(medAbstractView *
     d->windowLevelParameter = nullptr;
 
     connect(d->view, SIGNAL(currentTimeChanged(double)), this, SLOT(setCurrentTime(double)));
+    connect(d->view, SIGNAL(framesAhead(QList<double>)), this, SLOT(prefetchTimes(QList<double>)));
 }
 
 medAbstractImageViewInteractor::~medAbstractImageViewInteractor()
@@ -73,3 +74,14 @@ void medAbstractImageViewInteractor::setCurrentTime(double time)
     Q_UNUSED(time);
     qDebug() << "No implementation of setCurrentTime(const double &time) for" << this->identifier();
 }
+
+/**
+* @brief prefetchTimes Reimplement this method if preparing a time of the data
+* before it is displayed is worth it, e.g. reading it from the disk.
+* These times are the next ones of the playback, in the order they are shown.
+* @param times
+*/
+void medAbstractImageViewInteractor::prefetchTimes(const QList<double> &times)
+{
+    Q_UNUSED(times);
+}
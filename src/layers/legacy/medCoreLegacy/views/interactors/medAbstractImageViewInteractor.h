@@ -36,6 +36,7 @@ public slots:
     virtual void setOpacity(double opacity) = 0;
     virtual void setWindowLevel(QHash<QString,QVariant>) = 0;
     virtual void setCurrentTime(double time);
+    virtual void prefetchTimes(const QList<double> &times);
 
 private:
     medAbstractImageViewInteractorPrivate *d;
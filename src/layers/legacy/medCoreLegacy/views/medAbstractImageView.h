@@ -84,6 +84,7 @@ public slots:
 signals:
     void orientationChanged();
     void currentTimeChanged(const double &time);
+    void framesAhead(const QList<double> &times);
 
 protected:
     virtual medAbstractImageViewInteractor* primaryInteractor(medAbstractData* data);
@@ -47,6 +47,7 @@ medAbstractImageViewNavigator::medAbstractImageViewNavigator(medAbstractView *pa
     }
 
     connect(this, SIGNAL(currentTimeChanged(double)), d->view, SIGNAL(currentTimeChanged(double)));
+    connect(this, SIGNAL(framesAhead(QList<double>)), d->view, SIGNAL(framesAhead(QList<double>)));
     connect(d->view, SIGNAL(layerAdded(uint)), this, SLOT(updateTimeLineParameter()));
     connect(d->view, SIGNAL(layerRemoved(uint)), this, SLOT(updateTimeLineParameter()));
 }
@@ -86,6 +87,7 @@ medTimeLineParameterL* medAbstractImageViewNavigator::timeLineParameter()
     {
         d->timeLineParameter = new medTimeLineParameterL("TimeLine", this);
         connect(d->timeLineParameter, SIGNAL(timeChanged(double)), this, SLOT(setCurrentTime(double)));
+        connect(d->timeLineParameter, SIGNAL(framesAhead(QList<double>)), this, SIGNAL(framesAhead(QList<double>)));
     }
     return d->timeLineParameter;
 }
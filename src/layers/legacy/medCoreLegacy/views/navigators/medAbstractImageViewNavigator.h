@@ -57,6 +57,7 @@ private slots:
 
 signals:
     void currentTimeChanged(const double &time);
+    void framesAhead(const QList<double> &times);
 
 private:
     medAbstractImageViewNavigatorPrivate *d;
@@ -16,10 +16,16 @@ PURPOSE.
 #include <itkImage.h>
 #include <itkImageToVTKImageFilter.h>
 #include <itkExtractImageFilter.h>
+#include <itkMultiThreaderBase.h>
+#include <itkRGBAPixel.h>
+#include <itkRGBPixel.h>
+#include <itkVector.h>
+#include <vnl/vnl_det.h>
 
 #include <vtkAlgorithmOutput.h>
 #include <vtkMatrix4x4.h>
 
+#include <algorithm>
 #include <vector>
 
 class medAbstractData;
@@ -46,6 +52,7 @@ public:
     virtual float getTotalTime() = 0;
 
     virtual double * getCurrentScalarRange() = 0;
+    virtual bool getScalarRanges(double po_range[2], std::vector<double> *po_frameRanges = nullptr) = 0;
 
     static vtkItkConversionInterface * createInstance(medAbstractData* pi_poData);
 
@@ -101,10 +108,12 @@ public:
     virtual float getTotalTime();
 
     virtual double * getCurrentScalarRange();
+    virtual bool getScalarRanges(double po_range[2], std::vector<double> *po_frameRanges = nullptr);
 
 private:
     bool initializeImage(typename itk::ImageBase<imageDim>::Pointer &input);
     bool volumeExtraction();
+    void volumeViews();
     void conversion();
 };
 
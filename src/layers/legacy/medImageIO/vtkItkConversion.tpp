@@ -11,6 +11,17 @@ PURPOSE.
 
 =========================================================================*/
 
+namespace vtkItkConversionDetail
+{
+/**
+* @brief  Value of a pixel used for its scalar range: the pixel itself, or its first component.
+*/
+template <typename T> inline double firstComponent(const T &pixel) { return static_cast<double>(pixel); }
+template <typename T> inline double firstComponent(const itk::RGBPixel<T> &pixel) { return static_cast<double>(pixel[0]); }
+template <typename T> inline double firstComponent(const itk::RGBAPixel<T> &pixel) { return static_cast<double>(pixel[0]); }
+template <typename T, unsigned int N> inline double firstComponent(const itk::Vector<T, N> &pixel) { return static_cast<double>(pixel[0]); }
+}
+
 template <typename volumeType, unsigned int imageDim>
 vtkItkConversion<volumeType, imageDim>::vtkItkConversion() :m_ImageConverter(ConverterType::New()), m_uiCurrentTimeIndex(0), m_uiNbVolume(0), m_fTotalTime(0) {}
 
@@ -144,6 +155,8 @@ bool vtkItkConversion<volumeType, imageDim>::initializeImage(typename itk::Image
 
 /**
 * @brief  This internal function process the extraction of diffrents volume from 4D image input.
+* @details The volumes are views on the buffer of the 4D image, nothing is copied.
+*          The extraction filter is only used when the 4D image is not fully buffered.
 * @return True if succed. False in other cases.
 */
 template <typename volumeType, unsigned int imageDim>
@@ -155,52 +168,59 @@ bool vtkItkConversion<volumeType, imageDim>::volumeExtraction()
     m_uiNbVolume = size[3];
     m_oVolumeVectorFrom4D.reserve(m_uiNbVolume);
 
-    // split the 4D volume into 3D volumes
-    typename Image4DType::RegionType regionToExtract = m_ItkInputImage4D->GetLargestPossibleRegion();
-    typename Image4DType::IndexType index;
-    index[0] = 0;
-    index[1] = 0;
-    index[2] = 0;
-    index[3] = 0;
-    size[3] = 0;
-
-    regionToExtract.SetSize(size);
-    regionToExtract.SetIndex(index);
-
     if (m_uiNbVolume > 0)
     {
         double dTimeResolution = m_ItkInputImage4D->GetSpacing()[3];
         m_fTotalTime = dTimeResolution * (m_uiNbVolume-1);
         m_oVolumeVectorFrom4D.resize(m_uiNbVolume);
 
-        for (unsigned int n = 0; (n < m_uiNbVolume) && bRes; n++)
+        if (m_ItkInputImage4D->GetBufferedRegion() == m_ItkInputImage4D->GetLargestPossibleRegion())
         {
-            typedef typename itk::ExtractImageFilter<Image4DType, Image3DType> ExtractImageType;
-            regionToExtract.SetIndex(3, n);
-            typename ExtractImageType::Pointer myExtractor = ExtractImageType::New();
-            myExtractor->SetExtractionRegion(regionToExtract);
-            myExtractor->SetDirectionCollapseToGuess();
-            myExtractor->SetInput(m_ItkInputImage4D);
-
-            try
-            {
-                myExtractor->Update();
-            }
-            catch (itk::ExceptionObject &e)
-            {
-                bRes = false;
-                std::cerr << "no volume into 4D image with exception : " << e << std::endl;
-            }
-
-            try
-            {
-                myExtractor->GetOutput();
-                m_oVolumeVectorFrom4D[n] = myExtractor->GetOutput();
-            }
-            catch (itk::ExceptionObject &e)
+            volumeViews();
+        }
+        else
+        {
+            // split the 4D volume into 3D volumes
+            typename Image4DType::RegionType regionToExtract = m_ItkInputImage4D->GetLargestPossibleRegion();
+            typename Image4DType::IndexType index;
+            index[0] = 0;
+            index[1] = 0;
+            index[2] = 0;
+            index[3] = 0;
+            size[3] = 0;
+
+            regionToExtract.SetSize(size);
+            regionToExtract.SetIndex(index);
+
+            for (unsigned int n = 0; (n < m_uiNbVolume) && bRes; n++)
             {
-                bRes = false;
-                std::cerr<< "error when extracting volume from 4D itk image on volume : " << n << " \n with exception" << e << std::endl;
+                typedef typename itk::ExtractImageFilter<Image4DType, Image3DType> ExtractImageType;
+                regionToExtract.SetIndex(3, n);
+                typename ExtractImageType::Pointer myExtractor = ExtractImageType::New();
+                myExtractor->SetExtractionRegion(regionToExtract);
+                myExtractor->SetDirectionCollapseToGuess();
+                myExtractor->SetInput(m_ItkInputImage4D);
+
+                try
+                {
+                    myExtractor->Update();
+                }
+                catch (itk::ExceptionObject &e)
+                {
+                    bRes = false;
+                    std::cerr << "no volume into 4D image with exception : " << e << std::endl;
+                }
+
+                try
+                {
+                    myExtractor->GetOutput();
+                    m_oVolumeVectorFrom4D[n] = myExtractor->GetOutput();
+                }
+                catch (itk::ExceptionObject &e)
+                {
+                    bRes = false;
+                    std::cerr<< "error when extracting volume from 4D itk image on volume : " << n << " \n with exception" << e << std::endl;
+                }
             }
         }
 
@@ -215,6 +235,58 @@ bool vtkItkConversion<volumeType, imageDim>::volumeExtraction()
 
 }
 
+/**
+* @brief  This internal function makes each volume of the 4D image a 3D image on its part of the 4D buffer.
+* @details The geometry is the one the extraction filter would give, directions collapsed to guess.
+*          The volumes do not own their pixels, the 4D image is kept alive by m_ItkInputImage4D.
+*/
+template <typename volumeType, unsigned int imageDim>
+void vtkItkConversion<volumeType, imageDim>::volumeViews()
+{
+    typename Image4DType::RegionType region4D = m_ItkInputImage4D->GetLargestPossibleRegion();
+    typename Image4DType::SpacingType spacing4D = m_ItkInputImage4D->GetSpacing();
+    typename Image4DType::PointType origin4D = m_ItkInputImage4D->GetOrigin();
+    typename Image4DType::DirectionType direction4D = m_ItkInputImage4D->GetDirection();
+
+    typename Image3DType::RegionType region;
+    typename Image3DType::SpacingType spacing;
+    typename Image3DType::PointType origin;
+    typename Image3DType::DirectionType direction;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        region.SetIndex(i, region4D.GetIndex(i));
+        region.SetSize(i, region4D.GetSize(i));
+        spacing[i] = spacing4D[i];
+        origin[i] = origin4D[i];
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            direction(i, j) = direction4D(i, j);
+        }
+    }
+    if (vnl_det(direction.GetVnlMatrix()) == 0.0)
+    {
+        direction.SetIdentity();
+    }
+
+    const itk::SizeValueType nbPixels = region.GetNumberOfPixels();
+    volumeType *buffer = m_ItkInputImage4D->GetBufferPointer();
+
+    for (unsigned int n = 0; n < m_uiNbVolume; n++)
+    {
+        typename Image3DType::PixelContainerPointer pixels = Image3DType::PixelContainer::New();
+        pixels->SetImportPointer(buffer + n * nbPixels, nbPixels, false);
+
+        typename Image3DType::Pointer volume = Image3DType::New();
+        volume->SetRegions(region);
+        volume->SetSpacing(spacing);
+        volume->SetOrigin(origin);
+        volume->SetDirection(direction);
+        volume->SetPixelContainer(pixels);
+
+        m_oVolumeVectorFrom4D[n] = volume;
+    }
+}
+
 /**
 * @brief  This function change the current volume of 4D image.
 * @param  pi_uiTimeIndex [in] cardinal number of extracter volume (0..N-1).
@@ -290,32 +362,107 @@ void vtkItkConversion<volumeType, imageDim>::conversion()
 }
 
 /**
-* @brief  This function get the total time of 4D image.
-* @return The a table of 2 cases with the scalar range (compute with vtk method).
+* @brief  This function get the scalar range of the whole image, over all its volumes.
+* @return The a table of 2 cases with the scalar range (Caller must deallocate it after use).<br>null if there is no input image.
 */
 template <typename volumeType, unsigned int imageDim>
 double * vtkItkConversion<volumeType, imageDim>::getCurrentScalarRange()
 {
     double *dResScalarRange = nullptr;
-    double scalarRangeTmp[2];
-    unsigned int uiPreviousTimeIndex = m_uiCurrentTimeIndex;
 
     if (m_ItkInputImage.IsNotNull() || m_ItkInputImage4D.IsNotNull())
     {
-        dResScalarRange = new double[2]; //FloTODO check potential memory leak
-        dResScalarRange[0] = VTK_DOUBLE_MAX;
-        dResScalarRange[1] = VTK_DOUBLE_MIN;
+        dResScalarRange = new double[2];
+        getScalarRanges(dResScalarRange);
+    }
 
-        for (unsigned int i = 0; i < m_uiNbVolume; ++i)
+    return dResScalarRange;
+}
+
+/**
+* @brief  This function computes the scalar range of the image, and of each of its volumes, in one parallel pass over the ITK buffers.
+* @details As VTK does, the range of multi-component pixels is the one of their first component, and NaN values are ignored.
+*          Nothing is converted to VTK, the current volume is left unchanged.
+* @param  po_range [out] minimum and maximum over all the volumes.
+* @param  po_frameRanges [out] if not null, minimum and maximum of each volume, one after the other.
+* @return True if there is an input image.<br>False in other cases.
+*/
+template <typename volumeType, unsigned int imageDim>
+bool vtkItkConversion<volumeType, imageDim>::getScalarRanges(double po_range[2], std::vector<double> *po_frameRanges)
+{
+    po_range[0] = VTK_DOUBLE_MAX;
+    po_range[1] = VTK_DOUBLE_MIN;
+
+    std::vector<const volumeType *> volumes;
+    itk::SizeValueType nbPixels = 0;
+    if (imageDim == 4 && !m_oVolumeVectorFrom4D.empty())
+    {
+        for (unsigned int n = 0; n < m_oVolumeVectorFrom4D.size(); ++n)
         {
-            setTimeIndex(i);
-            m_ImageConverter->GetImporter()->GetOutput()->GetScalarRange(scalarRangeTmp);
-            if (dResScalarRange[0] > scalarRangeTmp[0]) dResScalarRange[0] = scalarRangeTmp[0];
-            if (dResScalarRange[1] < scalarRangeTmp[1]) dResScalarRange[1] = scalarRangeTmp[1];
+            volumes.push_back(m_oVolumeVectorFrom4D[n]->GetBufferPointer());
         }
+        nbPixels = m_oVolumeVectorFrom4D[0]->GetBufferedRegion().GetNumberOfPixels();
+    }
+    else if (m_ItkInputImage.IsNotNull())
+    {
+        volumes.push_back(m_ItkInputImage->GetBufferPointer());
+        nbPixels = m_ItkInputImage->GetBufferedRegion().GetNumberOfPixels();
     }
 
-    setTimeIndex(uiPreviousTimeIndex);
+    if (volumes.empty())
+    {
+        return false;
+    }
 
-    return dResScalarRange;
+    // volumes are split in blocks, so that the threads are busy even with few volumes
+    const itk::SizeValueType minimumBlockSize = 1 << 16;
+    const itk::SizeValueType nbThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+    itk::SizeValueType blocksPerVolume = (nbThreads + volumes.size() - 1) / volumes.size();
+    blocksPerVolume = std::max<itk::SizeValueType>(1, std::min(blocksPerVolume, nbPixels / minimumBlockSize));
+    const itk::SizeValueType blockSize = (nbPixels + blocksPerVolume - 1) / blocksPerVolume;
+
+    std::vector<double> blockRanges(2 * volumes.size() * blocksPerVolume);
+
+    itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+    multiThreader->ParallelizeArray(0, volumes.size() * blocksPerVolume, [&](itk::SizeValueType block)
+    {
+        const volumeType *pixel = volumes[block / blocksPerVolume];
+        const itk::SizeValueType begin = (block % blocksPerVolume) * blockSize;
+        const itk::SizeValueType end = std::min(begin + blockSize, nbPixels);
+
+        double dMin = VTK_DOUBLE_MAX;
+        double dMax = VTK_DOUBLE_MIN;
+        for (itk::SizeValueType i = begin; i < end; ++i)
+        {
+            const double value = vtkItkConversionDetail::firstComponent(pixel[i]);
+            if (value < dMin) dMin = value;
+            if (value > dMax) dMax = value;
+        }
+        blockRanges[2 * block] = dMin;
+        blockRanges[2 * block + 1] = dMax;
+    }, nullptr);
+
+    if (po_frameRanges)
+    {
+        po_frameRanges->assign(2 * volumes.size(), 0.0);
+    }
+    for (unsigned int n = 0; n < volumes.size(); ++n)
+    {
+        double frameRange[2] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MIN };
+        for (itk::SizeValueType b = n * blocksPerVolume; b < (n + 1) * blocksPerVolume; ++b)
+        {
+            if (frameRange[0] > blockRanges[2 * b])     frameRange[0] = blockRanges[2 * b];
+            if (frameRange[1] < blockRanges[2 * b + 1]) frameRange[1] = blockRanges[2 * b + 1];
+        }
+        if (po_range[0] > frameRange[0]) po_range[0] = frameRange[0];
+        if (po_range[1] < frameRange[1]) po_range[1] = frameRange[1];
+
+        if (po_frameRanges)
+        {
+            (*po_frameRanges)[2 * n] = frameRange[0];
+            (*po_frameRanges)[2 * n + 1] = frameRange[1];
+        }
+    }
+
+    return true;
 }
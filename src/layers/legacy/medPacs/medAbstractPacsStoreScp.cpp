@@ -38,3 +38,13 @@ bool medAbstractPacsStoreScp::setStorageDirectory( const char* directory )
     Q_UNUSED(directory);
     return false;
 }
+
+/**
+ * To be called by implementations from their storage callback, once the file
+ * of an instance is written in the storage directory. Can be called from the
+ * thread running the server.
+ */
+void medAbstractPacsStoreScp::notifyInstanceStored( const char* file, const char* studyInstanceUid, const char* seriesInstanceUid )
+{
+    emit instanceReceived(QString::fromLocal8Bit(file), QString::fromLatin1(studyInstanceUid), QString::fromLatin1(seriesInstanceUid));
+}
@@ -32,4 +32,13 @@ public:
 
 signals:
     void endOfStudy(QString);
+
+    /**
+     * Emitted through notifyInstanceStored() for each instance stored, so that
+     * series can be imported before the end of the transfer (see medPacsImportQueue).
+     */
+    void instanceReceived(QString file, QString studyInstanceUid, QString seriesInstanceUid);
+
+protected:
+    void notifyInstanceStored(const char* file, const char* studyInstanceUid, const char* seriesInstanceUid);
 };
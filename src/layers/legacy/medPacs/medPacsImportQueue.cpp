@@ -0,0 +1,316 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <medPacsImportQueue.h>
+
+#include <QtCore>
+
+#include <medDatabaseController.h>
+#include <medDatabaseImporter.h>
+#include <medJobManagerL.h>
+
+namespace
+{
+    bool isSeriesRequest(const medMoveCommandItem& request)
+    {
+        return request.group == 0x0020 && request.elem == 0x000E;
+    }
+
+    bool isStudyRequest(const medMoveCommandItem& request)
+    {
+        return request.group == 0x0020 && request.elem == 0x000D;
+    }
+
+    bool isSameRequest(const medMoveCommandItem& a, const medMoveCommandItem& b)
+    {
+        return a.group == b.group && a.elem == b.elem && a.query == b.query && a.sourceTitle == b.sourceTitle;
+    }
+}
+
+class medPacsImportQueuePrivate
+{
+public:
+    QDir staging;
+    bool streaming;
+    QTimer flushTimer;
+    int imports;
+
+    QHash<QString, QString> studyOfSeries; // series UID -> study UID, of the pending series
+    QHash<QString, int> instanceCount;     // series UID -> received instances
+    QList<medMoveCommandItem> running;     // requests started and not finished yet
+    QList<medMoveCommandItem> finished;    // requests finished, whose late instances are still imported
+    QHash<QObject*, QString> importing;    // importer -> series directory
+
+    QString seriesDirectory(const QString& seriesInstanceUid) const
+    {
+        // UIDs only contain digits and dots
+        return staging.absoluteFilePath(seriesInstanceUid);
+    }
+
+    /**
+     * Whether a running request other than one at patient or instance level
+     * retrieves this series.
+     */
+    bool isRetrievedByRunningRequest(const QString& seriesInstanceUid) const
+    {
+        for (const medMoveCommandItem& request : running)
+        {
+            if ((isSeriesRequest(request) && request.query == seriesInstanceUid) ||
+                (isStudyRequest(request) && request.query == studyOfSeries.value(seriesInstanceUid)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool hasRunningRequestAtOtherLevel() const
+    {
+        for (const medMoveCommandItem& request : running)
+        {
+            if (!isSeriesRequest(request) && !isStudyRequest(request))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Whether a finished request retrieved this series. The series received
+     * through requests at another level than study or series can not be told
+     * apart: they wait for the last of these requests.
+     */
+    bool isRetrievedByFinishedRequest(const QString& seriesInstanceUid) const
+    {
+        for (const medMoveCommandItem& request : finished)
+        {
+            if (isSeriesRequest(request))
+            {
+                if (request.query == seriesInstanceUid)
+                {
+                    return true;
+                }
+            }
+            else if (isStudyRequest(request))
+            {
+                if (request.query == studyOfSeries.value(seriesInstanceUid))
+                {
+                    return true;
+                }
+            }
+            else if (!hasRunningRequestAtOtherLevel())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isComplete(const QString& seriesInstanceUid) const
+    {
+        return isRetrievedByFinishedRequest(seriesInstanceUid) && !isRetrievedByRunningRequest(seriesInstanceUid);
+    }
+};
+
+medPacsImportQueue::medPacsImportQueue(const QString& stagingDirectory, QObject *parent) : QObject(parent), d(new medPacsImportQueuePrivate)
+{
+    d->staging = QDir(stagingDirectory);
+    // series left over by a previous session were not imported completely
+    d->staging.removeRecursively();
+    d->staging.mkpath(".");
+    d->streaming = false;
+    d->imports = 0;
+
+    d->flushTimer.setSingleShot(true);
+    d->flushTimer.setInterval(500);
+    connect(&d->flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+medPacsImportQueue::~medPacsImportQueue()
+{
+    // only removed when empty, the imports still running read from it
+    QDir().rmdir(d->staging.absolutePath());
+
+    delete d;
+    d = nullptr;
+}
+
+/**
+ * @brief True once the store SCP announced an instance, i.e. when it supports
+ * streaming. Otherwise whole studies are imported at the end of the transfer.
+ */
+bool medPacsImportQueue::isStreaming() const
+{
+    return d->streaming;
+}
+
+/**
+ * @brief Time given to the instances of a finished request to be announced,
+ * as the store SCP may report them after the move request completes. Those
+ * announced later still get imported, as a separate series import.
+ */
+void medPacsImportQueue::setGracePeriod(int msec)
+{
+    d->flushTimer.setInterval(msec);
+}
+
+/**
+ * @brief Keep track of the running requests, so that one finishing does not
+ * hand over the series another one is still retrieving.
+ */
+void medPacsImportQueue::onRequestStarted(medMoveCommandItem request)
+{
+    d->running << request;
+}
+
+void medPacsImportQueue::onInstanceReceived(QString file, QString studyInstanceUid, QString seriesInstanceUid)
+{
+    d->streaming = true;
+
+    if (seriesInstanceUid.isEmpty())
+    {
+        seriesInstanceUid = "unknown";
+    }
+
+    QString directory = d->seriesDirectory(seriesInstanceUid);
+    if (!d->instanceCount.contains(seriesInstanceUid))
+    {
+        QDir().mkpath(directory);
+        d->studyOfSeries.insert(seriesInstanceUid, studyInstanceUid);
+    }
+
+    QString target = directory + "/" + QFileInfo(file).fileName();
+    if (!QFile::rename(file, target))
+    {
+        qWarning() << "medPacsImportQueue: could not stage" << file;
+        return;
+    }
+    d->instanceCount[seriesInstanceUid]++;
+
+    if (d->isComplete(seriesInstanceUid) && !d->flushTimer.isActive())
+    {
+        d->flushTimer.start();
+    }
+}
+
+/**
+ * @brief Import the series covered by this request, once the grace period
+ * is over, except the ones a running request still retrieves.
+ */
+void medPacsImportQueue::onRequestFinished(medMoveCommandItem request, bool success)
+{
+    if (!success)
+    {
+        qWarning() << "medPacsImportQueue: move request" << request.query << "failed, importing what was received";
+    }
+
+    for (int i = 0; i < d->running.size(); ++i)
+    {
+        if (isSameRequest(d->running.at(i), request))
+        {
+            d->running.removeAt(i);
+            break;
+        }
+    }
+
+    bool known = false;
+    for (const medMoveCommandItem& other : d->finished)
+    {
+        known = known || isSameRequest(other, request);
+    }
+    if (!known)
+    {
+        d->finished << request;
+    }
+
+    if (!d->flushTimer.isActive())
+    {
+        d->flushTimer.start();
+    }
+}
+
+/**
+ * @brief Import the staged series no running request retrieves anymore. The
+ * directory of each is renamed first, so that late instances of the series
+ * are staged apart from the ones being imported.
+ */
+void medPacsImportQueue::flush()
+{
+    for (const QString& uid : d->studyOfSeries.keys())
+    {
+        if (!d->isComplete(uid))
+        {
+            continue;
+        }
+
+        QString directory = d->seriesDirectory(uid);
+        if (d->instanceCount.value(uid) > 0)
+        {
+            QString importDirectory = directory + "-" + QString::number(++d->imports);
+            if (QDir().rename(directory, importDirectory))
+            {
+                emit seriesReceived(importDirectory);
+                importSeries(importDirectory);
+            }
+            else
+            {
+                qWarning() << "medPacsImportQueue: could not import" << directory;
+            }
+        }
+        else
+        {
+            QDir(directory).removeRecursively();
+        }
+        d->studyOfSeries.remove(uid);
+        d->instanceCount.remove(uid);
+    }
+}
+
+/**
+ * @brief Remove the staged files of a series, once its import is over.
+ */
+void medPacsImportQueue::onSeriesImported(QString directory)
+{
+    if (!QDir(directory).removeRecursively())
+    {
+        qWarning() << "medPacsImportQueue: could not remove" << directory;
+    }
+}
+
+/**
+ * @brief Import the files of the series into the database, which keeps its
+ * own copy of them. onSeriesImported() is called when the import is over.
+ */
+void medPacsImportQueue::importSeries(const QString& directory)
+{
+    medDatabaseImporter *importer = new medDatabaseImporter(directory, QUuid::createUuid());
+    d->importing.insert(importer, directory);
+
+    connect(importer, SIGNAL(dataImported(medDataIndex,QUuid)),
+            medDatabaseController::instance(), SIGNAL(dataImported(medDataIndex,QUuid)));
+    connect(importer, SIGNAL(success(QObject *)), this, SLOT(onImportFinished(QObject *)));
+    connect(importer, SIGNAL(failure(QObject *)), this, SLOT(onImportFinished(QObject *)));
+    connect(importer, SIGNAL(cancelled(QObject *)), this, SLOT(onImportFinished(QObject *)));
+
+    medJobManagerL::instance()->registerJobItem(importer, tr("Importing"));
+    QThreadPool::globalInstance()->start(importer);
+}
+
+void medPacsImportQueue::onImportFinished(QObject *importer)
+{
+    if (d->importing.contains(importer))
+    {
+        onSeriesImported(d->importing.take(importer));
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QObject>
+
+#include <medMoveCommandItem.h>
+#include <medPacsExport.h>
+
+class medPacsImportQueuePrivate;
+
+/**
+ * Hands the series retrieved from a PACS to the importer one by one.
+ *
+ * The instances announced by the store SCP are moved into a staging
+ * directory per series as they arrive. Shortly after the move request
+ * covering a series completes, the series directory is emitted with
+ * seriesReceived() and imported while the other requests are still
+ * transferring. It is removed once its import is over.
+ *
+ * The staging directory is emptied at start: it must not be shared with
+ * another process.
+ */
+class MEDPACS_EXPORT medPacsImportQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    medPacsImportQueue(const QString& stagingDirectory, QObject *parent = nullptr);
+    ~medPacsImportQueue() override;
+
+    bool isStreaming() const;
+    void setGracePeriod(int msec);
+
+signals:
+    void seriesReceived(QString directory);
+
+public slots:
+    void onRequestStarted(medMoveCommandItem request);
+    void onInstanceReceived(QString file, QString studyInstanceUid, QString seriesInstanceUid);
+    void onRequestFinished(medMoveCommandItem request, bool success);
+    void onSeriesImported(QString directory);
+
+protected:
+    virtual void importSeries(const QString& directory);
+
+private slots:
+    void flush();
+    void onImportFinished(QObject *importer);
+
+private:
+    medPacsImportQueuePrivate *d;
+};
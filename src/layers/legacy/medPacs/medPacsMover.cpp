@@ -13,41 +13,118 @@
 
 #include <medPacsMover.h>
 
+#include <QHash>
+#include <QMutex>
+#include <QRunnable>
+#include <QSettings>
+#include <QThreadPool>
+
 #include <medAbstractPacsMoveScu.h>
 #include <medAbstractPacsFactory.h>
 #include <medAbstractPacsNode.h>
 #include <medPacsNode.h>
 
-#include <iostream>
-
 class medPacsMoverPrivate
 {
 public:
+    QVector<medMoveCommandItem> cmdList;
 
-    medAbstractPacsMoveScu* move;
+    QMutex mutex;
+    QList<int> pending;                // indexes in cmdList, not started yet
+    QHash<QString, int> associations;  // source title -> running associations
+    QHash<QString, int> limits;        // source title -> maximum associations
+    QList<medAbstractPacsMoveScu*> moves; // of the running requests
+    QHash<QObject*, int> progresses;      // move -> progress of its request
+    int done;
+    int failed;
+    bool cancelled;
 
-    QVector<medMoveCommandItem> cmdList;
+    /**
+     * Progress of all the requests, the running ones counting for their own
+     * progress.
+     */
+    int totalProgress() const
+    {
+        int total = done * 100;
+        for (int prog : progresses)
+        {
+            total += prog;
+        }
+        return total / cmdList.size();
+    }
+
+    /**
+     * Next request whose source node can take one more association, or -1.
+     */
+    int takeNext()
+    {
+        for (int i = 0; i < pending.size(); ++i)
+        {
+            const QString& source = cmdList.at(pending.at(i)).sourceTitle;
+            if (associations.value(source) < limits.value(source))
+            {
+                associations[source]++;
+                return pending.takeAt(i);
+            }
+        }
+        return -1;
+    }
+};
+
+// /////////////////////////////////////////////////////////////////
+// medPacsMoveAssociation
+// /////////////////////////////////////////////////////////////////
+
+class medPacsMoveAssociation : public QRunnable
+{
+public:
+    medPacsMoveAssociation(medPacsMover *mover) : mover(mover) {}
+
+    void run()
+    {
+        mover->runAssociations();
+    }
+
+private:
+    medPacsMover *mover;
 };
 
+// /////////////////////////////////////////////////////////////////
+// medPacsMover
+// /////////////////////////////////////////////////////////////////
+
 medPacsMover::medPacsMover(const QVector<medMoveCommandItem>& cmdList): medJobItemL(),
                            d(new medPacsMoverPrivate)
 {
-    d->cmdList = cmdList;
+    qRegisterMetaType<medMoveCommandItem>("medMoveCommandItem");
 
-    d->move = nullptr;
+    d->cmdList = cmdList;
+    d->done = 0;
+    d->failed = 0;
+    d->cancelled = false;
 }
 
 medPacsMover::~medPacsMover( void )
 {
-    if (d->move)
-    {
-        delete d->move;
-    }
-
     delete d;
     d = nullptr;
 }
 
+/**
+ * @brief Number of move associations opened at once with this node, read from
+ * the "medPacsMover/maxAssociations/<title>" setting, or "medPacsMover/maxAssociations"
+ * for all the nodes. Defaults to 4.
+ */
+int medPacsMover::maximumAssociations(const QString& nodeTitle)
+{
+    QSettings settings;
+    settings.beginGroup("medPacsMover");
+    int count = settings.value("maxAssociations/" + nodeTitle, settings.value("maxAssociations", 4)).toInt();
+    settings.endGroup();
+
+    return qMax(1, count);
+}
+
 void medPacsMover::internalRun( void )
 {
     doQueuedMove();
@@ -55,50 +132,157 @@ void medPacsMover::internalRun( void )
 
 void medPacsMover::doQueuedMove()
 {
-    if(!d->move)
+    if (d->cmdList.isEmpty())
     {
-        d->move = medAbstractPacsFactory::instance()->createMoveScu("dcmtkMoveScu");
-        connect(d->move,SIGNAL(progressed(int)),this, SLOT(progressForward(int)));
+        emit success(this);
+        return;
     }
 
-    if(d->move)
+    int associations = 0;
     {
-        for(int i=0; i<d->cmdList.size(); i++)
+        QMutexLocker locker(&d->mutex);
+
+        QHash<QString, int> requests;
+        for (int i = 0; i < d->cmdList.size(); i++)
         {
-            medPacsNode source;
-            source.setTitle(d->cmdList.at(i).sourceTitle);
-            source.setIp(d->cmdList.at(i).sourceIp);
-            source.setPort(d->cmdList.at(i).sourcePort);
+            d->pending << i;
+            requests[d->cmdList.at(i).sourceTitle]++;
+        }
 
-            medPacsNode target;
-            target.setTitle(d->cmdList.at(i).targetTitle);
-            target.setIp(d->cmdList.at(i).targetIp);
-            target.setPort(d->cmdList.at(i).targetPort);
+        for (auto it = requests.constBegin(); it != requests.constEnd(); ++it)
+        {
+            int limit = maximumAssociations(it.key());
+            d->limits.insert(it.key(), limit);
+            associations += qMin(limit, it.value());
+        }
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(associations);
+    for (int i = 0; i < associations; i++)
+    {
+        pool.start(new medPacsMoveAssociation(this));
+    }
+    pool.waitForDone();
+
+    if (d->cancelled)
+    {
+        return;
+    }
 
-            d->move->addRequestToQueue(d->cmdList.at(i).group, d->cmdList.at(i).elem, d->cmdList.at(i).query.toLatin1(), source, target);
+    if (d->failed == 0)
+    {
+        emit success(this);
+    }
+    else
+    {
+        emit failure(this);
+    }
+}
+
+/**
+ * @brief Perform requests, one association each, until none is left for this
+ * worker. Runs in the pool of doQueuedMove().
+ */
+void medPacsMover::runAssociations()
+{
+    forever
+    {
+        int index;
+        {
+            QMutexLocker locker(&d->mutex);
+            index = d->cancelled ? -1 : d->takeNext();
+        }
+        if (index < 0)
+        {
+            return;
         }
 
-        if(d->move->performQueuedMoveRequests() == 0)
+        const medMoveCommandItem& cmd = d->cmdList.at(index);
+        emit requestStarted(cmd);
+
+        medAbstractPacsMoveScu *move = medAbstractPacsFactory::instance()->createMoveScu("dcmtkMoveScu");
+        bool result = false;
+        if (move)
         {
-            emit success(this);
+            medPacsNode source;
+            source.setTitle(cmd.sourceTitle);
+            source.setIp(cmd.sourceIp);
+            source.setPort(cmd.sourcePort);
+
+            medPacsNode target;
+            target.setTitle(cmd.targetTitle);
+            target.setIp(cmd.targetIp);
+            target.setPort(cmd.targetPort);
+
+            move->addRequestToQueue(cmd.group, cmd.elem, cmd.query.toLatin1(), source, target);
+            // the slot runs in this thread, while the move still exists
+            connect(move, SIGNAL(progressed(int)), this, SLOT(progressForward(int)), Qt::DirectConnection);
+
+            {
+                QMutexLocker locker(&d->mutex);
+                d->moves << move;
+                d->progresses.insert(move, 0);
+            }
+
+            result = move->performQueuedMoveRequests() == 0;
+
+            QMutexLocker locker(&d->mutex);
+            d->moves.removeOne(move);
+            d->progresses.remove(move);
         }
-        else
+        delete move;
+
+        int prog;
         {
-            emit failure(this);
+            QMutexLocker locker(&d->mutex);
+            d->associations[cmd.sourceTitle]--;
+            d->done++;
+            if (!result)
+            {
+                d->failed++;
+            }
+            prog = d->totalProgress();
         }
+
+        emit requestFinished(cmd, result);
+        emit progress(this, prog);
     }
 }
 
 void medPacsMover::onCancel(QObject* sender)
 {
-    if(d->move && sender == this)
+    if (sender != this)
     {
-        d->move->sendCancelRequest();
-        emit cancelled(this);
+        return;
     }
+
+    {
+        QMutexLocker locker(&d->mutex);
+        d->cancelled = true;
+        d->pending.clear();
+        for (medAbstractPacsMoveScu *move : d->moves)
+        {
+            move->sendCancelRequest();
+        }
+    }
+    emit cancelled(this);
 }
 
+/**
+ * @brief Progress of one request, reported as the progress of all of them.
+ */
 void medPacsMover::progressForward( int prog)
 {
-    emit progress(this, prog);
+    int total;
+    {
+        QMutexLocker locker(&d->mutex);
+        if (!d->progresses.contains(sender()))
+        {
+            return;
+        }
+        d->progresses[sender()] = qBound(0, prog, 100);
+        total = d->totalProgress();
+    }
+    emit progress(this, total);
 }
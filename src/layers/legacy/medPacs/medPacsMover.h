@@ -18,6 +18,14 @@
 
 class medPacsMoverPrivate;
 
+/**
+ * Retrieves the requested studies or series from their PACS nodes.
+ *
+ * The requests are spread over several move associations, up to
+ * maximumAssociations() per source node, so that slow series do not hold back
+ * the others. requestStarted() and requestFinished() are emitted when each of
+ * them starts and completes.
+ */
 class MEDPACS_EXPORT medPacsMover : public medJobItemL
 {
     Q_OBJECT
@@ -28,8 +36,12 @@ public:
 
     void doQueuedMove();
 
+    static int maximumAssociations(const QString& nodeTitle);
+
 signals:
     void import(QString);
+    void requestStarted(medMoveCommandItem request);
+    void requestFinished(medMoveCommandItem request, bool success);
    
 public slots:
     void onCancel(QObject*);
@@ -41,5 +53,8 @@ private slots:
     void progressForward(int);
 
 private:
+    void runAssociations();
+
+    friend class medPacsMoveAssociation;
     medPacsMoverPrivate *d;
 };
@@ -19,6 +19,7 @@
 #include <medAbstractPacsNode.h>
 #include <medAbstractPacsStoreScp.h>
 #include <medAbstractPacsResultDataset.h>
+#include <medPacsImportQueue.h>
 
 // /////////////////////////////////////////////////////////////////
 // medPacsWidgetPrivate
@@ -43,7 +44,7 @@ public:
     medAbstractPacsFindScu  *find;
     medAbstractPacsEchoScu  *echo;
     medAbstractPacsStoreScp *server;
-
+    medPacsImportQueue *importQueue;
 };
 
 void medPacsWidgetPrivate::run(void)
@@ -92,6 +93,7 @@ medPacsWidget::medPacsWidget(QWidget *parent) : QTreeWidget(parent), d(new medPa
 
     d->find = nullptr;
     d->echo = nullptr;
+    d->importQueue = new medPacsImportQueue(QDir::temp().absoluteFilePath(QString("import-series-%1").arg(QCoreApplication::applicationPid())), this);
     d->server = medAbstractPacsFactory::instance()->createStoreScp("dcmtkStoreScp");
     if (!d->server)
     {
@@ -101,7 +103,9 @@ medPacsWidget::medPacsWidget(QWidget *parent) : QTreeWidget(parent), d(new medPa
 
     connect(this, SIGNAL(itemExpanded(QTreeWidgetItem *)), this, SLOT(onItemExpanded(QTreeWidgetItem *)));
     connect(this, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(updateContextMenu(const QPoint&)));
-    connect(this->d->server, SIGNAL(endOfStudy(QString)), this, SIGNAL(import(QString)));
+    connect(this->d->server, SIGNAL(endOfStudy(QString)), this, SLOT(onEndOfStudy(QString)));
+    connect(this->d->server, SIGNAL(instanceReceived(QString, QString, QString)),
+            d->importQueue, SLOT(onInstanceReceived(QString, QString, QString)), Qt::QueuedConnection);
 
     this->readSettings();
     d->start();
@@ -163,6 +167,23 @@ bool medPacsWidget::isServerFunctional()
         return false;
 }
 
+/**
+ * @brief Queue staging the retrieved series. Move requests report to it when they complete.
+ */
+medPacsImportQueue* medPacsWidget::importQueue()
+{
+    return d->importQueue;
+}
+
+void medPacsWidget::onEndOfStudy(QString directory)
+{
+    // streamed series were already imported one by one
+    if (!d->importQueue->isStreaming())
+    {
+        emit import(directory);
+    }
+}
+
 void medPacsWidget::search(QString query)
 {
     this->readSettings();
@@ -18,6 +18,7 @@
 #include <medPacsExport.h>
 #include <medMoveCommandItem.h>
 
+class medPacsImportQueue;
 class medPacsWidgetPrivate;
 
 class MEDPACS_EXPORT medPacsWidget : public QTreeWidget
@@ -34,6 +35,8 @@ public:
      */
     bool isServerFunctional();
 
+    medPacsImportQueue* importQueue();
+
 signals:
     void moveList(const QVector<medMoveCommandItem>&);
     void import(QString);
@@ -48,6 +51,7 @@ public slots:
 protected slots:
     void onItemExpanded(QTreeWidgetItem *);
     void onItemImported();
+    void onEndOfStudy(QString directory);
     void updateContextMenu(const QPoint&);
 
 protected:
@@ -0,0 +1,237 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QTemporaryDir>
+
+#include <medAbstractPacsStoreScp.h>
+#include <medPacsImportQueue.h>
+#include <medPacsImportQueueTest.h>
+
+namespace
+{
+    // Store SCP writing empty instances in its storage directory
+    class testStoreScp : public medAbstractPacsStoreScp
+    {
+    public:
+        testStoreScp(const QString& directory) : directory(directory) {}
+
+        QString store(const QString& name, const QString& studyInstanceUid, const QString& seriesInstanceUid)
+        {
+            QString file = QDir(directory).absoluteFilePath(name);
+            QFile(file).open(QIODevice::WriteOnly);
+            notifyInstanceStored(file.toLocal8Bit(), studyInstanceUid.toLatin1(), seriesInstanceUid.toLatin1());
+            return file;
+        }
+
+    private:
+        QString directory;
+    };
+
+    // Queue recording the series it would import
+    class testImportQueue : public medPacsImportQueue
+    {
+    public:
+        testImportQueue(const QString& stagingDirectory) : medPacsImportQueue(stagingDirectory)
+        {
+            setGracePeriod(0);
+        }
+
+        QStringList imported;
+        QStringList directories;
+
+    protected:
+        void importSeries(const QString& directory) override
+        {
+            // staged as <series UID>-<import number>
+            imported << QFileInfo(directory).fileName().section('-', 0, 0);
+            directories << directory;
+        }
+    };
+
+    // Let the queue import the series of the finished requests
+    void settle()
+    {
+        QTest::qWait(20);
+    }
+
+    medMoveCommandItem request(int group, int elem, const QString& query)
+    {
+        medMoveCommandItem item;
+        item.group = group;
+        item.elem = elem;
+        item.query = query;
+        item.sourceTitle = "PACS";
+        item.sourcePort = 104;
+        item.targetPort = 9999;
+        return item;
+    }
+
+    medMoveCommandItem seriesRequest(const QString& seriesInstanceUid)
+    {
+        return request(0x0020, 0x000E, seriesInstanceUid);
+    }
+
+    medMoveCommandItem studyRequest(const QString& studyInstanceUid)
+    {
+        return request(0x0020, 0x000D, studyInstanceUid);
+    }
+
+    medMoveCommandItem patientRequest(const QString& patientId)
+    {
+        return request(0x0010, 0x0020, patientId);
+    }
+
+    struct fixture
+    {
+        QTemporaryDir storage;
+        QTemporaryDir staging;
+        testStoreScp scp;
+        testImportQueue queue;
+
+        fixture() : scp(storage.path()), queue(staging.path())
+        {
+            QObject::connect(&scp, SIGNAL(instanceReceived(QString, QString, QString)),
+                             &queue, SLOT(onInstanceReceived(QString, QString, QString)));
+        }
+    };
+}
+
+void medPacsImportQueueTest::testStoredInstancesAreStaged()
+{
+    fixture f;
+    QVERIFY(!f.queue.isStreaming());
+
+    QString file = f.scp.store("1.dcm", "1.1", "1.1.1");
+
+    QVERIFY(f.queue.isStreaming());
+    QVERIFY(!QFile::exists(file));
+    QVERIFY(QFile::exists(QDir(f.staging.path()).absoluteFilePath("1.1.1/1.dcm")));
+}
+
+void medPacsImportQueueTest::testSeriesRequestImportsItsSeriesOnly()
+{
+    fixture f;
+    f.queue.onRequestStarted(seriesRequest("1.1.1"));
+    f.queue.onRequestStarted(seriesRequest("1.1.2"));
+
+    f.scp.store("1.dcm", "1.1", "1.1.1");
+    f.scp.store("2.dcm", "1.1", "1.1.2");
+    f.scp.store("3.dcm", "1.1", "1.1.1");
+
+    QSignalSpy received(&f.queue, SIGNAL(seriesReceived(QString)));
+    f.queue.onRequestFinished(seriesRequest("1.1.1"), true);
+    settle();
+
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1");
+    QCOMPARE(received.count(), 1);
+
+    f.queue.onRequestFinished(seriesRequest("1.1.2"), true);
+    settle();
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1" << "1.1.2");
+}
+
+void medPacsImportQueueTest::testStudyRequestKeepsSeriesOfRunningRequests()
+{
+    fixture f;
+    f.queue.onRequestStarted(studyRequest("1.1"));
+    f.queue.onRequestStarted(seriesRequest("1.1.1"));
+
+    f.scp.store("1.dcm", "1.1", "1.1.1");
+    f.scp.store("2.dcm", "1.1", "1.1.2");
+    f.scp.store("3.dcm", "1.2", "1.2.1");
+
+    f.queue.onRequestFinished(studyRequest("1.1"), true);
+    settle();
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.2");
+
+    f.queue.onRequestFinished(seriesRequest("1.1.1"), true);
+    settle();
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.2" << "1.1.1");
+}
+
+void medPacsImportQueueTest::testOtherLevelRequestsWaitForEachOther()
+{
+    fixture f;
+    f.queue.onRequestStarted(patientRequest("A"));
+    f.queue.onRequestStarted(patientRequest("B"));
+    f.queue.onRequestStarted(seriesRequest("2.1.1"));
+
+    f.scp.store("1.dcm", "1.1", "1.1.1");
+    f.scp.store("2.dcm", "2.1", "2.1.1");
+
+    // the series can come from the other patient request
+    f.queue.onRequestFinished(patientRequest("A"), true);
+    settle();
+    QVERIFY(f.queue.imported.isEmpty());
+
+    // but not from the running series request
+    f.queue.onRequestFinished(patientRequest("B"), false);
+    settle();
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1");
+
+    f.queue.onRequestFinished(seriesRequest("2.1.1"), true);
+    settle();
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1" << "2.1.1");
+}
+
+void medPacsImportQueueTest::testLateInstancesAreImported()
+{
+    fixture f;
+    f.queue.onRequestStarted(seriesRequest("1.1.1"));
+    f.scp.store("1.dcm", "1.1", "1.1.1");
+    f.queue.onRequestFinished(seriesRequest("1.1.1"), true);
+    f.scp.store("2.dcm", "1.1", "1.1.1");
+    settle();
+
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1");
+    QVERIFY(QFile::exists(QDir(f.queue.directories.first()).absoluteFilePath("2.dcm")));
+
+    // announced once the series is being imported
+    f.scp.store("3.dcm", "1.1", "1.1.1");
+    settle();
+
+    QCOMPARE(f.queue.imported, QStringList() << "1.1.1" << "1.1.1");
+    QVERIFY(f.queue.directories.at(0) != f.queue.directories.at(1));
+    QVERIFY(QFile::exists(QDir(f.queue.directories.at(1)).absoluteFilePath("3.dcm")));
+}
+
+void medPacsImportQueueTest::testStagedFilesRemovedAfterImport()
+{
+    fixture f;
+    f.queue.onRequestStarted(seriesRequest("1.1.1"));
+    f.scp.store("1.dcm", "1.1", "1.1.1");
+    f.queue.onRequestFinished(seriesRequest("1.1.1"), true);
+    settle();
+
+    QCOMPARE(f.queue.directories.size(), 1);
+    QString directory = f.queue.directories.first();
+    QVERIFY(QFileInfo(directory).isDir());
+
+    f.queue.onSeriesImported(directory);
+    QVERIFY(!QFileInfo(directory).exists());
+    QVERIFY(QFileInfo(f.staging.path()).isDir());
+}
+
+void medPacsImportQueueTest::testLeftOversRemovedAtStart()
+{
+    QTemporaryDir staging;
+    QDir(staging.path()).mkpath("1.1.1");
+    QFile(QDir(staging.path()).absoluteFilePath("1.1.1/1.dcm")).open(QIODevice::WriteOnly);
+
+    testImportQueue queue(staging.path());
+
+    QVERIFY(!QFileInfo(QDir(staging.path()).absoluteFilePath("1.1.1")).exists());
+    QVERIFY(QFileInfo(staging.path()).isDir());
+}
+
+QTEST_MAIN(medPacsImportQueueTest)
@@ -0,0 +1,30 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#pragma once
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class medPacsImportQueueTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testStoredInstancesAreStaged();
+    void testSeriesRequestImportsItsSeriesOnly();
+    void testStudyRequestKeepsSeriesOfRunningRequests();
+    void testOtherLevelRequestsWaitForEachOther();
+    void testLateInstancesAreImported();
+    void testStagedFilesRemovedAfterImport();
+    void testLeftOversRemovedAtStart();
+};
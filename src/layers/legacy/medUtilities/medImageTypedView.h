@@ -0,0 +1,198 @@
+#pragma once
+/*
+ * medInria
+ * Copyright (c) INRIA 2013. All rights reserved.
+ *
+ * medInria is under BSD-2-Clause license. See LICENSE.txt for details in the root of the sources or:
+ * https://github.com/medInria/medInria-public/blob/master/LICENSE.txt
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <QByteArray>
+#include <QSharedPointer>
+
+#include <itkImage.h>
+#include <itkImageAdaptor.h>
+#include <itkImageScanlineIterator.h>
+#include <itkMultiThreaderBase.h>
+
+#include <medAbstractImageData.h>
+
+#include <typeinfo>
+
+namespace medImageTypedViewDetail
+{
+    /** Reads a pixel as another type, as CastImageFilter does */
+    template <class TInternal, class TExternal>
+    class CastAccessor
+    {
+    public:
+        typedef TInternal InternalType;
+        typedef TExternal ExternalType;
+
+        static inline void Set(InternalType &output, const ExternalType &input)
+        {
+            output = static_cast<InternalType>(input);
+        }
+
+        static inline ExternalType Get(const InternalType &input)
+        {
+            return static_cast<ExternalType>(input);
+        }
+    };
+
+    /** Reads a pixel as 1 when it is non zero, 0 otherwise */
+    template <class TInternal, class TExternal>
+    class MaskAccessor
+    {
+    public:
+        typedef TInternal InternalType;
+        typedef TExternal ExternalType;
+
+        static inline void Set(InternalType &output, const ExternalType &input)
+        {
+            output = static_cast<InternalType>(input);
+        }
+
+        static inline ExternalType Get(const InternalType &input)
+        {
+            return input != InternalType(0) ? ExternalType(1) : ExternalType(0);
+        }
+    };
+
+    template <class TImage>
+    class View : public medAbstractImageData::TypedView
+    {
+    public:
+        typename TImage::Pointer image;
+        const itk::Object *source;
+        itk::ModifiedTimeType sourceTime;
+    };
+}
+
+/**
+ * @brief Pixels of a medAbstractImageData in the pixel type a process works with.
+ *
+ * When the data already holds an itk::Image of that type, it is returned as
+ * is, without a copy. Otherwise the data is read through an itk::ImageAdaptor
+ * converting each pixel, into a buffer kept with the data: the next request
+ * for the same type reuses it, until the data is modified.
+ *
+ * The returned image is shared with the data and the other processes. It must
+ * not be modified, e.g. filters given it as input must not run in place.
+ */
+template <class TPixel, unsigned int VDimension>
+class medImageTypedView
+{
+public:
+    typedef itk::Image<TPixel, VDimension> ImageType;
+
+    //! Pixels cast to TPixel, as CastImageFilter would. Null if the data is not a scalar image of this dimension.
+    static typename ImageType::Pointer image(medAbstractImageData *data)
+    {
+        return view<medImageTypedViewDetail::CastAccessor>(data, "image");
+    }
+
+    //! Non zero pixels as 1, the others as 0. Data of type TPixel is returned as is, with its own non zero values.
+    static typename ImageType::Pointer mask(medAbstractImageData *data)
+    {
+        return view<medImageTypedViewDetail::MaskAccessor>(data, "mask");
+    }
+
+private:
+    template <template <class, class> class TAccessor>
+    static typename ImageType::Pointer view(medAbstractImageData *data, const char *kind)
+    {
+        if (!data)
+        {
+            return nullptr;
+        }
+
+        itk::Object *object = static_cast<itk::Object*>(data->data());
+        if (ImageType *image = dynamic_cast<ImageType*>(object))
+        {
+            return image;
+        }
+        if (!object)
+        {
+            return nullptr;
+        }
+
+        typedef medImageTypedViewDetail::View<ImageType> ViewType;
+        const QByteArray key = QByteArray(kind) + ":" + typeid(ImageType).name();
+
+        QSharedPointer<ViewType> cached = data->typedView(key).dynamicCast<ViewType>();
+        if (cached && cached->source == object && cached->sourceTime == object->GetMTime())
+        {
+            return cached->image;
+        }
+
+        typename ImageType::Pointer converted;
+        const std::type_info &pixelType = data->PixelType();
+        if      (pixelType == typeid(char))           converted = convert<char, TAccessor>(object);
+        else if (pixelType == typeid(unsigned char))  converted = convert<unsigned char, TAccessor>(object);
+        else if (pixelType == typeid(short))          converted = convert<short, TAccessor>(object);
+        else if (pixelType == typeid(unsigned short)) converted = convert<unsigned short, TAccessor>(object);
+        else if (pixelType == typeid(int))            converted = convert<int, TAccessor>(object);
+        else if (pixelType == typeid(unsigned int))   converted = convert<unsigned int, TAccessor>(object);
+        else if (pixelType == typeid(long))           converted = convert<long, TAccessor>(object);
+        else if (pixelType == typeid(unsigned long))  converted = convert<unsigned long, TAccessor>(object);
+        else if (pixelType == typeid(float))          converted = convert<float, TAccessor>(object);
+        else if (pixelType == typeid(double))         converted = convert<double, TAccessor>(object);
+
+        if (converted)
+        {
+            QSharedPointer<ViewType> entry(new ViewType);
+            entry->image = converted;
+            entry->source = object;
+            entry->sourceTime = object->GetMTime();
+            data->setTypedView(key, entry);
+        }
+        return converted;
+    }
+
+    template <class TSourcePixel, template <class, class> class TAccessor>
+    static typename ImageType::Pointer convert(itk::Object *object)
+    {
+        typedef itk::Image<TSourcePixel, VDimension> SourceImageType;
+        typedef itk::ImageAdaptor<SourceImageType, TAccessor<TSourcePixel, TPixel> > AdaptorType;
+
+        SourceImageType *source = dynamic_cast<SourceImageType*>(object);
+        if (!source)
+        {
+            return nullptr;
+        }
+
+        typename AdaptorType::Pointer adaptor = AdaptorType::New();
+        adaptor->SetImage(source);
+
+        const typename ImageType::RegionType region = source->GetBufferedRegion();
+        typename ImageType::Pointer image = ImageType::New();
+        image->CopyInformation(source);
+        image->SetBufferedRegion(region);
+        image->SetRequestedRegion(region);
+        image->Allocate();
+
+        itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+        multiThreader->ParallelizeImageRegion<VDimension>(region, [&](const typename ImageType::RegionType &subRegion)
+        {
+            itk::ImageScanlineConstIterator<AdaptorType> itSource(adaptor, subRegion);
+            itk::ImageScanlineIterator<ImageType> itView(image, subRegion);
+            while (!itView.IsAtEnd())
+            {
+                while (!itView.IsAtEndOfLine())
+                {
+                    itView.Set(itSource.Get());
+                    ++itSource;
+                    ++itView;
+                }
+                itSource.NextLine();
+                itView.NextLine();
+            }
+        }, nullptr);
+
+        return image;
+    }
+};
@@ -0,0 +1,596 @@
+/*
+ * medInria
+ * Copyright (c) INRIA 2013. All rights reserved.
+ *
+ * medInria is under BSD-2-Clause license. See LICENSE.txt for details in the root of the sources or:
+ * https://github.com/medInria/medInria-public/blob/master/LICENSE.txt
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "medN4BiasCorrectionEngine.h"
+
+#include <QDebug>
+
+#include <itkBSplineControlPointImageFilter.h>
+#include <itkConstantPadImageFilter.h>
+#include <itkImageScanlineIterator.h>
+#include <itkMultiThreaderBase.h>
+#include <itkN4BiasFieldCorrectionImageFilter.h>
+#include <itkOtsuThresholdImageFilter.h>
+#include <itkShrinkImageFilter.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <thread>
+
+typedef medN4BiasCorrectionEngine::ImageType ImageType;
+typedef medN4BiasCorrectionEngine::MaskImageType MaskImageType;
+typedef itk::N4BiasFieldCorrectionImageFilter<ImageType, MaskImageType, ImageType> CorrecterType;
+typedef CorrecterType::ScalarImageType FieldType;
+
+namespace
+{
+    /** Shrunk image and mask of an input, which only depend on the input, the mask and the padding */
+    struct ShrunkInput
+    {
+        const itk::DataObject *input;
+        itk::ModifiedTimeType inputTime;
+        const itk::DataObject *mask;
+        itk::ModifiedTimeType maskTime;
+        unsigned int shrinkFactor;
+        double splineDistance;
+
+        ImageType::Pointer image;
+        MaskImageType::Pointer maskImage;
+        ImageType::RegionType paddedRegion;
+        ImageType::PointType paddedOrigin;
+        unsigned int spans[3]; // with a spline distance
+
+        bool sameKey(const ShrunkInput &other) const
+        {
+            return input == other.input && inputTime == other.inputTime
+                    && mask == other.mask && maskTime == other.maskTime
+                    && shrinkFactor == other.shrinkFactor && splineDistance == other.splineDistance;
+        }
+    };
+
+    const size_t s_cacheSize = 4;
+    std::mutex s_cacheMutex;
+    std::list<ShrunkInput> s_cache; // most recently used first
+
+    bool findShrunkInput(ShrunkInput &entry)
+    {
+        std::lock_guard<std::mutex> lock(s_cacheMutex);
+        for (auto it = s_cache.begin(); it != s_cache.end(); ++it)
+        {
+            if (it->sameKey(entry))
+            {
+                s_cache.splice(s_cache.begin(), s_cache, it);
+                entry = s_cache.front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void storeShrunkInput(const ShrunkInput &entry)
+    {
+        std::lock_guard<std::mutex> lock(s_cacheMutex);
+        s_cache.push_front(entry);
+        while (s_cache.size() > s_cacheSize)
+        {
+            s_cache.pop_back();
+        }
+    }
+}
+
+class medN4BiasCorrectionEnginePrivate
+{
+public:
+    itk::DataObject::ConstPointer inputSource;
+    itk::ProcessObject::Pointer inputFilter; // null when the input is used as is
+    ImageType::Pointer input;
+
+    itk::DataObject::ConstPointer maskSource;
+    itk::ProcessObject::Pointer maskFilter;
+    MaskImageType::Pointer mask;
+
+    medN4BiasCorrectionEngine::Parameters parameters;
+    unsigned int numberOfThreads;
+    bool computeBiasField;
+    std::function<void(double)> progressCallback;
+
+    ImageType::Pointer output;
+    ImageType::Pointer biasField;
+
+    std::atomic<bool> aborting;
+    std::mutex runningMutex;
+    itk::ProcessObject::Pointer running;
+
+    void progress(double value)
+    {
+        if (progressCallback)
+        {
+            progressCallback(value);
+        }
+    }
+
+    //! Update a filter with the engine's threads, abortable
+    void run(itk::ProcessObject *filter)
+    {
+        filter->SetNumberOfWorkUnits(numberOfThreads);
+        {
+            std::lock_guard<std::mutex> lock(runningMutex);
+            running = filter;
+            if (aborting)
+            {
+                filter->AbortGenerateDataOn();
+            }
+        }
+        filter->Update();
+        {
+            std::lock_guard<std::mutex> lock(runningMutex);
+            running = nullptr;
+        }
+    }
+
+    bool shrinkInput(ShrunkInput &shrunk);
+    void divideByField(const ImageType::RegionType &paddedRegion, const FieldType *logField);
+};
+
+medN4BiasCorrectionEngine::Parameters::Parameters()
+    : shrinkFactor(4), splineOrder(3), convergenceThreshold(0.0001), wienerFilterNoise(0.01),
+      biasFieldFullWidthAtHalfMaximum(0.15), numberOfHistogramBins(200), splineDistance(0)
+{
+    iterations = {50, 40, 30};
+    meshResolution[0] = meshResolution[1] = meshResolution[2] = 1;
+}
+
+medN4BiasCorrectionEngine::medN4BiasCorrectionEngine() : d(new medN4BiasCorrectionEnginePrivate)
+{
+    d->numberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+    d->computeBiasField = false;
+    d->aborting = false;
+}
+
+medN4BiasCorrectionEngine::~medN4BiasCorrectionEngine()
+{
+    delete d;
+    d = nullptr;
+}
+
+void medN4BiasCorrectionEngine::setInput(const ImageType *image)
+{
+    setInputPipeline(image, nullptr, const_cast<ImageType*>(image));
+}
+
+void medN4BiasCorrectionEngine::setInputPipeline(const itk::DataObject *source, itk::ProcessObject *filter, ImageType *image)
+{
+    d->inputSource = source;
+    d->inputFilter = filter;
+    d->input = image;
+}
+
+void medN4BiasCorrectionEngine::setMaskPipeline(const itk::DataObject *source, itk::ProcessObject *filter, MaskImageType *mask)
+{
+    d->maskSource = source;
+    d->maskFilter = filter;
+    d->mask = mask;
+}
+
+void medN4BiasCorrectionEngine::clearMask()
+{
+    setMaskPipeline(nullptr, nullptr, nullptr);
+}
+
+void medN4BiasCorrectionEngine::setParameters(const Parameters &parameters)
+{
+    d->parameters = parameters;
+}
+
+medN4BiasCorrectionEngine::Parameters medN4BiasCorrectionEngine::parameters() const
+{
+    return d->parameters;
+}
+
+void medN4BiasCorrectionEngine::setNumberOfThreads(unsigned int numberOfThreads)
+{
+    d->numberOfThreads = std::max(1u, numberOfThreads);
+}
+
+unsigned int medN4BiasCorrectionEngine::numberOfThreads() const
+{
+    return d->numberOfThreads;
+}
+
+void medN4BiasCorrectionEngine::setComputeBiasField(bool compute)
+{
+    d->computeBiasField = compute;
+}
+
+void medN4BiasCorrectionEngine::setProgressCallback(std::function<void(double)> callback)
+{
+    d->progressCallback = callback;
+}
+
+void medN4BiasCorrectionEngine::abort()
+{
+    d->aborting = true;
+
+    std::lock_guard<std::mutex> lock(d->runningMutex);
+    if (d->running)
+    {
+        d->running->AbortGenerateDataOn();
+    }
+}
+
+ImageType::Pointer medN4BiasCorrectionEngine::output() const
+{
+    return d->output;
+}
+
+ImageType::Pointer medN4BiasCorrectionEngine::biasField() const
+{
+    return d->biasField;
+}
+
+/**
+ * Pad the input (and mask) to a whole number of B-spline spans, then shrink
+ * them. The cast, Otsu, pad and shrink filters form one pipeline, the input
+ * is read once.
+ */
+bool medN4BiasCorrectionEnginePrivate::shrinkInput(ShrunkInput &shrunk)
+{
+    typedef itk::OtsuThresholdImageFilter<ImageType, MaskImageType> OtsuFilterType;
+    typedef itk::ConstantPadImageFilter<ImageType, ImageType> PadderType;
+    typedef itk::ConstantPadImageFilter<MaskImageType, MaskImageType> MaskPadderType;
+    typedef itk::ShrinkImageFilter<ImageType, ImageType> ShrinkerType;
+    typedef itk::ShrinkImageFilter<MaskImageType, MaskImageType> MaskShrinkerType;
+
+    input->UpdateOutputInformation();
+    const ImageType::RegionType region = input->GetLargestPossibleRegion();
+
+    // data objects only hold weak references to their source, the filters are kept here
+    OtsuFilterType::Pointer otsu;
+    PadderType::Pointer padder;
+    MaskPadderType::Pointer maskPadder;
+
+    ImageType::Pointer image = input;
+    MaskImageType::Pointer maskImage = mask;
+
+    if (!maskImage)
+    {
+        otsu = OtsuFilterType::New();
+        otsu->SetInput(input);
+        otsu->SetNumberOfHistogramBins(200);
+        otsu->SetInsideValue(0);
+        otsu->SetOutsideValue(1);
+        otsu->SetNumberOfWorkUnits(numberOfThreads);
+        maskImage = otsu->GetOutput();
+    }
+    else if (maskFilter)
+    {
+        maskFilter->SetNumberOfWorkUnits(numberOfThreads);
+    }
+
+    ImageType::SizeType lowerBound;
+    ImageType::SizeType upperBound;
+    lowerBound.Fill(0);
+    upperBound.Fill(0);
+
+    if (parameters.splineDistance > 0)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            const double spacing = input->GetSpacing()[i];
+            const double domain = static_cast<double>(region.GetSize()[i] - 1) * spacing;
+            shrunk.spans[i] = static_cast<unsigned int>(std::ceil(domain / parameters.splineDistance));
+            const itk::SizeValueType extraPadding = static_cast<itk::SizeValueType>((shrunk.spans[i] * parameters.splineDistance - domain) / spacing + 0.5);
+            lowerBound[i] = extraPadding / 2;
+            upperBound[i] = extraPadding - lowerBound[i];
+        }
+
+        padder = PadderType::New();
+        padder->SetInput(image);
+        padder->SetPadLowerBound(lowerBound);
+        padder->SetPadUpperBound(upperBound);
+        padder->SetConstant(0);
+        padder->SetNumberOfWorkUnits(numberOfThreads);
+        image = padder->GetOutput();
+
+        maskPadder = MaskPadderType::New();
+        maskPadder->SetInput(maskImage);
+        maskPadder->SetPadLowerBound(lowerBound);
+        maskPadder->SetPadUpperBound(upperBound);
+        maskPadder->SetConstant(0);
+        maskPadder->SetNumberOfWorkUnits(numberOfThreads);
+        maskImage = maskPadder->GetOutput();
+    }
+
+    ImageType::IndexType paddedIndex = region.GetIndex();
+    ImageType::SizeType paddedSize = region.GetSize();
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        paddedIndex[i] -= static_cast<ImageType::IndexValueType>(lowerBound[i]);
+        paddedSize[i] += lowerBound[i] + upperBound[i];
+    }
+    shrunk.paddedRegion = ImageType::RegionType(paddedIndex, paddedSize);
+    input->TransformIndexToPhysicalPoint(paddedIndex, shrunk.paddedOrigin);
+
+    ShrinkerType::Pointer shrinker = ShrinkerType::New();
+    shrinker->SetInput(image);
+    shrinker->SetShrinkFactors(parameters.shrinkFactor);
+
+    MaskShrinkerType::Pointer maskShrinker = MaskShrinkerType::New();
+    maskShrinker->SetInput(maskImage);
+    maskShrinker->SetShrinkFactors(parameters.shrinkFactor);
+
+    // the cast output is shared by both branches and only computed once
+    run(maskShrinker);
+    progress(0.05);
+    if (aborting)
+    {
+        return false;
+    }
+    run(shrinker);
+    progress(0.1);
+
+    shrunk.image = shrinker->GetOutput();
+    shrunk.image->DisconnectPipeline();
+    shrunk.maskImage = maskShrinker->GetOutput();
+    shrunk.maskImage->DisconnectPipeline();
+    return !aborting;
+}
+
+/**
+ * Divide the input by the exponential of the log field, on the original
+ * region only. logField covers paddedRegion, from index 0.
+ */
+void medN4BiasCorrectionEnginePrivate::divideByField(const ImageType::RegionType &paddedRegion, const FieldType *logField)
+{
+    const ImageType::RegionType region = input->GetLargestPossibleRegion();
+
+    output = ImageType::New();
+    output->CopyInformation(input);
+    output->SetRegions(region);
+    output->Allocate();
+
+    biasField = nullptr;
+    if (computeBiasField)
+    {
+        biasField = ImageType::New();
+        biasField->CopyInformation(input);
+        biasField->SetRegions(region);
+        biasField->Allocate();
+    }
+
+    itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+    multiThreader->SetMaximumNumberOfThreads(numberOfThreads);
+    multiThreader->SetNumberOfWorkUnits(numberOfThreads);
+    multiThreader->ParallelizeImageRegion<3>(region, [&](const ImageType::RegionType &subRegion)
+    {
+        ImageType::IndexType fieldIndex = subRegion.GetIndex();
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            fieldIndex[i] -= paddedRegion.GetIndex()[i];
+        }
+        const ImageType::RegionType fieldRegion(fieldIndex, subRegion.GetSize());
+
+        itk::ImageScanlineConstIterator<ImageType> itInput(input, subRegion);
+        itk::ImageScanlineConstIterator<FieldType> itField(logField, fieldRegion);
+        itk::ImageScanlineIterator<ImageType> itOutput(output, subRegion);
+        itk::ImageScanlineIterator<ImageType> itBias;
+        if (biasField)
+        {
+            itBias = itk::ImageScanlineIterator<ImageType>(biasField, subRegion);
+        }
+
+        while (!itOutput.IsAtEnd())
+        {
+            while (!itOutput.IsAtEndOfLine())
+            {
+                const float field = std::exp(itField.Get()[0]);
+                itOutput.Set(itInput.Get() / field);
+                ++itInput;
+                ++itField;
+                ++itOutput;
+                if (biasField)
+                {
+                    itBias.Set(field);
+                    ++itBias;
+                }
+            }
+            itInput.NextLine();
+            itField.NextLine();
+            itOutput.NextLine();
+            if (biasField)
+            {
+                itBias.NextLine();
+            }
+        }
+    }, nullptr);
+}
+
+medN4BiasCorrectionEngine::Status medN4BiasCorrectionEngine::update()
+{
+    typedef itk::BSplineControlPointImageFilter<CorrecterType::BiasFieldControlPointLatticeType, FieldType> BSplinerType;
+
+    d->output = nullptr;
+    d->biasField = nullptr;
+    d->aborting = false;
+
+    if (!d->input)
+    {
+        return Failed;
+    }
+
+    const Parameters &parameters = d->parameters;
+
+    try
+    {
+        if (d->inputFilter)
+        {
+            d->inputFilter->SetNumberOfWorkUnits(d->numberOfThreads);
+        }
+
+        ShrunkInput shrunk;
+        shrunk.input = d->inputSource;
+        shrunk.inputTime = d->inputSource->GetMTime();
+        shrunk.mask = d->maskSource;
+        shrunk.maskTime = d->maskSource ? d->maskSource->GetMTime() : 0;
+        shrunk.shrinkFactor = std::max(1u, parameters.shrinkFactor);
+        shrunk.splineDistance = parameters.splineDistance;
+
+        if (findShrunkInput(shrunk))
+        {
+            d->progress(0.1);
+        }
+        else
+        {
+            if (!d->shrinkInput(shrunk))
+            {
+                return Aborted;
+            }
+            storeShrunkInput(shrunk);
+        }
+
+        CorrecterType::Pointer correcter = CorrecterType::New();
+        correcter->SetInput(shrunk.image);
+        correcter->SetMaskImage(shrunk.maskImage);
+
+        if (parameters.splineOrder)
+        {
+            correcter->SetSplineOrder(parameters.splineOrder);
+        }
+
+        CorrecterType::ArrayType numberOfControlPoints;
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            const unsigned int spans = parameters.splineDistance > 0 ? shrunk.spans[i]
+                                                                     : static_cast<unsigned int>(parameters.meshResolution[i]);
+            numberOfControlPoints[i] = spans + correcter->GetSplineOrder();
+        }
+        correcter->SetNumberOfControlPoints(numberOfControlPoints);
+
+        if (!parameters.iterations.empty())
+        {
+            CorrecterType::VariableSizeArrayType maximumNumberOfIterations(parameters.iterations.size());
+            for (unsigned int i = 0; i < parameters.iterations.size(); ++i)
+            {
+                maximumNumberOfIterations[i] = parameters.iterations[i];
+            }
+            correcter->SetMaximumNumberOfIterations(maximumNumberOfIterations);
+
+            CorrecterType::ArrayType numberOfFittingLevels;
+            numberOfFittingLevels.Fill(parameters.iterations.size());
+            correcter->SetNumberOfFittingLevels(numberOfFittingLevels);
+        }
+        if (parameters.convergenceThreshold)
+        {
+            correcter->SetConvergenceThreshold(parameters.convergenceThreshold);
+        }
+        if (parameters.wienerFilterNoise)
+        {
+            correcter->SetWienerFilterNoise(parameters.wienerFilterNoise);
+        }
+        if (parameters.biasFieldFullWidthAtHalfMaximum)
+        {
+            correcter->SetBiasFieldFullWidthAtHalfMaximum(parameters.biasFieldFullWidthAtHalfMaximum);
+        }
+        if (parameters.numberOfHistogramBins)
+        {
+            correcter->SetNumberOfHistogramBins(parameters.numberOfHistogramBins);
+        }
+
+        correcter->AddObserver(itk::ProgressEvent(), [&](const itk::EventObject &)
+        {
+            d->progress(0.1 + 0.75 * correcter->GetProgress());
+        });
+        d->run(correcter);
+
+        // full resolution log field on the padded grid the lattice was fitted on
+        BSplinerType::Pointer bspliner = BSplinerType::New();
+        bspliner->SetInput(correcter->GetLogBiasFieldControlPointLattice());
+        bspliner->SetSplineOrder(correcter->GetSplineOrder());
+        bspliner->SetSize(shrunk.paddedRegion.GetSize());
+        bspliner->SetOrigin(shrunk.paddedOrigin);
+        bspliner->SetSpacing(d->input->GetSpacing());
+        bspliner->SetDirection(d->input->GetDirection());
+        d->run(bspliner);
+        d->progress(0.95);
+
+        // the cast input is up to date after the shrink pipeline, it only runs here when the cache was hit
+        if (d->inputFilter)
+        {
+            d->run(d->inputFilter);
+        }
+
+        if (d->aborting)
+        {
+            return Aborted;
+        }
+        d->divideByField(shrunk.paddedRegion, bspliner->GetOutput());
+        d->progress(1);
+    }
+    catch (itk::ProcessAborted &)
+    {
+        d->output = nullptr;
+        d->biasField = nullptr;
+        return Aborted;
+    }
+    catch (itk::ExceptionObject &err)
+    {
+        qWarning() << "medN4BiasCorrectionEngine:" << err.GetDescription();
+        d->output = nullptr;
+        d->biasField = nullptr;
+        return Failed;
+    }
+
+    return d->aborting ? Aborted : Succeeded;
+}
+
+std::vector<medN4BiasCorrectionEngine::Status> medN4BiasCorrectionEngine::correctBatch(const std::vector<medN4BiasCorrectionEngine*> &engines, unsigned int numberOfThreads)
+{
+    std::vector<Status> status(engines.size(), Failed);
+    if (engines.empty())
+    {
+        return status;
+    }
+
+    numberOfThreads = std::max(1u, numberOfThreads);
+    const unsigned int workers = std::min<unsigned int>(numberOfThreads, static_cast<unsigned int>(engines.size()));
+    const unsigned int threadsPerEngine = std::max(1u, numberOfThreads / workers);
+
+    std::atomic<size_t> next(0);
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < engines.size(); i = next++)
+        {
+            engines[i]->setNumberOfThreads(threadsPerEngine);
+            status[i] = engines[i]->update();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < workers; ++i)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    return status;
+}
+
+void medN4BiasCorrectionEngine::clearCache()
+{
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    s_cache.clear();
+}
@@ -0,0 +1,128 @@
+#pragma once
+/*
+ * medInria
+ * Copyright (c) INRIA 2013. All rights reserved.
+ *
+ * medInria is under BSD-2-Clause license. See LICENSE.txt for details in the root of the sources or:
+ * https://github.com/medInria/medInria-public/blob/master/LICENSE.txt
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "medUtilitiesExport.h"
+
+#include <itkBinaryThresholdImageFilter.h>
+#include <itkCastImageFilter.h>
+#include <itkImage.h>
+
+#include <functional>
+#include <vector>
+
+class medN4BiasCorrectionEnginePrivate;
+
+/**
+ * @brief N4 bias field correction of 3D images.
+ *
+ * The input is padded to the B-spline distance, shrunk and masked (Otsu
+ * mask unless one is given), then corrected by itk::N4BiasFieldCorrectionImageFilter.
+ * The bias field is evaluated at full resolution and divided out of the input
+ * in a single parallel pass over the original region, without padding,
+ * cropping or intermediate images.
+ *
+ * The shrunk image and mask do not depend on the N4 settings (iterations,
+ * convergence, histogram...). They are kept in a small cache shared by all
+ * engines, so running again on the same input with other settings only runs
+ * the fitting and the final pass.
+ *
+ * Every filter uses at most numberOfThreads() threads. correctBatch() runs
+ * several engines concurrently, sharing a number of threads between them.
+ */
+class MEDUTILITIES_EXPORT medN4BiasCorrectionEngine
+{
+public:
+    typedef itk::Image<float, 3> ImageType;
+    typedef itk::Image<unsigned char, 3> MaskImageType;
+
+    enum Status { Succeeded, Failed, Aborted };
+
+    struct MEDUTILITIES_EXPORT Parameters
+    {
+        Parameters();
+
+        unsigned int shrinkFactor;
+        unsigned int splineOrder;               // 0 keeps the filter default
+        std::vector<unsigned int> iterations;   // per fitting level, empty keeps the filter default
+        double convergenceThreshold;            // 0 keeps the filter default
+        double wienerFilterNoise;               // 0 keeps the filter default
+        double biasFieldFullWidthAtHalfMaximum; // 0 keeps the filter default
+        unsigned int numberOfHistogramBins;     // 0 keeps the filter default
+        double splineDistance;                  // mm between control points, 0 to use meshResolution
+        double meshResolution[3];               // spans of the B-spline mesh along each axis
+    };
+
+    medN4BiasCorrectionEngine();
+    ~medN4BiasCorrectionEngine();
+
+    //! Any 3D scalar image, cast to float when the engine runs
+    template <class TInputImage>
+    void setInput(const TInputImage *image)
+    {
+        typedef itk::CastImageFilter<TInputImage, ImageType> CastFilterType;
+        typename CastFilterType::Pointer caster = CastFilterType::New();
+        caster->SetInput(image);
+        setInputPipeline(image, caster, caster->GetOutput());
+    }
+    void setInput(const ImageType *image);
+
+    //! Voxels of the mask equal to label are corrected. Without a mask, an Otsu mask of the input is used.
+    template <class TMaskImage>
+    void setMask(const TMaskImage *mask, typename TMaskImage::PixelType label)
+    {
+        typedef itk::BinaryThresholdImageFilter<TMaskImage, MaskImageType> ThresholdFilterType;
+        typename ThresholdFilterType::Pointer thresholder = ThresholdFilterType::New();
+        thresholder->SetInput(mask);
+        thresholder->SetLowerThreshold(label);
+        thresholder->SetUpperThreshold(label);
+        thresholder->SetInsideValue(1);
+        thresholder->SetOutsideValue(0);
+        setMaskPipeline(mask, thresholder, thresholder->GetOutput());
+    }
+    void clearMask();
+
+    void setParameters(const Parameters &parameters);
+    Parameters parameters() const;
+
+    void setNumberOfThreads(unsigned int numberOfThreads);
+    unsigned int numberOfThreads() const;
+
+    //! Keep the full resolution bias field too, see biasField()
+    void setComputeBiasField(bool compute);
+
+    //! Called with the progression, between 0 and 1, from the thread running update()
+    void setProgressCallback(std::function<void(double)> callback);
+
+    Status update();
+
+    //! Thread-safe, makes the running update() return Aborted
+    void abort();
+
+    ImageType::Pointer output() const;
+    ImageType::Pointer biasField() const;
+
+    /**
+     * @brief correctBatch updates several engines concurrently.
+     * The engines run numberOfThreads at a time, each with its share of the threads.
+     * @return the status of each engine
+     */
+    static std::vector<Status> correctBatch(const std::vector<medN4BiasCorrectionEngine*> &engines, unsigned int numberOfThreads);
+
+    //! Drop the shrunk images and masks kept for later runs
+    static void clearCache();
+
+private:
+    void setInputPipeline(const itk::DataObject *source, itk::ProcessObject *filter, ImageType *image);
+    void setMaskPipeline(const itk::DataObject *source, itk::ProcessObject *filter, MaskImageType *mask);
+
+    medN4BiasCorrectionEnginePrivate *d;
+};
@@ -0,0 +1,88 @@
+/*
+ * medInria
+ * Copyright (c) INRIA 2013. All rights reserved.
+ *
+ * medInria is under BSD-2-Clause license. See LICENSE.txt for details in the root of the sources or:
+ * https://github.com/medInria/medInria-public/blob/master/LICENSE.txt
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "medPolygonRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+QVector<medPolygonRasterizer::Span> medPolygonRasterizer::spans(const QPolygonF &polygon, int width, int height)
+{
+    QVector<Span> result;
+
+    const int nbPoints = polygon.size();
+    if (nbPoints < 3 || width <= 0 || height <= 0)
+    {
+        return result;
+    }
+
+    const QRectF bounds = polygon.boundingRect();
+    // Rows whose center lies within the bounds. Clamp in floating point
+    // first, vertices may lie far outside the slice
+    const int firstRow = static_cast<int>(std::min<double>(height, std::max(0.0, std::ceil(bounds.top() - 0.5))));
+    const int lastRow = static_cast<int>(std::max(0.0, std::min<double>(height, std::ceil(bounds.bottom() - 0.5)))) - 1;
+
+    std::vector<double> crossings;
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+        // The row is sampled at the center of its voxels. An edge crosses it
+        // when one end is on or above it and the other is below, so that
+        // shared vertices are counted once and horizontal edges are skipped.
+        const double y = row + 0.5;
+        crossings.clear();
+        for (int i = 0; i < nbPoints; ++i)
+        {
+            const QPointF &a = polygon[i];
+            const QPointF &b = polygon[(i + 1) % nbPoints];
+            if ((a.y() <= y) != (b.y() <= y))
+            {
+                crossings.push_back(a.x() + (y - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Voxels whose center lies between two crossings
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+        {
+            const int begin = static_cast<int>(std::min<double>(width, std::max(0.0, std::ceil(crossings[i] - 0.5))));
+            const int end = static_cast<int>(std::min<double>(width, std::max(0.0, std::ceil(crossings[i + 1] - 0.5))));
+            if (begin < end)
+            {
+                result.append({row, begin, end});
+            }
+        }
+    }
+
+    return result;
+}
+
+void medPolygonRasterizer::sliceAxes(unsigned int orientation, unsigned int &x, unsigned int &y, unsigned int &z)
+{
+    switch (orientation)
+    {
+        case 0:
+            x = 1;
+            y = 2;
+            z = 0;
+            break;
+        case 1:
+            x = 0;
+            y = 2;
+            z = 1;
+            break;
+        case 2:
+        default:
+            x = 0;
+            y = 1;
+            z = 2;
+            break;
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+/*
+ * medInria
+ * Copyright (c) INRIA 2013. All rights reserved.
+ *
+ * medInria is under BSD-2-Clause license. See LICENSE.txt for details in the root of the sources or:
+ * https://github.com/medInria/medInria-public/blob/master/LICENSE.txt
+ *
+ * This software is distributed WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "medUtilitiesExport.h"
+
+#include <QMap>
+#include <QPolygonF>
+#include <QVector>
+
+#include <itkImage.h>
+#include <itkMultiThreaderBase.h>
+
+#include <vector>
+
+/**
+ * @brief Scanline rasterization of slice polygons into image buffers.
+ *
+ * Polygon vertices are given in index coordinates of the slice, voxel i
+ * spanning [i, i + 1). A voxel is inside when its center (i + 0.5) is inside
+ * the polygon (even-odd rule, top-left convention on edges), which matches
+ * what filling a QPainterPath into a QImage gives for the same polygon.
+ */
+class MEDUTILITIES_EXPORT medPolygonRasterizer
+{
+public:
+    /** Run of voxels [begin, end) on one row of a slice */
+    struct Span
+    {
+        int row;
+        int begin;
+        int end;
+    };
+
+    /**
+     * @brief spans computes the runs of voxels covered by a polygon, clipped to the slice
+     */
+    static QVector<Span> spans(const QPolygonF &polygon, int width, int height);
+
+    /**
+     * @brief sliceAxes gives the in-slice axes (x, y) and the stacking axis (z) of an orientation
+     * @param orientation 0 (sagittal), 1 (coronal) or 2 (axial)
+     */
+    static void sliceAxes(unsigned int orientation, unsigned int &x, unsigned int &y, unsigned int &z);
+
+    /**
+     * @brief fillSlices writes a value in the voxels covered by the polygons of each slice
+     * Spans go straight into the image buffer and slices are processed in parallel.
+     * @param polygons polygons of each slice, indexed by slice number along the orientation
+     * @param outside if true, the voxels covered by none of the polygons of a slice are written instead
+     */
+    template <typename ImageType>
+    static void fillSlices(ImageType *image, unsigned int orientation,
+                           const QMap<int, QVector<QPolygonF> > &polygons,
+                           typename ImageType::PixelType value, bool outside = false)
+    {
+        typedef typename ImageType::OffsetValueType OffsetValueType;
+
+        unsigned int x = 0, y = 0, z = 0;
+        sliceAxes(orientation, x, y, z);
+
+        const typename ImageType::RegionType region = image->GetBufferedRegion();
+        const int width = static_cast<int>(region.GetSize()[x]);
+        const int height = static_cast<int>(region.GetSize()[y]);
+        const int depth = static_cast<int>(region.GetSize()[z]);
+        const OffsetValueType stride = image->GetOffsetTable()[x];
+        typename ImageType::PixelType *buffer = image->GetBufferPointer();
+        const QList<int> slices = polygons.keys();
+
+        auto fillSlice = [&](itk::SizeValueType n)
+        {
+            const int slice = slices[static_cast<int>(n)];
+            if (slice < 0 || slice >= depth)
+            {
+                return;
+            }
+
+            typename ImageType::IndexType index = region.GetIndex();
+            index[z] += slice;
+            auto fillSpan = [&](int row, int begin, int end)
+            {
+                index[x] = region.GetIndex()[x] + begin;
+                index[y] = region.GetIndex()[y] + row;
+                OffsetValueType offset = image->ComputeOffset(index);
+                for (int i = begin; i < end; ++i, offset += stride)
+                {
+                    buffer[offset] = value;
+                }
+            };
+
+            const QVector<QPolygonF> &slicePolygons = polygons.constFind(slice).value();
+            if (!outside)
+            {
+                for (const QPolygonF &polygon : slicePolygons)
+                {
+                    for (const Span &span : spans(polygon, width, height))
+                    {
+                        fillSpan(span.row, span.begin, span.end);
+                    }
+                }
+                return;
+            }
+
+            std::vector<unsigned char> covered(static_cast<size_t>(width) * height, 0);
+            for (const QPolygonF &polygon : slicePolygons)
+            {
+                for (const Span &span : spans(polygon, width, height))
+                {
+                    std::fill(covered.begin() + span.row * width + span.begin,
+                              covered.begin() + span.row * width + span.end, 1);
+                }
+            }
+            for (int row = 0; row < height; ++row)
+            {
+                const unsigned char *line = covered.data() + static_cast<size_t>(row) * width;
+                int begin = 0;
+                while (begin < width)
+                {
+                    while (begin < width && line[begin])
+                    {
+                        ++begin;
+                    }
+                    int end = begin;
+                    while (end < width && !line[end])
+                    {
+                        ++end;
+                    }
+                    if (begin < end)
+                    {
+                        fillSpan(row, begin, end);
+                    }
+                    begin = end;
+                }
+            }
+        };
+
+        itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+        threader->ParallelizeArray(0, slices.size(), fillSlice, nullptr);
+        image->Modified();
+    }
+};
@@ -20,6 +20,7 @@
 #include <medAbstractImageData.h>
 #include <medAttachedData.h>
 #include <medDataManager.h>
+#include <medImageTypedView.h>
 
 #include <itkImageRegionIterator.h>
 #include <itkMinimumMaximumImageCalculator.h>
@@ -54,54 +55,7 @@ public:
         {
             if (composite->input1)
             {
-                QString id = composite->input1->identifier();
-
-                if ( id == "itkDataImageChar3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <char,3> >();
-                }
-                else if ( id == "itkDataImageUChar3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <unsigned char,3> >();
-                }
-                else if ( id == "itkDataImageShort3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <short,3> >();
-                }
-                else if ( id == "itkDataImageUShort3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <unsigned short,3> >();
-                }
-                else if ( id == "itkDataImageInt3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <int,3> >();
-                }
-                else if ( id == "itkDataImageUInt3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <unsigned int,3> >();
-                }
-                else if ( id == "itkDataImageLong3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <long,3> >();
-                }
-                else if ( id== "itkDataImageULong3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <unsigned long,3> >();
-                }
-                else if ( id == "itkDataImageFloat3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <float,3> >();
-                }
-                else if ( id == "itkDataImageDouble3" )
-                {
-                    res = runMeanStdDeviation< ImageType, itk::Image <double,3> >();
-                }
-                else
-                {
-                    qDebug() <<"statsROI, error: pixel type not yet implemented ("
-                             << id
-                             << ")";
-                }
+                res = runMeanStdDeviation<ImageType>();
             }
         }
         else // Compute Volume in mL
@@ -119,10 +73,21 @@ public:
 
     }
 
-    template <class ImageType, class ImageType2> int runMeanStdDeviation()
+    template <class ImageType> int runMeanStdDeviation()
     {
+        typedef itk::Image<unsigned char, 3> ImageType2;
+
         typename ImageType::Pointer  imag = dynamic_cast<ImageType  *> ( ( itk::Object* ) ( composite->input0->data() )) ;
-        typename ImageType2::Pointer mask = dynamic_cast<ImageType2 *> ( ( itk::Object* ) ( composite->input1->data() )) ;
+
+        // masks of any pixel type, converted once per mask data
+        typename ImageType2::Pointer mask = medImageTypedView<unsigned char, 3>::mask(qobject_cast<medAbstractImageData*>(composite->input1.data()));
+        if (mask.IsNull())
+        {
+            qDebug() <<"statsROI, error: pixel type not yet implemented ("
+                     << composite->input1->identifier()
+                     << ")";
+            return DTK_FAILURE;
+        }
 
         // Iterators
         typedef itk::ImageRegionIterator <ImageType> MaskIterator;
@@ -175,6 +175,39 @@ void vtkMetaDataSet::SetDataSet (vtkDataSet* dataset)
   this->Modified();
 }
 
+//----------------------------------------------------------------------------
+void vtkMetaDataSet::ReleaseDataSet()
+{
+  if (!this->DataSet)
+  {
+    return;
+  }
+  this->DataSet->UnRegister(this);
+  this->DataSet = nullptr;
+  this->CurrentScalarArray = nullptr;
+
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSet::TakeDataSet (vtkMetaDataSet* metadataset)
+{
+  if (!metadataset || metadataset == this || !metadataset->DataSet)
+  {
+    return;
+  }
+  if (this->DataSet)
+  {
+    this->DataSet->UnRegister(this);
+  }
+  this->DataSet = metadataset->DataSet;
+  this->DataSet->Register(this);
+  metadataset->ReleaseDataSet();
+
+  this->Initialize();
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkMetaDataSet::SetLookupTable (vtkLookupTable* array)
 {
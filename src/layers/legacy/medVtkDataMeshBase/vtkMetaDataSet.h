@@ -19,8 +19,10 @@
 
 #include <QString>
 
+#include <vtkDataArray.h>
 #include <vtkDataObject.h>
 #include <vtkDataSet.h>
+#include <vtkSmartPointer.h>
 
 #include <string>
 #include <vector>
@@ -129,6 +131,16 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSet: public vtkDataObject
      Get the dataset associated with the metadataset
   */
   vtkGetObjectMacro (DataSet, vtkDataSet)
+  /**
+     Release the dataset, e.g. for a frame of a sequence that can be read
+     again from GetFilePath() when it is needed.
+  */
+  virtual void ReleaseDataSet();
+  /**
+     Take the dataset of another metadataset, without copying it.
+     The other metadataset is left without dataset.
+  */
+  virtual void TakeDataSet (vtkMetaDataSet* metadataset);
   /**
      Get the type of the metadataset :
       vtkMetaDataSet::VTK_META_IMAGE_DATA, vtkMetaDataSet::VTK_META_SURFACE_MESH,
@@ -340,7 +352,10 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSet: public vtkDataObject
   /**
      Get the currently used scalar array for visualization
   */
-  vtkGetObjectMacro (CurrentScalarArray, vtkDataArray)
+  vtkDataArray* GetCurrentScalarArray()
+  {
+    return this->CurrentScalarArray;
+  }
   void SetCurrentActiveArray (vtkDataArray* array)
   {
     this->CurrentScalarArray = array;
@@ -420,7 +435,8 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSet: public vtkDataObject
   vtkDataArrayCollection* ArrayCollection;
   vtkLookupTable* LookupTable;
 
-  vtkDataArray* CurrentScalarArray;
+  // kept alive, the arrays of the dataset can be replaced (e.g. by a sequence changing frame)
+  vtkSmartPointer<vtkDataArray> CurrentScalarArray;
 
  private:
 
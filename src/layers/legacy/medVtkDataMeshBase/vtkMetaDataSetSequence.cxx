@@ -35,9 +35,148 @@
 #include <vtkCellArray.h>
 #include <vtkDoubleArray.h>
 #include <vtkDataArrayCollection.h>
+#include <vtkIdTypeArray.h>
+#include <vtkUnsignedCharArray.h>
 
 #include <sstream>
 #include <algorithm> // for sort algorithm
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    //! Cell arrays with the same cells; a missing array is an empty one.
+    bool SameCells (vtkCellArray *a, vtkCellArray *b)
+    {
+        if (a == b)
+            return true;
+
+        vtkIdType na = a ? a->GetNumberOfCells() : 0;
+        vtkIdType nb = b ? b->GetNumberOfCells() : 0;
+        if (na != nb)
+            return false;
+        if (na == 0)
+            return true;
+
+        vtkIdTypeArray *da = a->GetData();
+        vtkIdTypeArray *db = b->GetData();
+        if (da->GetNumberOfValues() != db->GetNumberOfValues())
+            return false;
+
+        return std::equal (da->GetPointer(0), da->GetPointer(0) + da->GetNumberOfValues(), db->GetPointer(0));
+    }
+
+    bool SameCellTypes (vtkUnsignedCharArray *a, vtkUnsignedCharArray *b)
+    {
+        if (a == b)
+            return true;
+        if (!a || !b || a->GetNumberOfValues() != b->GetNumberOfValues())
+            return false;
+
+        return std::equal (a->GetPointer(0), a->GetPointer(0) + a->GetNumberOfValues(), b->GetPointer(0));
+    }
+
+    //! The datasets use the very same connectivity arrays.
+    bool SharesTopology (vtkDataSet *a, vtkDataSet *b)
+    {
+        vtkPolyData *pa = vtkPolyData::SafeDownCast (a);
+        vtkPolyData *pb = vtkPolyData::SafeDownCast (b);
+        if (pa && pb)
+        {
+            return pa->GetVerts() == pb->GetVerts() && pa->GetLines() == pb->GetLines()
+                    && pa->GetPolys() == pb->GetPolys() && pa->GetStrips() == pb->GetStrips();
+        }
+
+        vtkUnstructuredGrid *ua = vtkUnstructuredGrid::SafeDownCast (a);
+        vtkUnstructuredGrid *ub = vtkUnstructuredGrid::SafeDownCast (b);
+        if (ua && ub)
+        {
+            return ua->GetCells() == ub->GetCells() && ua->GetCellTypesArray() == ub->GetCellTypesArray();
+        }
+
+        return false;
+    }
+
+    std::string ArrayName (vtkDataArray *array)
+    {
+        return (array && array->GetName()) ? array->GetName() : "";
+    }
+}
+
+//----------------------------------------------------------------------------
+// Frames read ahead by a background thread. Each frame is read into a
+// metadataset of its own, whose dataset is handed to the frame when needed.
+class vtkMetaDataSetSequencePrefetch
+{
+public:
+    struct Request
+    {
+        vtkMetaDataSet *Frame;
+        vtkSmartPointer<vtkMetaDataSet> Copy;
+        std::string Path;
+    };
+
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    std::thread Worker;
+    bool Stop = false;
+
+    std::deque<Request> Queue;                  // requested, not started yet
+    std::set<vtkMetaDataSet*> Wanted;           // of the last request
+    std::set<vtkMetaDataSet*> Reading;
+    std::map<vtkMetaDataSet*, vtkSmartPointer<vtkMetaDataSet> > Ready;
+
+    vtkMetaDataSetSequencePrefetch()
+    {
+        this->Worker = std::thread (&vtkMetaDataSetSequencePrefetch::Run, this);
+    }
+
+    ~vtkMetaDataSetSequencePrefetch()
+    {
+        {
+            std::lock_guard<std::mutex> lock (this->Mutex);
+            this->Stop = true;
+            this->Queue.clear();
+        }
+        this->Changed.notify_all();
+        this->Worker.join();
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock (this->Mutex);
+        while (true)
+        {
+            this->Changed.wait (lock, [this] { return this->Stop || !this->Queue.empty(); });
+            if (this->Stop)
+                return;
+
+            Request request = this->Queue.front();
+            this->Queue.pop_front();
+            this->Reading.insert (request.Frame);
+            lock.unlock();
+
+            bool read = true;
+            try
+            {
+                request.Copy->Read (request.Path.c_str());
+            }
+            catch (vtkErrorCode::ErrorIds)
+            {
+                read = false;
+            }
+
+            lock.lock();
+            this->Reading.erase (request.Frame);
+            if (read && request.Copy->GetDataSet() && this->Wanted.count (request.Frame))
+                this->Ready[request.Frame] = request.Copy;
+            this->Changed.notify_all();
+        }
+    }
+};
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro( vtkMetaDataSetSequence )
@@ -51,6 +190,8 @@ vtkMetaDataSetSequence::vtkMetaDataSetSequence()
     this->Type = vtkMetaDataSet::VTK_META_UNKNOWN;
     this->SameGeometryFlag = true;
     this->ParseAttributes = true;
+    this->MaximumNumberOfLoadedFrames = 0;
+    this->Prefetch = nullptr;
 }
 
 vtkMetaDataSetSequence::vtkMetaDataSetSequence(const vtkMetaDataSetSequence& other)
@@ -60,16 +201,38 @@ vtkMetaDataSetSequence::vtkMetaDataSetSequence(const vtkMetaDataSetSequence& oth
     this->CurrentId = other.CurrentId;
     this->SameGeometryFlag = other.SameGeometryFlag;
     this->ParseAttributes = other.ParseAttributes;
+    this->MaximumNumberOfLoadedFrames = other.MaximumNumberOfLoadedFrames;
+    this->Prefetch = nullptr;
+    this->ColorArrayName = other.ColorArrayName;
+    this->ColorLookupTable = other.ColorLookupTable;
 
     for (unsigned int i = 0; i < other.MetaDataSetList.size(); ++i)
     {
-        this->MetaDataSetList.push_back(other.MetaDataSetList[i]->Clone());
+        vtkMetaDataSet *frame = other.MetaDataSetList[i]->Clone();
+        this->MetaDataSetList.push_back(frame);
+
+        if (other.LazyFrames.count(other.MetaDataSetList[i]))
+        {
+            this->LazyFrames.insert(frame);
+            std::map<vtkMetaDataSet*, FrameRanges>::const_iterator ranges = other.LazyFrameRanges.find(other.MetaDataSetList[i]);
+            if (ranges != other.LazyFrameRanges.end())
+            {
+                this->LazyFrameRanges[frame] = ranges->second;
+            }
+            if (frame->GetDataSet())
+            {
+                this->LoadedFrames.push_back(frame);
+            }
+        }
+        this->ShareTopology(frame);
     }
 }
 
 //----------------------------------------------------------------------------
 vtkMetaDataSetSequence::~vtkMetaDataSetSequence()
 {
+    delete this->Prefetch;
+
     for (unsigned int i=0; i<this->MetaDataSetList.size(); i++)
     {
         this->MetaDataSetList[i]->Delete();
@@ -106,6 +269,12 @@ void vtkMetaDataSetSequence::AddMetaDataSet (vtkMetaDataSet *metadataset)
         throw vtkErrorCode::UserError;
     }
 
+    if (!metadataset->GetDataSet() && !(*metadataset->GetFilePath()))
+    {
+        vtkErrorMacro(<<"Cannot add a dataset without data nor file to sequence !"<<endl);
+        throw vtkErrorCode::UserError;
+    }
+
     std::vector<vtkMetaDataSet*>::iterator it;
     bool inserted = false;
 
@@ -115,6 +284,7 @@ void vtkMetaDataSetSequence::AddMetaDataSet (vtkMetaDataSet *metadataset)
         {
             this->MetaDataSetList.insert(it, metadataset);
             inserted = true;
+            break;
         }
     }
     if (!inserted)
@@ -123,13 +293,32 @@ void vtkMetaDataSetSequence::AddMetaDataSet (vtkMetaDataSet *metadataset)
     }
     metadataset->Register(this);
 
+    if (!metadataset->GetDataSet())
+    {
+        this->LazyFrames.insert (metadataset);
+    }
+    else
+    {
+        this->ShareTopology (metadataset);
+    }
+
     try
     {
         if (!this->GetDataSet())
         {
+            unsigned int id = std::find (this->MetaDataSetList.begin(), this->MetaDataSetList.end(), metadataset)
+                    - this->MetaDataSetList.begin();
+            if (!this->LoadFrame (id))
+            {
+                throw vtkErrorCode::CannotOpenFileError;
+            }
+
             this->Time = metadataset->GetTime();
-            this->CurrentId = this->MetaDataSetList.size() - 1;
             this->BuildMetaDataSetFromMetaDataSet (metadataset);
+
+            // the output shares the arrays of the frame rather than copying them
+            this->CurrentId = -1;
+            this->UpdateToIndex (id);
         }
         this->ComputeSequenceDuration();
     }
@@ -154,6 +343,10 @@ void vtkMetaDataSetSequence::RemoveMetaDataSet (unsigned int id)
             this->MetaDataSetList.push_back (templist[i]);
         else
         {
+            this->CancelPrefetch (templist[i]);
+            this->LazyFrames.erase (templist[i]);
+            this->LazyFrameRanges.erase (templist[i]);
+            this->LoadedFrames.remove (templist[i]);
             templist[i]->UnRegister(this);
         }
     }
@@ -186,11 +379,17 @@ void vtkMetaDataSetSequence::RemoveMetaDataSet (vtkMetaDataSet *metadataset)
 //----------------------------------------------------------------------------
 void vtkMetaDataSetSequence::RemoveAllMetaDataSets()
 {
+    this->CancelPrefetch();
+
     for (unsigned int i=0; i<this->MetaDataSetList.size(); i++)
     {
         this->MetaDataSetList[i]->UnRegister(this);
     }
     this->MetaDataSetList.clear();
+    this->LazyFrames.clear();
+    this->LazyFrameRanges.clear();
+    this->LoadedFrames.clear();
+    this->Topology = nullptr;
     this->ComputeSequenceDuration();
     this->Type = vtkMetaDataSet::VTK_META_UNKNOWN;
 
@@ -205,6 +404,7 @@ vtkMetaDataSet*vtkMetaDataSetSequence::GetMetaDataSet (unsigned int i)
 {
     if (i>=this->MetaDataSetList.size())
         return nullptr;
+    this->LoadFrame (i);
     return this->MetaDataSetList[i];
 }
 
@@ -378,130 +578,424 @@ void vtkMetaDataSetSequence::UpdateToIndex (unsigned int id)
     if (id >= this->MetaDataSetList.size())
         return;
 
-    vtkDataSet *datasettoshow  = this->MetaDataSetList[id]->GetDataSet();
+    vtkDataSet *datasettoshow   = this->LoadFrame (id);
+    vtkDataSet *datasettochange = this->GetDataSet();
+    if (!datasettoshow || !datasettochange)
+        return;
+
+    // the attributes shown stay the same through the frames
+    std::string pdscalars = ArrayName (datasettochange->GetPointData()->GetScalars());
+    std::string cdscalars = ArrayName (datasettochange->GetCellData()->GetScalars());
+    std::string pdtensors = ArrayName (datasettochange->GetPointData()->GetTensors());
+    std::string cdtensors = ArrayName (datasettochange->GetCellData()->GetTensors());
 
-    vtkPolyData *polydatatoshow   = vtkPolyData::SafeDownCast (datasettoshow);
-    vtkPolyData *polydatatochange = vtkPolyData::SafeDownCast (this->GetDataSet());
+    vtkPointSet *pointsettoshow   = vtkPointSet::SafeDownCast (datasettoshow);
+    vtkPointSet *pointsettochange = vtkPointSet::SafeDownCast (datasettochange);
 
-    if (polydatatoshow && polydatatochange) {
-        polydatatochange->ShallowCopy (polydatatoshow);
-    } else {
-        vtkUnstructuredGrid *unstructuredgridtoshow   = vtkUnstructuredGrid::SafeDownCast (datasettoshow);
-        vtkUnstructuredGrid *unstructuredgridtochange = vtkUnstructuredGrid::SafeDownCast (this->GetDataSet());
-        if (unstructuredgridtoshow && unstructuredgridtochange) {
-            unstructuredgridtochange->ShallowCopy (unstructuredgridtoshow);
-        }
+    if (pointsettoshow && pointsettochange && SharesTopology (pointsettochange, pointsettoshow))
+    {
+        // same connectivity: only swap the points and attribute arrays
+        pointsettochange->SetPoints (pointsettoshow->GetPoints());
+        datasettochange->GetPointData()->ShallowCopy (datasettoshow->GetPointData());
+        datasettochange->GetCellData()->ShallowCopy (datasettoshow->GetCellData());
+    }
+    else if (vtkPolyData::SafeDownCast (datasettoshow) && vtkPolyData::SafeDownCast (datasettochange))
+    {
+        datasettochange->ShallowCopy (datasettoshow);
+    }
+    else if (vtkUnstructuredGrid::SafeDownCast (datasettoshow) && vtkUnstructuredGrid::SafeDownCast (datasettochange))
+    {
+        datasettochange->ShallowCopy (datasettoshow);
+    }
+    else
+    {
+        datasettochange->GetPointData()->ShallowCopy (datasettoshow->GetPointData());
+        datasettochange->GetCellData()->ShallowCopy (datasettoshow->GetCellData());
     }
 
     if (this->ParseAttributes)
     {
-        vtkDataArray *pdscalars = this->GetDataSet()->GetPointData()->GetScalars();
-        vtkDataArray *cdscalars = this->GetDataSet()->GetCellData()->GetScalars();
-        vtkDataArray *pdtensors = this->GetDataSet()->GetPointData()->GetTensors();
-        vtkDataArray *cdtensors = this->GetDataSet()->GetCellData()->GetTensors();
+        vtkPointData *pointData = datasettochange->GetPointData();
+        vtkCellData  *cellData  = datasettochange->GetCellData();
+
+        if (!pdscalars.empty() && pointData->HasArray (pdscalars.c_str()))
+            pointData->SetActiveScalars (pdscalars.c_str());
+        if (!cdscalars.empty() && cellData->HasArray (cdscalars.c_str()))
+            cellData->SetActiveScalars (cdscalars.c_str());
+        if (!pdtensors.empty() && pointData->HasArray (pdtensors.c_str()))
+            pointData->SetActiveTensors (pdtensors.c_str());
+        if (!cdtensors.empty() && cellData->HasArray (cdtensors.c_str()))
+            cellData->SetActiveTensors (cdtensors.c_str());
+    }
+
+    datasettochange->GetPointData()->Modified();
+    datasettochange->GetCellData()->Modified();
+    datasettochange->Modified();
 
-        if (pdscalars)
+    // updating the current id
+    this->CurrentId   = id;
+}
+
+//----------------------------------------------------------------------------
+vtkDataSet* vtkMetaDataSetSequence::LoadFrame (unsigned int id)
+{
+    if (id >= this->MetaDataSetList.size())
+        return nullptr;
+
+    vtkMetaDataSet *frame = this->MetaDataSetList[id];
+    if (!this->LazyFrames.count (frame))
+        return frame->GetDataSet();
+
+    if (!frame->GetDataSet())
+    {
+        if (!this->TakePrefetchedFrame (frame))
         {
-            const char *c_name = pdscalars->GetName();
-            if ( c_name && (*c_name) )
+            try
             {
-                std::string name = c_name;
-                vtkDataArray *array = datasettoshow->GetPointData()->GetArray(name.c_str());
-                if (array)
-                {
-                    pdscalars->DeepCopy (array);
-                }
+                frame->Read (frame->GetFilePath());
             }
-            else
+            catch (vtkErrorCode::ErrorIds)
             {
-                this->GetDataSet()->GetPointData()->SetScalars(datasettoshow->GetPointData()->GetScalars());
+                vtkErrorMacro(<<"cannot read frame "<<frame->GetFilePath()<<endl);
+                return nullptr;
             }
-
-            this->GetDataSet()->GetPointData()->Modified();
-            this->GetDataSet()->Modified();
         }
 
-        if (cdscalars)
+        this->StoreFrameRanges (frame);
+        this->ShareTopology (frame);
+
+        // the frame is colored like the others
+        vtkDataSet *dataset = frame->GetDataSet();
+        if (dataset && !this->ColorArrayName.empty())
         {
-            const char *c_name = cdscalars->GetName();
-            if ( c_name && (*c_name) )
-            {
-                std::string name = c_name;
-                vtkDataArray *array = datasettoshow->GetCellData()->GetArray(name.c_str());
+            const char *name = this->ColorArrayName.c_str();
+            vtkDataSetAttributes *attributes = dataset->GetPointData();
+            if (!attributes->HasArray (name))
+                attributes = dataset->GetCellData();
 
-                if (array)
-                {
-                    cdscalars->DeepCopy (array);
-                }
-            }
-            else
+            vtkDataArray *array = attributes->GetArray (name);
+            if (array)
             {
-                this->GetDataSet()->GetCellData()->SetScalars(datasettoshow->GetCellData()->GetScalars());
+                if (this->ColorLookupTable)
+                    array->SetLookupTable (this->ColorLookupTable);
+                attributes->SetActiveScalars (name);
+                frame->SetCurrentActiveArray (array);
             }
-            this->GetDataSet()->GetCellData()->Modified();
         }
-        if (pdtensors)
+    }
+
+    this->LoadedFrames.remove (frame);
+    this->LoadedFrames.push_front (frame);
+    this->ReleaseFrames();
+
+    return frame->GetDataSet();
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSetSequence::StoreFrameRanges (vtkMetaDataSet *metadataset)
+{
+    vtkDataSet *dataset = metadataset->GetDataSet();
+    if (!dataset || this->LazyFrameRanges.count (metadataset))
+        return;
+
+    // the file of a frame does not change, neither do the ranges of its arrays
+    FrameRanges &ranges = this->LazyFrameRanges[metadataset];
+    vtkDataSetAttributes *attributes[2] = { dataset->GetPointData(), dataset->GetCellData() };
+    std::map<std::string, std::pair<double, double> > *stored[2] = { &ranges.Points, &ranges.Cells };
+
+    for (int a = 0; a < 2; a++)
+    {
+        for (int i = 0; i < attributes[a]->GetNumberOfArrays(); i++)
         {
-            const char *c_name = pdtensors->GetName();
-            if ( c_name && (*c_name) )
-            {
-                std::string name = c_name;
-                vtkDataArray *array = datasettoshow->GetPointData()->GetArray(name.c_str());
-                if (array)
-                {
-                    pdtensors->DeepCopy (array);
-                }
-            }
-            else
-            {
-                this->GetDataSet()->GetPointData()->SetTensors(datasettoshow->GetPointData()->GetTensors());
-            }
+            vtkDataArray *array = attributes[a]->GetArray (i);
+            if (!array || !array->GetName())
+                continue;
+
+            double range[2];
+            array->GetRange (range);
+            (*stored[a])[array->GetName()] = std::make_pair (range[0], range[1]);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMetaDataSetSequence::GetFrameRange (unsigned int id, const std::string& name, double range[2])
+{
+    if (id >= this->MetaDataSetList.size())
+        return false;
+
+    vtkMetaDataSet *frame = this->MetaDataSetList[id];
+    std::map<vtkMetaDataSet*, FrameRanges>::const_iterator ranges = this->LazyFrameRanges.find (frame);
 
-            this->GetDataSet()->GetPointData()->Modified();
+    if (ranges == this->LazyFrameRanges.end())
+    {
+        // reading a lazy frame keeps its ranges, the others are in memory
+        vtkDataSet *dataset = this->LoadFrame (id);
+        if (!dataset)
+            return false;
+
+        ranges = this->LazyFrameRanges.find (frame);
+        if (ranges == this->LazyFrameRanges.end())
+        {
+            vtkDataArray *array = dataset->GetPointData()->GetArray (name.c_str());
+            if (!array)
+                array = dataset->GetCellData()->GetArray (name.c_str());
+            if (!array)
+                return false;
+
+            array->GetRange (range);
+            return true;
         }
+    }
+
+    std::map<std::string, std::pair<double, double> >::const_iterator it = ranges->second.Points.find (name);
+    if (it == ranges->second.Points.end())
+    {
+        it = ranges->second.Cells.find (name);
+        if (it == ranges->second.Cells.end())
+            return false;
+    }
+
+    range[0] = it->second.first;
+    range[1] = it->second.second;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSetSequence::GetSequenceRange (QString attributeName, double range[2])
+{
+    range[0] = VTK_DOUBLE_MAX;
+    range[1] = VTK_DOUBLE_MIN;
+
+    for (unsigned int i = 0; i < this->MetaDataSetList.size(); i++)
+    {
+        vtkMetaDataSet *frame = this->MetaDataSetList[i];
+
+        // frames which can not be read are skipped
+        if (!this->LazyFrameRanges.count (frame) && !this->LoadFrame (i))
+            continue;
 
-        if (cdtensors)
+        // as vtkMetaDataSet::GetScalarRange(), the current array by default
+        std::string name = attributeName.trimmed().toStdString();
+        if (name.empty())
         {
-            const char *c_name = cdtensors->GetName();
-            if ( c_name && (*c_name) )
-            {
-                std::string name = c_name;
-                vtkDataArray *array = datasettoshow->GetCellData()->GetArray(name.c_str());
+            if (frame->GetDataSet() && frame->GetCurrentScalarArray() && frame->GetCurrentScalarArray()->GetName())
+                name = frame->GetCurrentScalarArray()->GetName();
+            else if (!frame->GetDataSet())
+                name = this->ColorArrayName;
+        }
 
-                if (array)
-                {
-                    cdtensors->DeepCopy (array);
-                }
-            }
-            else
+        // frames without the array count as [0, 1]
+        double frameRange[2] = { 0, 1 };
+        this->GetFrameRange (i, name, frameRange);
+
+        if (range[0] > frameRange[0])
+            range[0] = frameRange[0];
+        if (range[1] < frameRange[1])
+            range[1] = frameRange[1];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSetSequence::ReleaseFrames()
+{
+    if (this->MaximumNumberOfLoadedFrames <= 0)
+        return;
+
+    vtkMetaDataSet *current = nullptr;
+    if (this->CurrentId >= 0 && this->CurrentId < (int)this->MetaDataSetList.size())
+        current = this->MetaDataSetList[this->CurrentId];
+
+    // the current and the most recently used frames are kept
+    std::list<vtkMetaDataSet*>::iterator it = this->LoadedFrames.end();
+    while ((int)this->LoadedFrames.size() > this->MaximumNumberOfLoadedFrames && it != this->LoadedFrames.begin())
+    {
+        --it;
+        if (*it == current || it == this->LoadedFrames.begin())
+            continue;
+
+        (*it)->ReleaseDataSet();
+        it = this->LoadedFrames.erase (it);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSetSequence::PrefetchFrames (const std::vector<unsigned int>& ids)
+{
+    if (this->LazyFrames.empty())
+        return;
+
+    if (!this->Prefetch)
+        this->Prefetch = new vtkMetaDataSetSequencePrefetch;
+
+    std::lock_guard<std::mutex> lock (this->Prefetch->Mutex);
+
+    this->Prefetch->Queue.clear();
+    this->Prefetch->Wanted.clear();
+    for (unsigned int i=0; i<ids.size(); i++)
+    {
+        if (ids[i] >= this->MetaDataSetList.size())
+            continue;
+
+        vtkMetaDataSet *frame = this->MetaDataSetList[ids[i]];
+        if (!this->LazyFrames.count (frame) || frame->GetDataSet() || this->Prefetch->Wanted.count (frame))
+            continue;
+
+        this->Prefetch->Wanted.insert (frame);
+        if (this->Prefetch->Ready.count (frame) || this->Prefetch->Reading.count (frame))
+            continue;
+
+        vtkMetaDataSetSequencePrefetch::Request request;
+        request.Frame = frame;
+        request.Copy = vtkSmartPointer<vtkMetaDataSet>::Take (frame->NewInstance());
+        request.Path = frame->GetFilePath();
+        this->Prefetch->Queue.push_back (request);
+    }
+
+    // the frames already passed are not kept
+    std::map<vtkMetaDataSet*, vtkSmartPointer<vtkMetaDataSet> >::iterator it = this->Prefetch->Ready.begin();
+    while (it != this->Prefetch->Ready.end())
+    {
+        if (this->Prefetch->Wanted.count (it->first))
+            ++it;
+        else
+            it = this->Prefetch->Ready.erase (it);
+    }
+
+    this->Prefetch->Changed.notify_all();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMetaDataSetSequence::TakePrefetchedFrame (vtkMetaDataSet *metadataset)
+{
+    if (!this->Prefetch)
+        return false;
+
+    vtkSmartPointer<vtkMetaDataSet> copy;
+    {
+        std::unique_lock<std::mutex> lock (this->Prefetch->Mutex);
+
+        // read here rather than waiting for the queue
+        std::deque<vtkMetaDataSetSequencePrefetch::Request>& queue = this->Prefetch->Queue;
+        for (std::deque<vtkMetaDataSetSequencePrefetch::Request>::iterator it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (it->Frame == metadataset)
             {
-                this->GetDataSet()->GetCellData()->SetTensors(datasettoshow->GetCellData()->GetTensors());
+                queue.erase (it);
+                break;
             }
-            this->GetDataSet()->GetCellData()->Modified();
         }
+
+        this->Prefetch->Changed.wait (lock, [&] { return !this->Prefetch->Reading.count (metadataset); });
+
+        this->Prefetch->Wanted.erase (metadataset);
+        std::map<vtkMetaDataSet*, vtkSmartPointer<vtkMetaDataSet> >::iterator it = this->Prefetch->Ready.find (metadataset);
+        if (it == this->Prefetch->Ready.end())
+            return false;
+
+        copy = it->second;
+        this->Prefetch->Ready.erase (it);
     }
 
-    // updating the current id
-    this->CurrentId   = id;
+    metadataset->TakeDataSet (copy);
+    return metadataset->GetDataSet() != nullptr;
 }
 
 //----------------------------------------------------------------------------
-double*vtkMetaDataSetSequence::GetCurrentScalarRange()
+void vtkMetaDataSetSequence::CancelPrefetch (vtkMetaDataSet *metadataset)
 {
-    double *val = new double[2];
-    val[0] = VTK_DOUBLE_MAX;
-    val[1] = VTK_DOUBLE_MIN;
+    if (!this->Prefetch)
+        return;
 
-    for (unsigned int i=0; i<this->MetaDataSetList.size(); i++)
+    std::unique_lock<std::mutex> lock (this->Prefetch->Mutex);
+    if (!metadataset)
     {
-        double *range = this->MetaDataSetList[i]->GetScalarRange();
+        this->Prefetch->Queue.clear();
+        this->Prefetch->Wanted.clear();
+        this->Prefetch->Ready.clear();
+        return;
+    }
 
-        if (val[0] > range[0])
-            val[0] = range[0];
-        if (val[1] < range[1])
-            val[1] = range[1];
-        delete [] range;
+    std::deque<vtkMetaDataSetSequencePrefetch::Request>& queue = this->Prefetch->Queue;
+    for (std::deque<vtkMetaDataSetSequencePrefetch::Request>::iterator it = queue.begin(); it != queue.end(); ++it)
+    {
+        if (it->Frame == metadataset)
+        {
+            queue.erase (it);
+            break;
+        }
     }
+    this->Prefetch->Wanted.erase (metadataset);
+    this->Prefetch->Ready.erase (metadataset);
+
+    // the address of a removed frame may be reused by another one
+    this->Prefetch->Changed.wait (lock, [&] { return !this->Prefetch->Reading.count (metadataset); });
+}
+
+//----------------------------------------------------------------------------
+void vtkMetaDataSetSequence::ShareTopology (vtkMetaDataSet *metadataset)
+{
+    vtkDataSet *dataset = metadataset->GetDataSet();
+    if (!this->SameGeometryFlag || !dataset)
+        return;
+
+    vtkPolyData *polydata = vtkPolyData::SafeDownCast (dataset);
+    vtkUnstructuredGrid *unstructuredgrid = vtkUnstructuredGrid::SafeDownCast (dataset);
+    if (!polydata && !unstructuredgrid)
+        return;
+
+    if (!this->Topology)
+    {
+        // the first frame gives the connectivity shared by the next ones
+        this->Topology.TakeReference (dataset->NewInstance());
+        if (polydata)
+        {
+            vtkPolyData *topology = vtkPolyData::SafeDownCast (this->Topology);
+            topology->SetVerts (polydata->GetVerts());
+            topology->SetLines (polydata->GetLines());
+            topology->SetPolys (polydata->GetPolys());
+            topology->SetStrips (polydata->GetStrips());
+        }
+        else
+        {
+            vtkUnstructuredGrid *topology = vtkUnstructuredGrid::SafeDownCast (this->Topology);
+            topology->SetCells (unstructuredgrid->GetCellTypesArray(), unstructuredgrid->GetCellLocationsArray(), unstructuredgrid->GetCells());
+        }
+        return;
+    }
+
+    if (polydata)
+    {
+        vtkPolyData *topology = vtkPolyData::SafeDownCast (this->Topology);
+        if (topology
+                && SameCells (topology->GetVerts(), polydata->GetVerts())
+                && SameCells (topology->GetLines(), polydata->GetLines())
+                && SameCells (topology->GetPolys(), polydata->GetPolys())
+                && SameCells (topology->GetStrips(), polydata->GetStrips()))
+        {
+            polydata->SetVerts (topology->GetVerts());
+            polydata->SetLines (topology->GetLines());
+            polydata->SetPolys (topology->GetPolys());
+            polydata->SetStrips (topology->GetStrips());
+        }
+    }
+    else
+    {
+        vtkUnstructuredGrid *topology = vtkUnstructuredGrid::SafeDownCast (this->Topology);
+        if (topology
+                && SameCellTypes (topology->GetCellTypesArray(), unstructuredgrid->GetCellTypesArray())
+                && SameCells (topology->GetCells(), unstructuredgrid->GetCells()))
+        {
+            unstructuredgrid->SetCells (topology->GetCellTypesArray(), topology->GetCellLocationsArray(), topology->GetCells());
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+double*vtkMetaDataSetSequence::GetCurrentScalarRange()
+{
+    double *val = new double[2];
+    this->GetSequenceRange (QString(), val);
 
     return val;
 }
@@ -510,6 +1004,8 @@ double*vtkMetaDataSetSequence::GetCurrentScalarRange()
 void vtkMetaDataSetSequence::ColorByArray(vtkDataArray *array)
 {
     this->CurrentScalarArray = array;
+    this->ColorArrayName = ArrayName (array);
+    this->ColorLookupTable = array ? array->GetLookupTable() : nullptr;
 
     if (!array)
         return;
@@ -534,15 +1030,33 @@ void vtkMetaDataSetSequence::ColorByArray(vtkDataArray *array)
         vtkDataArray *junk;
         vtkDataSetAttributes *attributes;
 
+        // lazy frames not in memory are colored when read, only their range is needed
+        if (!this->MetaDataSetList[i]->GetDataSet() && this->LazyFrameRanges.count (this->MetaDataSetList[i]))
+        {
+            double range[2];
+            if (this->GetFrameRange (i, array->GetName(), range))
+            {
+                if (min > range[0])
+                    min = range[0];
+                if (max < range[1])
+                    max = range[1];
+            }
+            continue;
+        }
+
+        vtkDataSet *frame = this->LoadFrame (i);
+        if (!frame)
+            continue;
+
         if (array_is_in_points)
         {
-            junk = this->MetaDataSetList[i]->GetDataSet()->GetPointData()->GetArray (array->GetName());
-            attributes = this->MetaDataSetList[i]->GetDataSet()->GetPointData();
+            junk = frame->GetPointData()->GetArray (array->GetName());
+            attributes = frame->GetPointData();
         }
         else
         {
-            junk = this->MetaDataSetList[i]->GetDataSet()->GetCellData()->GetArray (array->GetName());
-            attributes = this->MetaDataSetList[i]->GetDataSet()->GetCellData();
+            junk = frame->GetCellData()->GetArray (array->GetName());
+            attributes = frame->GetCellData();
         }
 
         if (!junk)
@@ -716,23 +1230,7 @@ double* vtkMetaDataSetSequence::GetScalarRange(QString attributeName)
 {
     // TODO: this is evil, would be better to pass the range as parameter
     static double* val = new double[2];
-    val[0] = VTK_DOUBLE_MAX;
-    val[1] = VTK_DOUBLE_MIN;
-
-    for (unsigned int i = 0; i < this->MetaDataSetList.size(); i++)
-    {
-      double* range = this->MetaDataSetList[i]->GetScalarRange(attributeName);
-
-      if (val[0] > range[0])
-      {
-        val[0] = range[0];
-      }
-      if (val[1] < range[1])
-      {
-        val[1] = range[1];
-      }
-      delete [] range;
-    }
+    this->GetSequenceRange(attributeName, val);
 
     return val;
 }
@@ -15,8 +15,13 @@
 #include "medVtkDataMeshBaseExport.h"
 
 #include <vtkMetaDataSet.h>
+#include <vtkSmartPointer.h>
 
+#include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -30,7 +35,11 @@
    of different vtkMetaDataSet (of the same type), the output dataset (got from GetDataSet())
    can be updated to a specific time with UpdateToTime().
 
-   It does not compute any time interpolation. 
+   It does not compute any time interpolation.
+
+   Frames with the same topology share their connectivity, only their points
+   and attributes are stored per frame. Changing frame swaps the points and
+   attribute arrays of the output, nothing is copied.
    
    \see
    vtkMetaSurfaceMesh vtkMetaVolumeMesh
@@ -39,6 +48,8 @@
 
 
 class vtkDoubleArray;
+class vtkLookupTable;
+class vtkMetaDataSetSequencePrefetch;
 
 class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSetSequence: public vtkMetaDataSet
 {
@@ -59,6 +70,8 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSetSequence: public vtkMetaDataSet
      with respect to the progress of time.
      The first vtkMetaDataSet added will determine the type of the sequence.
      adding new heterogeneous vtkMetaDataSet will fail.
+     A vtkMetaDataSet without dataset but with a file path is read from that
+     file the first time the frame is needed.
   */
   virtual void AddMetaDataSet (vtkMetaDataSet* metadataset);
   /**
@@ -97,13 +110,14 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSetSequence: public vtkMetaDataSet
   virtual void UpdateToIndex (unsigned int id = 0);
 
   /**
-     Access to one of the vtkMetaDataSet in the sequence list
+     Access to one of the vtkMetaDataSet in the sequence list.
+     The frame is read if it was not yet.
   */
   virtual vtkMetaDataSet* GetMetaDataSet (unsigned int i);
 
   /**
      Access to the entire list of vtkMetaDataSet.
-     Use with care.
+     Use with care: the frames read lazily may have no dataset.
   */
   //BTX
   std::vector<vtkMetaDataSet*> GetMetaDataSetList() const
@@ -213,7 +227,21 @@ class MEDVTKDATAMESHBASE_EXPORT vtkMetaDataSetSequence: public vtkMetaDataSet
   double* GetScalarRange(QString attributeName = QString()) override;
 
   vtkGetMacro (CurrentId, int);
-  
+
+  /**
+     Maximum number of frames read lazily (see AddMetaDataSet()) kept in memory.
+     The least recently used ones are released first. 0, the default, keeps them all.
+  */
+  vtkGetMacro (MaximumNumberOfLoadedFrames, int)
+  vtkSetMacro (MaximumNumberOfLoadedFrames, int)
+
+  /**
+     Read these frames in a background thread, in this order, if they are read
+     lazily and not in memory. The frames of a previous call that are not part
+     of this one are dropped, so only the frames about to be shown are kept.
+  */
+  void PrefetchFrames (const std::vector<unsigned int>& ids);
+
 protected:
   vtkMetaDataSetSequence();
   vtkMetaDataSetSequence(const vtkMetaDataSetSequence& other);
@@ -227,7 +255,40 @@ protected:
      Internal use : Build the output from a given vtkMetaDataSet.
   */
   virtual void   BuildMetaDataSetFromMetaDataSet (vtkMetaDataSet* metadataset);
-  
+  /**
+     Internal use : Read the frame if needed, and return its dataset.
+  */
+  vtkDataSet* LoadFrame (unsigned int id);
+  /**
+     Internal use : Make the frame use the connectivity of the sequence if it is the same.
+  */
+  void ShareTopology (vtkMetaDataSet* metadataset);
+  /**
+     Internal use : Keep the ranges of the arrays of a lazy frame read for the first time.
+  */
+  void StoreFrameRanges (vtkMetaDataSet* metadataset);
+  /**
+     Internal use : Range of this array of the frame. Lazy frames are not read again
+     once their ranges are kept. False if the frame has no such array.
+  */
+  bool GetFrameRange (unsigned int id, const std::string& name, double range[2]);
+  /**
+     Internal use : Range of this array over all the frames, see GetScalarRange().
+  */
+  void GetSequenceRange (QString attributeName, double range[2]);
+  /**
+     Internal use : Release the least recently used frames above MaximumNumberOfLoadedFrames.
+  */
+  void ReleaseFrames();
+  /**
+     Internal use : Give the frame the dataset read in the background, if it was requested.
+  */
+  bool TakePrefetchedFrame (vtkMetaDataSet* metadataset);
+  /**
+     Internal use : Drop the background requests of these frames, or of all frames.
+  */
+  void CancelPrefetch (vtkMetaDataSet* metadataset = nullptr);
+
   
   //BTX
   std::vector<vtkMetaDataSet*> MetaDataSetList;
@@ -239,4 +300,21 @@ protected:
   double SequenceDuration;
   bool   SameGeometryFlag;
   bool  ParseAttributes;
+
+  int MaximumNumberOfLoadedFrames;
+  //BTX
+  std::set<vtkMetaDataSet*>  LazyFrames;   // read from their file path when needed
+  std::list<vtkMetaDataSet*> LoadedFrames; // lazy frames in memory, most recently used first
+  vtkSmartPointer<vtkDataSet> Topology;    // connectivity shared by the frames, without points nor attributes
+  std::string ColorArrayName;              // of ColorByArray(), applied to the frames read again
+  vtkSmartPointer<vtkLookupTable> ColorLookupTable;
+  vtkMetaDataSetSequencePrefetch *Prefetch; // created on the first PrefetchFrames()
+
+  struct FrameRanges
+  {
+    std::map<std::string, std::pair<double, double> > Points;
+    std::map<std::string, std::pair<double, double> > Cells;
+  };
+  std::map<vtkMetaDataSet*, FrameRanges> LazyFrameRanges; // of the lazy frames, kept when first read
+  //ETX
 };
@@ -12,6 +12,7 @@
 =========================================================================*/
 #include "vtkImage3DDisplay.h"
 #include "vtkImageView3D.h"
+#include "vtkImageView3DProgressiveRenderingCallback.h"
 
 #ifndef VTK_MAJOR_VERSION
 #  include "vtkVersion.h"
@@ -20,16 +21,18 @@
 #include <vtkActor.h>
 #include <vtkAnnotatedCubeActor.h>
 #include <vtkColorTransferFunction.h>
+#include <vtkDataArray.h>
 #include <vtkDataSetCollection.h>
 #include <vtkGeometryFilter.h>
 #include <vtkIdFilter.h>
 #include <vtkImageActor.h>
-#include <vtkImageAppendComponents.h>
 #include <vtkImageCast.h>
 #include <vtkImageMapper3D.h>
 #include <vtkImageMapToColors.h>
+#include <vtkImageShrink3D.h>
 #include <vtkInteractorStyleTrackball.h>
 #include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
 #include <vtkPointSet.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPolyDataNormals.h>
@@ -39,11 +42,60 @@
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkRendererCollection.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartVolumeMapper.h>
 #include <vtkTextProperty.h>
 
+#include <algorithm>
+
 vtkStandardNewMacro(vtkImageView3D)
 
+namespace
+{
+// Write the components of source at the given component offset of the
+// interleaved target volume. Both images must have the same number of points.
+template <class T>
+void vtkImageView3DCopyComponents(vtkImageData *source, vtkImageData *target, int offset)
+{
+    const T *in = static_cast<const T *>(source->GetScalarPointer());
+    T *out = static_cast<T *>(target->GetScalarPointer());
+    const int inComps  = source->GetNumberOfScalarComponents();
+    const int outComps = target->GetNumberOfScalarComponents();
+
+    auto copyRange = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            for (int c = 0; c < inComps; ++c)
+            {
+                out[i * outComps + offset + c] = in[i * inComps + c];
+            }
+        }
+    };
+    vtkSMPTools::For(0, source->GetNumberOfPoints(), copyRange);
+}
+
+// Set to zero the given components of the interleaved target volume.
+template <class T>
+void vtkImageView3DClearComponents(vtkImageData *target, int offset, int count)
+{
+    T *out = static_cast<T *>(target->GetScalarPointer());
+    const int outComps = target->GetNumberOfScalarComponents();
+
+    auto clearRange = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            for (int c = 0; c < count; ++c)
+            {
+                out[i * outComps + offset + c] = static_cast<T>(0);
+            }
+        }
+    };
+    vtkSMPTools::For(0, target->GetNumberOfPoints(), clearRange);
+}
+}
+
 //----------------------------------------------------------------------------
 vtkImageView3D::vtkImageView3D()
 {
@@ -53,6 +105,8 @@ vtkImageView3D::vtkImageView3D()
   VolumeMapper = vtkSmartVolumeMapper::New();
 
   Callback    = vtkImageView3DCroppingBoxCallback::New();
+  ProgressiveCallback = vtkImageView3DProgressiveRenderingCallback::New();
+  ProgressiveCallback->SetView (this);
   BoxWidget   = vtkOrientedBoxWidget::New();
   PlaneWidget = vtkPlaneWidget::New();
   Marker      = vtkOrientationMarkerWidget::New();
@@ -88,6 +142,17 @@ vtkImageView3D::vtkImageView3D()
 
   CroppingMode = CROPPING_OFF;
 
+  ProgressiveRendering     = 0;
+  AutoAdjustSampleDistancesBeforeProgressive = 1;
+  NumberOfLevelsOfDetail   = 4;
+  CurrentLevelOfDetail     = 0;
+  InteractiveLevelOfDetail = 1;
+  RefinementTimerId        = -1;
+  InteractiveFrameTime     = 0.1;
+  StillFrameTime           = 0.0;
+  RendererObserverTag      = 0;
+  InteractorObserverTag    = 0;
+
   vtkInteractorStyleSwitch* styleswitch = vtkInteractorStyleSwitch::New();
   styleswitch->SetCurrentStyleToTrackballCamera();
   SetInteractorStyle ( styleswitch );
@@ -107,6 +172,8 @@ vtkImageView3D::~vtkImageView3D()
   VolumeActor->Delete();
   BoxWidget->Delete();
   Callback->Delete();
+  ProgressiveCallback->SetView (nullptr);
+  ProgressiveCallback->Delete();
   Cube->Delete();
   Marker->Delete();
   PlaneWidget->Delete();
@@ -170,6 +237,7 @@ vtkMTimeType vtkImageView3D::GetMTime()
 //----------------------------------------------------------------------------
 void vtkImageView3D::SetVolumeMapperToRayCast()
 {
+  SetProgressiveRendering(0);
   VolumeMapper->SetRequestedRenderMode(vtkSmartVolumeMapper::RayCastRenderMode );
 }
 
@@ -177,6 +245,7 @@ void vtkImageView3D::SetVolumeMapperToRayCast()
 //----------------------------------------------------------------------------
 void vtkImageView3D::SetVolumeMapperToOSPRayRenderMode()
 {
+  SetProgressiveRendering(0);
   VolumeMapper->SetRequestedRenderMode(vtkSmartVolumeMapper::OSPRayRenderMode);
 }
 #endif // MED_USE_OSPRAY_4_VR_BY_CPU
@@ -184,15 +253,220 @@ void vtkImageView3D::SetVolumeMapperToOSPRayRenderMode()
 //----------------------------------------------------------------------------
 void vtkImageView3D::SetVolumeMapperToGPU()
 {
+  SetProgressiveRendering(0);
   VolumeMapper->SetRequestedRenderMode(vtkSmartVolumeMapper::GPURenderMode );
 }
 
 //----------------------------------------------------------------------------
 void vtkImageView3D::SetVolumeMapperToDefault()
 {
+  SetProgressiveRendering(0);
   VolumeMapper->SetRequestedRenderMode(vtkSmartVolumeMapper::DefaultRenderMode );
 }
 
+//----------------------------------------------------------------------------
+void vtkImageView3D::SetVolumeMapperToProgressiveCPU()
+{
+  // The ray cast mode of the smart mapper is the multi-threaded
+  // vtkFixedPointVolumeRayCastMapper, which adapts its sample distances
+  // to the time allocated to the volume.
+  VolumeMapper->SetRequestedRenderMode(vtkSmartVolumeMapper::RayCastRenderMode );
+  SetProgressiveRendering(1);
+  VolumeMapper->AutoAdjustSampleDistancesOn();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::SetNumberOfLevelsOfDetail(int levels)
+{
+  levels = std::max(1, std::min(levels, 6));
+  if (levels == NumberOfLevelsOfDetail)
+  {
+    return;
+  }
+  NumberOfLevelsOfDetail = levels;
+
+  // the pyramid is rebuilt with the new number of levels when next needed
+  CancelRefinement();
+  SetLevelOfDetail(0);
+  LevelOfDetailFilters.clear();
+  Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::SetInteractiveFrameTime(double time)
+{
+  if (time <= 0.0 || time == InteractiveFrameTime)
+  {
+    return;
+  }
+  InteractiveFrameTime = time;
+  if (ProgressiveRendering && Interactor)
+  {
+    Interactor->SetDesiredUpdateRate (1.0 / InteractiveFrameTime);
+  }
+  Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::SetProgressiveRendering(int on)
+{
+  if (ProgressiveRendering == on)
+  {
+    return;
+  }
+  ProgressiveRendering = on;
+
+  if (on)
+  {
+    AutoAdjustSampleDistancesBeforeProgressive = VolumeMapper->GetAutoAdjustSampleDistances();
+    VolumeMapper->SetInteractiveUpdateRate (1.0 / InteractiveFrameTime);
+    if (Interactor)
+    {
+      Interactor->SetDesiredUpdateRate (1.0 / InteractiveFrameTime);
+    }
+    InteractiveLevelOfDetail = 1;
+  }
+  else
+  {
+    VolumeMapper->SetAutoAdjustSampleDistances(AutoAdjustSampleDistancesBeforeProgressive);
+    CancelRefinement();
+    SetLevelOfDetail(0);
+    LevelOfDetailFilters.clear();
+  }
+  Modified();
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Select the level of detail of the frame about to be rendered. While the
+ * interactor asks for interactive update rates, a coarse level is used and
+ * adapted to the last measured frame time (each level is expected to cost
+ * about four times less than the previous one). Once the camera stops, each
+ * render goes one level finer and schedules the next refinement pass.
+ */
+void vtkImageView3D::UpdateLevelOfDetail()
+{
+  if (!ProgressiveRendering || !Interactor || !RenderWindow || !Renderer ||
+      RenderingMode != VOLUME_RENDERING || !FullResolutionInput)
+  {
+    return;
+  }
+
+  const double lastFrameTime = Renderer->GetLastRenderTimeInSeconds();
+  const bool interacting = RenderWindow->GetDesiredUpdateRate() > Interactor->GetStillUpdateRate();
+  int level = CurrentLevelOfDetail;
+
+  if (interacting)
+  {
+    CancelRefinement();
+    if (CurrentLevelOfDetail == 0)
+    {
+      level = InteractiveLevelOfDetail;
+    }
+    else if (lastFrameTime > 1.5 * InteractiveFrameTime)
+    {
+      level = std::min(CurrentLevelOfDetail + 1, NumberOfLevelsOfDetail - 1);
+    }
+    else if (lastFrameTime > 0.0 && lastFrameTime < 0.25 * InteractiveFrameTime)
+    {
+      level = std::max(CurrentLevelOfDetail - 1, 1);
+    }
+    level = std::min(level, NumberOfLevelsOfDetail - 1);
+    InteractiveLevelOfDetail = std::max(level, 1);
+  }
+  else if (CurrentLevelOfDetail > 0 && RefinementTimerId < 0)
+  {
+    level = CurrentLevelOfDetail - 1;
+    if (StillFrameTime > 0.0 && 4.0 * lastFrameTime > StillFrameTime)
+    {
+      // the finer level would not fit the refinement budget
+      level = CurrentLevelOfDetail;
+    }
+    else if (level > 0)
+    {
+      RefinementTimerId = Interactor->CreateOneShotTimer(10);
+    }
+  }
+
+  SetLevelOfDetail(level);
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::RefineLevelOfDetail(int timerId)
+{
+  if (timerId != RefinementTimerId || RefinementTimerId < 0)
+  {
+    return;
+  }
+  RefinementTimerId = -1;
+  Render();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::CancelRefinement()
+{
+  if (RefinementTimerId >= 0 && Interactor)
+  {
+    Interactor->DestroyTimer(RefinementTimerId);
+  }
+  RefinementTimerId = -1;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageView3D::SetLevelOfDetail(int level)
+{
+  if (!FullResolutionInput)
+  {
+    CurrentLevelOfDetail = 0;
+    return;
+  }
+  if (level == CurrentLevelOfDetail)
+  {
+    return;
+  }
+
+  if (level > 0 && LevelOfDetailFilters.empty())
+  {
+    // Build the pyramid from the full resolution volume, halving each
+    // dimension at each level as long as it stays large enough.
+    auto *fullResolution = vtkImageData::SafeDownCast(
+        FullResolutionInput->GetProducer()->GetOutputDataObject(FullResolutionInput->GetIndex()));
+    int dims[3] = {1, 1, 1};
+    if (fullResolution)
+    {
+      fullResolution->GetDimensions(dims);
+    }
+
+    vtkAlgorithmOutput *input = FullResolutionInput;
+    for (int i = 1; i < NumberOfLevelsOfDetail; ++i)
+    {
+      int factors[3];
+      for (int d = 0; d < 3; ++d)
+      {
+        factors[d] = (dims[d] >= 16) ? 2 : 1;
+        dims[d] /= factors[d];
+      }
+      auto shrink = vtkSmartPointer<vtkImageShrink3D>::New();
+      shrink->SetInputConnection(input);
+      shrink->SetShrinkFactors(factors);
+      shrink->AveragingOn();
+      LevelOfDetailFilters.push_back(shrink);
+      input = shrink->GetOutputPort();
+    }
+  }
+
+  level = std::min(level, static_cast<int>(LevelOfDetailFilters.size()));
+  if (level == 0)
+  {
+    VolumeMapper->SetInputConnection(FullResolutionInput);
+  }
+  else
+  {
+    VolumeMapper->SetInputConnection(LevelOfDetailFilters[level - 1]->GetOutputPort());
+  }
+  CurrentLevelOfDetail = level;
+}
+
 //----------------------------------------------------------------------------
 void vtkImageView3D::SetVolumeRayCastFunctionToComposite()
 {
@@ -369,6 +643,7 @@ void vtkImageView3D::InstallPipeline()
     Renderer->AddViewProp (ActorX);
     Renderer->AddViewProp (ActorY);
     Renderer->AddViewProp (ActorZ);
+    RendererObserverTag = Renderer->AddObserver (vtkCommand::StartEvent, ProgressiveCallback);
   }
 }
 
@@ -377,6 +652,7 @@ void vtkImageView3D::UnInstallPipeline()
 {
   if (Renderer)
   {
+    Renderer->RemoveObserver (RendererObserverTag);
     Renderer->RemoveViewProp (ActorX);
     Renderer->RemoveViewProp (ActorY);
     Renderer->RemoveViewProp (ActorZ);
@@ -403,6 +679,11 @@ void vtkImageView3D::InstallInteractor()
             Marker->On();
             Marker->InteractiveOff ();
         }
+        InteractorObserverTag = Interactor->AddObserver (vtkCommand::TimerEvent, ProgressiveCallback);
+        if (ProgressiveRendering)
+        {
+            Interactor->SetDesiredUpdateRate (1.0 / InteractiveFrameTime);
+        }
     }
     IsInteractorInstalled = 1;
 }
@@ -416,6 +697,8 @@ void vtkImageView3D::UnInstallInteractor()
     // Happening for instance switching from 2D->3D->2D
     if (Interactor)
     {
+        CancelRefinement();
+        Interactor->RemoveObserver (InteractorObserverTag);
         if (Interactor->GetRenderWindow())
         {
             auto poRenderer = Interactor->GetRenderWindow()->GetRenderers()->GetFirstRenderer();
@@ -529,24 +812,36 @@ void vtkImageView3D::InternalUpdate()
                               (m_poInternalImageFromInput->GetNumberOfScalarComponents() == 3 ||
                                m_poInternalImageFromInput->GetNumberOfScalarComponents() == 4 ));
 
-    auto *appender = vtkImageAppendComponents::New();
-    if (LayerInfoVec.size()>0 && !multichannelInput)
+    // A single layer is rendered straight from its producer, without any copy.
+    // Fused layers share one multi-component volume, refreshed per layer.
+    vtkImageData *volumeImage = nullptr;
+    auto *firstDisplay = GetImage3DDisplayForLayer(0);
+    if (multiLayers && !multichannelInput)
     {
-        // append all scalar buffer into the same image
-        for (auto &it : this->LayerInfoVec)
-        {
-            if (it.ImageDisplay->GetInputProducer())
-            {
-                appender->AddInputConnection(it.ImageDisplay->GetInputProducer()->GetOutputPort());
-            }
-        }
+        UpdateFusedVolume();
+        VolumeMapper->SetInputData(FusedVolume);
+        volumeImage = FusedVolume;
+    }
+    else if (firstDisplay && firstDisplay->GetInputProducer())
+    {
+        FusedVolume = nullptr;
+        auto *producer = firstDisplay->GetInputProducer();
+        producer->Update();
+        VolumeMapper->SetInputConnection(producer->GetOutputPort());
+        volumeImage = producer->GetOutput();
+    }
+    else
+    {
+        FusedVolume = nullptr;
+        VolumeMapper->SetInputConnection(nullptr);
     }
-    appender->Update();
-    appender->GetOutput();
-    VolumeMapper->SetInputConnection( appender->GetOutputPort());
-    VolumeMapper->Update();
     VolumeMapper->Modified();
 
+    // the level of detail pyramid follows the new full resolution volume
+    FullResolutionInput = VolumeMapper->GetInputConnection(0, 0);
+    LevelOfDetailFilters.clear();
+    CurrentLevelOfDetail = 0;
+
     // If an image is already of type unsigned char, there is no need to
     // map it through a lookup table
     if ( !multiLayers && multichannelInput )
@@ -555,9 +850,9 @@ void vtkImageView3D::InternalUpdate()
         //shading and more than one dependent component (rgb) don't work well...
         //as vtk stands now in debug mode an assert makes this crash.
         VolumeProperty->ShadeOff();
-        ActorX->GetMapper()->SetInputConnection(appender->GetOutputPort());
-        ActorY->GetMapper()->SetInputConnection(appender->GetOutputPort());
-        ActorZ->GetMapper()->SetInputConnection(appender->GetOutputPort());
+        ActorX->GetMapper()->SetInputConnection(VolumeMapper->GetInputConnection(0, 0));
+        ActorY->GetMapper()->SetInputConnection(VolumeMapper->GetInputConnection(0, 0));
+        ActorZ->GetMapper()->SetInputConnection(VolumeMapper->GetInputConnection(0, 0));
     }
     else if(LayerInfoVec.size()>0)
     {
@@ -594,18 +889,130 @@ void vtkImageView3D::InternalUpdate()
         }
     }
     // Read bounds and use these to place widget, rather than force whole dataset to be read.
+    if (volumeImage)
+    {
+        double * bounds = volumeImage->GetBounds();
 
-    auto image = appender->GetOutput();
-    double * bounds = image->GetBounds();
-
-    BoxWidget->SetInputConnection(appender->GetOutputPort());
-    BoxWidget->PlaceWidget (bounds);
-    Callback->Execute (BoxWidget, 0, bounds);
-    PlaneWidget->SetInputConnection(appender->GetOutputPort());
-    PlaneWidget->PlaceWidget(bounds);
+        BoxWidget->SetInputData(volumeImage);
+        BoxWidget->PlaceWidget (bounds);
+        Callback->Execute (BoxWidget, 0, bounds);
+        PlaneWidget->SetInputData(volumeImage);
+        PlaneWidget->PlaceWidget(bounds);
+    }
     UpdateDisplayExtent();
+}
+
+//----------------------------------------------------------------------------
+/**
+ * Refresh the multi-component volume used for fused layers. The volume is
+ * only reallocated when its layout changes (extent, scalar type or number
+ * of components); otherwise only the components of layers whose image
+ * changed since the last call are rewritten.
+ */
+void vtkImageView3D::UpdateFusedVolume()
+{
+    std::vector<vtkImageData*> images;
+    int numberOfComponents = 0;
+    for (auto &it : this->LayerInfoVec)
+    {
+        vtkImageData *image = nullptr;
+        if (it.ImageDisplay && it.ImageDisplay->GetInputProducer())
+        {
+            it.ImageDisplay->GetInputProducer()->Update();
+            image = it.ImageDisplay->GetInputProducer()->GetOutput();
+            numberOfComponents += image->GetNumberOfScalarComponents();
+        }
+        images.push_back(image);
+    }
+
+    vtkImageData *reference = nullptr;
+    for (auto *image : images)
+    {
+        if (image)
+        {
+            reference = image;
+            break;
+        }
+    }
+    if (!reference)
+    {
+        FusedVolume = nullptr;
+        return;
+    }
+
+    int *refExtent = reference->GetExtent();
+    bool reallocate = !FusedVolume ||
+            FusedVolume->GetScalarType() != reference->GetScalarType() ||
+            FusedVolume->GetNumberOfScalarComponents() != numberOfComponents;
+    if (!reallocate)
+    {
+        int *extent = FusedVolume->GetExtent();
+        for (int i = 0; i < 6; ++i)
+        {
+            reallocate |= (extent[i] != refExtent[i]);
+        }
+    }
+
+    if (reallocate)
+    {
+        FusedVolume = vtkSmartPointer<vtkImageData>::New();
+        FusedVolume->SetExtent(refExtent);
+        FusedVolume->SetSpacing(reference->GetSpacing());
+        FusedVolume->SetOrigin(reference->GetOrigin());
+        FusedVolume->AllocateScalars(reference->GetScalarType(), numberOfComponents);
+        for (auto &it : this->LayerInfoVec)
+        {
+            it.FusedImage = nullptr;
+            it.FusedComponentOffset = -1;
+        }
+    }
+
+    bool changed = reallocate;
+    int offset = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        vtkImageData *image = images[i];
+        if (!image)
+        {
+            continue;
+        }
+        LayerInfo &info = LayerInfoVec[i];
+        bool upToDate = info.FusedImage == image &&
+                info.FusedComponentOffset == offset &&
+                info.FusedMTime >= image->GetMTime();
 
-    appender->Delete();
+        if (!upToDate)
+        {
+            if (image->GetScalarType() != FusedVolume->GetScalarType() ||
+                image->GetNumberOfPoints() != FusedVolume->GetNumberOfPoints())
+            {
+                vtkWarningMacro( <<"Layer " << i << " does not match the first layer geometry, skipping it in 3D fusion" );
+                // The fused volume is not initialized: leave blank components, not garbage
+                switch (FusedVolume->GetScalarType())
+                {
+                    vtkTemplateMacro(vtkImageView3DClearComponents<VTK_TT>(FusedVolume, offset, image->GetNumberOfScalarComponents()));
+                }
+            }
+            else
+            {
+                switch (FusedVolume->GetScalarType())
+                {
+                    vtkTemplateMacro(vtkImageView3DCopyComponents<VTK_TT>(image, FusedVolume, offset));
+                }
+            }
+            changed = true;
+            info.FusedImage = image;
+            info.FusedMTime = image->GetMTime();
+            info.FusedComponentOffset = offset;
+        }
+        offset += image->GetNumberOfScalarComponents();
+    }
+
+    if (changed)
+    {
+        FusedVolume->GetPointData()->GetScalars()->Modified();
+        FusedVolume->Modified();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -16,6 +16,8 @@
 
 #include <vtkImageView.h>
 #include <vtkImageView3DCroppingBoxCallback.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkImageData.h>
 #include <vtkOrientationMarkerWidget.h>
 #include <vtkOrientedBoxWidget.h>
 #include <vtkPlaneWidget.h>
@@ -37,6 +39,8 @@ class vtkColorTransferFunction;
 class vtkSmartVolumeMapper;
 class vtkImage3DDisplay;
 class vtkProp3DCollection;
+class vtkImageShrink3D;
+class vtkImageView3DProgressiveRenderingCallback;
 
 /**
    \class vtkImageView3D vtkImageView3D.h "vtkImageView3D.h"
@@ -86,6 +90,28 @@ public:
 #endif //MED_USE_OSPRAY_4_VR_BY_CPU
     virtual void SetVolumeMapperToGPU();
     virtual void SetVolumeMapperToDefault();
+    /**
+     CPU ray casting on a pyramid of down-sampled copies of the volume: a
+     coarse level is rendered while the camera moves, then the image is
+     refined level by level once the interaction stops.
+  */
+    virtual void SetVolumeMapperToProgressiveCPU();
+    vtkGetMacro (ProgressiveRendering, int);
+
+    /** Target time (in seconds) of a frame rendered during interaction. */
+    virtual void SetInteractiveFrameTime (double time);
+    vtkGetMacro (InteractiveFrameTime, double);
+    /** Maximum time (in seconds) of a refinement pass, 0 to always refine to full resolution. */
+    vtkSetMacro (StillFrameTime, double);
+    vtkGetMacro (StillFrameTime, double);
+    /** Number of levels of the pyramid, including the full resolution volume. */
+    virtual void SetNumberOfLevelsOfDetail (int levels);
+    vtkGetMacro (NumberOfLevelsOfDetail, int);
+
+    /** Used by the progressive rendering callback before each render. */
+    virtual void UpdateLevelOfDetail();
+    /** Used by the progressive rendering callback when a refinement timer expires. */
+    virtual void RefineLevelOfDetail(int timerId);
 
     virtual void SetVolumeRayCastFunctionToComposite();
     virtual void SetVolumeRayCastFunctionToMaximumIntensityProjection();
@@ -227,6 +253,10 @@ protected:
     virtual void UpdateVolumeFunctions(int layer);
     void ApplyColorTransferFunction(vtkScalarsToColors *, int) override;
     virtual void InternalUpdate();
+    virtual void UpdateFusedVolume();
+    virtual void SetProgressiveRendering(int on);
+    virtual void SetLevelOfDetail(int level);
+    virtual void CancelRefinement();
 
     vtkImage3DDisplay * GetImage3DDisplayForLayer(int layer) const;
 
@@ -283,8 +313,36 @@ protected:
 
     struct LayerInfo {
         vtkSmartPointer<vtkImage3DDisplay> ImageDisplay;
+        // What was last written into FusedVolume for this layer, so that
+        // only the components of a changed layer are copied again.
+        vtkImageData* FusedImage = nullptr;
+        vtkMTimeType  FusedMTime = 0;
+        int           FusedComponentOffset = -1;
     };
 
+    /**
+     Multi-component volume handed to the volume mapper when several layers
+     are fused. It is kept between updates and only the components of the
+     layers whose input changed are refreshed.
+  */
+    vtkSmartPointer<vtkImageData> FusedVolume;
+
+    // Progressive rendering: level 0 is FullResolutionInput, level i > 0 is
+    // the output of LevelOfDetailFilters[i-1], built lazily.
+    vtkImageView3DProgressiveRenderingCallback* ProgressiveCallback;
+    vtkSmartPointer<vtkAlgorithmOutput> FullResolutionInput;
+    std::vector<vtkSmartPointer<vtkImageShrink3D> > LevelOfDetailFilters;
+    int ProgressiveRendering;
+    int AutoAdjustSampleDistancesBeforeProgressive;
+    int NumberOfLevelsOfDetail;
+    int CurrentLevelOfDetail;
+    int InteractiveLevelOfDetail;
+    int RefinementTimerId;
+    double InteractiveFrameTime;
+    double StillFrameTime;
+    unsigned long RendererObserverTag;
+    unsigned long InteractorObserverTag;
+
     vtkSmartPointer<vtkImageMapToColors>        PlanarWindowLevelX;
     vtkSmartPointer<vtkImageMapToColors>        PlanarWindowLevelY;
     vtkSmartPointer<vtkImageMapToColors>        PlanarWindowLevelZ;
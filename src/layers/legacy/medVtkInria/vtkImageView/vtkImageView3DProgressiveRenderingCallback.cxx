@@ -0,0 +1,33 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+ 
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include "vtkImageView3DProgressiveRenderingCallback.h"
+
+#include <vtkImageView3D.h>
+
+void vtkImageView3DProgressiveRenderingCallback::Execute ( vtkObject *vtkNotUsed(caller), unsigned long event, void *callData )
+{
+  if( !this->View )
+  {
+    return;
+  }
+
+  if ( event == vtkCommand::StartEvent )
+  {
+    this->View->UpdateLevelOfDetail();
+  }
+  else if ( event == vtkCommand::TimerEvent && callData )
+  {
+    this->View->RefineLevelOfDetail( *reinterpret_cast<int *>(callData) );
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+ 
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <medVtkInriaExport.h>
+
+#include <vtkCommand.h>
+#include <vtkSetGet.h>
+#include <vtkObjectFactory.h>
+
+class vtkImageView3D;
+
+/**
+   \class vtkImageView3DProgressiveRenderingCallback
+   \brief Drives the level of detail of the progressive CPU volume rendering.
+
+   Observes the renderer StartEvent to pick the level of detail of the
+   coming frame, and the interactor TimerEvent to trigger the refinement
+   passes once the camera stops.
+*/
+class MEDVTKINRIA_EXPORT vtkImageView3DProgressiveRenderingCallback: public vtkCommand
+{
+
+ public:
+  static vtkImageView3DProgressiveRenderingCallback* New()
+  { return new vtkImageView3DProgressiveRenderingCallback; }
+
+  virtual void Execute ( vtkObject *caller, unsigned long event, void *callData );
+
+  void SetView (vtkImageView3D* view)
+  {
+    this->View = view;
+  }
+  vtkImageView3D* GetView() const
+  {
+    return this->View;
+  }
+
+ protected:
+  vtkImageView3DProgressiveRenderingCallback()
+  {
+    this->View = nullptr;
+  }
+  ~vtkImageView3DProgressiveRenderingCallback(){};
+
+ private:
+
+  vtkImageView3D* View;
+
+};
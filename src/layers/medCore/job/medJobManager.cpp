@@ -19,6 +19,8 @@
 #include <dtkLog>
 
 #include <medAbstractJob.h>
+#include <medAbstractProcess.h>
+#include <medProcessResultCache.h>
 
 medJobManager* medJobManager::s_instance = nullptr;
 
@@ -71,6 +73,8 @@ QList<medAbstractJob *> medJobManager::jobs() const
 
 void medJobManager::startJobInThread(medAbstractJob *job)
 {
+    // make sure the cache is created in the main thread, as a child of the application
+    medProcessResultCache::instance();
     QThreadPool::globalInstance()->start(new medJobRunner(job));
 }
 
@@ -86,7 +90,19 @@ void medJobRunner::run()
     medAbstractJob::medJobExitStatus jobExitStatus = medAbstractJob::MED_JOB_EXIT_FAILURE;
     try
     {
-        jobExitStatus = m_job->run();
+        medAbstractProcess *process = qobject_cast<medAbstractProcess *>(m_job);
+        if(process && medProcessResultCache::instance()->restore(process))
+        {
+            jobExitStatus = medAbstractJob::MED_JOB_EXIT_SUCCESS;
+        }
+        else
+        {
+            jobExitStatus = m_job->run();
+            if(process && jobExitStatus == medAbstractJob::MED_JOB_EXIT_SUCCESS)
+            {
+                medProcessResultCache::instance()->store(process);
+            }
+        }
         if(jobExitStatus == medAbstractJob::MED_JOB_EXIT_CANCELLED)
         {
             qDebug() << "job aborted (cancelled)"
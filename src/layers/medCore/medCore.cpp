@@ -13,6 +13,8 @@
 
 #include <medCore.h>
 
+#include <medPluginManifest.h>
+
 namespace medCore
 {
 
@@ -20,6 +22,21 @@ DTK_DEFINE_LAYER_MANAGER
 
 namespace pluginManager
 {
+    namespace
+    {
+        // Only the plugins of the manager's concept are scanned and loaded,
+        // so that each library is opened once instead of once per manager.
+        template <typename T>
+        void load(dtkCorePluginManager<T>& manager, const QStringList& plugins)
+        {
+            for(QString const& plugin : plugins)
+                manager.scan(plugin);
+
+            for(QString const& plugin : plugins)
+                manager.load(plugin);
+        }
+    }
+
     void initialize(const QString& path)
     {
         for(QString const& realpath : path.split(';'))
@@ -27,15 +44,17 @@ namespace pluginManager
             if(realpath.isEmpty())
                 break;
 
-            medCore::arithmeticOperation::pluginManager().initialize(realpath);
-            medCore::dwiMasking::pluginManager().initialize(realpath);
-            medCore::diffusionModelEstimation::pluginManager().initialize(realpath);
-            medCore::diffusionScalarMaps::pluginManager().initialize(realpath);
-            medCore::tractography::pluginManager().initialize(realpath);
-            medCore::morphomathOperation::pluginManager().initialize(realpath);
-            medCore::maskImage::pluginManager().initialize(realpath);
-            medCore::singleFilterOperation::pluginManager().initialize(realpath);
-            medCore::dataConverter::pluginManager().initialize(realpath);
+            medPluginManifest manifest(realpath);
+
+            load(medCore::arithmeticOperation::pluginManager(), manifest.plugins("medAbstractArithmeticOperationProcess"));
+            load(medCore::dwiMasking::pluginManager(), manifest.plugins("medAbstractDWIMaskingProcess"));
+            load(medCore::diffusionModelEstimation::pluginManager(), manifest.plugins("medAbstractDiffusionModelEstimationProcess"));
+            load(medCore::diffusionScalarMaps::pluginManager(), manifest.plugins("medAbstractDiffusionScalarMapsProcess"));
+            load(medCore::tractography::pluginManager(), manifest.plugins("medAbstractTractographyProcess"));
+            load(medCore::morphomathOperation::pluginManager(), manifest.plugins("medAbstractMorphomathOperationProcess"));
+            load(medCore::maskImage::pluginManager(), manifest.plugins("medAbstractMaskImageProcess"));
+            load(medCore::singleFilterOperation::pluginManager(), manifest.plugins("medAbstractSingleFilterOperationProcess"));
+            load(medCore::dataConverter::pluginManager(), manifest.plugins("medAbstractDataConverter"));
         }
     }
 }
@@ -0,0 +1,196 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <medPluginManifest.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLibrary>
+#include <QMap>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <dtkLog>
+
+struct medPluginManifestEntry
+{
+    qint64 modified;
+    qint64 size;
+    QJsonObject metaData;
+};
+
+class medPluginManifestPrivate
+{
+public:
+    QString directory;
+    QString cacheFile;
+    QMap<QString, medPluginManifestEntry> entries; // by file name
+    bool changed;
+};
+
+medPluginManifest::medPluginManifest(const QString& directory) : d(new medPluginManifestPrivate)
+{
+    d->directory = QDir(directory).absolutePath();
+    d->changed = false;
+
+    QByteArray hash = QCryptographicHash::hash(d->directory.toUtf8(), QCryptographicHash::Sha1).toHex();
+    d->cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/pluginManifests/" + QString::fromLatin1(hash) + ".json";
+
+    scan();
+
+    if (d->changed)
+    {
+        save();
+    }
+}
+
+medPluginManifest::~medPluginManifest()
+{
+}
+
+QString medPluginManifest::directory() const
+{
+    return d->directory;
+}
+
+QString medPluginManifest::cacheFile() const
+{
+    return d->cacheFile;
+}
+
+/**
+ * @brief Absolute paths of all the plugins of the directory.
+ */
+QStringList medPluginManifest::plugins() const
+{
+    QStringList paths;
+    for (const QString& fileName : d->entries.keys())
+    {
+        paths << d->directory + "/" + fileName;
+    }
+    return paths;
+}
+
+/**
+ * @brief Absolute paths of the plugins declaring this concept in their metadata.
+ */
+QStringList medPluginManifest::plugins(const QString& concept) const
+{
+    QStringList paths;
+    for (auto it = d->entries.cbegin(); it != d->entries.cend(); ++it)
+    {
+        if (it.value().metaData.value("MetaData").toObject().value("concept").toString() == concept)
+        {
+            paths << d->directory + "/" + it.key();
+        }
+    }
+    return paths;
+}
+
+/**
+ * @brief Metadata of a plugin, as returned by QPluginLoader::metaData().
+ */
+QJsonObject medPluginManifest::metaData(const QString& plugin) const
+{
+    return d->entries.value(QFileInfo(plugin).fileName()).metaData;
+}
+
+void medPluginManifest::scan()
+{
+    QMap<QString, medPluginManifestEntry> cached;
+
+    QFile file(d->cacheFile);
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QJsonObject plugins = QJsonDocument::fromJson(file.readAll()).object().value("plugins").toObject();
+        for (auto it = plugins.constBegin(); it != plugins.constEnd(); ++it)
+        {
+            QJsonObject object = it.value().toObject();
+
+            medPluginManifestEntry entry;
+            entry.modified = static_cast<qint64>(object.value("modified").toDouble());
+            entry.size = static_cast<qint64>(object.value("size").toDouble());
+            entry.metaData = object.value("metaData").toObject();
+            cached.insert(it.key(), entry);
+        }
+    }
+
+    QDir dir(d->directory);
+    const QFileInfoList files = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QFileInfo& info : files)
+    {
+        if (!QLibrary::isLibrary(info.fileName()))
+        {
+            continue;
+        }
+
+        medPluginManifestEntry entry;
+        entry.modified = info.lastModified().toMSecsSinceEpoch();
+        entry.size = info.size();
+
+        auto hit = cached.constFind(info.fileName());
+        if (hit != cached.constEnd() && hit.value().modified == entry.modified && hit.value().size == entry.size)
+        {
+            entry.metaData = hit.value().metaData;
+        }
+        else
+        {
+            entry.metaData = QPluginLoader(info.absoluteFilePath()).metaData();
+            d->changed = true;
+        }
+
+        d->entries.insert(info.fileName(), entry);
+    }
+
+    // removed plugins
+    if (cached.size() != d->entries.size())
+    {
+        d->changed = true;
+    }
+}
+
+void medPluginManifest::save()
+{
+    QJsonObject plugins;
+    for (auto it = d->entries.cbegin(); it != d->entries.cend(); ++it)
+    {
+        QJsonObject object;
+        object.insert("modified", static_cast<double>(it.value().modified));
+        object.insert("size", static_cast<double>(it.value().size));
+        object.insert("metaData", it.value().metaData);
+        plugins.insert(it.key(), object);
+    }
+
+    QJsonObject root;
+    root.insert("directory", d->directory);
+    root.insert("plugins", plugins);
+
+    QDir().mkpath(QFileInfo(d->cacheFile).absolutePath());
+
+    QSaveFile file(d->cacheFile);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        dtkWarn() << "Could not write the plugin manifest" << d->cacheFile;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+    {
+        dtkWarn() << "Could not write the plugin manifest" << d->cacheFile;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QJsonObject>
+#include <QScopedPointer>
+#include <QStringList>
+
+#include <medCoreExport.h>
+
+class medPluginManifestPrivate;
+
+/**
+ * Metadata of the plugins of a directory, cached on disk.
+ *
+ * The directory is listed once. The JSON metadata of a library is only read
+ * (with QPluginLoader::metaData(), which does not load the library) when it
+ * is new or when its modification time or size changed since the manifest
+ * was written, so that a start with an unchanged install only stats files.
+ */
+class MEDCORE_EXPORT medPluginManifest
+{
+public:
+    medPluginManifest(const QString& directory);
+    ~medPluginManifest();
+
+public:
+    QString directory() const;
+
+    QStringList plugins() const;
+    QStringList plugins(const QString& concept) const;
+
+    QJsonObject metaData(const QString& plugin) const;
+
+    QString cacheFile() const;
+
+private:
+    void scan();
+    void save();
+
+private:
+    const QScopedPointer<medPluginManifestPrivate> d;
+};
@@ -82,3 +82,23 @@ medAbstractImageData* medAbstractArithmeticOperationProcess::output() const
 {
     return d->output;
 }
+
+QList<medAbstractData*> medAbstractArithmeticOperationProcess::resultCacheInputs() const
+{
+    QList<medAbstractData*> inputs;
+    if (input1() && input2())
+    {
+        inputs << input1() << input2();
+    }
+    return inputs;
+}
+
+medAbstractData* medAbstractArithmeticOperationProcess::resultCacheOutput() const
+{
+    return this->output();
+}
+
+void medAbstractArithmeticOperationProcess::setResultCacheOutput(medAbstractData *output)
+{
+    this->setOutput(qobject_cast<medAbstractImageData *>(output));
+}
@@ -37,6 +37,10 @@ public:
 
     medAbstractImageData* output() const;
 
+    QList<medAbstractData*> resultCacheInputs() const override;
+    medAbstractData* resultCacheOutput() const override;
+    void setResultCacheOutput(medAbstractData *output) override;
+
 protected:
     void setOutput(medAbstractImageData* data);
     virtual QString outputNameAddon() const {return "arithmetic";}
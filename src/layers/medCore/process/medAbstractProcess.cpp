@@ -47,3 +47,18 @@ QList<medAbstractParameter*> medAbstractProcess::parameters() const
 {
     return d->parameters.values();
 }
+
+QList<medAbstractData*> medAbstractProcess::resultCacheInputs() const
+{
+    return QList<medAbstractData*>();
+}
+
+medAbstractData* medAbstractProcess::resultCacheOutput() const
+{
+    return nullptr;
+}
+
+void medAbstractProcess::setResultCacheOutput(medAbstractData *output)
+{
+    Q_UNUSED(output);
+}
@@ -17,6 +17,7 @@
 
 #include <dtkCore>
 
+class medAbstractData;
 class medAbstractParameter;
 class medAbstractProcessPrivate;
 
@@ -32,6 +33,11 @@ public:
     medAbstractParameter* parameter(QString const& id) const;
     QList<medAbstractParameter*> parameters() const;
 
+    //! Data the output depends on, an empty list keeps the process out of medProcessResultCache
+    virtual QList<medAbstractData*> resultCacheInputs() const;
+    virtual medAbstractData* resultCacheOutput() const;
+    virtual void setResultCacheOutput(medAbstractData *output);
+
 protected:
     void registerParameter(medAbstractParameter *parameter);
 
@@ -0,0 +1,480 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <medProcessResultCache.h>
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPointer>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#include <dtkCoreSupport/dtkSmartPointer.h>
+#include <dtkLog>
+
+#include <medAbstractImageData.h>
+#include <medAbstractProcess.h>
+#include <medBoolParameter.h>
+#include <medDataIndex.h>
+#include <medDataReaderWriter.h>
+#include <medDoubleParameter.h>
+#include <medIntParameter.h>
+#include <medSettingsManager.h>
+#include <medStringParameter.h>
+
+namespace
+{
+
+qint64 estimatedSize(medAbstractData *data)
+{
+    // Data we can not measure are accounted for 1 MB.
+    qint64 size = 1 << 20;
+
+    medAbstractImageData *image = qobject_cast<medAbstractImageData *>(data);
+    if (image)
+    {
+        QString id = image->identifier();
+        qint64 bytesPerComponent = 4;
+        if (id.contains("Char"))
+        {
+            bytesPerComponent = 1;
+        }
+        else if (id.contains("Short"))
+        {
+            bytesPerComponent = 2;
+        }
+        else if (id.contains("Double") || id.contains("Long"))
+        {
+            bytesPerComponent = 8;
+        }
+        size = bytesPerComponent
+                * qMax(image->xDimension(), 1)
+                * qMax(image->yDimension(), 1)
+                * qMax(image->zDimension(), 1)
+                * qMax(image->tDimension(), 1);
+    }
+    return size;
+}
+
+}
+
+struct medProcessResultCacheEntry
+{
+    dtkSmartPointer<medAbstractData> data; // null once spilled to disk
+    QString spillPath;
+    qint64 size;
+    quint64 lastUse;
+    QList<QObject *> inputs;
+};
+
+class medProcessResultCachePrivate
+{
+public:
+    // recursive: releasing a result may delete an input watched by the cache
+    medProcessResultCachePrivate() : mutex(QMutex::Recursive) {}
+
+    QMutex mutex;
+    QHash<QByteArray, medProcessResultCacheEntry> entries;
+    QHash<QObject *, quint64> revisions;
+    QHash<QObject *, QPointer<QObject> > inputsToWatch;
+
+    qint64 budget;
+    qint64 used;
+    quint64 useCounter;
+    bool spillToDisk;
+    QString spillDirectory;
+};
+
+medProcessResultCache* medProcessResultCache::s_instance = nullptr;
+
+medProcessResultCache* medProcessResultCache::instance()
+{
+    if(s_instance == nullptr)
+        s_instance = new medProcessResultCache(QApplication::instance());
+        // delete is delegate to the QApplication instance.
+    return s_instance;
+}
+
+medProcessResultCache::medProcessResultCache(QObject *parent)
+    : QObject(parent), d(new medProcessResultCachePrivate)
+{
+    medSettingsManager *settings = medSettingsManager::instance();
+    d->budget = settings->value("processes", "result_cache_budget_mb", 1024).toLongLong() << 20;
+    d->spillToDisk = settings->value("processes", "result_cache_spill_to_disk", false).toBool();
+    d->spillDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/processResults";
+    d->used = 0;
+    d->useCounter = 0;
+
+    // Spilled results are only valid for the session that produced them.
+    QDir(d->spillDirectory).removeRecursively();
+}
+
+medProcessResultCache::~medProcessResultCache()
+{
+    QDir(d->spillDirectory).removeRecursively();
+}
+
+/**
+ * Set the output of the process from a previous run with the same inputs
+ * and parameters.
+ * @return false if there is no such result, the process must then be run.
+ */
+bool medProcessResultCache::restore(medAbstractProcess *process)
+{
+    if (process->resultCacheInputs().isEmpty())
+    {
+        return false;
+    }
+
+    QMutexLocker locker(&d->mutex);
+
+    QByteArray processKey = key(process);
+    if (processKey.isEmpty())
+    {
+        return false;
+    }
+    auto it = d->entries.find(processKey);
+    if (it == d->entries.end())
+    {
+        return false;
+    }
+
+    medProcessResultCacheEntry &entry = it.value();
+    if (entry.data.isNull())
+    {
+        entry.data = medDataReaderWriter::read(entry.spillPath);
+        if (entry.data.isNull())
+        {
+            dtkWarn() << "Unable to reload cached process result" << entry.spillPath;
+            d->entries.erase(it);
+            return false;
+        }
+        d->used += entry.size;
+    }
+    entry.lastUse = ++d->useCounter;
+    dtkSmartPointer<medAbstractData> cached = entry.data;
+    evict();
+    locker.unlock();
+
+    // The output may be edited in place once displayed, it gets its own
+    // pixels so that the cached result is never modified.
+    medAbstractImageData *image = qobject_cast<medAbstractImageData *>(cached.data());
+    medAbstractData *copy = image ? image->deepCopy() : nullptr;
+    if (!copy)
+    {
+        return false;
+    }
+    process->setResultCacheOutput(copy);
+
+    return true;
+}
+
+/**
+ * Keep the output of a process that just ran successfully.
+ */
+void medProcessResultCache::store(medAbstractProcess *process)
+{
+    QList<medAbstractData *> inputs = process->resultCacheInputs();
+    medAbstractImageData *output = qobject_cast<medAbstractImageData *>(process->resultCacheOutput());
+    if (inputs.isEmpty() || !output)
+    {
+        return;
+    }
+
+    // The output is handed to the application, which may edit it in place:
+    // keep a copy with its own pixels. Data that can not be copied are not
+    // cached.
+    dtkSmartPointer<medAbstractData> copy = output->deepCopy();
+    if (copy.isNull())
+    {
+        return;
+    }
+
+    QMutexLocker locker(&d->mutex);
+
+    QByteArray processKey = key(process);
+    if (d->budget <= 0 || processKey.isEmpty())
+    {
+        return;
+    }
+
+    medProcessResultCacheEntry entry;
+    entry.data = copy;
+    entry.size = estimatedSize(output);
+    entry.lastUse = ++d->useCounter;
+    for (medAbstractData *input : inputs)
+    {
+        if (input && !input->dataIndex().isValid())
+        {
+            entry.inputs << input;
+        }
+    }
+
+    auto replaced = d->entries.find(processKey);
+    if (replaced != d->entries.end())
+    {
+        if (!replaced.value().data.isNull())
+        {
+            d->used -= replaced.value().size;
+        }
+        if (!replaced.value().spillPath.isEmpty())
+        {
+            QFile::remove(replaced.value().spillPath);
+        }
+    }
+    d->entries.insert(processKey, entry);
+    d->used += entry.size;
+
+    evict();
+}
+
+void medProcessResultCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->used = 0;
+    QDir(d->spillDirectory).removeRecursively();
+}
+
+qint64 medProcessResultCache::memoryBudget() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->budget;
+}
+
+void medProcessResultCache::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&d->mutex);
+    d->budget = bytes;
+    medSettingsManager::instance()->setValue("processes", "result_cache_budget_mb", bytes >> 20);
+    evict();
+}
+
+bool medProcessResultCache::isSpillToDiskEnabled() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->spillToDisk;
+}
+
+void medProcessResultCache::setSpillToDiskEnabled(bool enabled)
+{
+    QMutexLocker locker(&d->mutex);
+    d->spillToDisk = enabled;
+    medSettingsManager::instance()->setValue("processes", "result_cache_spill_to_disk", enabled);
+}
+
+QString medProcessResultCache::spillDirectory() const
+{
+    return d->spillDirectory;
+}
+
+void medProcessResultCache::_bumpRevision(medAbstractData *data)
+{
+    QMutexLocker locker(&d->mutex);
+    if (d->revisions.contains(data))
+    {
+        ++d->revisions[data];
+    }
+}
+
+/**
+ * Follow the modifications and the destruction of the inputs met by key().
+ * Runs in the thread of the cache, inputs deleted in the meantime are
+ * forgotten.
+ */
+void medProcessResultCache::_watchInputs()
+{
+    QMutexLocker locker(&d->mutex);
+    QHash<QObject *, QPointer<QObject> > inputs;
+    inputs.swap(d->inputsToWatch);
+
+    for (auto it = inputs.begin(); it != inputs.end(); ++it)
+    {
+        medAbstractData *input = qobject_cast<medAbstractData *>(it.value().data());
+        if (input)
+        {
+            connect(input, &medAbstractData::dataModified,
+                    this, &medProcessResultCache::_bumpRevision, Qt::DirectConnection);
+            connect(input, &QObject::destroyed,
+                    this, &medProcessResultCache::_forgetInput, Qt::DirectConnection);
+        }
+        else
+        {
+            _forgetInput(it.key());
+        }
+    }
+}
+
+void medProcessResultCache::_forgetInput(QObject *data)
+{
+    QMutexLocker locker(&d->mutex);
+    d->revisions.remove(data);
+
+    // Results keyed on the address of a deleted object could be wrongly
+    // matched by a new object allocated at the same place.
+    auto it = d->entries.begin();
+    while (it != d->entries.end())
+    {
+        if (it.value().inputs.contains(data))
+        {
+            if (!it.value().data.isNull())
+            {
+                d->used -= it.value().size;
+            }
+            if (!it.value().spillPath.isEmpty())
+            {
+                QFile::remove(it.value().spillPath);
+            }
+            it = d->entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Hash of the process type, of the identity, revision and modification time
+ * of its inputs and of the value of all its parameters. Empty when a
+ * parameter can not be hashed. Must be called with the mutex held.
+ */
+QByteArray medProcessResultCache::key(medAbstractProcess *process)
+{
+    QByteArray buffer;
+    QDataStream stream(&buffer, QIODevice::WriteOnly);
+
+    stream << QString(process->metaObject()->className());
+
+    for (medAbstractData *input : process->resultCacheInputs())
+    {
+        if (!input)
+        {
+            stream << QString("none");
+            continue;
+        }
+
+        if (!d->revisions.contains(input))
+        {
+            // key() runs in the job threads, the signals are connected from
+            // the thread of the cache. Until then, the modification time
+            // still tells edited images apart.
+            d->revisions.insert(input, 0);
+            if (d->inputsToWatch.isEmpty())
+            {
+                QMetaObject::invokeMethod(this, "_watchInputs", Qt::QueuedConnection);
+            }
+            d->inputsToWatch.insert(input, QPointer<QObject>(input));
+        }
+
+        // Data stored in a database are identified by their index, so that
+        // reloading the same series still matches previous results.
+        medDataIndex index = input->dataIndex();
+        if (index.isValid())
+        {
+            stream << QString("index") << index.asString();
+        }
+        else
+        {
+            stream << QString("object") << quint64(reinterpret_cast<quintptr>(input));
+        }
+        stream << input->identifier() << d->revisions.value(input);
+
+        medAbstractImageData *image = qobject_cast<medAbstractImageData *>(input);
+        stream << quint64(image ? image->modificationTime() : 0);
+    }
+
+    QList<medAbstractParameter *> parameters = process->findChildren<medAbstractParameter *>();
+    std::sort(parameters.begin(), parameters.end(),
+              [](medAbstractParameter *a, medAbstractParameter *b) { return a->id() < b->id(); });
+
+    for (medAbstractParameter *parameter : parameters)
+    {
+        if (parameter == process->progression())
+        {
+            continue;
+        }
+        stream << parameter->id();
+        switch (parameter->type())
+        {
+            case MED_PARAMETER_INT:
+                stream << static_cast<medIntParameter *>(parameter)->value();
+                break;
+            case MED_PARAMETER_DOUBLE:
+                stream << static_cast<medDoubleParameter *>(parameter)->value();
+                break;
+            case MED_PARAMETER_BOOL:
+                stream << static_cast<medBoolParameter *>(parameter)->value();
+                break;
+            case MED_PARAMETER_STRING:
+                stream << static_cast<medStringParameter *>(parameter)->value();
+                break;
+            default:
+                // a parameter that can not be hashed could tell two runs
+                // apart: the process is not cached
+                return QByteArray();
+        }
+    }
+
+    return QCryptographicHash::hash(buffer, QCryptographicHash::Sha1);
+}
+
+/**
+ * Spill or drop the least recently used results until the budget is
+ * respected. Must be called with the mutex held.
+ */
+void medProcessResultCache::evict()
+{
+    while (d->used > d->budget)
+    {
+        auto oldest = d->entries.end();
+        for (auto it = d->entries.begin(); it != d->entries.end(); ++it)
+        {
+            if (!it.value().data.isNull() &&
+                (oldest == d->entries.end() || it.value().lastUse < oldest.value().lastUse))
+            {
+                oldest = it;
+            }
+        }
+        if (oldest == d->entries.end())
+        {
+            break;
+        }
+
+        medProcessResultCacheEntry &entry = oldest.value();
+        d->used -= entry.size;
+
+        bool spilled = !entry.spillPath.isEmpty() && QFile::exists(entry.spillPath);
+        if (!spilled && d->spillToDisk && qobject_cast<medAbstractImageData *>(entry.data.data()))
+        {
+            QDir().mkpath(d->spillDirectory);
+            entry.spillPath = d->spillDirectory + "/" + oldest.key().toHex() + ".mha";
+            spilled = medDataReaderWriter::write(entry.spillPath, entry.data.data());
+        }
+
+        if (spilled)
+        {
+            entry.data = nullptr;
+        }
+        else
+        {
+            d->entries.erase(oldest);
+        }
+    }
+}
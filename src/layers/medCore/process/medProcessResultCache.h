@@ -0,0 +1,75 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <QObject>
+
+#include <medCoreExport.h>
+
+class medAbstractData;
+class medAbstractProcess;
+
+class medProcessResultCachePrivate;
+
+/**
+ * Memoization of process outputs.
+ *
+ * Results are keyed by the process type, the identity, revision and
+ * modification time of each input (the revision is bumped by
+ * medAbstractData::dataModified) and the value of every parameter of the
+ * process. Entries are evicted in least recently used order once the memory
+ * budget is exceeded, and are written to the cache directory instead of
+ * being dropped when spilling is enabled.
+ *
+ * The cache keeps its own copy of each output and hands over copies, so that
+ * results edited once displayed do not alter it. Only processes that report
+ * their inputs through medAbstractProcess::resultCacheInputs(), and whose
+ * output is an image supporting medAbstractImageData::deepCopy(), take part
+ * in the cache.
+ */
+class MEDCORE_EXPORT medProcessResultCache: public QObject
+{
+    Q_OBJECT
+
+private:
+    medProcessResultCache(QObject *parent = nullptr);
+    ~medProcessResultCache();
+    static medProcessResultCache *s_instance;
+
+public:
+    static medProcessResultCache *instance();
+
+public:
+    bool restore(medAbstractProcess *process);
+    void store(medAbstractProcess *process);
+    void clear();
+
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    bool isSpillToDiskEnabled() const;
+    void setSpillToDiskEnabled(bool enabled);
+    QString spillDirectory() const;
+
+private slots:
+    void _bumpRevision(medAbstractData *data);
+    void _watchInputs();
+    void _forgetInput(QObject *data);
+
+private:
+    QByteArray key(medAbstractProcess *process);
+    void evict();
+
+private:
+    const QScopedPointer<medProcessResultCachePrivate> d;
+};
@@ -83,3 +83,23 @@ medIntParameter* medAbstractMorphomathOperationProcess::kernelRadius() const
 {
     return d->kernelRadius;
 }
+
+QList<medAbstractData*> medAbstractMorphomathOperationProcess::resultCacheInputs() const
+{
+    QList<medAbstractData*> inputs;
+    if (input())
+    {
+        inputs << input();
+    }
+    return inputs;
+}
+
+medAbstractData* medAbstractMorphomathOperationProcess::resultCacheOutput() const
+{
+    return this->output();
+}
+
+void medAbstractMorphomathOperationProcess::setResultCacheOutput(medAbstractData *output)
+{
+    this->setOutput(qobject_cast<medAbstractImageData *>(output));
+}
@@ -33,6 +33,10 @@ public:
     medAbstractImageData* input() const;
     medAbstractImageData* output() const;
 
+    QList<medAbstractData*> resultCacheInputs() const override;
+    medAbstractData* resultCacheOutput() const override;
+    void setResultCacheOutput(medAbstractData *output) override;
+
     virtual medIntParameter* kernelRadius() const;
 
 protected:
@@ -71,3 +71,22 @@ medAbstractImageData* medAbstractSingleFilterOperationProcess::output() const
     return d->output;
 }
 
+QList<medAbstractData*> medAbstractSingleFilterOperationProcess::resultCacheInputs() const
+{
+    QList<medAbstractData*> inputs;
+    if (input())
+    {
+        inputs << input();
+    }
+    return inputs;
+}
+
+medAbstractData* medAbstractSingleFilterOperationProcess::resultCacheOutput() const
+{
+    return this->output();
+}
+
+void medAbstractSingleFilterOperationProcess::setResultCacheOutput(medAbstractData *output)
+{
+    this->setOutput(qobject_cast<medAbstractImageData *>(output));
+}
@@ -51,6 +51,8 @@ public:
     int maxNumIterations;
     int maxNumLandmarks;
     double maxMeanDistance;
+    double trimmedFraction;
+    double maxPairDistance;
     int exportMatrixState;
     QString exportMatrixFilePath;
     QString sourceName;
@@ -75,8 +77,10 @@ iterativeClosestPointProcess::iterativeClosestPointProcess()
     d->checkMeanDistance         = 0;
     d->scaleFactor               = 1;
     d->maxNumIterations          = 100;
-    d->maxNumLandmarks           = 1000;
+    d->maxNumLandmarks           = 0;
     d->maxMeanDistance           = 1;
+    d->trimmedFraction           = 1;
+    d->maxPairDistance           = 0;
 }
 
 iterativeClosestPointProcess::~iterativeClosestPointProcess()
@@ -122,6 +126,12 @@ void iterativeClosestPointProcess::setParameter(double data, int channel)
         case 6:
             d->scaleFactor = data;
             break;
+        case 11:
+            d->trimmedFraction = data;
+            break;
+        case 12:
+            d->maxPairDistance = data;
+            break;
     }
 }
 
@@ -186,6 +196,8 @@ int iterativeClosestPointProcess::update()
     ICPFilter->SetMaximumNumberOfLandmarks(d->maxNumLandmarks);
     ICPFilter->SetMaximumMeanDistance(d->maxMeanDistance);
     ICPFilter->SetScaleFactor(d->scaleFactor);
+    ICPFilter->SetTrimmedFraction(d->trimmedFraction);
+    ICPFilter->SetMaximumCorrespondenceDistance(d->maxPairDistance);
 
     if(d->checkMeanDistance)
     {
@@ -315,6 +327,8 @@ void iterativeClosestPointProcess::exportTransformMatrix()
         matrixStr += "# Max Mean Distance = " + QByteArray::number(d->maxMeanDistance) + "\n";
         matrixStr += "# Max Num Iterations = " + QByteArray::number(d->maxNumIterations) + "\n";
         matrixStr += "# Max Num Landmarks = " + QByteArray::number(d->maxNumLandmarks) + "\n";
+        matrixStr += "# Kept Pairs Fraction = " + QByteArray::number(d->trimmedFraction) + "\n";
+        matrixStr += "# Max Pair Distance = " + QByteArray::number(d->maxPairDistance) + "\n";
         matrixStr += "# Fiducial Registration Error = " + QByteArray::number(d->mean);
         matrixStr += " +- " + QByteArray::number(d->variance);
         matrixStr += ", Median = " + QByteArray::number(d->median) + "\n";
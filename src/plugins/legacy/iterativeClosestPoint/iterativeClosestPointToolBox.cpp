@@ -33,7 +33,7 @@ class iterativeClosestPointToolBoxPrivate
 public:
     medAbstractLayeredView *currentView;
     QComboBox *layerSource, *layerTarget;
-    QDoubleSpinBox *ScaleFactor, *MaxMeanDistance;
+    QDoubleSpinBox *ScaleFactor, *MaxMeanDistance, *KeptPairs, *MaxPairDistance;
     QSpinBox *MaxNumIterations, *MaxNumLandmarks;
     QCheckBox *bStartByMatchingCentroids, *bCheckMeanDistance, *exportTransferMatrix;
     QComboBox *bTransformationComboBox;
@@ -129,13 +129,37 @@ iterativeClosestPointToolBox::iterativeClosestPointToolBox(QWidget *parent)
     
     d->MaxNumLandmarks = new QSpinBox(widget);
     d->MaxNumLandmarks->setMaximum(1000000);
-    d->MaxNumLandmarks->setValue(200);
+    d->MaxNumLandmarks->setSpecialValueText("All points");
+    d->MaxNumLandmarks->setValue(0);
     d->MaxNumLandmarks->setToolTip("Set the maximum number of landmarks");
     QHBoxLayout *MaxNumLandmarks_layout = new QHBoxLayout;
     QLabel *MaxNumLandmarks_Label = new QLabel("Max Num Landmarks");
     MaxNumLandmarks_layout->addWidget(MaxNumLandmarks_Label);
     MaxNumLandmarks_layout->addWidget(d->MaxNumLandmarks);
 
+    // Trimmed ICP and outlier rejection
+    d->KeptPairs = new QDoubleSpinBox(widget);
+    d->KeptPairs->setRange(1.0, 100.0);
+    d->KeptPairs->setDecimals(1);
+    d->KeptPairs->setSuffix(" %");
+    d->KeptPairs->setValue(100.0);
+    d->KeptPairs->setToolTip("Percentage of closest point pairs used at each iteration, the farthest ones are discarded");
+    QHBoxLayout *KeptPairs_layout = new QHBoxLayout;
+    QLabel *KeptPairs_Label = new QLabel("Kept Pairs");
+    KeptPairs_layout->addWidget(KeptPairs_Label);
+    KeptPairs_layout->addWidget(d->KeptPairs);
+
+    d->MaxPairDistance = new QDoubleSpinBox(widget);
+    d->MaxPairDistance->setMaximum(1000000);
+    d->MaxPairDistance->setDecimals(3);
+    d->MaxPairDistance->setSpecialValueText("No limit");
+    d->MaxPairDistance->setValue(0.0);
+    d->MaxPairDistance->setToolTip("Point pairs farther apart than this distance are rejected as outliers");
+    QHBoxLayout *MaxPairDistance_layout = new QHBoxLayout;
+    QLabel *MaxPairDistance_Label = new QLabel("Max Pair Distance");
+    MaxPairDistance_layout->addWidget(MaxPairDistance_Label);
+    MaxPairDistance_layout->addWidget(d->MaxPairDistance);
+
     d->exportTransferMatrix = new QCheckBox(tr("Export Transformation Matrix in a File"));
     d->exportTransferMatrix->setToolTip("Write the Transformation Matrix to go from Source to Target");
     connect (d->exportTransferMatrix, SIGNAL(toggled(bool)),
@@ -169,6 +193,8 @@ iterativeClosestPointToolBox::iterativeClosestPointToolBox(QWidget *parent)
     parameters_layout->addLayout(MaxMeanDistance_layout);
     parameters_layout->addLayout(MaxNumIterations_layout);
     parameters_layout->addLayout(MaxNumLandmarks_layout);
+    parameters_layout->addLayout(KeptPairs_layout);
+    parameters_layout->addLayout(MaxPairDistance_layout);
     parameters_layout->addWidget(d->exportTransferMatrix);
     parameters_layout->addWidget(d->pathExportMatrixLineEdit);
     parameters_layout->addWidget(runButton);
@@ -215,6 +241,8 @@ void iterativeClosestPointToolBox::run()
             d->process->setParameter(d->MaxNumLandmarks->value(),5);
             d->process->setParameter(d->ScaleFactor->value(),6);
             d->process->setParameter(d->exportTransferMatrix->checkState(),7);
+            d->process->setParameter(d->KeptPairs->value() / 100.0,11);
+            d->process->setParameter(d->MaxPairDistance->value(),12);
             if (d->exportTransferMatrix->checkState() == 2)
             {
                 d->process->setParameter(d->pathExportMatrixLineEdit->text(), 8);
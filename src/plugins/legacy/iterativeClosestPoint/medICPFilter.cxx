@@ -11,12 +11,12 @@
  */
 #include "medICPFilter.h"
 
-#include "vtkCellLocator.h"
 #include "vtkDataSet.h"
 #include "vtkLandmarkTransform.h"
 #include "vtkMath.h"
 #include "vtkObjectFactory.h"
 #include "vtkPoints.h"
+#include "vtkSMPTools.h"
 #include "vtkTransform.h"
 #include "vtkMatrixToLinearTransform.h"
 #include "vtkTransformPolyDataFilter.h"
@@ -24,8 +24,137 @@
 #include <QList>
 #include <medUtilities.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
 vtkStandardNewMacro(medICPFilter)
 
+//----------------------------------------------------------------------------
+// Balanced k-d tree over a copy of the target points. Nodes are implicit:
+// the median of each index range is the node of that range, and its split
+// axis is stored alongside. Queries only read the tree, so they can run
+// from several threads at once.
+
+class medICPPointTree
+{
+public:
+  void Build(vtkDataSet *dataSet)
+  {
+    vtkIdType nbPoints = dataSet->GetNumberOfPoints();
+    this->Coordinates.resize(3 * nbPoints);
+    for (vtkIdType i = 0; i < nbPoints; ++i)
+    {
+      dataSet->GetPoint(i, &this->Coordinates[3 * i]);
+    }
+    this->Ids.resize(nbPoints);
+    std::iota(this->Ids.begin(), this->Ids.end(), 0);
+    this->Axes.assign(nbPoints, 0);
+    this->BuildRange(0, nbPoints);
+  }
+
+  // -1 when the tree is empty
+  vtkIdType FindClosestPoint(const double x[3], double &dist2) const
+  {
+    vtkIdType closest = -1;
+    dist2 = std::numeric_limits<double>::max();
+    this->SearchRange(0, static_cast<vtkIdType>(this->Ids.size()), x, closest, dist2);
+    return closest;
+  }
+
+  const double *GetPoint(vtkIdType id) const
+  {
+    return &this->Coordinates[3 * id];
+  }
+
+private:
+  void BuildRange(vtkIdType begin, vtkIdType end)
+  {
+    if (end - begin < 2)
+    {
+      return;
+    }
+
+    // Split along the largest extent of the range
+    double lower[3], upper[3];
+    std::fill(lower, lower + 3, std::numeric_limits<double>::max());
+    std::fill(upper, upper + 3, std::numeric_limits<double>::lowest());
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+      const double *p = this->GetPoint(this->Ids[i]);
+      for (int c = 0; c < 3; ++c)
+      {
+        lower[c] = std::min(lower[c], p[c]);
+        upper[c] = std::max(upper[c], p[c]);
+      }
+    }
+    int axis = 0;
+    for (int c = 1; c < 3; ++c)
+    {
+      if (upper[c] - lower[c] > upper[axis] - lower[axis])
+      {
+        axis = c;
+      }
+    }
+
+    vtkIdType middle = begin + (end - begin) / 2;
+    const double *coordinates = this->Coordinates.data();
+    std::nth_element(this->Ids.begin() + begin,
+                     this->Ids.begin() + middle,
+                     this->Ids.begin() + end,
+                     [coordinates, axis](vtkIdType a, vtkIdType b)
+                     {
+                       return coordinates[3 * a + axis] < coordinates[3 * b + axis];
+                     });
+    this->Axes[middle] = static_cast<unsigned char>(axis);
+
+    this->BuildRange(begin, middle);
+    this->BuildRange(middle + 1, end);
+  }
+
+  void SearchRange(vtkIdType begin, vtkIdType end, const double x[3],
+                   vtkIdType &closest, double &dist2) const
+  {
+    if (begin >= end)
+    {
+      return;
+    }
+
+    vtkIdType middle = begin + (end - begin) / 2;
+    vtkIdType id = this->Ids[middle];
+    double d2 = vtkMath::Distance2BetweenPoints(x, this->GetPoint(id));
+    if (d2 < dist2)
+    {
+      dist2 = d2;
+      closest = id;
+    }
+
+    int axis = this->Axes[middle];
+    double delta = x[axis] - this->GetPoint(id)[axis];
+    if (delta < 0)
+    {
+      this->SearchRange(begin, middle, x, closest, dist2);
+      if (delta * delta < dist2)
+      {
+        this->SearchRange(middle + 1, end, x, closest, dist2);
+      }
+    }
+    else
+    {
+      this->SearchRange(middle + 1, end, x, closest, dist2);
+      if (delta * delta < dist2)
+      {
+        this->SearchRange(begin, middle, x, closest, dist2);
+      }
+    }
+  }
+
+  std::vector<double> Coordinates;
+  std::vector<vtkIdType> Ids;
+  std::vector<unsigned char> Axes;
+};
+
 //----------------------------------------------------------------------------
 
 medICPFilter::medICPFilter()
@@ -33,14 +162,18 @@ medICPFilter::medICPFilter()
 {
   this->Source = nullptr;
   this->Target = nullptr;
-  this->Locator = nullptr;
+  this->TargetTree = nullptr;
+  this->TargetTreeDataSet = nullptr;
+  this->TargetTreeBuildTime = 0;
   this->LandmarkTransform = vtkLandmarkTransform::New();
   this->MaximumNumberOfIterations = 50;
   this->CheckMeanDistance = 0;
   this->MeanDistanceMode = VTK_ICP_MODE_RMS;
   this->MaximumMeanDistance = 0.01;
-  this->MaximumNumberOfLandmarks = 200;
+  this->MaximumNumberOfLandmarks = 0;
   this->StartByMatchingCentroids = 0;
+  this->TrimmedFraction = 1.0;
+  this->MaximumCorrespondenceDistance = 0.0;
   this->ScaleFactor = 1.0;
 
   this->NumberOfIterations = 0;
@@ -69,7 +202,7 @@ medICPFilter::~medICPFilter()
 {
   ReleaseSource();
   ReleaseTarget();
-  ReleaseLocator();
+  delete this->TargetTree;
   this->LandmarkTransform->Delete();
 }
 
@@ -141,46 +274,28 @@ void medICPFilter::ReleaseTarget(void) {
 
 //----------------------------------------------------------------------------
 
-void medICPFilter::SetLocator(vtkCellLocator *locator)
+bool medICPFilter::UpdateTargetTree(void)
 {
-  if (this->Locator == locator)
+  if (this->Target == nullptr || !this->Target->GetNumberOfPoints())
   {
-    return;
+    return false;
   }
 
-  if (this->Locator)
+  if (this->TargetTree &&
+      this->TargetTreeDataSet == this->Target &&
+      this->TargetTreeBuildTime >= this->Target->GetMTime())
   {
-    this->ReleaseLocator();
+    return true;
   }
 
-  if (locator)
+  if (!this->TargetTree)
   {
-    locator->Register(this);
+    this->TargetTree = new medICPPointTree;
   }
-
-  this->Locator = locator;
-  this->Modified();
-}
-
-//----------------------------------------------------------------------------
-
-void medICPFilter::ReleaseLocator(void) {
-  if (this->Locator)
-  {
-    this->Locator->UnRegister(this);
-    this->Locator = nullptr;
-  }
-}
-
-//----------------------------------------------------------------------------
-
-void medICPFilter::CreateDefaultLocator() {
-  if (this->Locator)
-  {
-    this->ReleaseLocator();
-  }
-
-  this->Locator = vtkCellLocator::New();
+  this->TargetTree->Build(this->Target);
+  this->TargetTreeDataSet = this->Target;
+  this->TargetTreeBuildTime = this->Target->GetMTime();
+  return true;
 }
 
 //------------------------------------------------------------------------
@@ -208,15 +323,6 @@ vtkMTimeType medICPFilter::GetMTime()
     }
   }
 
-  if (this->Locator)
-  {
-    mtime = this->Locator->GetMTime();
-    if (mtime > result)
-    {
-      result = mtime;
-    }
-  }
-
   if (this->LandmarkTransform)
   {
     mtime = this->LandmarkTransform->GetMTime();
@@ -270,12 +376,13 @@ void medICPFilter::InternalDeepCopy(vtkAbstractTransform *transform)
 
   this->SetSource(t->GetSource());
   this->SetTarget(t->GetTarget());
-  this->SetLocator(t->GetLocator());
   this->SetMaximumNumberOfIterations(t->GetMaximumNumberOfIterations());
   this->SetCheckMeanDistance(t->GetCheckMeanDistance());
   this->SetMeanDistanceMode(t->GetMeanDistanceMode());
   this->SetMaximumMeanDistance(t->GetMaximumMeanDistance());
   this->SetMaximumNumberOfLandmarks(t->GetMaximumNumberOfLandmarks());
+  this->SetTrimmedFraction(t->GetTrimmedFraction());
+  this->SetMaximumCorrespondenceDistance(t->GetMaximumCorrespondenceDistance());
   this->SetScaleFactor(t->GetScaleFactor());
 
   this->Modified();
@@ -316,17 +423,28 @@ void medICPFilter::InternalUpdate()
 
   vtkSmartPointer<vtkPolyData> newSource = TransformFilter1->GetOutput();
 
-  // Create locator
+  // Only polydata go through the transform filter
+  if (!newSource->GetNumberOfPoints())
+  {
+    vtkErrorMacro(<<"Can't execute with an input without points");
+    return;
+  }
+
+  // Build (or reuse) the k-d tree of the target, which must not be empty:
+  // the closest point search would find no point
 
-  this->CreateDefaultLocator();
-  this->Locator->SetDataSet(this->Target);
-  this->Locator->SetNumberOfCellsPerBucket(1);
-  this->Locator->BuildLocator();
+  if (!this->UpdateTargetTree())
+  {
+    vtkErrorMacro(<<"Can't execute with nullptr or empty target");
+    return;
+  }
+  const medICPPointTree *tree = this->TargetTree;
 
-  // Create two sets of points to handle iteration
+  // Pick the source landmarks
 
   int step = 1;
-  if (newSource->GetNumberOfPoints() > this->MaximumNumberOfLandmarks)
+  if (this->MaximumNumberOfLandmarks > 0 &&
+      newSource->GetNumberOfPoints() > this->MaximumNumberOfLandmarks)
   {
     step = newSource->GetNumberOfPoints() / this->MaximumNumberOfLandmarks;
     vtkDebugMacro(<< "Landmarks step is now : " << step);
@@ -336,27 +454,24 @@ void medICPFilter::InternalUpdate()
 
   this->SourceLandmarkIds.resize(nb_points);
 
-  for (int i = 0, j = 0; i < nb_points; i++, j += step)
+  for (vtkIdType i = 0, j = 0; i < nb_points; i++, j += step)
   {
      this->SourceLandmarkIds[i] = j;
   }
 
-  // Allocate some points.
-  // - closestp is used so that the internal state of LandmarkTransform remains
-  //   correct whenever the iteration process is stopped (hence its source
-  //   and landmark points might be used in a vtkThinPlateSplineTransform).
-  // - points2 could have been avoided, but do not ask me why
-  //   InternalTransformPoint is not working correctly on my computer when
-  //   in and out are the same pointer.
-
-  vtkPoints *points1 = vtkPoints::New();
-  points1->SetNumberOfPoints(nb_points);
+  // Moving landmarks, their closest target points and squared distances are
+  // kept in flat buffers so that every landmark can be processed in
+  // parallel. Only the pairs retained at each iteration are copied to the
+  // vtkPoints handed to the landmark transform, which keeps a valid state
+  // whenever the iteration process is stopped (hence its source and
+  // landmark points might be used in a vtkThinPlateSplineTransform).
 
-  vtkPoints *closestp = vtkPoints::New();
-  closestp->SetNumberOfPoints(nb_points);
+  std::vector<double> current(3 * nb_points), next(3 * nb_points);
+  std::vector<double> closest(3 * nb_points);
+  std::vector<double> distances2(nb_points), moves(nb_points);
 
-  vtkPoints *points2 = vtkPoints::New();
-  points2->SetNumberOfPoints(nb_points);
+  vtkPoints *sourceLandmarks = vtkPoints::New();
+  vtkPoints *targetLandmarks = vtkPoints::New();
 
   // Fill with initial positions (sample dataset using step)
 
@@ -365,7 +480,7 @@ void medICPFilter::InternalUpdate()
   accumulate->Concatenate(linearTransform->GetMatrix());
 
   vtkIdType i;
-  int j;
+  vtkIdType j;
   double p1[3], p2[3];
 
   if (StartByMatchingCentroids)
@@ -408,50 +523,99 @@ void medICPFilter::InternalUpdate()
     translateTransform->SetMatrix(translateMatrix);
     translateTransform->Update();
 
-    double outPoint[3];
     for (i = 0, j = 0; i < nb_points; i++, j += step)
     {
-      translateTransform->TransformPoint(newSource->GetPoint(j), outPoint);
-      points1->SetPoint(i, outPoint);
+      newSource->GetPoint(j, p1);
+      translateTransform->TransformPoint(p1, &current[3 * i]);
     }
   }
   else
   {
     for (i = 0, j = 0; i < nb_points; i++, j += step)
     {
-      points1->SetPoint(i, newSource->GetPoint(j));
+      newSource->GetPoint(j, &current[3 * i]);
     }
   }
 
-  // Go
+  // Parallel steps of an iteration
+
+  auto findClosestPoints = [&](vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      vtkIdType id = tree->FindClosestPoint(&current[3 * k], distances2[k]);
+      const double *point = tree->GetPoint(id);
+      std::copy(point, point + 3, &closest[3 * k]);
+    }
+  };
+
+  vtkLandmarkTransform *landmarkTransform = this->LandmarkTransform;
+  auto movePoints = [&](vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType k = begin; k < end; ++k)
+    {
+      landmarkTransform->InternalTransformPoint(&current[3 * k], &next[3 * k]);
+      moves[k] = vtkMath::Distance2BetweenPoints(&current[3 * k], &next[3 * k]);
+    }
+  };
 
-  vtkIdType cell_id;
-  int sub_id;
-  double dist2, totaldist = 0;
-  double outPoint[3];
+  // Go
 
-  vtkPoints *temp, *a = points1, *b = points2;
+  double totaldist = 0;
+  std::vector<double> ranked;
 
   this->NumberOfIterations = 0;
 
   do
   {
-    // Fill points with the closest points to each vertex in input
+    // Pair each landmark with its closest target point
+
+    vtkSMPTools::For(0, nb_points, findClosestPoints);
+
+    // Reject outliers, then keep the closest fraction of the pairs
+
+    double maxDist2 = std::numeric_limits<double>::max();
+    if (this->MaximumCorrespondenceDistance > 0)
+    {
+      maxDist2 = this->MaximumCorrespondenceDistance * this->MaximumCorrespondenceDistance;
+    }
+
+    if (this->TrimmedFraction < 1.0)
+    {
+      vtkIdType kept = static_cast<vtkIdType>(std::ceil(this->TrimmedFraction * nb_points));
+      kept = std::max<vtkIdType>(kept, 3);
+      if (kept < nb_points)
+      {
+        ranked = distances2;
+        std::nth_element(ranked.begin(), ranked.begin() + (kept - 1), ranked.end());
+        maxDist2 = std::min(maxDist2, ranked[kept - 1]);
+      }
+    }
+
+    sourceLandmarks->Reset();
+    targetLandmarks->Reset();
+    for (i = 0; i < nb_points; i++)
+    {
+      if (distances2[i] <= maxDist2)
+      {
+        sourceLandmarks->InsertNextPoint(&current[3 * i]);
+        targetLandmarks->InsertNextPoint(&closest[3 * i]);
+      }
+    }
+    sourceLandmarks->Modified();
+    targetLandmarks->Modified();
 
-    for(i = 0; i < nb_points; i++)
+    if (sourceLandmarks->GetNumberOfPoints() < 3)
     {
-      this->Locator->FindClosestPoint(a->GetPoint(i),
-                                      outPoint,
-                                      cell_id,
-                                      sub_id,
-                                      dist2);
-      closestp->SetPoint(i, outPoint);
+      vtkWarningMacro(<< "Only " << sourceLandmarks->GetNumberOfPoints()
+                      << " point pairs left after outlier rejection, stopping");
+      break;
     }
 
     // Build the landmark transform
 
-    this->LandmarkTransform->SetSourceLandmarks(a);
-    this->LandmarkTransform->SetTargetLandmarks(closestp);
+    this->LandmarkTransform->SetSourceLandmarks(sourceLandmarks);
+    this->LandmarkTransform->SetTargetLandmarks(targetLandmarks);
     this->LandmarkTransform->Update();
 
     // Concatenate (can't use this->Concatenate directly)
@@ -465,33 +629,25 @@ void medICPFilter::InternalUpdate()
       break;
     }
 
-    // Move mesh and compute mean distance if needed
+    // Move landmarks and compute mean distance if needed
+
+    vtkSMPTools::For(0, nb_points, movePoints);
 
     if (this->CheckMeanDistance)
     {
       totaldist = 0.0;
-    }
-
-    for(i = 0; i < nb_points; i++)
-    {
-      a->GetPoint(i, p1);
-      this->LandmarkTransform->InternalTransformPoint(p1, p2);
-      b->SetPoint(i, p2);
-      if (this->CheckMeanDistance)
+      for (i = 0; i < nb_points; i++)
       {
         if (this->MeanDistanceMode == VTK_ICP_MODE_RMS)
         {
-          totaldist += vtkMath::Distance2BetweenPoints(p1, p2);
+          totaldist += moves[i];
         }
         else
         {
-          totaldist += sqrt(vtkMath::Distance2BetweenPoints(p1, p2));
+          totaldist += sqrt(moves[i]);
         }
       }
-    }
 
-    if (this->CheckMeanDistance)
-    {
       if (this->MeanDistanceMode == VTK_ICP_MODE_RMS)
       {
         this->MeanDistance = sqrt(totaldist / (double)nb_points);
@@ -507,9 +663,7 @@ void medICPFilter::InternalUpdate()
       }
     }
 
-    temp = a;
-    a = b;
-    b = temp;
+    current.swap(next);
 
   }
   while (1);
@@ -520,12 +674,14 @@ void medICPFilter::InternalUpdate()
 
   double transformSourcePoint[3];
   QList<double> distances;
+  distances.reserve(nb_points);
 
   for(i = 0; i < nb_points; i++)
   {
-      accumulate->TransformPoint(this->Source->GetPoint(this->SourceLandmarkIds[i]), transformSourcePoint);
+      this->Source->GetPoint(this->SourceLandmarkIds[i], p1);
+      accumulate->TransformPoint(p1, transformSourcePoint);
       distances.append(sqrt(vtkMath::Distance2BetweenPoints(transformSourcePoint,
-                                                        closestp->GetPoint(i) )));
+                                                        &closest[3 * i])));
 
   }
 
@@ -533,9 +689,8 @@ void medICPFilter::InternalUpdate()
   medUtilities::computeMedian(distances, &this->medianFRE);
 
   accumulate->Delete();
-  points1->Delete();
-  closestp->Delete();
-  points2->Delete();
+  sourceLandmarks->Delete();
+  targetLandmarks->Delete();
 }
 
 //----------------------------------------------------------------------------
@@ -562,20 +717,13 @@ void medICPFilter::PrintSelf(ostream& os, vtkIndent indent)
     os << indent << "Target: (none)\n";
   }
 
-  if ( this->Locator )
-  {
-    os << indent << "Locator: " << this->Locator << "\n";
-  }
-  else
-  {
-    os << indent << "Locator: (none)\n";
-  }
-
   os << indent << "MaximumNumberOfIterations: " << this->MaximumNumberOfIterations << "\n";
   os << indent << "CheckMeanDistance: " << this->CheckMeanDistance << "\n";
   os << indent << "MeanDistanceMode: " << this->GetMeanDistanceModeAsString() << "\n";
   os << indent << "MaximumMeanDistance: " << this->MaximumMeanDistance << "\n";
   os << indent << "MaximumNumberOfLandmarks: " << this->MaximumNumberOfLandmarks << "\n";
+  os << indent << "TrimmedFraction: " << this->TrimmedFraction << "\n";
+  os << indent << "MaximumCorrespondenceDistance: " << this->MaximumCorrespondenceDistance << "\n";
   os << indent << "StartByMatchingCentroids: " << this->StartByMatchingCentroids << "\n";
   os << indent << "NumberOfIterations: " << this->NumberOfIterations << "\n";
   os << indent << "MeanDistance: " << this->MeanDistance << "\n";
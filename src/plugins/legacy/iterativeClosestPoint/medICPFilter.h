@@ -21,9 +21,9 @@
 #define VTK_ICP_MODE_RMS 0
 #define VTK_ICP_MODE_AV 1
 
-class vtkCellLocator;
 class vtkLandmarkTransform;
 class vtkDataSet;
+class medICPPointTree;
 
 class ITERATIVECLOSESTPOINTPLUGIN_EXPORT medICPFilter : public vtkLinearTransform
 {
@@ -41,15 +41,6 @@ public:
   vtkGetObjectMacro(Target, vtkDataSet);
   //@}
 
-  //@{
-  /**
-   * Set/Get a spatial locator for speeding up the search process.
-   * An instance of vtkCellLocator is used by default.
-   */
-  void SetLocator(vtkCellLocator *locator);
-  vtkGetObjectMacro(Locator, vtkCellLocator);
-  //@}
-
   //@{
   /**
    * Set/Get the scale factor
@@ -122,13 +113,31 @@ public:
   //@{
   /**
    * Set/Get the maximum number of landmarks sampled in your dataset.
-   * If your dataset is dense, then you will typically not need all the
-   * points to compute the ICP transform. The default is 200.
+   * A value of 0 uses every source point. The default is 0.
    */
   vtkSetMacro(MaximumNumberOfLandmarks, int);
   vtkGetMacro(MaximumNumberOfLandmarks, int);
   //@}
 
+  //@{
+  /**
+   * Set/Get the fraction of closest point pairs kept at each iteration
+   * (trimmed ICP). Pairs are ranked by distance and the farthest ones are
+   * left out of the landmark transform. The default is 1.0 (keep all).
+   */
+  vtkSetClampMacro(TrimmedFraction, double, 0.01, 1.0);
+  vtkGetMacro(TrimmedFraction, double);
+  //@}
+
+  //@{
+  /**
+   * Set/Get the maximum distance between paired points. Farther pairs are
+   * rejected as outliers. A value of 0 disables the test. The default is 0.
+   */
+  vtkSetMacro(MaximumCorrespondenceDistance, double);
+  vtkGetMacro(MaximumCorrespondenceDistance, double);
+  //@}
+
   //@{
   /**
    * Starts the process by translating source centroid to target centroid.
@@ -172,17 +181,14 @@ protected:
   //@}
 
   /**
-   * Release locator
-   */
-  void ReleaseLocator(void);
-
-  /**
-   * Create default locator. Used to create one when none is specified.
+   * Build the k-d tree over the target points, unless the one from a
+   * previous update still matches the target. False when the target has
+   * no points.
    */
-  void CreateDefaultLocator(void);
+  bool UpdateTargetTree(void);
 
   /**
-   * Get the MTime of this object also considering the locator.
+   * Get the MTime of this object also considering source and target.
    */
   vtkMTimeType GetMTime() override;
 
@@ -198,13 +204,17 @@ protected:
 
   vtkDataSet *Source;
   vtkDataSet *Target;
-  vtkCellLocator *Locator;
+  medICPPointTree *TargetTree;
+  vtkDataSet *TargetTreeDataSet;
+  vtkMTimeType TargetTreeBuildTime;
   int MaximumNumberOfIterations;
   int CheckMeanDistance;
   int MeanDistanceMode;
   double MaximumMeanDistance;
   int MaximumNumberOfLandmarks;
   int StartByMatchingCentroids;
+  double TrimmedFraction;
+  double MaximumCorrespondenceDistance;
   double ScaleFactor;
   std::vector<vtkIdType> SourceLandmarkIds;
   double meanFRE, varianceFRE, medianFRE;
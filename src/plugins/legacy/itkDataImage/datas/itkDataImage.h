@@ -67,7 +67,7 @@ public:
     enum { Dimension=DIM };
 
     itkDataImage(): medAbstractTypedImageData<DIM,T>(),d(new PrivateMember) { }
-    itkDataImage(const itkDataImage& other): medAbstractTypedImageData<DIM,T>(), d(new PrivateMember(*(other.d))) { }
+    itkDataImage(const itkDataImage& other): medAbstractTypedImageData<DIM,T>(other), d(new PrivateMember(*(other.d))) { }
     ~itkDataImage()
     {
         delete d;
@@ -84,6 +84,17 @@ public:
         return new itkDataImage(*this);
     }
 
+    // the copy constructor duplicates the image and keeps the metadata
+    itkDataImage* deepCopy()
+    {
+        return new itkDataImage(*this);
+    }
+
+    unsigned long modificationTime()
+    {
+        return d->image ? d->image->GetMTime() : 0;
+    }
+
     // Inherited slots (through virtual member functions).
     void* output() { return d->image.GetPointer(); }
     void* data() { return d->image.GetPointer(); }
@@ -98,6 +109,8 @@ public:
         }
         d->image = image;
         d->reset();
+        this->clearScalarRange();
+        this->clearTypedViews();
     }
 
     void update() { }
@@ -131,10 +131,17 @@ void medVtkViewItkDataImage4DInteractor::setInputData(medAbstractData *data)
             d->view2d->GetImageActor(d->view2d->GetCurrentLayer())->GetProperty()->SetInterpolationTypeToCubic();
             initParameters(d->imageData);
 
-            double* range = m_poConv->getCurrentScalarRange();
+            // computed once per data, other views reuse it
+            double range[2];
+            if (!d->imageData->hasScalarRange())
+            {
+                std::vector<double> frameRanges;
+                m_poConv->getScalarRanges(range, &frameRanges);
+                d->imageData->setScalarRange(range, QVector<double>::fromStdVector(frameRanges));
+            }
+            d->imageData->scalarRange(range);
             d->view2d->SetColorRange(range);
             this->initWindowLevelParameters(range);
-            delete [] range;
 
             createSlicingParam();
 
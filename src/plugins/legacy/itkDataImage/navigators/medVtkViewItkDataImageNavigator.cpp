@@ -84,6 +84,7 @@ medVtkViewItkDataImageNavigator::medVtkViewItkDataImageNavigator(medAbstractView
     d->renderer3DParameter->addItem("OSPRay / CPU");
 #endif //MED_USE_OSPRAY_4_VR_BY_CPU
     d->renderer3DParameter->addItem("Ray Cast");
+    d->renderer3DParameter->addItem("Progressive CPU");
     d->renderer3DParameter->addItem("Default");
     connect(d->renderer3DParameter, SIGNAL(valueChanged(QString)), this, SLOT(setRenderer(QString)));
 
@@ -306,6 +307,9 @@ void medVtkViewItkDataImageNavigator::setRenderer(QString renderer)
     else if ( renderer=="Ray Cast" )
         d->view3d->SetVolumeMapperToRayCast();
 
+    else if ( renderer=="Progressive CPU" )
+        d->view3d->SetVolumeMapperToProgressiveCPU();
+
     else if ( renderer=="Default" )
         d->view3d->SetVolumeMapperToDefault();
 
@@ -19,8 +19,7 @@
 
 #include <itkImage.h>
 #include <itkImageToImageFilter.h>
-#include <itkImageRegionIterator.h>
-#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkMultiThreaderBase.h>
 
 #include <vtkSphericalHarmonicGlyph.h>
 #include <itkSphericalHarmonicITKToVTKFilter.h>
@@ -131,28 +130,38 @@ namespace itk
         rgb_array->SetNumberOfTuples(size[0]*size[1]*size[2]);
 
         this->UpdateProgress(0.0);
-        const unsigned long step = 0.15*numVoxels;
-        int count = 0;
 
-        typedef itk::ImageRegionConstIteratorWithIndex<SHImageType> IteratorType;
-        for (IteratorType it(inputSH,inputSH->GetLargestPossibleRegion());!it.IsAtEnd();++it) {
+        // The coefficients of a vector image are contiguous, pixel by pixel, in
+        // the same order as the VTK array: copy them in bulk, in parallel.
 
-            SHType sphericalHarmonic = it.Get();
-            sh_array->InsertTuple(count,&sphericalHarmonic[0]);
+        const ScalarType*  buffer        = inputSH->GetBufferPointer();
+        const unsigned int numComponents = inputSH->GetNumberOfComponentsPerPixel();
+
+        float* shValues    = sh_array->GetPointer(0);
+        float* anisoValues = aniso_array->GetPointer(0);
+        float* rgbValues   = rgb_array->GetPointer(0);
+
+        auto convertVoxel = [&](SizeValueType voxel)
+        {
+            const ScalarType* sphericalHarmonic = buffer + voxel*numComponents;
+            float* sh = shValues + voxel*numComponents;
 
             float sum = 0.0;
-            for(unsigned int i = 0; i < sphericalHarmonic.Size(); i++)
-                sum += sphericalHarmonic[i]*sphericalHarmonic[i];
+            for(unsigned int i = 0; i < numComponents; i++)
+            {
+                sh[i] = sphericalHarmonic[i];
+                sum += sh[i]*sh[i];
+            }
 
-            const float c0  = sphericalHarmonic[0];
+            const float c0  = sh[0];
             const float gfa = (sum>0.0) ? std::sqrt(1-c0*c0/sum) : 0.0;
 
-            aniso_array->InsertTuple1(count,gfa);
-            rgb_array->InsertTuple1(count, gfa);
+            anisoValues[voxel] = gfa;
+            rgbValues[voxel]   = gfa;
+        };
+        MultiThreaderBase::New()->ParallelizeArray(0, numVoxels, convertVoxel, nullptr);
 
-            if (++count%step==0)
-                this->UpdateProgress(double(count)/double(numVoxels));
-        }
+        this->UpdateProgress(1.0);
 
         m_VTKSphericalHarmonic->GetPointData()->AddArray(sh_array);
         m_VTKSphericalHarmonic->GetPointData()->AddArray(aniso_array);
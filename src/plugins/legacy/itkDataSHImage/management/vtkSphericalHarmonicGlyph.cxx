@@ -11,15 +11,18 @@
 
 =========================================================================*/
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 #include <vtkPolyData.h>
 #include <vtkCellArray.h>
 #include <vtkDataSet.h>
 #include <vtkExecutive.h>
 #include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
-#include <vtkTransform.h>
+#include <vtkSMPTools.h>
 
 #include "vtkSphericalHarmonicGlyph.h"
 
@@ -114,16 +117,51 @@ vtkSphericalHarmonicGlyph::~vtkSphericalHarmonicGlyph() {
         SphericalHarmonicSource->UnRegister(this);
 }
 
+// Connectivity of one cell array of the shell, replicated for every glyph.
+
+static void
+ReplicateShellCells(vtkCellArray* shellCells,vtkCellArray* cells,const vtkIdType numGlyphs,const vtkIdType numShellPts) {
+
+    std::vector<vtkIdType> values;
+    std::vector<char>      isPointId;
+
+    vtkIdType  npts;
+    vtkIdType* pts;
+    for (shellCells->InitTraversal();shellCells->GetNextCell(npts,pts);) {
+        values.push_back(npts);
+        isPointId.push_back(0);
+        for (vtkIdType i=0;i<npts;++i) {
+            values.push_back(pts[i]);
+            isPointId.push_back(1);
+        }
+    }
+
+    const vtkIdType size = static_cast<vtkIdType>(values.size());
+
+    vtkIdTypeArray* connectivity = vtkIdTypeArray::New();
+    connectivity->SetNumberOfValues(numGlyphs*size);
+    vtkIdType* out = connectivity->GetPointer(0);
+
+    auto fillGlyphCells = [&](vtkIdType begin,vtkIdType end) {
+        for (vtkIdType g=begin;g<end;++g) {
+            const vtkIdType offset = g*numShellPts;
+            for (vtkIdType i=0;i<size;++i)
+                out[g*size+i] = values[i]+(isPointId[i] ? offset : 0);
+        }
+    };
+    vtkSMPTools::For(0,numGlyphs,fillGlyphCells);
+
+    cells->SetCells(numGlyphs*shellCells->GetNumberOfCells(),connectivity);
+    connectivity->Delete();
+}
+
 int
 vtkSphericalHarmonicGlyph::RequestData(vtkInformation*,vtkInformationVector** inputVector,
                                        vtkInformationVector* outputVector)
 {
     // Get the info objects.
-    vtkInformation* inInfo     = inputVector[0]->GetInformationObject(0);
-    vtkInformation* sourceInfo = inputVector[1]->GetInformationObject(0);
-    vtkInformation* outInfo    = outputVector->GetInformationObject(0);
-
-    const int numDirs = 1;
+    vtkInformation* inInfo  = inputVector[0]->GetInformationObject(0);
+    vtkInformation* outInfo = outputVector->GetInformationObject(0);
 
     // Get the input.
 
@@ -141,204 +179,189 @@ vtkSphericalHarmonicGlyph::RequestData(vtkInformation*,vtkInformationVector** in
     vtkDataArray* inScalars = pd->GetScalars(GetSphericalHarmonicCoefficientsArrayName());
     vtkDataArray* inAniso   = pd->GetScalars(GetAnisotropyMeasureArrayName());
 
-    // Allocate storage for output PolyData
+    if (!inScalars || !SphericalHarmonicSource) {
+        vtkErrorMacro(<<"No spherical harmonics to glyph!");
+        return 1;
+    }
+
+    // The basis is evaluated once per shell (tesselation, order, basis type
+    // and flips) by the source: every glyph is then a matrix-vector product.
 
-    vtkPolyData* source    = vtkPolyData::SafeDownCast(sourceInfo->Get(vtkDataObject::DATA_OBJECT()));
-    vtkPoints*   sourcePts = source->GetPoints();  //shell
+    vtkPolyData* shell = SphericalHarmonicSource->GetShell();
+    const itk::VariableSizeMatrix<double>& basis = SphericalHarmonicSource->GetBasisFunction();
 
     // Number of points on the shell
 
-    const vtkIdType numSourcePts   = sourcePts->GetNumberOfPoints();
-    if (!numSourcePts || numSourcePts < 0) {
+    const vtkIdType numShellPts = shell->GetNumberOfPoints();
+    if (!numShellPts || numShellPts < 0 || basis.Cols()!=static_cast<unsigned>(numShellPts)) {
         vtkErrorMacro(<<"No data to glyph!");
         return 1;
     }
 
+    const int     numCoeffs = std::min<int>(inScalars->GetNumberOfComponents(),basis.Rows());
+    const double* basisData = basis.GetVnlMatrix().data_block();
 
-    // Number of cells is the number of triangles in shell
+    std::vector<double> shellPts(3*numShellPts);
+    for (vtkIdType i=0;i<numShellPts;++i)
+        shell->GetPoint(i,&shellPts[3*i]);
 
-    const vtkIdType numSourceCells = source->GetNumberOfCells();
-    const unsigned newpts_sz = numDirs*numPts*numSourcePts;
+    // Only glyph the points with some anisotropy.
 
-    vtkPoints* newPts = vtkPoints::New();
-    newPts->Allocate(newpts_sz);
+    std::vector<vtkIdType> glyphIds;
+    glyphIds.reserve(numPts);
+    for (vtkIdType inPtId=0;inPtId<numPts;++inPtId)
+        if (!inAniso || inAniso->GetComponent(inPtId,0)!=0)
+            glyphIds.push_back(inPtId);
 
-    vtkPointData* newPointData = vtkPointData::New();
-    newPointData->Allocate(newpts_sz);
+    const vtkIdType numGlyphs = static_cast<vtkIdType>(glyphIds.size());
 
-    // Setting up for calls to PolyData::InsertNextCell()
+    std::vector<double> centers(3*numGlyphs);
+    for (vtkIdType g=0;g<numGlyphs;++g)
+        input->GetPoint(glyphIds[g],&centers[3*g]);
 
-    vtkPolyData*  output = vtkPolyData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
-    vtkPointData* outPD  = output->GetPointData();
+    // Shell pose (source) and glyph pose (image coordinate system).
 
-    vtkCellArray* sourceCells;
-    if ((sourceCells=source->GetVerts())->GetNumberOfCells()>0) {
-        vtkCellArray* cells = vtkCellArray::New();
-        cells->Allocate(numDirs*numPts*sourceCells->GetSize());
-        output->SetVerts(cells);
-        cells->Delete();
-    }
-    if ((sourceCells=GetSource()->GetLines())->GetNumberOfCells()>0) {
-        vtkCellArray* cells = vtkCellArray::New();
-        cells->Allocate(numDirs*numPts*sourceCells->GetSize());
-        output->SetLines(cells);
-        cells->Delete();
-    }
-    if ((sourceCells=GetSource()->GetPolys())->GetNumberOfCells()>0) {
-        vtkCellArray* cells = vtkCellArray::New();
-        cells->Allocate(numDirs*numPts*sourceCells->GetSize());
-        output->SetPolys(cells);
-        cells->Delete();
-    }
-    if ((sourceCells=GetSource()->GetStrips())->GetNumberOfCells()>0) {
-        vtkCellArray* cells = vtkCellArray::New();
-        cells->Allocate(numDirs*numPts*sourceCells->GetSize());
-        output->SetStrips(cells);
-        cells->Delete();
-    }
+    vtkMatrix4x4* rotation = SphericalHarmonicSource->GetRotationMatrix();
+
+    double shellPose[12] = { 1,0,0,0, 0,1,0,0, 0,0,1,0 };
+    double glyphPose[12] = { 1,0,0,0, 0,1,0,0, 0,0,1,0 };
+    for (int i=0;i<3;++i)
+        for (int j=0;j<4;++j) {
+            if (rotation)
+                shellPose[4*i+j] = rotation->GetElement(i,j);
+            if (TMatrix)
+                glyphPose[4*i+j] = TMatrix->GetElement(i,j);
+        }
 
-    vtkFloatArray* newPointScalars = vtkFloatArray::New();
-    newPointScalars->Allocate(numDirs*numPts*numSourcePts);
+    double shellCenter[3];
+    SphericalHarmonicSource->GetCenter(shellCenter);
 
-    // Only copy scalar data through.
-    pd = GetSource()->GetPointData();
+    const bool   deform    = SphericalHarmonicSource->GetDeform();
+    const bool   normalize = SphericalHarmonicSource->GetNormalize();
+    const double radius    = SphericalHarmonicSource->GetRadius();
+
+    vtkPoints* newPts = vtkPoints::New();
+    newPts->SetDataTypeToFloat();
+    newPts->SetNumberOfPoints(numGlyphs*numShellPts);
+    float* outPts = static_cast<float*>(newPts->GetVoidPointer(0));
 
     vtkFloatArray* newScalars = 0;
-    if (ColorGlyphs && (ColorMode==COLOR_BY_DIRECTIONS ||
-        (inAniso && ColorMode==COLOR_BY_SCALARS)))
-    {
+    float* outScalars = 0;
+    if (ColorGlyphs && (ColorMode==COLOR_BY_DIRECTIONS || (inAniso && ColorMode==COLOR_BY_SCALARS))) {
         newScalars = vtkFloatArray::New();
-        newScalars->Allocate(numDirs*numPts*numSourcePts);
-    } else {
-        outPD->CopyAllOff();
-        outPD->CopyScalarsOn();
-        outPD->CopyAllocate(pd,numDirs*numPts*numSourcePts);
-    }
-
-    if (pd->GetNormals()) {
-        vtkFloatArray* newNormals = vtkFloatArray::New();
-        newNormals->SetNumberOfComponents(3);
-        newNormals->Allocate(numDirs*3*numPts*numSourcePts);
-        newNormals->Delete();
+        newScalars->SetNumberOfTuples(numGlyphs*numShellPts);
+        outScalars = newScalars->GetPointer(0);
     }
 
-    // First copy all topology (transformation independent)
+    // Traverse all glyphed points in parallel, deforming and placing the shell.
 
-    for (vtkIdType inPtId=0,inPtIdReal=0;inPtId<numPts;++inPtId)
-        if (inAniso->GetComponent(inPtId,0)!=0) {
-            const vtkIdType ptIncr = numDirs*inPtIdReal*numSourcePts;
-            for (vtkIdType cellId=0;cellId<numSourceCells;++cellId) {
-                vtkCell*   cell    = GetSource()->GetCell(cellId);
-                vtkIdList* cellPts = cell->GetPointIds();
+    auto generateGlyphs = [&](vtkIdType begin,vtkIdType end) {
+        std::vector<double> sh(inScalars->GetNumberOfComponents());
+        std::vector<double> values(numShellPts);
 
-                const int npts = cellPts->GetNumberOfIds();
-                vtkIdType* pts = new vtkIdType[npts];
+        for (vtkIdType g=begin;g<end;++g) {
+            const vtkIdType inPtId = glyphIds[g];
 
-                for (int dir=0;dir<numDirs;++dir) {
-                    const vtkIdType subIncr = ptIncr+dir*numSourcePts;
-                    for (vtkIdType i=0;i<npts;++i)
-                        pts[i] = cellPts->GetId(i)+subIncr;
-                    output->InsertNextCell(cell->GetCellType(),npts,pts);
-                }
-
-                delete[] pts;
+            // Spherical function S = C B, written so that the inner loop vectorizes.
 
+            inScalars->GetTuple(inPtId,sh.data());
+            std::fill(values.begin(),values.end(),0.0);
+            for (int k=0;k<numCoeffs;++k) {
+                const double  c   = sh[k];
+                const double* row = basisData+k*numShellPts;
+                for (vtkIdType i=0;i<numShellPts;++i)
+                    values[i] += c*row[i];
             }
-            inPtIdReal++;
-        }
-
-    // Traverse all Input points, transforming glyph at Source points
-
-    vtkTransform* trans = vtkTransform::New();
-    trans->PreMultiply();
-
-    double x[4];
-    for (vtkIdType inPtId=0,inPtIdReal=0;inPtId<numPts;++inPtId) {
-        if (inPtId%10000==0) {
-            UpdateProgress (static_cast<double>(inPtId)/numPts);
-            if (GetAbortExecute())
-                break;
-        }
-
-        if (inAniso->GetComponent(inPtId,0)) {
-            const vtkIdType ptIncr = numDirs*inPtIdReal*numSourcePts;
-
-            // Get the Spherical Harmonic vector.
-            double* sh = new double[inScalars->GetNumberOfComponents()];
-            inScalars->GetTuple(inPtId,sh);
-
-            // Set harmonics and compute spherical function.
 
-            SphericalHarmonicSource->SetSphericalHarmonics(sh);
-            SphericalHarmonicSource->Update();
-
-            vtkPointData* sourcePointData = SphericalHarmonicSource->GetOutput()->GetPointData();
-            vtkPoints*    deformPts       = SphericalHarmonicSource->GetOutput()->GetPoints();
-
-            trans->SetMatrix( TMatrix);
-            input->GetPoint(inPtId,x);
-            trans->Translate(x[0],x[1],x[2]);
-            trans->Scale(ScaleFactor,ScaleFactor,ScaleFactor);
-
-            // Translate the deform pt to the correct x,y,z location
+            if (normalize) {
+                const auto   range = std::minmax_element(values.begin(),values.end());
+                const double min   = *range.first;
+                const double max   = *range.second;
+                for (vtkIdType i=0;i<numShellPts;++i)
+                    values[i] = (max!=min) ? (values[i]-min)/(max-min) : 1.0;
+            }
 
-            trans->TransformPoints(deformPts,newPts);
+            const double* x = &centers[3*g];
+            const vtkIdType ptIncr = g*numShellPts;
 
-            // This is for spherical values coloring
-            // Need to set them at the right place in the list of all points
+            for (vtkIdType i=0;i<numShellPts;++i) {
+                double p[3];
+                const double val = radius*values[i];
+                for (int j=0;j<3;++j)
+                    p[j] = (deform) ? val*shellPts[3*i+j] : shellPts[3*i+j];
 
-            for (int z=0;z<numSourcePts;++z)
-                newPointScalars->InsertTuple(ptIncr+z,sourcePointData->GetScalars()->GetTuple(z));
+                // deformed shell point, as output by the source
 
-            if (ColorGlyphs) {
+                double q[3];
+                for (int j=0;j<3;++j)
+                    q[j] = shellPose[4*j]*p[0]+shellPose[4*j+1]*p[1]+shellPose[4*j+2]*p[2]+shellPose[4*j+3]+shellCenter[j];
 
-                // Scalar color for anisotropy : one color per shell
+                // translated to x and scaled, in the image coordinate system
 
-                if (inAniso && ColorMode==COLOR_BY_SCALARS) {
-                    const double s = inAniso->GetComponent(inPtId,0);
-                    for (vtkIdType i=0;i<numSourcePts;++i)
-                        newScalars->InsertTuple(ptIncr+i,&s);
-                }
+                double r[3];
+                for (int j=0;j<3;++j)
+                    r[j] = x[j]+ScaleFactor*q[j];
 
-                // RGB color : color at every point of the spherical function
+                float* out = outPts+3*(ptIncr+i);
+                for (int j=0;j<3;++j)
+                    out[j] = static_cast<float>(glyphPose[4*j]*r[0]+glyphPose[4*j+1]*r[1]+glyphPose[4*j+2]*r[2]+glyphPose[4*j+3]);
 
-                if (ColorMode==COLOR_BY_DIRECTIONS) {
-                    for (vtkIdType i=0;i<numSourcePts;++i) {
-                        double s,vect[3];
-                        SphericalHarmonicSource->GetOutput()->GetPoints()->GetPoint(i,vect);
-                        RGBToIndex(fabs(vect[0]),fabs(vect[1]),fabs(vect[2]),s);
-                        newScalars->InsertTuple(ptIncr+i,&s);
-                    }
+                if (outScalars) {
+                    double s;
+                    if (ColorMode==COLOR_BY_SCALARS)
+                        s = inAniso->GetComponent(inPtId,0);
+                    else
+                        RGBToIndex(fabs(q[0]),fabs(q[1]),fabs(q[2]),s);
+                    outScalars[ptIncr+i] = static_cast<float>(s);
                 }
             }
+        }
+    };
+    vtkSMPTools::For(0,numGlyphs,generateGlyphs);
 
-            inPtIdReal++;
+    // Setting up the topology (transformation independent)
 
-            delete[] sh;
-        }
+    vtkPolyData* output = vtkPolyData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+    vtkCellArray* shellCells;
+    if ((shellCells=shell->GetVerts())->GetNumberOfCells()>0) {
+        vtkCellArray* cells = vtkCellArray::New();
+        ReplicateShellCells(shellCells,cells,numGlyphs,numShellPts);
+        output->SetVerts(cells);
+        cells->Delete();
+    }
+    if ((shellCells=shell->GetLines())->GetNumberOfCells()>0) {
+        vtkCellArray* cells = vtkCellArray::New();
+        ReplicateShellCells(shellCells,cells,numGlyphs,numShellPts);
+        output->SetLines(cells);
+        cells->Delete();
+    }
+    if ((shellCells=shell->GetPolys())->GetNumberOfCells()>0) {
+        vtkCellArray* cells = vtkCellArray::New();
+        ReplicateShellCells(shellCells,cells,numGlyphs,numShellPts);
+        output->SetPolys(cells);
+        cells->Delete();
+    }
+    if ((shellCells=shell->GetStrips())->GetNumberOfCells()>0) {
+        vtkCellArray* cells = vtkCellArray::New();
+        ReplicateShellCells(shellCells,cells,numGlyphs,numShellPts);
+        output->SetStrips(cells);
+        cells->Delete();
     }
+
     output->SetPoints(newPts);
+    newPts->Delete();
 
     // Assigning color to PointData
 
     if (newScalars) {
+        vtkPointData* outPD = output->GetPointData();
         newScalars->SetName((ColorMode==COLOR_BY_SCALARS) ? GetAnisotropyMeasureArrayName() : GetRGBArrayName());
         const int idx = outPD->AddArray(newScalars);
         outPD->SetActiveAttribute(idx,vtkDataSetAttributes::SCALARS);
         newScalars->Delete();
     }
 
-    // Assigning spherical values
-
-    if (newPointScalars) {
-        newPointScalars->SetName(GetSphericalHarmonicValuesArrayName());
-        newPointScalars->Delete();
-    }
-
-    newPts->Delete();
-    newPointData->Delete();
-    trans->Delete();
-
     return 1;
 }
 
@@ -150,6 +150,17 @@ public:
 
     void UpdateSphericalHarmonicSource();
 
+    /** Get the tesselated unit sphere the spherical function is sampled on*/
+
+    vtkPolyData* GetShell() { return sphereT->GetOutput(); }
+
+    /** Get the basis function evaluated on the shell: one row per spherical
+      * harmonic, one column per shell point. It is only recomputed by
+      * UpdateSphericalHarmonicSource, i.e. when the resolution, the order,
+      * the basis or the flips change*/
+
+    const itk::VariableSizeMatrix<double>& GetBasisFunction() const { return BasisFunction; }
+
     //     /** Function constructing the Spherical Harmonic function with the given
     //      *  directions text file.  At this point, the number of directions needs
     //      *  to match the Tesselation. i.e. Tesselation = 3 -> 81 directions
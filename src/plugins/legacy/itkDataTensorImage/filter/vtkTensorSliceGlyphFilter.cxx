@@ -0,0 +1,592 @@
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include "vtkTensorSliceGlyphFilter.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkSmartPointer.h>
+#include <vtkSMPTools.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace
+{
+// Per sample: the three eigenvalues (decreasing), then the eigenvector
+// matrix row by row, eigenvectors being its columns (as vtkMath::Jacobi).
+const int EigenStride = 12;
+
+struct SliceEigenCache
+{
+    std::vector<vtkIdType> ids;
+    std::vector<double> eigen;
+    unsigned long lastUse;
+};
+
+// Connectivity of one cell array of the glyph shape, in the legacy
+// (count, ids...) layout, with the entries that are point ids flagged.
+struct CellTemplate
+{
+    vtkIdType numberOfCells;
+    std::vector<vtkIdType> values;
+    std::vector<char> isPointId;
+};
+
+CellTemplate makeCellTemplate(vtkCellArray *cells)
+{
+    CellTemplate cellTemplate;
+    cellTemplate.numberOfCells = cells->GetNumberOfCells();
+
+    vtkIdType npts;
+    vtkIdType *pts;
+    cells->InitTraversal();
+    while (cells->GetNextCell(npts, pts))
+    {
+        cellTemplate.values.push_back(npts);
+        cellTemplate.isPointId.push_back(0);
+        for (vtkIdType i = 0; i < npts; ++i)
+        {
+            cellTemplate.values.push_back(pts[i]);
+            cellTemplate.isPointId.push_back(1);
+        }
+    }
+    return cellTemplate;
+}
+
+vtkSmartPointer<vtkCellArray> replicateCells(const CellTemplate &cellTemplate,
+                                             vtkIdType numberOfGlyphs, vtkIdType pointsPerGlyph)
+{
+    const vtkIdType size = static_cast<vtkIdType>(cellTemplate.values.size());
+
+    vtkNew<vtkIdTypeArray> connectivity;
+    connectivity->SetNumberOfValues(numberOfGlyphs * size);
+    vtkIdType *out = connectivity->GetPointer(0);
+
+    auto fillGlyphCells = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType g = begin; g < end; ++g)
+        {
+            vtkIdType *glyphOut = out + g * size;
+            const vtkIdType offset = g * pointsPerGlyph;
+            for (vtkIdType i = 0; i < size; ++i)
+            {
+                glyphOut[i] = cellTemplate.values[i] + (cellTemplate.isPointId[i] ? offset : 0);
+            }
+        }
+    };
+    vtkSMPTools::For(0, numberOfGlyphs, fillGlyphCells);
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->SetCells(numberOfGlyphs * cellTemplate.numberOfCells, connectivity.GetPointer());
+    return cells;
+}
+} // namespace
+
+class vtkTensorSliceGlyphFilter::vtkInternals
+{
+public:
+    // key: clamped VOI then sample rate
+    std::map<std::array<int, 9>, SliceEigenCache> slices;
+    vtkDataArray *tensors = nullptr;
+    vtkMTimeType inputTime = 0;
+    unsigned long useCounter = 0;
+};
+
+vtkStandardNewMacro (vtkTensorSliceGlyphFilter)
+
+vtkTensorSliceGlyphFilter::vtkTensorSliceGlyphFilter()
+{
+  this->SetNumberOfInputPorts(2);
+
+  this->Internals = new vtkInternals;
+
+  for (int i = 0; i < 3; i++)
+  {
+    this->VOI[2*i]   = 0;
+    this->VOI[2*i+1] = VTK_INT_MAX;
+    this->SampleRate[i] = 1;
+  }
+
+  this->FlipX = false;
+  this->FlipY = false;
+  this->FlipZ = false;
+
+  this->ScaleFactor = 1.0;
+  this->MaxScaleFactor = 100.0;
+  this->ClampScaling = false;
+
+  this->ColorMode = COLOR_BY_EIGENVECTOR;
+  this->EigenNumber = 2;
+  for (int i = 0; i < 9; i++)
+  {
+    this->ColorMatrix[i] = (i % 4 == 0) ? 1.0 : 0.0;
+  }
+
+  this->Scalars = nullptr;
+
+  this->MaximumNumberOfCachedSlices = 16;
+}
+
+vtkTensorSliceGlyphFilter::~vtkTensorSliceGlyphFilter()
+{
+  this->SetScalars(nullptr);
+  delete this->Internals;
+}
+
+vtkCxxSetObjectMacro (vtkTensorSliceGlyphFilter, Scalars, vtkDataArray)
+
+void vtkTensorSliceGlyphFilter::SetColorMatrix (vtkMatrix4x4* matrix)
+{
+  if( !matrix )
+  {
+    return;
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      this->ColorMatrix[i*3+j] = matrix->GetElement(i, j);
+    }
+  }
+  this->Modified();
+}
+
+void vtkTensorSliceGlyphFilter::ClearCache()
+{
+  this->Internals->slices.clear();
+  this->Internals->tensors = nullptr;
+  this->Internals->inputTime = 0;
+}
+
+int vtkTensorSliceGlyphFilter::FillInputPortInformation (int port, vtkInformation *info)
+{
+  if( port == 0 )
+  {
+    info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+  }
+  else
+  {
+    info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkPolyData");
+  }
+  return 1;
+}
+
+int vtkTensorSliceGlyphFilter::RequestData(vtkInformation *vtkNotUsed(request),
+                                           vtkInformationVector **inputVector,
+                                           vtkInformationVector *outputVector)
+{
+  vtkImageData *input  = vtkImageData::GetData(inputVector[0]);
+  vtkPolyData  *source = vtkPolyData::GetData(inputVector[1]);
+  vtkPolyData  *output = vtkPolyData::GetData(outputVector);
+
+  output->Initialize();
+
+  vtkDataArray *tensors = input ? input->GetPointData()->GetTensors() : nullptr;
+  if ( !tensors || tensors->GetNumberOfComponents() != 9 )
+  {
+    vtkErrorMacro(<<"No tensors to glyph!");
+    return 1;
+  }
+  if ( !source || !source->GetPoints() || source->GetNumberOfPoints() == 0 )
+  {
+    return 1;
+  }
+
+  // a new or modified volume invalidates every cached slice
+  vtkMTimeType inputTime = std::max(input->GetMTime(), tensors->GetMTime());
+  if ( tensors != this->Internals->tensors || inputTime != this->Internals->inputTime )
+  {
+    this->Internals->slices.clear();
+    this->Internals->tensors = tensors;
+    this->Internals->inputTime = inputTime;
+  }
+
+  // clamp the VOI to the image, as vtkExtractVOI does
+  int extent[6];
+  input->GetExtent(extent);
+
+  std::array<int, 9> key;
+  for (int i = 0; i < 3; i++)
+  {
+    key[2*i]   = std::max(this->VOI[2*i],   extent[2*i]);
+    key[2*i+1] = std::min(this->VOI[2*i+1], extent[2*i+1]);
+    key[6+i]   = std::max(this->SampleRate[i], 1);
+
+    if ( key[2*i] > key[2*i+1] )
+    {
+      return 1;
+    }
+  }
+
+  // fetch or compute the eigen-decompositions of the slice
+  auto found = this->Internals->slices.find(key);
+  if ( found == this->Internals->slices.end() )
+  {
+    std::vector<vtkIdType> candidates;
+    for (int k = key[4]; k <= key[5]; k += key[8])
+    {
+      for (int j = key[2]; j <= key[3]; j += key[7])
+      {
+        for (int i = key[0]; i <= key[1]; i += key[6])
+        {
+          int ijk[3] = {i, j, k};
+          candidates.push_back(input->ComputePointId(ijk));
+        }
+      }
+    }
+
+    const vtkIdType numberOfCandidates = static_cast<vtkIdType>(candidates.size());
+    std::vector<double> eigen(numberOfCandidates * EigenStride);
+    std::vector<char> empty(numberOfCandidates, 0);
+
+    auto decompose = [&](vtkIdType begin, vtkIdType end)
+    {
+      double tensor[9];
+      double m0[3], m1[3], m2[3], v0[3], v1[3], v2[3];
+      double *m[3] = {m0, m1, m2};
+      double *v[3] = {v0, v1, v2};
+
+      for (vtkIdType n = begin; n < end; ++n)
+      {
+        tensors->GetTuple(candidates[n], tensor);
+
+        bool isNull = true;
+        for (int c = 0; c < 9 && isNull; c++)
+        {
+          isNull = (tensor[c] == 0.0);
+        }
+        if ( isNull )
+        {
+          empty[n] = 1;
+          continue;
+        }
+
+        // symmetric part only, as vtkTensorGlyph
+        for (int r = 0; r < 3; r++)
+        {
+          for (int c = 0; c < 3; c++)
+          {
+            m[r][c] = 0.5 * (tensor[r+3*c] + tensor[c+3*r]);
+          }
+        }
+
+        double *out = &eigen[n * EigenStride];
+        vtkMath::Jacobi(m, out, v);
+        for (int r = 0; r < 3; r++)
+        {
+          for (int c = 0; c < 3; c++)
+          {
+            out[3 + r*3 + c] = v[r][c];
+          }
+        }
+      }
+    };
+    vtkSMPTools::For(0, numberOfCandidates, decompose);
+
+    // null tensors (background) would only produce degenerate glyphs
+    SliceEigenCache slice;
+    for (vtkIdType n = 0; n < numberOfCandidates; ++n)
+    {
+      if ( !empty[n] )
+      {
+        slice.ids.push_back(candidates[n]);
+        slice.eigen.insert(slice.eigen.end(),
+                           eigen.begin() + n * EigenStride, eigen.begin() + (n + 1) * EigenStride);
+      }
+    }
+
+    found = this->Internals->slices.emplace(key, std::move(slice)).first;
+  }
+  found->second.lastUse = ++this->Internals->useCounter;
+
+  // evict the least recently used slices
+  const size_t maxSlices = static_cast<size_t>(std::max(this->MaximumNumberOfCachedSlices, 1));
+  while ( this->Internals->slices.size() > maxSlices )
+  {
+    auto oldest = this->Internals->slices.begin();
+    for (auto it = this->Internals->slices.begin(); it != this->Internals->slices.end(); ++it)
+    {
+      if ( it->second.lastUse < oldest->second.lastUse )
+      {
+        oldest = it;
+      }
+    }
+    this->Internals->slices.erase(oldest);
+  }
+
+  const SliceEigenCache &slice = found->second;
+  const vtkIdType numberOfGlyphs = static_cast<vtkIdType>(slice.ids.size());
+  if ( numberOfGlyphs == 0 )
+  {
+    return 1;
+  }
+
+  // the shape is small: give it normals once rather than the whole output
+  vtkSmartPointer<vtkPolyData> shape = source;
+  if ( !source->GetPointData()->GetNormals() && (source->GetNumberOfPolys() || source->GetNumberOfStrips()) )
+  {
+    vtkNew<vtkPolyDataNormals> shapeNormals;
+    shapeNormals->SetInputData(source);
+    shapeNormals->Update();
+    shape = shapeNormals->GetOutput();
+  }
+
+  const vtkIdType pointsPerGlyph = shape->GetNumberOfPoints();
+  std::vector<double> shapePoints(pointsPerGlyph * 3);
+  for (vtkIdType s = 0; s < pointsPerGlyph; ++s)
+  {
+    shape->GetPoint(s, &shapePoints[s * 3]);
+  }
+
+  vtkDataArray *shapeNormalArray = shape->GetPointData()->GetNormals();
+  std::vector<double> shapeNormals;
+  if ( shapeNormalArray )
+  {
+    shapeNormals.resize(pointsPerGlyph * 3);
+    for (vtkIdType s = 0; s < pointsPerGlyph; ++s)
+    {
+      shapeNormalArray->GetTuple(s, &shapeNormals[s * 3]);
+    }
+  }
+
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToFloat();
+  points->SetNumberOfPoints(numberOfGlyphs * pointsPerGlyph);
+  float *outPoints = vtkFloatArray::SafeDownCast(points->GetData())->GetPointer(0);
+
+  vtkNew<vtkFloatArray> normals;
+  float *outNormals = nullptr;
+  if ( shapeNormalArray )
+  {
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(numberOfGlyphs * pointsPerGlyph);
+    outNormals = normals->GetPointer(0);
+  }
+
+  vtkDataArray *scalars = this->Scalars;
+  if ( scalars && scalars->GetNumberOfTuples() != input->GetNumberOfPoints() )
+  {
+    scalars = nullptr;
+  }
+  const bool byEigenvector = (this->ColorMode == COLOR_BY_EIGENVECTOR);
+  const bool hasColors = (this->ColorMode != COLOR_BY_SCALAR || scalars);
+
+  vtkNew<vtkUnsignedCharArray> rgb;
+  vtkNew<vtkDoubleArray> values;
+  unsigned char *outRGB = nullptr;
+  double *outValues = nullptr;
+  if ( hasColors && byEigenvector )
+  {
+    rgb->SetName("TensorColors");
+    rgb->SetNumberOfComponents(3);
+    rgb->SetNumberOfTuples(numberOfGlyphs * pointsPerGlyph);
+    outRGB = rgb->GetPointer(0);
+  }
+  else if ( hasColors )
+  {
+    values->SetName("TensorColors");
+    values->SetNumberOfTuples(numberOfGlyphs * pointsPerGlyph);
+    outValues = values->GetPointer(0);
+  }
+
+  double origin[3], spacing[3];
+  input->GetOrigin(origin);
+  input->GetSpacing(spacing);
+  const vtkIdType dimX = extent[1] - extent[0] + 1;
+  const vtkIdType dimXY = dimX * (extent[3] - extent[2] + 1);
+
+  const double flip[3] = {this->FlipX ? -1.0 : 1.0, this->FlipY ? -1.0 : 1.0, this->FlipZ ? -1.0 : 1.0};
+  const int eigenIndex = 2 - this->EigenNumber;
+
+  auto generateGlyphs = [&](vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType g = begin; g < end; ++g)
+    {
+      const vtkIdType id = slice.ids[g];
+      const double *e = &slice.eigen[g * EigenStride];
+
+      const vtkIdType ijk[3] = {id % dimX, (id / dimX) % (dimXY / dimX), id / dimXY};
+      double center[3];
+      for (int i = 0; i < 3; i++)
+      {
+        center[i] = origin[i] + spacing[i] * (ijk[i] + extent[2*i]);
+      }
+
+      // flipping the tensor along an axis flips that coordinate of its eigenvectors
+      double R[3][3];
+      for (int r = 0; r < 3; r++)
+      {
+        for (int c = 0; c < 3; c++)
+        {
+          R[r][c] = flip[r] * e[3 + r*3 + c];
+        }
+      }
+
+      // scaling, as vtkTensorGlyph with extracted eigenvalues
+      double w[3] = {e[0] * this->ScaleFactor, e[1] * this->ScaleFactor, e[2] * this->ScaleFactor};
+      if ( this->ClampScaling )
+      {
+        double maxScale = std::max({std::fabs(w[0]), std::fabs(w[1]), std::fabs(w[2])});
+        if ( maxScale > this->MaxScaleFactor )
+        {
+          for (int i = 0; i < 3; i++)
+          {
+            w[i] *= this->MaxScaleFactor / maxScale;
+          }
+        }
+      }
+      double maxScale = std::max({w[0], w[1], w[2], 0.0});
+      if ( maxScale == 0.0 )
+      {
+        maxScale = 1.0;
+      }
+      for (int i = 0; i < 3; i++)
+      {
+        if ( w[i] == 0.0 )
+        {
+          w[i] = maxScale * 1.0e-06;
+        }
+      }
+
+      const vtkIdType firstPoint = g * pointsPerGlyph;
+      for (vtkIdType s = 0; s < pointsPerGlyph; ++s)
+      {
+        const double *p = &shapePoints[s * 3];
+        float *q = outPoints + (firstPoint + s) * 3;
+        for (int r = 0; r < 3; r++)
+        {
+          q[r] = static_cast<float>(center[r] + R[r][0]*w[0]*p[0] + R[r][1]*w[1]*p[1] + R[r][2]*w[2]*p[2]);
+        }
+
+        if ( outNormals )
+        {
+          // normals transform with the inverse transpose
+          const double *n = &shapeNormals[s * 3];
+          double tn[3];
+          for (int r = 0; r < 3; r++)
+          {
+            tn[r] = R[r][0]*n[0]/w[0] + R[r][1]*n[1]/w[1] + R[r][2]*n[2]/w[2];
+          }
+          vtkMath::Normalize(tn);
+          float *qn = outNormals + (firstPoint + s) * 3;
+          qn[0] = static_cast<float>(tn[0]);
+          qn[1] = static_cast<float>(tn[1]);
+          qn[2] = static_cast<float>(tn[2]);
+        }
+      }
+
+      if ( outRGB )
+      {
+        unsigned char color[3];
+        for (int j = 0; j < 3; j++)
+        {
+          double c = 0.0;
+          for (int k = 0; k < 3; k++)
+          {
+            c += R[k][eigenIndex] * this->ColorMatrix[j*3+k];
+          }
+          color[j] = static_cast<unsigned char>(std::min(std::fabs(c), 1.0) * 255.0);
+        }
+        for (vtkIdType s = 0; s < pointsPerGlyph; ++s)
+        {
+          std::copy(color, color + 3, outRGB + (firstPoint + s) * 3);
+        }
+      }
+      else if ( outValues )
+      {
+        double value = 0.0;
+        switch(this->ColorMode)
+        {
+          case COLOR_BY_EIGENVALUE:
+            value = e[eigenIndex];
+            break;
+
+          case COLOR_BY_VOLUME:
+            value = e[0] * e[1] * e[2];
+            break;
+
+          case COLOR_BY_TRACE:
+            value = std::sqrt(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]);
+            break;
+
+          case COLOR_BY_DISTANCE_TO_IDENTITY:
+            value = std::sqrt(1.0 + std::log(e[0])*std::log(e[0]) + std::log(e[1])*std::log(e[1]) + std::log(e[2])*std::log(e[2]));
+            break;
+
+          case COLOR_BY_SCALAR:
+            value = scalars->GetComponent(id, 0);
+            break;
+
+          default:
+            break;
+        }
+        std::fill(outValues + firstPoint, outValues + firstPoint + pointsPerGlyph, value);
+      }
+    }
+  };
+  vtkSMPTools::For(0, numberOfGlyphs, generateGlyphs);
+
+  output->SetPoints(points.GetPointer());
+  if ( outNormals )
+  {
+    output->GetPointData()->SetNormals(normals.GetPointer());
+  }
+  if ( outRGB )
+  {
+    output->GetPointData()->SetScalars(rgb.GetPointer());
+  }
+  else if ( outValues )
+  {
+    output->GetPointData()->SetScalars(values.GetPointer());
+  }
+
+  if ( shape->GetNumberOfVerts() )
+  {
+    output->SetVerts(replicateCells(makeCellTemplate(shape->GetVerts()), numberOfGlyphs, pointsPerGlyph));
+  }
+  if ( shape->GetNumberOfLines() )
+  {
+    output->SetLines(replicateCells(makeCellTemplate(shape->GetLines()), numberOfGlyphs, pointsPerGlyph));
+  }
+  if ( shape->GetNumberOfPolys() )
+  {
+    output->SetPolys(replicateCells(makeCellTemplate(shape->GetPolys()), numberOfGlyphs, pointsPerGlyph));
+  }
+  if ( shape->GetNumberOfStrips() )
+  {
+    output->SetStrips(replicateCells(makeCellTemplate(shape->GetStrips()), numberOfGlyphs, pointsPerGlyph));
+  }
+
+  return 1;
+}
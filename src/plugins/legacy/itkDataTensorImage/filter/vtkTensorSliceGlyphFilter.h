@@ -0,0 +1,129 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2020. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <vtkPolyDataAlgorithm.h>
+
+class vtkDataArray;
+class vtkMatrix4x4;
+
+/**
+ * Glyphs the tensors of a single slice (VOI) of a tensor image.
+ *
+ * The tensors of the VOI are read directly from the input array, so the
+ * volume is never copied. Their eigen-decompositions are kept in a small
+ * per-slice cache, so that browsing back and forth between slices does not
+ * recompute them. Flips are applied to the cached eigenvectors, and the
+ * glyph geometry and colors are generated in parallel with vtkSMPTools.
+ *
+ * Input port 0 is the tensor image, input port 1 the glyph shape.
+ */
+class vtkTensorSliceGlyphFilter : public vtkPolyDataAlgorithm
+{
+ public:
+  static vtkTensorSliceGlyphFilter *New();
+  vtkTypeMacro (vtkTensorSliceGlyphFilter, vtkPolyDataAlgorithm);
+  void PrintSelf (ostream &os, vtkIndent indent) {}
+
+  /** Color codes, in the same order as vtkTensorVisuManager. */
+  enum
+  {
+    COLOR_BY_EIGENVECTOR,
+    COLOR_BY_EIGENVALUE,
+    COLOR_BY_VOLUME,
+    COLOR_BY_TRACE,
+    COLOR_BY_DISTANCE_TO_IDENTITY,
+    COLOR_BY_SCALAR
+  };
+
+  /** Set the glyph shape. */
+  void SetSourceConnection (vtkAlgorithmOutput* output)
+  { this->SetInputConnection (1, output); }
+
+  /** Set the Volume Of Interest: xmin, xmax, ymin, ymax, zmin, zmax. */
+  vtkSetVector6Macro (VOI, int);
+  vtkGetVector6Macro (VOI, int);
+
+  /** Set the sample rate. 1 over n tensors will be displayed. */
+  vtkSetVector3Macro (SampleRate, int);
+  vtkGetVector3Macro (SampleRate, int);
+
+  vtkSetMacro (FlipX, bool);
+  vtkGetMacro (FlipX, bool);
+  vtkSetMacro (FlipY, bool);
+  vtkGetMacro (FlipY, bool);
+  vtkSetMacro (FlipZ, bool);
+  vtkGetMacro (FlipZ, bool);
+
+  /** Same meaning as in vtkTensorGlyph. */
+  vtkSetMacro (ScaleFactor, double);
+  vtkGetMacro (ScaleFactor, double);
+  vtkSetMacro (MaxScaleFactor, double);
+  vtkGetMacro (MaxScaleFactor, double);
+  vtkSetMacro (ClampScaling, bool);
+  vtkBooleanMacro (ClampScaling, bool);
+  vtkGetMacro (ClampScaling, bool);
+
+  /** Set the colormode and the eigen element it uses, if any. */
+  vtkSetMacro (ColorMode, int);
+  vtkGetMacro (ColorMode, int);
+  vtkSetClampMacro (EigenNumber, int, 0, 2);
+  vtkGetMacro (EigenNumber, int);
+
+  /** Scalars mapped in COLOR_BY_SCALAR mode, indexed like the input points. */
+  void SetScalars (vtkDataArray* scalars);
+  vtkGetObjectMacro (Scalars, vtkDataArray);
+
+  /** Orientation used to color by eigenvector (the actor's user matrix). */
+  void SetColorMatrix (vtkMatrix4x4* matrix);
+
+  /** Maximum number of slices whose eigen-decompositions are kept. */
+  vtkSetMacro (MaximumNumberOfCachedSlices, int);
+  vtkGetMacro (MaximumNumberOfCachedSlices, int);
+
+  /** Drop all cached eigen-decompositions. */
+  void ClearCache();
+
+ protected:
+  vtkTensorSliceGlyphFilter();
+  ~vtkTensorSliceGlyphFilter();
+
+  virtual int FillInputPortInformation (int port, vtkInformation *info);
+  virtual int RequestData(vtkInformation *request,  vtkInformationVector **inputVector, vtkInformationVector *outputVector);
+
+ private:
+  vtkTensorSliceGlyphFilter (const vtkTensorSliceGlyphFilter&);
+  void operator=(const vtkTensorSliceGlyphFilter&);
+
+  class vtkInternals;
+  vtkInternals* Internals;
+
+  int VOI[6];
+  int SampleRate[3];
+
+  bool FlipX;
+  bool FlipY;
+  bool FlipZ;
+
+  double ScaleFactor;
+  double MaxScaleFactor;
+  bool   ClampScaling;
+
+  int ColorMode;
+  int EigenNumber;
+  double ColorMatrix[9];
+
+  vtkDataArray* Scalars;
+
+  int MaximumNumberOfCachedSlices;
+};
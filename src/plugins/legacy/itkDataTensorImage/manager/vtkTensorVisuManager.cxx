@@ -29,19 +29,20 @@
 
 #include "vtkLookupTableManager.h"
 
+#include <algorithm>
+
 vtkStandardNewMacro(vtkTensorVisuManager)
 
 vtkTensorVisuManager::vtkTensorVisuManager()
 {
 
-    this->Fliper = vtkFlipTensorImageFilter::New();
-
-    this->VOI = vtkExtractVOI::New();
-    this->VOI->SetSampleRate(1,1,1);
-    this->VOI->SetInputConnection ( this->Fliper->GetOutputPort() );
+    this->SliceGlyph = vtkTensorSliceGlyphFilter::New();
+    this->SliceGlyph->SetSampleRate(1,1,1);
+    this->SliceGlyph->SetScaleFactor(1000.0);
+    this->SliceGlyph->ClampScalingOn();
 
+    // sparse tensors only
     this->Glyph = vtkTensorGlyph::New();
-    this->Glyph->SetInputConnection( this->VOI->GetOutputPort() );
     this->Glyph->SetScaleFactor(1000.0);
     this->Glyph->ClampScalingOn();
     this->Glyph->ColorGlyphsOn();
@@ -53,7 +54,7 @@ vtkTensorVisuManager::vtkTensorVisuManager()
 
     this->Mapper = vtkPolyDataMapper::New();
     this->Mapper->SetColorModeToMapScalars();
-    this->Mapper->SetInputConnection( this->Normals->GetOutputPort() );
+    this->Mapper->SetInputConnection( this->SliceGlyph->GetOutputPort() );
 
     this->Actor = vtkActor::New();
     this->Actor->SetMapper( this->Mapper );
@@ -67,6 +68,10 @@ vtkTensorVisuManager::vtkTensorVisuManager()
     this->DistanceArray = vtkDoubleArray::New();
 
     this->Input = nullptr;
+    this->SparseInput = false;
+    this->VolumeRange[0] = 0.0;
+    this->VolumeRange[1] = 1.0;
+    this->VolumeRangeTime = 0;
 
     this->ColorMode = COLOR_BY_EIGENVECTOR;
     this->EigenNumber = 2; // biggest eigen element
@@ -81,8 +86,7 @@ vtkTensorVisuManager::vtkTensorVisuManager()
 
 vtkTensorVisuManager::~vtkTensorVisuManager()
 {
-    this->Fliper->Delete();
-    this->VOI->Delete();
+    this->SliceGlyph->Delete();
     this->Glyph->Delete();
     this->Normals->Delete();
     this->Mapper->Delete();
@@ -149,6 +153,7 @@ void vtkTensorVisuManager::SetGlyphShapeToLine()
     this->ShapeMode = GLYPH_LINE;
     this->Shape = vtkLineSource::New();
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -159,6 +164,7 @@ void vtkTensorVisuManager::SetGlyphShapeToDisk()
     source->SetInnerRadius (0.0);
     this->Shape = source;
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -172,6 +178,7 @@ void vtkTensorVisuManager::SetGlyphShapeToArrow()
     arrow->SetShaftRadius (0.18);
 
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -180,6 +187,7 @@ void vtkTensorVisuManager::SetGlyphShapeToCube()
     this->ShapeMode = GLYPH_CUBE;
     this->Shape = vtkCubeSource::New();
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -188,6 +196,7 @@ void vtkTensorVisuManager::SetGlyphShapeToCylinder()
     this->ShapeMode = GLYPH_CYLINDER;
     this->Shape = vtkCylinderSource::New();
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -196,6 +205,7 @@ void vtkTensorVisuManager::SetGlyphShapeToSphere()
     this->ShapeMode = GLYPH_SPHERE;
     this->Shape = vtkSphereSource::New();
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -206,6 +216,7 @@ void vtkTensorVisuManager::SetGlyphShapeToSuperquadric()
     vtkSuperquadricSource::SafeDownCast (this->Shape)->SetPhiRoundness (0.25);
     vtkSuperquadricSource::SafeDownCast (this->Shape)->SetThetaRoundness (0.25);
     this->Glyph->SetSourceConnection(this->Shape->GetOutputPort());
+    this->SliceGlyph->SetSourceConnection(this->Shape->GetOutputPort());
     this->Shape->Delete();
 }
 
@@ -280,6 +291,7 @@ void vtkTensorVisuManager::SetGlyphScale(const float& f)
     }
 
     this->Glyph->SetScaleFactor(f);
+    this->SliceGlyph->SetScaleFactor(f);
 }
 
 double vtkTensorVisuManager::GetGlyphScale()
@@ -296,6 +308,7 @@ void vtkTensorVisuManager::SetMaxGlyphSize(const float& f)
     }
 
     this->Glyph->SetMaxScaleFactor(f);
+    this->SliceGlyph->SetMaxScaleFactor(f);
 }
 
 void vtkTensorVisuManager::SetInput(vtkStructuredPoints* data, vtkMatrix4x4 *matrix)
@@ -312,6 +325,7 @@ void vtkTensorVisuManager::SetInput(vtkStructuredPoints* data, vtkMatrix4x4 *mat
     }
 
     this->Input = data;
+    this->SparseInput = false;
 
     if( this->Input->GetPointData()->GetScalars() )
     {
@@ -325,10 +339,12 @@ void vtkTensorVisuManager::SetInput(vtkStructuredPoints* data, vtkMatrix4x4 *mat
     if (matrix)
     {
         this->Actor->SetUserMatrix(matrix);
+        this->SliceGlyph->SetColorMatrix(matrix);
     }
 
-    this->Fliper->SetInputData ( this->Input );
-    this->Fliper->Update();
+    // glyphs are only generated for the VOI, when the mapper asks for them
+    this->SliceGlyph->SetInputData ( data );
+    this->Mapper->SetInputConnection( this->SliceGlyph->GetOutputPort() );
 
     this->UpdateLUT();
 }
@@ -347,6 +363,7 @@ void vtkTensorVisuManager::SetInput(vtkUnstructuredGrid* data, vtkMatrix4x4 *mat
     }
 
     this->Input = data;
+    this->SparseInput = true;
 
     if( this->Input->GetPointData()->GetScalars() )
     {
@@ -364,6 +381,7 @@ void vtkTensorVisuManager::SetInput(vtkUnstructuredGrid* data, vtkMatrix4x4 *mat
 
     this->Glyph->SetInputData( data );
     this->Glyph->Update();
+    this->Mapper->SetInputConnection( this->Normals->GetOutputPort() );
     this->UpdateLUT();
 }
 
@@ -371,12 +389,12 @@ void vtkTensorVisuManager::SetVOI(const int& imin, const int& imax,
                                   const int& jmin, const int& jmax,
                                   const int& kmin, const int& kmax)
 {
-    this->VOI->SetVOI(imin,imax,jmin,jmax,kmin,kmax);
+    this->SliceGlyph->SetVOI(imin,imax,jmin,jmax,kmin,kmax);
 }
 
 void vtkTensorVisuManager::SetSampleRate(const int& a, const int& b, const int& c)
 {
-    this->VOI->SetSampleRate(a,b,c);
+    this->SliceGlyph->SetSampleRate(a,b,c);
 }
 
 void vtkTensorVisuManager::SetColorModeToEigenvector( const int& i )
@@ -433,6 +451,11 @@ void vtkTensorVisuManager::UpdateLUT()
         return;
     }
 
+    // image inputs are colored slice by slice, while glyphing
+    this->SliceGlyph->SetColorMode(this->ColorMode);
+    this->SliceGlyph->SetEigenNumber(this->EigenNumber);
+    this->SliceGlyph->SetScalars(this->Scalars);
+
     switch(this->ColorMode)
     {
         case COLOR_BY_EIGENVECTOR:
@@ -467,6 +490,13 @@ void vtkTensorVisuManager::UpdateLUT()
 
 void vtkTensorVisuManager::SetUpLUTToMapEigenVector()
 {
+    // image inputs get their colors directly from the slice glyph filter
+    if( !this->SparseInput )
+    {
+        this->Mapper->SetColorModeToDefault();
+        return;
+    }
+
     vtkDataSet* myData = this->GetInput();
 
     int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
@@ -551,63 +581,67 @@ void vtkTensorVisuManager::SetUpLUTToMapEigenVector()
 
 void vtkTensorVisuManager::SetUpLUTToMapEigenValue()
 {
-    vtkDataSet* myData = this->GetInput();
+    // image inputs are colored by the slice glyph filter
+    if( this->SparseInput )
+    {
+        vtkDataSet* myData = this->GetInput();
 
-    int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
+        int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
 
-    this->EigenvalueArray->Initialize();
-    this->EigenvalueArray->SetNumberOfComponents(1);
-    this->EigenvalueArray->SetNumberOfTuples(numPoints);
+        this->EigenvalueArray->Initialize();
+        this->EigenvalueArray->SetNumberOfComponents(1);
+        this->EigenvalueArray->SetNumberOfTuples(numPoints);
 
-    double coefs[9];
-    double **a;
-    a = new double*[3];
-    double *w = new double[3];
-    double **v;
-    v = new double*[3];
+        double coefs[9];
+        double **a;
+        a = new double*[3];
+        double *w = new double[3];
+        double **v;
+        v = new double*[3];
     
-    for( unsigned int j=0; j<3; j++)
-    {
-        a[j] = new double[3];
-        v[j] = new double[3];
-    }
-
-    for(int i=0;i<numPoints;i++)
-    {
-        // Color coding with the eigenvalue
-        myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+        for( unsigned int j=0; j<3; j++)
+        {
+            a[j] = new double[3];
+            v[j] = new double[3];
+        }
 
-        for( int nl=0; nl<3; nl++)
+        for(int i=0;i<numPoints;i++)
         {
-            for( int nc=0; nc<3; nc++)
+            // Color coding with the eigenvalue
+            myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+
+            for( int nl=0; nl<3; nl++)
             {
-                a[nl][nc] = coefs[nl*3+nc];
+                for( int nc=0; nc<3; nc++)
+                {
+                    a[nl][nc] = coefs[nl*3+nc];
+                }
             }
-        }
 
-        vtkMath::Jacobi (a, w, v);
+            vtkMath::Jacobi (a, w, v);
 
-        double val = w[2-this->EigenNumber];
+            double val = w[2-this->EigenNumber];
 
-        this->EigenvalueArray->SetTuple1(i,val);
-    }
+            this->EigenvalueArray->SetTuple1(i,val);
+        }
 
-    for( int j=0; j<3; j++)
-    {
-        delete [] a[j];
-        delete [] v[j];
-    }
+        for( int j=0; j<3; j++)
+        {
+            delete [] a[j];
+            delete [] v[j];
+        }
 
-    delete [] a;
-    delete [] w;
-    delete [] v;
+        delete [] a;
+        delete [] w;
+        delete [] v;
 
-    double range[2];
-    this->EigenvalueArray->GetRange (range);
-    std::cout << "Eigenvalue range is: " << range[0] << " " << range[1] << std::endl;
+        double range[2];
+        this->EigenvalueArray->GetRange (range);
+        std::cout << "Eigenvalue range is: " << range[0] << " " << range[1] << std::endl;
 
-    myData->GetPointData()->SetScalars(this->EigenvalueArray);
-    this->Glyph->Modified();
+        myData->GetPointData()->SetScalars(this->EigenvalueArray);
+        this->Glyph->Modified();
+    }
 
     this->Mapper->SetColorModeToMapScalars();
 
@@ -632,69 +666,108 @@ void vtkTensorVisuManager::SetUpLUTToMapEigenValue()
 
 void vtkTensorVisuManager::SetUpLUTToMapVolume()
 {
-    vtkDataSet* myData = this->GetInput();
+    double range[2] = {0.0, 1.0};
 
-    int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
-    this->VolumeArray->Initialize();
-    this->VolumeArray->SetNumberOfComponents(1);
-    this->VolumeArray->SetNumberOfTuples(numPoints);
+    // image inputs are colored by the slice glyph filter
+    if( this->SparseInput )
+    {
+        vtkDataSet* myData = this->GetInput();
 
-    double coefs[9];
+        int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
+        this->VolumeArray->Initialize();
+        this->VolumeArray->SetNumberOfComponents(1);
+        this->VolumeArray->SetNumberOfTuples(numPoints);
 
-    double **a;
-    a = new double*[3];
-    double *w = new double[3];
-    double **v;
-    v = new double*[3];
-    
-    for( unsigned int j=0; j<3; j++)
-    {
-        a[j] = new double[3];
-        v[j] = new double[3];
-    }
+        double coefs[9];
 
-    for(int i=0;i<numPoints;i++)
-    {
-        // Color coding with the eigenvalue
-        myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+        double **a;
+        a = new double*[3];
+        double *w = new double[3];
+        double **v;
+        v = new double*[3];
+    
+        for( unsigned int j=0; j<3; j++)
+        {
+            a[j] = new double[3];
+            v[j] = new double[3];
+        }
 
-        for( int nl=0; nl<3; nl++)
+        for(int i=0;i<numPoints;i++)
         {
-            for( int nc=0; nc<3; nc++)
+            // Color coding with the eigenvalue
+            myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+
+            for( int nl=0; nl<3; nl++)
             {
-                a[nl][nc] = coefs[nl*3+nc];
+                for( int nc=0; nc<3; nc++)
+                {
+                    a[nl][nc] = coefs[nl*3+nc];
+                }
             }
-        }
 
-        vtkMath::Jacobi (a, w, v);
+            vtkMath::Jacobi (a, w, v);
 
-        double prod = 1.0;
+            double prod = 1.0;
 
-        for(int j=0;j<3;j++)
-        {
-            prod *= w[j];
+            for(int j=0;j<3;j++)
+            {
+                prod *= w[j];
+            }
+
+            this->VolumeArray->SetTuple1(i, prod);
         }
 
-        this->VolumeArray->SetTuple1(i, prod);
-    }
+        for( int j=0; j<3; j++)
+        {
+            delete [] a[j];
+            delete [] v[j];
+        }
 
-    for( int j=0; j<3; j++)
-    {
-        delete [] a[j];
-        delete [] v[j];
-    }
+        delete [] a;
+        delete [] w;
+        delete [] v;
 
-    delete [] a;
-    delete [] w;
-    delete [] v;
+        this->VolumeArray->GetRange (range);
+        std::cout << "Volume range is: " << range[0] << " " << range[1] << std::endl;
 
-    double range[2];
-    this->VolumeArray->GetRange (range);
-    std::cout << "Volume range is: " << range[0] << " " << range[1] << std::endl;
+        myData->GetPointData()->SetScalars(this->VolumeArray);
+        this->Glyph->Modified();
+    }
+    else if( this->Input )
+    {
+        // The glyphs of a slice are mapped with the range of the whole
+        // volume. The product of the eigenvalues is the determinant of the
+        // tensor, no decomposition is needed.
+        vtkDataArray *tensors = this->Input->GetPointData()->GetTensors();
+        if( tensors->GetMTime() != this->VolumeRangeTime )
+        {
+            this->VolumeRange[0] = VTK_DOUBLE_MAX;
+            this->VolumeRange[1] = VTK_DOUBLE_MIN;
 
-    myData->GetPointData()->SetScalars(this->VolumeArray);
-    this->Glyph->Modified();
-    this->LUT->SetRange (range);
+            double coefs[9];
+            double a[3][3];
+            for(vtkIdType i=0; i<tensors->GetNumberOfTuples(); i++)
+            {
+                tensors->GetTuple(i, coefs);
+                for( int nl=0; nl<3; nl++)
+                {
+                    for( int nc=0; nc<3; nc++)
+                    {
+                        a[nl][nc] = coefs[nl*3+nc];
+                    }
+                }
+                double det = vtkMath::Determinant3x3(a);
+                this->VolumeRange[0] = std::min(this->VolumeRange[0], det);
+                this->VolumeRange[1] = std::max(this->VolumeRange[1], det);
+            }
+            this->VolumeRangeTime = tensors->GetMTime();
+        }
+        if( this->VolumeRange[0] <= this->VolumeRange[1] )
+        {
+            range[0] = this->VolumeRange[0];
+            range[1] = this->VolumeRange[1];
+        }
+    }
     this->Mapper->SetColorModeToMapScalars();
     this->Mapper->UseLookupTableScalarRangeOn();
 
@@ -713,6 +786,7 @@ void vtkTensorVisuManager::SetUpLUTToMapVolume()
     {
         this->Mapper->SetLookupTable (this->LUT);
     }
+    this->LUT->SetRange (range);
 
     this->Mapper->SetScalarRange(this->Min,this->Max);
 
@@ -720,38 +794,42 @@ void vtkTensorVisuManager::SetUpLUTToMapVolume()
 
 void vtkTensorVisuManager::SetUpLUTToMapTrace()
 {
-    vtkDataSet* myData = this->GetInput();
+    // image inputs are colored by the slice glyph filter
+    if( this->SparseInput )
+    {
+        vtkDataSet* myData = this->GetInput();
 
-    int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
+        int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
 
-    this->TraceArray->Initialize();
-    this->TraceArray->SetNumberOfComponents(1);
-    this->TraceArray->SetNumberOfTuples(numPoints);
+        this->TraceArray->Initialize();
+        this->TraceArray->SetNumberOfComponents(1);
+        this->TraceArray->SetNumberOfTuples(numPoints);
 
-    double coefs[9];
+        double coefs[9];
 
-    for(int i=0;i<numPoints;i++)
-    {
-        // Color coding with the eigenvalue
-        myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+        for(int i=0;i<numPoints;i++)
+        {
+            // Color coding with the eigenvalue
+            myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
 
 
-        double trace2 = coefs[0]*coefs[0] + coefs[1]*coefs[1] + coefs[2]*coefs[2] +
-                coefs[3]*coefs[3] + coefs[4]*coefs[4] + coefs[5]*coefs[5] +
-                coefs[6]*coefs[6] + coefs[7]*coefs[7] + coefs[8]*coefs[8];
+            double trace2 = coefs[0]*coefs[0] + coefs[1]*coefs[1] + coefs[2]*coefs[2] +
+                    coefs[3]*coefs[3] + coefs[4]*coefs[4] + coefs[5]*coefs[5] +
+                    coefs[6]*coefs[6] + coefs[7]*coefs[7] + coefs[8]*coefs[8];
 
-        double sum = sqrt ( trace2 );
+            double sum = sqrt ( trace2 );
 
-        this->TraceArray->SetTuple1(i, sum);
+            this->TraceArray->SetTuple1(i, sum);
 
-    }
+        }
 
-    double range[2];
-    this->TraceArray->GetRange (range);
-    std::cout << "RMS range is: " << range[0] << " " << range[1] << std::endl;
+        double range[2];
+        this->TraceArray->GetRange (range);
+        std::cout << "RMS range is: " << range[0] << " " << range[1] << std::endl;
 
-    myData->GetPointData()->SetScalars (this->TraceArray);
-    this->Glyph->Modified();
+        myData->GetPointData()->SetScalars (this->TraceArray);
+        this->Glyph->Modified();
+    }
 
     this->Mapper->SetColorModeToMapScalars();
 
@@ -771,69 +849,73 @@ void vtkTensorVisuManager::SetUpLUTToMapTrace()
 
 void vtkTensorVisuManager::SetUpLUTToMapDistanceToIdentity()
 {
-    vtkDataSet* myData = this->GetInput();
+    // image inputs are colored by the slice glyph filter
+    if( this->SparseInput )
+    {
+        vtkDataSet* myData = this->GetInput();
 
-    int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
+        int numPoints = myData->GetPointData()->GetTensors()->GetNumberOfTuples();
 
-    this->DistanceArray->Initialize();
-    this->DistanceArray->SetNumberOfComponents(1);
-    this->DistanceArray->SetNumberOfTuples(numPoints);
+        this->DistanceArray->Initialize();
+        this->DistanceArray->SetNumberOfComponents(1);
+        this->DistanceArray->SetNumberOfTuples(numPoints);
 
-    double coefs[9];
+        double coefs[9];
 
-    double **a;
-    a = new double*[3];
-    double *w = new double[3];
-    double **v;
-    v = new double*[3];
+        double **a;
+        a = new double*[3];
+        double *w = new double[3];
+        double **v;
+        v = new double*[3];
     
-    for( unsigned int j=0; j<3; j++)
-    {
-        a[j] = new double[3];
-        v[j] = new double[3];
-    }
-
-    for(int i=0;i<numPoints;i++)
-    {
-        // Color coding with the eigenvalue
-        myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+        for( unsigned int j=0; j<3; j++)
+        {
+            a[j] = new double[3];
+            v[j] = new double[3];
+        }
 
-        for( int nl=0; nl<3; nl++)
+        for(int i=0;i<numPoints;i++)
         {
-            for( int nc=0; nc<3; nc++)
+            // Color coding with the eigenvalue
+            myData->GetPointData()->GetTensors()->GetTuple(i,coefs);
+
+            for( int nl=0; nl<3; nl++)
             {
-                a[nl][nc] = coefs[nl*3+nc];
+                for( int nc=0; nc<3; nc++)
+                {
+                    a[nl][nc] = coefs[nl*3+nc];
+                }
             }
-        }
 
-        vtkMath::Jacobi (a, w, v);
+            vtkMath::Jacobi (a, w, v);
+
+            double norm = 1.0;
+            for( int j=0; j<3; j++)
+            {
+                norm += log (w[j])*log (w[j]);
+            }
+            norm = sqrt (norm);
+
+            this->DistanceArray->SetTuple1(i,norm);
+        }
 
-        double norm = 1.0;
         for( int j=0; j<3; j++)
         {
-            norm += log (w[j])*log (w[j]);
+            delete [] a[j];
+            delete [] v[j];
         }
-        norm = sqrt (norm);
 
-        this->DistanceArray->SetTuple1(i,norm);
-    }
+        delete [] a;
+        delete [] w;
+        delete [] v;
 
-    for( int j=0; j<3; j++)
-    {
-        delete [] a[j];
-        delete [] v[j];
-    }
+        double range[2];
+        this->DistanceArray->GetRange (range);
+        std::cout << "Norm range is: " << range[0] << " " << range[1] << std::endl;
 
-    delete [] a;
-    delete [] w;
-    delete [] v;
-
-    double range[2];
-    this->DistanceArray->GetRange (range);
-    std::cout << "Norm range is: " << range[0] << " " << range[1] << std::endl;
-
-    myData->GetPointData()->SetScalars(this->DistanceArray);
-    this->Glyph->Modified();
+        myData->GetPointData()->SetScalars(this->DistanceArray);
+        this->Glyph->Modified();
+    }
 
     this->Mapper->SetColorModeToMapScalars();
 
@@ -858,15 +940,16 @@ void vtkTensorVisuManager::SetUpLUTToMapDistanceToIdentity()
 
 void vtkTensorVisuManager::SetUpLUTToMapScalars()
 {
-    vtkDataSet* myData = this->GetInput();
-
     if( !this->Scalars )
     {
         return;
     }
 
-    myData->GetPointData()->SetScalars (this->Scalars);
-    this->Glyph->Modified();
+    if( this->SparseInput )
+    {
+        this->GetInput()->GetPointData()->SetScalars (this->Scalars);
+        this->Glyph->Modified();
+    }
 
     double range[2];
     this->Scalars->GetRange(range);
@@ -21,9 +21,8 @@
 #include <vtkTensorGlyph.h> 
 #include <vtkStructuredPoints.h>
 #include <vtkUnstructuredGrid.h>
-#include <vtkExtractVOI.h>
 #include <vtkLookupTable.h>
-#include <vtkFlipTensorImageFilter.h>
+#include <vtkTensorSliceGlyphFilter.h>
 #include <vtkPolyDataAlgorithm.h>
 #include <vtkUnsignedIntArray.h>
 #include <vtkDoubleArray.h>
@@ -51,9 +50,9 @@ class vtkTensorVisuManager : public vtkObject
   };
   //ETX
   
-  /** Set the input as a vtkStructuredPoints dataset. It is then
-      mapped through a vtkExtractVOI to limit the visualization
-      to one slice. */	
+  /** Set the input as a vtkStructuredPoints dataset. Only the
+      tensors of the VOI (one slice) are glyphed, directly from
+      the input tensors. */	
   void SetInput(vtkStructuredPoints* data, vtkMatrix4x4 *matrix = 0);
   
   /** Set the input as a vtkUnstructuredGrid dataset. It consists
@@ -156,7 +155,7 @@ class vtkTensorVisuManager : public vtkObject
   
   /** Get the vtkPolyData. */
   vtkPolyData* GetPolyData() const
-  { return this->Normals->GetOutput(); }
+  { return this->Mapper->GetInput(); }
   
   /** Get the vtkMapper. */
   vtkGetObjectMacro (Mapper, vtkMapper);
@@ -168,18 +167,18 @@ class vtkTensorVisuManager : public vtkObject
   
   /** Flip tensors along the X axis */
   void FlipX (bool a)
-  { this->Fliper->SetFlipX (a); }
+  { this->SliceGlyph->SetFlipX (a); }
   
   /** Flip tensors along the Y axis */
   void FlipY (bool a)
-  { this->Fliper->SetFlipY (a); }
+  { this->SliceGlyph->SetFlipY (a); }
   
   /** Flip tensors along the Z axis */
   void FlipZ (bool a)
-  { this->Fliper->SetFlipZ (a); }
+  { this->SliceGlyph->SetFlipZ (a); }
   
-  /** Get the flipper */
-  vtkGetObjectMacro (Fliper, vtkFlipTensorImageFilter);
+  /** Get the slice glyph filter used for image inputs */
+  vtkGetObjectMacro (SliceGlyph, vtkTensorSliceGlyphFilter);
   
   void SetLookupTable (vtkLookupTable* lut);
 
@@ -200,8 +199,7 @@ class vtkTensorVisuManager : public vtkObject
   
  private:
   
-  vtkFlipTensorImageFilter* Fliper;
-  vtkExtractVOI*            VOI;
+  vtkTensorSliceGlyphFilter* SliceGlyph;
   vtkPolyDataAlgorithm*     Shape;
   vtkTensorGlyph*           Glyph;
   vtkPolyDataNormals*       Normals;
@@ -224,6 +222,11 @@ class vtkTensorVisuManager : public vtkObject
   GlyphShapeMode ShapeMode;
   
   vtkDataSet* Input;
+  bool        SparseInput;
+
+  // range of the tensor volumes of an image input, for the tensors of that time
+  double       VolumeRange[2];
+  vtkMTimeType VolumeRangeTime;
   
   double Min;
   double Max;
@@ -17,14 +17,39 @@
 #include <itkBinaryErodeImageFilter.h>
 #include <itkBinaryMorphologicalClosingImageFilter.h>
 #include <itkBinaryMorphologicalOpeningImageFilter.h>
+#include <itkBinaryThresholdImageFilter.h>
 #include <itkFlatStructuringElement.h>
 #include <itkGrayscaleMorphologicalClosingImageFilter.h>
 #include <itkGrayscaleMorphologicalOpeningImageFilter.h>
 #include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
 #include <itkMinimumMaximumImageFilter.h>
+#include <itkSignedMaurerDistanceMapImageFilter.h>
 #include <medUtilities.h>
 #include <medUtilitiesITK.h>
 
+#include <algorithm>
+
+namespace
+{
+// Progress of one distance map among the passes of an operation
+struct distanceMapPass
+{
+    itkFiltersProcessBase *process;
+    int pass;
+    int passCount;
+};
+
+void distanceMapPassCallback(itk::Object *caller, const itk::EventObject& event, void *clientData)
+{
+    distanceMapPass *pass = reinterpret_cast<distanceMapPass *>(clientData);
+    itk::ProcessObject *processObject = (itk::ProcessObject*) caller;
+
+    double progress = (pass->pass + processObject->GetProgress()) / pass->passCount;
+    pass->process->emitProgress(static_cast<int>(progress * 100));
+}
+}
+
 class itkMorphologicalFiltersProcessBasePrivate
 {
 public:
@@ -101,11 +126,88 @@ void itkMorphologicalFiltersProcessBase::convertMmInPixels(ImageType *image)
     }
 }
 
+// Whether the image only holds the foreground and background values, the
+// other values being lost by the distance maps
+template <class ImageType>
+bool itkMorphologicalFiltersProcessBase::isBinary(ImageType *image,
+                                                  typename ImageType::PixelType foreground,
+                                                  typename ImageType::PixelType background)
+{
+    itk::ImageRegionConstIterator<ImageType> it(image, image->GetLargestPossibleRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+        if (it.Get() != foreground && it.Get() != background)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Binary dilation (resp. erosion) by a ball keeps the voxels closer to the
+// foreground (resp. farther from the background) than the radius. The
+// distances come from a single multi-threaded Maurer distance map, so the
+// cost does not depend on the radius. The progress is reported as the given
+// pass of passCount.
+template <class ImageType>
+typename ImageType::Pointer itkMorphologicalFiltersProcessBase::distanceMapMorphology(ImageType *image,
+                                                                                      bool dilate,
+                                                                                      double radius,
+                                                                                      bool radiusInMm,
+                                                                                      typename ImageType::PixelType foreground,
+                                                                                      typename ImageType::PixelType background,
+                                                                                      int pass,
+                                                                                      int passCount)
+{
+    typedef itk::Image<unsigned char, 3> MaskType;
+    typedef itk::Image<float, 3> DistanceMapType;
+
+    // Set the distances are measured to: foreground to dilate, background to erode
+    typedef itk::BinaryThresholdImageFilter<ImageType, MaskType> MaskFilterType;
+    typename MaskFilterType::Pointer maskFilter = MaskFilterType::New();
+    maskFilter->SetInput(image);
+    maskFilter->SetLowerThreshold(foreground);
+    maskFilter->SetUpperThreshold(foreground);
+    maskFilter->SetInsideValue(dilate ? 1 : 0);
+    maskFilter->SetOutsideValue(dilate ? 0 : 1);
+
+    typedef itk::SignedMaurerDistanceMapImageFilter<MaskType, DistanceMapType> DistanceFilterType;
+    typename DistanceFilterType::Pointer distanceFilter = DistanceFilterType::New();
+    distanceFilter->SetInput(maskFilter->GetOutput());
+    distanceFilter->SetBackgroundValue(0);
+    distanceFilter->SetUseImageSpacing(radiusInMm);
+    distanceFilter->SquaredDistanceOff();
+    distanceFilter->InsideIsPositiveOff();
+
+    distanceMapPass progress = { this, pass, passCount };
+    itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
+    callback->SetClientData ( ( void * ) &progress );
+    callback->SetCallback ( distanceMapPassCallback );
+    distanceFilter->AddObserver ( itk::ProgressEvent(), callback );
+
+    // Voxels inside the set have non-positive distances
+    typedef itk::BinaryThresholdImageFilter<DistanceMapType, ImageType> OutputFilterType;
+    typename OutputFilterType::Pointer outputFilter = OutputFilterType::New();
+    outputFilter->SetInput(distanceFilter->GetOutput());
+    outputFilter->SetLowerThreshold(itk::NumericTraits<float>::NonpositiveMin());
+    outputFilter->SetUpperThreshold(radius);
+    outputFilter->SetInsideValue(dilate ? foreground : background);
+    outputFilter->SetOutsideValue(dilate ? background : foreground);
+    outputFilter->Update();
+
+    typename ImageType::Pointer output = outputFilter->GetOutput();
+    output->DisconnectPipeline();
+    return output;
+}
+
 template <class ImageType>
 int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData)
 {
     typename ImageType::Pointer inputImage = static_cast<ImageType*>(inputData->data());
 
+    // Requested radius, in mm or in pixels
+    double ballRadius = d->radius[0];
+
     if(!d->isRadiusInPixels)
     {
         convertMmInPixels<ImageType>(inputImage);
@@ -119,10 +221,24 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
 
     StructuringElementType kernel;
 
+    bool binaryOperation = description() == "Dilate filter"
+            || description() == "Erode filter"
+            || description() == "Binary Close filter"
+            || description() == "Binary Open filter";
+
     switch (d->kernelShape)
     {
     case itkMorphologicalFiltersProcessBase::BallKernel:
-        kernel = StructuringElementType::Ball(elementRadius);
+        if (!binaryOperation && std::max({elementRadius[0], elementRadius[1], elementRadius[2]}) > 2)
+        {
+            // Decomposable approximation of the ball (20 lines), run with the
+            // van Herk/Gil-Werman algorithm in a time independent of the radius
+            kernel = StructuringElementType::Polygon(elementRadius, 20);
+        }
+        else
+        {
+            kernel = StructuringElementType::Ball(elementRadius);
+        }
         break;
     case itkMorphologicalFiltersProcessBase::CrossKernel:
         kernel = StructuringElementType::Cross(elementRadius);
@@ -144,14 +260,49 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
 
     QString filenameDescription;
 
-    if(description() == "Dilate filter")
+    typename ImageType::PixelType foreground = imageCalculatorFilter->GetMaximum();
+    typename ImageType::PixelType background = imageCalculatorFilter->GetMinimum();
+    bool radiusInMm = !d->isRadiusInPixels;
+
+    // Binary operations with a ball go through distance maps, unless other
+    // values than the foreground and background must be kept
+    if (binaryOperation && d->kernelShape == itkMorphologicalFiltersProcessBase::BallKernel
+            && isBinary<ImageType>(inputImage, foreground, background))
+    {
+        typename ImageType::Pointer outputImage;
+        if(description() == "Dilate filter")
+        {
+            filenameDescription = "dilated";
+            outputImage = distanceMapMorphology<ImageType>(inputImage, true, ballRadius, radiusInMm, foreground, background, 0, 1);
+        }
+        else if(description() == "Erode filter")
+        {
+            filenameDescription = "eroded";
+            outputImage = distanceMapMorphology<ImageType>(inputImage, false, ballRadius, radiusInMm, foreground, background, 0, 1);
+        }
+        else if(description() == "Binary Close filter")
+        {
+            filenameDescription = "binaryClosed";
+            outputImage = distanceMapMorphology<ImageType>(inputImage, true, ballRadius, radiusInMm, foreground, background, 0, 2);
+            outputImage = distanceMapMorphology<ImageType>(outputImage, false, ballRadius, radiusInMm, foreground, background, 1, 2);
+        }
+        else
+        {
+            filenameDescription = "binaryOpened";
+            outputImage = distanceMapMorphology<ImageType>(inputImage, false, ballRadius, radiusInMm, foreground, background, 0, 2);
+            outputImage = distanceMapMorphology<ImageType>(outputImage, true, ballRadius, radiusInMm, foreground, background, 1, 2);
+        }
+
+        getOutputData()->setData ( outputImage );
+    }
+    else if(description() == "Dilate filter")
     {
         filenameDescription = "dilated";
 
         typedef itk::BinaryDilateImageFilter< ImageType, ImageType,StructuringElementType >  DilateFilterType;
         filter = DilateFilterType::New();
-        dynamic_cast<DilateFilterType *>(filter.GetPointer())->SetForegroundValue(imageCalculatorFilter->GetMaximum());
-        dynamic_cast<DilateFilterType *>(filter.GetPointer())->SetBackgroundValue(imageCalculatorFilter->GetMinimum());
+        dynamic_cast<DilateFilterType *>(filter.GetPointer())->SetForegroundValue(foreground);
+        dynamic_cast<DilateFilterType *>(filter.GetPointer())->SetBackgroundValue(background);
     }
     else if(description() == "Erode filter")
     {
@@ -159,8 +310,8 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
 
         typedef itk::BinaryErodeImageFilter< ImageType, ImageType,StructuringElementType >  ErodeFilterType;
         filter = ErodeFilterType::New();
-        dynamic_cast<ErodeFilterType *>(filter.GetPointer())->SetForegroundValue(imageCalculatorFilter->GetMaximum());
-        dynamic_cast<ErodeFilterType *>(filter.GetPointer())->SetBackgroundValue(imageCalculatorFilter->GetMinimum());
+        dynamic_cast<ErodeFilterType *>(filter.GetPointer())->SetForegroundValue(foreground);
+        dynamic_cast<ErodeFilterType *>(filter.GetPointer())->SetBackgroundValue(background);
     }
     else if(description() == "Grayscale Close filter")
     {
@@ -182,7 +333,7 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
 
         typedef itk::BinaryMorphologicalClosingImageFilter< ImageType, ImageType, StructuringElementType >  BCloseFilterType;
         filter = BCloseFilterType::New();
-        dynamic_cast<BCloseFilterType *>(filter.GetPointer())->SetForegroundValue(imageCalculatorFilter->GetMaximum());
+        dynamic_cast<BCloseFilterType *>(filter.GetPointer())->SetForegroundValue(foreground);
     }
     else if(description() == "Binary Open filter")
     {
@@ -190,8 +341,8 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
 
         typedef itk::BinaryMorphologicalOpeningImageFilter< ImageType, ImageType, StructuringElementType >  BOpenFilterType;
         filter = BOpenFilterType::New();
-        dynamic_cast<BOpenFilterType *>(filter.GetPointer())->SetForegroundValue(imageCalculatorFilter->GetMaximum());
-        dynamic_cast<BOpenFilterType *>(filter.GetPointer())->SetBackgroundValue(imageCalculatorFilter->GetMinimum());
+        dynamic_cast<BOpenFilterType *>(filter.GetPointer())->SetForegroundValue(foreground);
+        dynamic_cast<BOpenFilterType *>(filter.GetPointer())->SetBackgroundValue(background);
     }
     else
     {
@@ -199,17 +350,20 @@ int itkMorphologicalFiltersProcessBase::updateProcess(medAbstractData *inputData
         return medAbstractProcessLegacy::FAILURE;
     }
 
-    filter->SetInput(inputImage);
-    filter->SetKernel ( kernel );
+    if (filter)
+    {
+        filter->SetInput(inputImage);
+        filter->SetKernel ( kernel );
 
-    itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
-    callback->SetClientData ( ( void * ) this );
-    callback->SetCallback ( itkFiltersProcessBase::eventCallback );
-    filter->AddObserver ( itk::ProgressEvent(), callback );
+        itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
+        callback->SetClientData ( ( void * ) this );
+        callback->SetCallback ( itkFiltersProcessBase::eventCallback );
+        filter->AddObserver ( itk::ProgressEvent(), callback );
 
-    filter->Update();
+        filter->Update();
 
-    getOutputData()->setData ( filter->GetOutput() );
+        getOutputData()->setData ( filter->GetOutput() );
+    }
 
     // Add description on output data
     QString newSeriesDescription = filenameDescription + " ";
@@ -39,6 +39,17 @@ public slots:
 protected:
     template <class ImageType> void convertMmInPixels(ImageType *image);
     template <class ImageType> int updateProcess(medAbstractData *inputData);
+    template <class ImageType> bool isBinary(ImageType *image,
+                                             typename ImageType::PixelType foreground,
+                                             typename ImageType::PixelType background);
+    template <class ImageType> typename ImageType::Pointer distanceMapMorphology(ImageType *image,
+                                                                                 bool dilate,
+                                                                                 double radius,
+                                                                                 bool radiusInMm,
+                                                                                 typename ImageType::PixelType foreground,
+                                                                                 typename ImageType::PixelType background,
+                                                                                 int pass,
+                                                                                 int passCount);
 
 private:
     itkMorphologicalFiltersProcessBasePrivate *d;
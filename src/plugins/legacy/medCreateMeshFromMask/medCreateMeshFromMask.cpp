@@ -19,16 +19,26 @@
 #include <medUtilities.h>
 
 #include <itkImage.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 #include <itkImageToVTKImageFilter.h>
+#include <itkMultiThreaderBase.h>
 
-#include <vtkContourFilter.h>
+#include <vtkCellArray.h>
 #include <vtkDecimatePro.h>
+#include <vtkExtractVOI.h>
+#include <vtkFlyingEdges3D.h>
 #include <vtkMetaSurfaceMesh.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
-#include <vtkSmoothPolyDataFilter.h>
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
-#include <vtkTriangleFilter.h>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <vector>
 
 // /////////////////////////////////////////////////////////////////
 // medCreateMeshFromMaskPrivate
@@ -48,8 +58,159 @@ public:
     int nbTriangles;
 
     template <class PixelType> int update();
+    template <class ImageType> bool computeBoundingBox(ImageType *img, int voi[6]);
+    void smoothMesh(vtkPolyData *mesh);
 };
 
+/**
+ * Index bounding box of the voxels at or above the iso-value, padded by one
+ * voxel so that the surface is closed, computed in parallel over the image.
+ * @return false if no voxel reaches the iso-value.
+ */
+template <class ImageType> bool medCreateMeshFromMaskPrivate::computeBoundingBox(ImageType *img, int voi[6])
+{
+    typedef typename ImageType::RegionType RegionType;
+    const RegionType region = img->GetLargestPossibleRegion();
+
+    itk::IndexValueType lower[3], upper[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        lower[i] = std::numeric_limits<itk::IndexValueType>::max();
+        upper[i] = std::numeric_limits<itk::IndexValueType>::min();
+    }
+    std::mutex boundsMutex;
+
+    itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+    multiThreader->ParallelizeImageRegion<3>(region, [&](const RegionType &subRegion)
+    {
+        itk::IndexValueType subLower[3], subUpper[3];
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            subLower[i] = std::numeric_limits<itk::IndexValueType>::max();
+            subUpper[i] = std::numeric_limits<itk::IndexValueType>::min();
+        }
+
+        itk::ImageRegionConstIteratorWithIndex<ImageType> it(img, subRegion);
+        for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+        {
+            if (static_cast<double>(it.Get()) >= isoValue)
+            {
+                const typename ImageType::IndexType &index = it.GetIndex();
+                for (unsigned int i = 0; i < 3; ++i)
+                {
+                    subLower[i] = std::min(subLower[i], index[i]);
+                    subUpper[i] = std::max(subUpper[i], index[i]);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            lower[i] = std::min(lower[i], subLower[i]);
+            upper[i] = std::max(upper[i], subUpper[i]);
+        }
+    }, nullptr);
+
+    if (lower[0] > upper[0])
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        const itk::IndexValueType first = region.GetIndex()[i];
+        const itk::IndexValueType last = first + static_cast<itk::IndexValueType>(region.GetSize()[i]) - 1;
+        voi[2*i]   = static_cast<int>(std::max(lower[i] - 1, first));
+        voi[2*i+1] = static_cast<int>(std::min(upper[i] + 1, last));
+    }
+    return true;
+}
+
+/**
+ * Laplacian smoothing with the same relaxation scheme as
+ * vtkSmoothPolyDataFilter, each iteration computing all the new point
+ * positions in parallel from the previous ones.
+ */
+void medCreateMeshFromMaskPrivate::smoothMesh(vtkPolyData *mesh)
+{
+    const vtkIdType nbPoints = mesh->GetNumberOfPoints();
+    if (nbPoints == 0 || iterations <= 0)
+    {
+        return;
+    }
+
+    // Point neighbourhoods, from the edges of the triangles
+    std::vector<std::vector<vtkIdType> > neighbours(nbPoints);
+    vtkCellArray *polys = mesh->GetPolys();
+    vtkIdType nbCellPoints;
+    vtkIdType *cellPoints;
+    for (polys->InitTraversal(); polys->GetNextCell(nbCellPoints, cellPoints);)
+    {
+        for (vtkIdType i = 0; i < nbCellPoints; ++i)
+        {
+            vtkIdType a = cellPoints[i];
+            vtkIdType b = cellPoints[(i + 1) % nbCellPoints];
+            neighbours[a].push_back(b);
+            neighbours[b].push_back(a);
+        }
+    }
+    auto uniqueNeighbours = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            std::sort(neighbours[i].begin(), neighbours[i].end());
+            neighbours[i].erase(std::unique(neighbours[i].begin(), neighbours[i].end()), neighbours[i].end());
+        }
+    };
+    vtkSMPTools::For(0, nbPoints, uniqueNeighbours);
+
+    vtkPoints *points = mesh->GetPoints();
+    std::vector<double> current(3 * nbPoints), next(3 * nbPoints);
+    for (vtkIdType i = 0; i < nbPoints; ++i)
+    {
+        points->GetPoint(i, &current[3 * i]);
+    }
+
+    auto relax = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const std::vector<vtkIdType> &ring = neighbours[i];
+            for (int c = 0; c < 3; ++c)
+            {
+                double value = current[3 * i + c];
+                if (!ring.empty())
+                {
+                    double mean = 0.0;
+                    for (vtkIdType n : ring)
+                    {
+                        mean += current[3 * n + c];
+                    }
+                    mean /= ring.size();
+                    value += relaxationFactor * (mean - value);
+                }
+                next[3 * i + c] = value;
+            }
+        }
+    };
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        vtkSMPTools::For(0, nbPoints, relax);
+        current.swap(next);
+    }
+
+    auto writeBack = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            points->SetPoint(i, &current[3 * i]);
+        }
+    };
+    vtkSMPTools::For(0, nbPoints, writeBack);
+    points->Modified();
+}
+
 template <class PixelType> int medCreateMeshFromMaskPrivate::update()
 {
     typedef itk::Image<PixelType, 3> ImageType;
@@ -86,26 +247,33 @@ template <class PixelType> int medCreateMeshFromMaskPrivate::update()
 
     //------------------------------------------------------
 
-    vtkImageData *vtkImage = filter->GetOutput();
+    // Only the bounding box of the label is contoured
+    int voi[6];
+    if (!computeBoundingBox<ImageType>(img, voi))
+    {
+        matrix->Delete();
+        output = nullptr;
+        nbTriangles = 0;
+        return medAbstractProcessLegacy::FAILURE;
+    }
 
-    vtkContourFilter *contour = vtkContourFilter::New();
-    contour->SetInputData(vtkImage);
+    vtkSmartPointer<vtkExtractVOI> crop = vtkSmartPointer<vtkExtractVOI>::New();
+    crop->SetInputData(filter->GetOutput());
+    crop->SetVOI(voi);
+
+    // Multi-threaded iso-surface extraction, producing triangles directly
+    vtkSmartPointer<vtkFlyingEdges3D> contour = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    contour->SetInputConnection(crop->GetOutputPort());
     contour->SetValue(0, isoValue);
     contour->Update();
 
-    vtkTriangleFilter *contourTrian = vtkTriangleFilter::New();
-    contourTrian->SetInputConnection(contour->GetOutputPort());
-    contourTrian->PassVertsOn();
-    contourTrian->PassLinesOn();
-    contourTrian->Update();
-
-    vtkPolyDataAlgorithm *lastAlgo = contourTrian;
+    vtkPolyDataAlgorithm *lastAlgo = contour;
 
-    vtkDecimatePro *contourDecimated = nullptr;
+    vtkSmartPointer<vtkDecimatePro> contourDecimated;
     if (decimate)
     {
         // Decimate the mesh if required
-        contourDecimated = vtkDecimatePro::New();
+        contourDecimated = vtkSmartPointer<vtkDecimatePro>::New();
         contourDecimated->SetInputConnection(lastAlgo->GetOutputPort());
         contourDecimated->SetTargetReduction(targetReduction);
         contourDecimated->SplittingOff();
@@ -114,21 +282,16 @@ template <class PixelType> int medCreateMeshFromMaskPrivate::update()
         lastAlgo = contourDecimated;
     }
 
-    vtkSmoothPolyDataFilter *contourSmoothed = nullptr;
-    if(smooth)
+    vtkSmartPointer<vtkPolyData> polydata = vtkSmartPointer<vtkPolyData>::New();
+    polydata->ShallowCopy(lastAlgo->GetOutput());
+    nbTriangles = polydata->GetNumberOfPolys();
+
+    if (smooth)
     {
         // Smooth the mesh if required
-        contourSmoothed = vtkSmoothPolyDataFilter::New();
-        contourSmoothed->SetInputConnection(lastAlgo->GetOutputPort());
-        contourSmoothed->SetNumberOfIterations(iterations);
-        contourSmoothed->SetRelaxationFactor(relaxationFactor);
-        contourSmoothed->Update();
-        lastAlgo = contourSmoothed;
+        smoothMesh(polydata);
     }
 
-    vtkPolyData *polydata = lastAlgo->GetOutput();
-    nbTriangles = polydata->GetNumberOfPolys();
-
     if (nbTriangles > 0)
     {
         // To get the itkImage info back
@@ -136,7 +299,7 @@ template <class PixelType> int medCreateMeshFromMaskPrivate::update()
         t->SetMatrix(matrix);
 
         vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-        transformFilter->SetInputConnection(lastAlgo->GetOutputPort());
+        transformFilter->SetInputData(polydata);
         transformFilter->SetTransform(t);
         transformFilter->Update();
 
@@ -146,16 +309,6 @@ template <class PixelType> int medCreateMeshFromMaskPrivate::update()
         smesh->SetDataSet(polydata);
 
         matrix->Delete();
-        contour->Delete();
-        contourTrian->Delete();
-        if (contourDecimated)
-        {
-            contourDecimated->Delete();
-        }
-        if (contourSmoothed)
-        {
-            contourSmoothed->Delete();
-        }
 
         output = medAbstractDataFactory::instance()->createSmartPointer("vtkDataMesh");
         medUtilities::setDerivedMetaData(output, input, "mesh from mask");
@@ -165,16 +318,6 @@ template <class PixelType> int medCreateMeshFromMaskPrivate::update()
     }
 
     matrix->Delete();
-    contour->Delete();
-    contourTrian->Delete();
-    if (contourDecimated)
-    {
-        contourDecimated->Delete();
-    }
-    if (contourSmoothed)
-    {
-        contourSmoothed->Delete();
-    }
     output = nullptr;
     return medAbstractProcessLegacy::FAILURE;
 }
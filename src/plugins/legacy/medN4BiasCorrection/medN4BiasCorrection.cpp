@@ -18,16 +18,12 @@
 
 #include <medAbstractDataFactory.h>
 #include <medDataManager.h>
+#include <medN4BiasCorrectionEngine.h>
 #include <medUtilities.h>
 #include <medUtilitiesITK.h>
 
-#include <itkCastImageFilter.h>
-#include <itkConstantPadImageFilter.h>
-#include <itkExtractImageFilter.h>
 #include <itkImage.h>
-#include <itkN4BiasFieldCorrectionImageFilter.h>
-#include <itkOtsuThresholdImageFilter.h>
-#include <itkShrinkImageFilter.h>
+#include <itkImageRegionConstIterator.h>
 
 class medN4BiasCorrectionPrivate
 {
@@ -36,12 +32,13 @@ public:
     dtkSmartPointer <medAbstractData> mask;
     dtkSmartPointer <medAbstractData> output;
 
-    std::vector<int> numberOfIterations, initialMeshResolution;
+    std::vector<int> numberOfIterations;
     double convergenceThreshold, wienerFilterNoise, saveBias;
     float bfFWHM;
     int bsplineOrder, splineDistance, shrinkFactor, nbHistogramBins;
     dtkSmartPointer<medAbstractData> biasField;
 
+    medN4BiasCorrectionEngine engine;
     bool cancelAsked;
 };
 // /////////////////////////////////////////////////////////////////
@@ -147,22 +144,14 @@ medAbstractData * medN4BiasCorrection::output()
 void medN4BiasCorrection::onCanceled()
 {
     d->cancelAsked = true;
+    d->engine.abort();
 }
 
 template <class InputImageType>
 int medN4BiasCorrection::update(medAbstractData *inputData)
 {
     typename InputImageType::Pointer inputImage = static_cast<InputImageType*>(inputData->data());
-
-    typedef itk::Image<float, 3> OutputImageType;
-    typedef itk::CastImageFilter<InputImageType, OutputImageType> CastType;
-
-    typename CastType::Pointer caster = CastType::New();
-    caster->SetInput(inputImage);
-    typename OutputImageType::Pointer image = caster->GetOutput();
-
-    d->output = medAbstractDataFactory::instance()->createSmartPointer("itkDataImageFloat3");
-    d->biasField = medAbstractDataFactory::instance()->createSmartPointer("itkDataImageFloat3");
+    d->engine.setInput(inputImage.GetPointer());
 
     typedef itk::Image<unsigned short, 3> MaskImageType;
     typename MaskImageType::Pointer maskImage;
@@ -170,18 +159,6 @@ int medN4BiasCorrection::update(medAbstractData *inputData)
     {
         maskImage = dynamic_cast<MaskImageType *>((itk::Object*) (d->mask->data()));
     }
-    else
-    {
-        maskImage = nullptr;
-    }
-    typedef itk::N4BiasFieldCorrectionImageFilter<OutputImageType, MaskImageType, OutputImageType> CorrecterType;
-
-    typename CorrecterType::Pointer correcter = CorrecterType::New();
-    
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
 
     // Handle the mask image
     if( maskImage)
@@ -201,20 +178,12 @@ int medN4BiasCorrection::update(medAbstractData *inputData)
         {
             return medAbstractProcessLegacy::FAILURE;
         }
-        correcter->SetMaskLabel(maskLabel);
+        d->engine.setMask(maskImage.GetPointer(), maskLabel);
     }
     else
     {
         qDebug() << "N4 Bias Correction: mask not read, creating Otsu mask." << endl;
-        typedef itk::OtsuThresholdImageFilter<OutputImageType, MaskImageType>
-            ThresholderType;
-        ThresholderType::Pointer otsu = ThresholderType::New();
-        otsu->SetInput(image);
-        otsu->SetNumberOfHistogramBins(200);
-        otsu->SetInsideValue(0);
-        otsu->SetOutsideValue(1);
-        otsu->Update();
-        maskImage = otsu->GetOutput();
+        d->engine.clearMask();
     }
 
     if (d->cancelAsked)
@@ -222,288 +191,40 @@ int medN4BiasCorrection::update(medAbstractData *inputData)
         return medAbstractProcessLegacy::FAILURE;
     }
 
-    typename OutputImageType::Pointer weightImage = nullptr;
-
-    // Convergence options
-    d->initialMeshResolution.push_back(1); // BSpline Grid Resolution
-    d->initialMeshResolution.push_back(1);
-    d->initialMeshResolution.push_back(1);
-
+    medN4BiasCorrectionEngine::Parameters parameters;
+    parameters.shrinkFactor = d->shrinkFactor;
+    parameters.splineOrder = d->bsplineOrder;
+    parameters.convergenceThreshold = d->convergenceThreshold;
+    parameters.wienerFilterNoise = d->wienerFilterNoise;
+    parameters.biasFieldFullWidthAtHalfMaximum = d->bfFWHM;
+    parameters.numberOfHistogramBins = d->nbHistogramBins;
+    parameters.splineDistance = d->splineDistance;
+    parameters.iterations.clear();
     if (d->numberOfIterations.size() > 1 && d->numberOfIterations[0])
     {
-        typename CorrecterType::VariableSizeArrayType
-            maximumNumberOfIterations( d->numberOfIterations.size() );
-        for( unsigned int i = 0; i < d->numberOfIterations.size(); i++ )
-        {
-            maximumNumberOfIterations[i] = d->numberOfIterations[i];
-        }
-        correcter->SetMaximumNumberOfIterations(maximumNumberOfIterations);
-
-        typename CorrecterType::ArrayType numberOfFittingLevels;
-        numberOfFittingLevels.Fill(d->numberOfIterations.size());
-        correcter->SetNumberOfFittingLevels(numberOfFittingLevels);
-    }
-        
-    if(d->convergenceThreshold)
-    {
-        correcter->SetConvergenceThreshold(d->convergenceThreshold);
-    }
-
-    typename OutputImageType::IndexType imageIndex = image->GetLargestPossibleRegion().GetIndex();
-    typename OutputImageType::SizeType imageSize = image->GetLargestPossibleRegion().GetSize();
-    typename OutputImageType::PointType newOrigin = image->GetOrigin();
-
-    // B-spline options -- we place this here to take care of the case where
-    // the user wants to specify things in terms of the spline distance.        
-    if (d->bsplineOrder)
-    {
-        correcter->SetSplineOrder(d->bsplineOrder);
-    }
-
-    typename CorrecterType::ArrayType numberOfControlPoints;
-    
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    if (d->splineDistance)
-    {
-        itk::SizeValueType lowerBound[InputImageType::ImageDimension];
-        itk::SizeValueType upperBound[InputImageType::ImageDimension];
-
-        for( unsigned int i = 0; i < 3; i++ )
-        {
-            float domain = static_cast<typename InputImageType::PixelType>( 
-                image->GetLargestPossibleRegion().GetSize()[i] - 1 ) 
-                * image->GetSpacing()[i];
-            unsigned int numberOfSpans = static_cast<unsigned int>(
-                std::ceil(domain / d->splineDistance));
-            unsigned long extraPadding = static_cast<unsigned long>( ( numberOfSpans
-                                                                       * d->splineDistance
-                                                                       - domain ) / image->GetSpacing()[i] + 0.5 );
-            lowerBound[i] = static_cast<unsigned long>( 0.5 * extraPadding );
-            upperBound[i] = extraPadding - lowerBound[i];
-            newOrigin[i] -= static_cast<typename InputImageType::PixelType>( lowerBound[i] )
-                                  * image->GetSpacing()[i];
-            numberOfControlPoints[i] = numberOfSpans + correcter->GetSplineOrder();
-        }
-
-        if (d->cancelAsked)
-        {
-            return medAbstractProcessLegacy::FAILURE;
-        }
-
-        typedef itk::ConstantPadImageFilter<OutputImageType, OutputImageType> PadderType;
-        typename PadderType::Pointer padder = PadderType::New();
-        padder->SetInput(image);
-        padder->SetPadLowerBound(lowerBound);
-        padder->SetPadUpperBound(upperBound);
-        padder->SetConstant(0);
-        padder->Update();
-        image = padder->GetOutput();
-
-        if (d->cancelAsked)
-        {
-            return medAbstractProcessLegacy::FAILURE;
-        }
-
-        typedef itk::ConstantPadImageFilter<MaskImageType, MaskImageType> MaskPadderType;
-        typename MaskPadderType::Pointer maskPadder = MaskPadderType::New();
-        maskPadder->SetInput(maskImage);
-        maskPadder->SetPadLowerBound(lowerBound);
-        maskPadder->SetPadUpperBound(upperBound);
-        maskPadder->SetConstant(0);
-        maskPadder->Update();
-        maskImage = maskPadder->GetOutput();
-
-        if (d->cancelAsked)
-        {
-            return medAbstractProcessLegacy::FAILURE;
-        }
-
-        if(weightImage)
-        {
-            typename PadderType::Pointer weightPadder = PadderType::New();
-            weightPadder->SetInput(weightImage);
-            weightPadder->SetPadLowerBound(lowerBound);
-            weightPadder->SetPadUpperBound(upperBound);
-            weightPadder->SetConstant(0);
-            weightPadder->Update();
-            weightImage = weightPadder->GetOutput();
-        }
-        correcter->SetNumberOfControlPoints(numberOfControlPoints);
-    }
-    else if( d->initialMeshResolution.size() == InputImageType::ImageDimension )
-    {
-        for( unsigned int i = 0; i < InputImageType::ImageDimension; i++ )
-        {
-            numberOfControlPoints[i] = static_cast<unsigned int>( d->initialMeshResolution[i] )
-                        + correcter->GetSplineOrder();
-        }
-        correcter->SetNumberOfControlPoints(numberOfControlPoints);
-    }
-
-    typedef itk::ShrinkImageFilter<OutputImageType, OutputImageType> ShrinkerType;
-    typename ShrinkerType::Pointer shrinker = ShrinkerType::New();
-    shrinker->SetInput(image);
-
-    typedef itk::ShrinkImageFilter<MaskImageType, MaskImageType> MaskShrinkerType;
-    typename MaskShrinkerType::Pointer maskshrinker = MaskShrinkerType::New();
-    maskshrinker->SetInput(maskImage);
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    shrinker->SetShrinkFactors(d->shrinkFactor);
-    maskshrinker->SetShrinkFactors(d->shrinkFactor);
-    shrinker->Update();
-    maskshrinker->Update();
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
+        parameters.iterations.assign(d->numberOfIterations.begin(), d->numberOfIterations.end());
     }
 
-    correcter->SetInput(shrinker->GetOutput());
-    correcter->SetMaskImage(maskshrinker->GetOutput());
-
-    // Histogram sharpening options
-
-    if( d->bfFWHM )
-    {
-        correcter->SetBiasFieldFullWidthAtHalfMaximum(d->bfFWHM);
-    }
-        
-    if( d->wienerFilterNoise )
-    {
-        correcter->SetWienerFilterNoise(d->wienerFilterNoise);
-    }
-        
-    if( d->nbHistogramBins )
+    d->engine.setParameters(parameters);
+    d->engine.setComputeBiasField(d->saveBias != 0);
+    d->engine.setProgressCallback([this](double value)
     {
-        correcter->SetNumberOfHistogramBins(d->nbHistogramBins);
-    }
+        emit progressed(static_cast<int>(100 * value));
+    });
 
-    try
-    {
-        correcter->Update();
-    }
-    catch( itk::ExceptionObject & err )
+    if (d->engine.update() != medN4BiasCorrectionEngine::Succeeded)
     {
-        std::cout << "Exception caught: " << err << std::endl;
         return medAbstractProcessLegacy::FAILURE;
     }
-    catch( ... )
-    {
-        qDebug() << "Unknown exception caught." << endl;
-        return medAbstractProcessLegacy::FAILURE;
-    }
-    
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-    // Output
-    // Reconstruct the bias field at full image resolution.  Divide
-    // the original input image by the bias field to get the final
-    // corrected image.
-
-    typedef itk::BSplineControlPointImageFilter<
-        CorrecterType::BiasFieldControlPointLatticeType,
-        CorrecterType::ScalarImageType> BSplinerType;
-    typename BSplinerType::Pointer bspliner = BSplinerType::New();
-    bspliner->SetInput(correcter->GetLogBiasFieldControlPointLattice());
-    bspliner->SetSplineOrder(correcter->GetSplineOrder());
-    bspliner->SetSize(image->GetLargestPossibleRegion().GetSize());
-    bspliner->SetOrigin(newOrigin);
-    bspliner->SetDirection(image->GetDirection());
-    bspliner->SetSpacing(image->GetSpacing());
-    bspliner->Update();
 
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    typename OutputImageType::Pointer logField = OutputImageType::New();
-    logField->SetOrigin(image->GetOrigin());
-    logField->SetSpacing(image->GetSpacing());
-    logField->SetRegions(image->GetLargestPossibleRegion());
-    logField->SetDirection(image->GetDirection());
-    logField->Allocate();
-
-    itk::ImageRegionIterator<CorrecterType::ScalarImageType> IB(
-        bspliner->GetOutput(),
-        bspliner->GetOutput()->GetLargestPossibleRegion() );
-    itk::ImageRegionIterator<OutputImageType> IF( logField,
-        logField->GetLargestPossibleRegion() );
-    for( IB.GoToBegin(), IF.GoToBegin(); !IB.IsAtEnd(); ++IB, ++IF )
-    {
-        IF.Set( IB.Get()[0] );
-    }
-    
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    typedef itk::ExpImageFilter<OutputImageType, OutputImageType> ExpFilterType;
-    typename ExpFilterType::Pointer expFilter = ExpFilterType::New();
-    expFilter->SetInput(logField);
-    expFilter->Update();
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    typedef itk::DivideImageFilter<OutputImageType, OutputImageType, OutputImageType> DividerType;
-    typename DividerType::Pointer divider = DividerType::New();
-    divider->SetInput1(image);
-    divider->SetInput2(expFilter->GetOutput());
-    divider->Update();
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    typename OutputImageType::RegionType inputRegion;
-    inputRegion.SetIndex(imageIndex);
-    inputRegion.SetSize(imageSize);
-
-    typedef itk::ExtractImageFilter<OutputImageType, OutputImageType> CropperType;
-    typename CropperType::Pointer cropper = CropperType::New();
-    cropper->SetInput(divider->GetOutput());
-    cropper->SetExtractionRegion(inputRegion);
-    cropper->SetDirectionCollapseToSubmatrix();
-    cropper->Update();
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    typename CropperType::Pointer biasFieldCropper = CropperType::New();
-    biasFieldCropper->SetInput(expFilter->GetOutput());
-    biasFieldCropper->SetExtractionRegion(inputRegion);
-    biasFieldCropper->SetDirectionCollapseToSubmatrix();
-    biasFieldCropper->Update();
-
-    if (d->cancelAsked)
-    {
-        return medAbstractProcessLegacy::FAILURE;
-    }
-
-    d->output->setData(cropper->GetOutput());
+    d->output = medAbstractDataFactory::instance()->createSmartPointer("itkDataImageFloat3");
+    d->output->setData(d->engine.output().GetPointer());
     medUtilities::setDerivedMetaData(d->output, d->input, "N4-corrected");
 
     if(d->saveBias)
     {
-        d->biasField->setData(biasFieldCropper->GetOutput());
+        d->biasField = medAbstractDataFactory::instance()->createSmartPointer("itkDataImageFloat3");
+        d->biasField->setData(d->engine.biasField().GetPointer());
         medUtilities::setDerivedMetaData(d->biasField, d->input, "bias");
         medDataManager::instance()->importData(d->biasField, false);
     }
@@ -17,6 +17,7 @@
 #include <medAbstractImageData.h>
 #include <medDataManager.h>
 #include <medMetaDataKeys.h>
+#include <medPolygonRasterizer.h>
 #include <medTagContours.h>
 #include <medIntParameterL.h>
 #include <medUtilities.h>
@@ -34,6 +35,37 @@
 #include <vtkPolyDataMapper.h>
 #include <vtkPolyLine.h>
 #include <vtkPointData.h>
+#include <vtkCamera.h>
+#include <vtkMatrix4x4.h>
+#include <vtkRenderer.h>
+
+#include <QDataStream>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include <array>
+
+/**
+ * Interpolation between two successive master contours. Inputs are copied
+ * on the GUI thread so that the curves can be computed in the background.
+ * The ROI pointers only identify the pair and are never used off the GUI
+ * thread.
+ */
+struct polygonLabelInterpolation
+{
+    polygonRoi *first;
+    polygonRoi *second;
+    QByteArray firstKey;
+    QByteArray secondKey;
+    unsigned int minSlice;
+    unsigned int maxSlice;
+    vtkSmartPointer<vtkPolyData> minNodes;
+    vtkSmartPointer<vtkPolyData> minContour;
+    vtkSmartPointer<vtkPolyData> maxNodes;
+    vtkSmartPointer<vtkPolyData> maxContour;
+    std::array<double, 16> worldToView;
+    QList<QVector<QVector3D> > curves;
+};
 
 class medLabelPolygonsPrivate
 {
@@ -50,12 +82,28 @@ public:
     baseViewEvent *eventCursor;
     medLabelProperty property;
     bool enableInterpolation;
+
+    // Intermediate contours currently shown, per pair of master contours
+    struct InterpolatedPair
+    {
+        polygonRoi *first;
+        polygonRoi *second;
+        QByteArray firstKey;
+        QByteArray secondKey;
+        QList<polygonRoi *> rois;
+    };
+    QList<InterpolatedPair> interpolatedPairs;
+    // Intermediate contours of changed pairs, shown until their replacements are published
+    QList<polygonRoi *> staleRois;
+    QFutureWatcher<QList<polygonLabelInterpolation> > interpolationWatcher;
+    bool interpolationPending;
+    bool interpolationRequested;
 };
 
 medLabelPolygonsPrivate::medLabelPolygonsPrivate(medAbstractImageView *view, baseViewEvent *eventCursor,
                                                  QColor &color, QString &name, int position, bool selected,
                                                  bool interpolate)
-    : eventCursor(eventCursor), property(name, color, position, selected), enableInterpolation(interpolate)//, isActivated(true)
+    : eventCursor(eventCursor), property(name, color, position, selected), enableInterpolation(interpolate), interpolationPending(false), interpolationRequested(false)//, isActivated(true)
 {
     vtkImageView2D *view2d = static_cast<medVtkViewBackend *>(view->backend())->view2D;
     this->view = view;
@@ -71,6 +119,8 @@ void medLabelPolygonsPrivate::clearRois()
         delete roi;
     }
     rois.clear();
+    interpolatedPairs.clear();
+    staleRois.clear();
 }
 
 medLabelPolygonsPrivate::~medLabelPolygonsPrivate()
@@ -83,6 +133,7 @@ polygonLabel::polygonLabel(medAbstractImageView *view, baseViewEvent *eventCurso
                            int position, bool isSelected, bool interpolate) :
     d(new medLabelPolygonsPrivate(view, eventCursor, color, name, position, isSelected, interpolate))
 {
+    connect(&d->interpolationWatcher, SIGNAL(finished()), this, SLOT(publishInterpolation()));
 }
 
 polygonLabel::~polygonLabel()
@@ -214,6 +265,8 @@ void polygonLabel::removeIntermediateContours()
             delete roi;
         }
     }
+    d->interpolatedPairs.clear();
+    d->staleRois.clear();
 }
 
 void polygonLabel::setEnableInterpolation(bool state)
@@ -382,6 +435,8 @@ void polygonLabel::initializeMaskData(medAbstractData * imageData, medAbstractDa
 
 vtkSmartPointer<vtkPolyData> polygonLabel::getContoursAsPolyData(int label)
 {
+    finishInterpolation();
+
     vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
     append->SetUserManagedInputs(true);
     append->SetNumberOfInputs(d->rois.size());
@@ -417,6 +472,8 @@ QVector<medWorldPosContours> polygonLabel::getContoursAsNodes()
 
 void polygonLabel::createMask(int label, QString &desc)
 {
+    finishInterpolation();
+
     vtkImageView2D *view2d = getView2D();
     if (!view2d)
         return;
@@ -496,89 +553,25 @@ void polygonLabel::createMask(int label, QString &desc)
     auto *inputData = qobject_cast<medAbstractImageData*>(data);
     initializeMaskData(inputData, output);
     UChar3ImageType::Pointer m_itkMask = dynamic_cast<UChar3ImageType*>( reinterpret_cast<itk::Object*>(output->data()) );
+    unsigned int x=0, y=0, z=0;
+    medPolygonRasterizer::sliceAxes(d->sliceOrientation, x, y, z);
+
+    QMap<int, QVector<QPolygonF> > slicePolygons;
+    double point[3];
     for(QPair<vtkPolygon *, int> polygon : polygons)
     {
-        double bounds[6];
-        polygon.first->GetBounds(bounds);
-        unsigned int x=0, y=0, z=0;
-        unsigned int bx=0, by=0;
-        int dimX=0, dimY=0;
-        switch (d->sliceOrientation)
-        {
-            case 0 :
-            {
-                dimX = inputData->yDimension();
-                dimY = inputData->zDimension();
-                x = 1;
-                y = 2;
-                z = 0;
-                bx = 2;
-                by = 4;
-                break;
-            }
-            case 1 :
-            {
-                dimX = inputData->xDimension();
-                dimY = inputData->zDimension();
-                x = 0;
-                y = 2;
-                z = 1;
-                bx = 0;
-                by = 4;
-                break;
-            }
-            case 2 :
-            {
-                dimX = inputData->xDimension();
-                dimY = inputData->yDimension();
-                x = 0;
-                y = 1;
-                z = 2;
-                bx = 0;
-                by = 2;
-                break;
-            }
-        }
-
-        // Qt rasterization
         int nbPoints = polygon.first->GetPoints()->GetNumberOfPoints();
         vtkPoints *pointsArray = polygon.first->GetPoints();
         QPolygonF polygonF;
         for(int i=0; i<nbPoints; i++)
         {
-            polygonF << QPointF(pointsArray->GetPoint(i)[x], pointsArray->GetPoint(i)[y]);
-        }
-
-        QPainterPath path;
-        path.addPolygon(polygonF);
-
-        QBrush brush;
-        brush.setColor(Qt::white);
-        brush.setStyle(Qt::SolidPattern);
-
-        QImage imagePolygon(dimX,dimY,QImage::Format_RGB16);
-        imagePolygon.fill(Qt::black);
-        QPainter painter;
-        painter.begin(&imagePolygon);
-        painter.fillPath(path,brush);
-
-        for(int i=(int)bounds[bx]; i<=(int)bounds[bx+1]; i++)
-        {
-            for(int j=(int)bounds[by]; j<=(int)bounds[by+1]; j++)
-            {
-                QRgb val = imagePolygon.pixel(i,j);
-
-                if (val==qRgb(255,255,255))
-                {
-                    UChar3ImageType::IndexType index;
-                    index[x]=i;
-                    index[y]=j;
-                    index[z]=polygon.second;
-                    m_itkMask->SetPixel(index,label+1);
-                }
-            }
+            pointsArray->GetPoint(i, point);
+            polygonF << QPointF(point[x], point[y]);
         }
+        slicePolygons[polygon.second].append(polygonF);
     }
+    medPolygonRasterizer::fillSlices<UChar3ImageType>(m_itkMask, d->sliceOrientation, slicePolygons, label+1);
+
     medUtilities::setDerivedMetaData(output, inputData, desc, false, false);
 
     output->setMetaData(medMetaDataKeys::Toolbox.key(), "PolygonROI");
@@ -862,6 +855,23 @@ void polygonLabel::interpolateIfNeeded()
     if (!d->enableInterpolation)
         return;
 
+    if (d->interpolationWatcher.isRunning())
+    {
+        // Edits made while computing are handled once the result comes back
+        d->interpolationRequested = true;
+        return;
+    }
+    d->interpolationRequested = false;
+
+    QList<polygonRoi *> masterRois;
+    for (polygonRoi *roi : d->rois)
+    {
+        if (roi->isMasterRoi())
+        {
+            masterRois.append(roi);
+        }
+    }
+
     if (d->rois.size() < 2)
         return;
 
@@ -876,45 +886,189 @@ void polygonLabel::interpolateIfNeeded()
         }
     }
 
-    removeIntermediateContours();
-    if (d->rois.size() >= 2)
+    std::sort(d->rois.begin(), d->rois.end(), polygonLabel::sortRois);
+    std::sort(masterRois.begin(), masterRois.end(), polygonLabel::sortRois);
+
+    // Pairs whose master contours did not change keep their intermediate
+    // contours, the others are recomputed in the background
+    vtkImageView2D *view2d = static_cast<medVtkViewBackend*>(d->view->backend())->view2D;
+    std::array<double, 16> worldToView;
+    vtkRenderer *renderer = view2d->GetRenderer();
+    vtkMatrix4x4 *matrix = renderer->GetActiveCamera()->GetCompositeProjectionTransformMatrix(renderer->GetTiledAspectRatio(), 0, 1);
+    std::copy(&matrix->Element[0][0], &matrix->Element[0][0] + 16, worldToView.begin());
+
+    QList<medLabelPolygonsPrivate::InterpolatedPair> keptPairs;
+    QVector<bool> isKept(d->interpolatedPairs.size(), false);
+    QList<polygonLabelInterpolation> jobs;
+    for (int i = 0; i + 1 < masterRois.size(); i++)
+    {
+        polygonRoi *firstRoi = masterRois.at(i);
+        polygonRoi *secondRoi = masterRois.at(i+1);
+        QByteArray firstKey = contourKey(firstRoi);
+        QByteArray secondKey = contourKey(secondRoi);
+
+        bool upToDate = false;
+        for (int j = 0; j < d->interpolatedPairs.size() && !upToDate; j++)
+        {
+            const medLabelPolygonsPrivate::InterpolatedPair &pair = d->interpolatedPairs.at(j);
+            if (!isKept[j] && pair.first == firstRoi && pair.second == secondRoi &&
+                pair.firstKey == firstKey && pair.secondKey == secondKey)
+            {
+                isKept[j] = true;
+                keptPairs.append(pair);
+                upToDate = true;
+            }
+        }
+
+        if (upToDate || secondRoi->getIdSlice() - firstRoi->getIdSlice() < 2)
+        {
+            continue;
+        }
+
+        polygonLabelInterpolation job;
+        job.first = firstRoi;
+        job.second = secondRoi;
+        job.firstKey = firstKey;
+        job.secondKey = secondKey;
+        job.minSlice = firstRoi->getIdSlice();
+        job.maxSlice = secondRoi->getIdSlice();
+
+        vtkContourRepresentation *minContour = firstRoi->getContour()->GetContourRepresentation();
+        vtkContourRepresentation *maxContour = secondRoi->getContour()->GetContourRepresentation();
+        job.minNodes = vtkSmartPointer<vtkPolyData>::New();
+        minContour->GetNodePolyData(job.minNodes);
+        job.minContour = vtkSmartPointer<vtkPolyData>::New();
+        job.minContour->DeepCopy(minContour->GetContourRepresentationAsPolyData());
+        job.maxNodes = vtkSmartPointer<vtkPolyData>::New();
+        maxContour->GetNodePolyData(job.maxNodes);
+        job.maxContour = vtkSmartPointer<vtkPolyData>::New();
+        job.maxContour->DeepCopy(maxContour->GetContourRepresentationAsPolyData());
+        job.worldToView = worldToView;
+        jobs.append(job);
+    }
+
+    for (int j = 0; j < d->interpolatedPairs.size(); j++)
+    {
+        if (!isKept[j])
+        {
+            d->staleRois.append(d->interpolatedPairs.at(j).rois);
+        }
+    }
+    d->interpolatedPairs = keptPairs;
+
+    if (jobs.isEmpty())
+    {
+        deleteIntermediateRois(d->staleRois);
+        d->staleRois.clear();
+    }
+    else
+    {
+        d->interpolationPending = true;
+        d->interpolationWatcher.setFuture(QtConcurrent::run(&polygonLabel::computeInterpolations, jobs));
+    }
+
+    connectRois();
+    manageVisibility();
+}
+
+/**
+ * Wait for the interpolation being computed and publish it, so that the
+ * intermediate contours are complete before the contours are read.
+ */
+void polygonLabel::finishInterpolation()
+{
+    while (d->interpolationPending)
+    {
+        d->interpolationWatcher.waitForFinished();
+        publishInterpolation();
+    }
+}
+
+void polygonLabel::publishInterpolation()
+{
+    // Already published by finishInterpolation()
+    if (!d->interpolationPending || !d->interpolationWatcher.isFinished())
+    {
+        return;
+    }
+    d->interpolationPending = false;
+
+    QList<polygonLabelInterpolation> jobs = d->interpolationWatcher.result();
+
+    // Drop the result if contours were edited, added or removed meanwhile
+    bool upToDate = d->enableInterpolation && !d->interpolationRequested;
+    for (int i = 0; i < jobs.size() && upToDate; i++)
+    {
+        const polygonLabelInterpolation &job = jobs.at(i);
+        upToDate = d->rois.contains(job.first) && d->rois.contains(job.second) &&
+                   job.first->isMasterRoi() && job.second->isMasterRoi() &&
+                   contourKey(job.first) == job.firstKey && contourKey(job.second) == job.secondKey;
+    }
+    if (!upToDate)
     {
-        std::sort(d->rois.begin(), d->rois.end(), polygonLabel::sortRois);
+        interpolateIfNeeded();
+        return;
+    }
 
-        QList<polygonRoi *> listOfRois;
-        for (int i=0; i<d->rois.size()-1; i++)
+    // The new intermediate contours replace the stale ones at once
+    deleteIntermediateRois(d->staleRois);
+    d->staleRois.clear();
+    for (const polygonLabelInterpolation &job : jobs)
+    {
+        if ( job.curves.size() != static_cast<int>(job.maxSlice-job.minSlice-1) )
         {
-            polygonRoi *firstRoi = d->rois.at(i);
-            polygonRoi *secondRoi = d->rois.at(i+1);
-            listOfRois.append(interpolateBetween2Slices(firstRoi, secondRoi));
+            emit sendErrorMessage(getName() + ": Unable to interpolate between slice: " + QString::number(job.minSlice+1) + " and " + QString::number(job.maxSlice-1) + ". Operation aborted");
         }
-        d->rois.append(listOfRois);
+
+        medLabelPolygonsPrivate::InterpolatedPair pair;
+        pair.first = job.first;
+        pair.second = job.second;
+        pair.firstKey = job.firstKey;
+        pair.secondKey = job.secondKey;
+        pair.rois = createIntermediateRois(job.curves, job.minSlice);
+        d->rois.append(pair.rois);
+        d->interpolatedPairs.append(pair);
     }
+
     connectRois();
     manageVisibility();
+    d->view->render();
 }
 
-QList<polygonRoi *> polygonLabel::interpolateBetween2Slices(polygonRoi *firstRoi, polygonRoi *secondRoi)
+QByteArray polygonLabel::contourKey(polygonRoi *roi)
 {
-    QList<polygonRoi *> outputRois;
-    vtkContourRepresentation* minContour;
-    vtkContourRepresentation* maxContour;
-    // Contour first ROI
-    minContour = firstRoi->getContour()->GetContourRepresentation();
-    unsigned int minSlice = firstRoi->getIdSlice();
-
-    maxContour = secondRoi->getContour()->GetContourRepresentation();
-    unsigned int maxSlice = secondRoi->getIdSlice();
-    // Compute intermediate ROIs between two successive ROIs
-    QList<QVector<QVector3D>> listOfNodes = generateIntermediateCurves(maxContour,minContour,maxSlice-minSlice-1);
-    if ( listOfNodes.size() != static_cast<int>(maxSlice-minSlice-1) )
+    vtkContourRepresentation *contourRep = roi->getContour()->GetContourRepresentation();
+
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << roi->getIdSlice() << contourRep->GetNumberOfNodes();
+    double position[3];
+    for (int i = 0; i < contourRep->GetNumberOfNodes(); i++)
+    {
+        contourRep->GetNthNodeWorldPosition(i, position);
+        stream << position[0] << position[1] << position[2];
+    }
+    return key;
+}
+
+QList<polygonLabelInterpolation> polygonLabel::computeInterpolations(QList<polygonLabelInterpolation> jobs)
+{
+    for (polygonLabelInterpolation &job : jobs)
     {
-        emit sendErrorMessage(getName() + ": Unable to interpolate between slice: " + QString::number(minSlice+1) + " and " + QString::number(maxSlice-1) + ". Operation aborted");
+        job.curves = generateIntermediateCurves(job.maxNodes, job.maxContour,
+                                                job.minNodes, job.minContour,
+                                                job.maxSlice-job.minSlice-1, job.worldToView.data());
     }
+    return jobs;
+}
+
+QList<polygonRoi *> polygonLabel::createIntermediateRois(const QList<QVector<QVector3D> > &curves, unsigned int firstSlice)
+{
+    QList<polygonRoi *> outputRois;
 
     vtkImageView2D *view2d = static_cast<medVtkViewBackend*>(d->view->backend())->view2D;
-    unsigned int idSlice = minSlice+1;
-    for (QVector<QVector3D>& nodes : listOfNodes)
+    unsigned int idSlice = firstSlice+1;
+    for (const QVector<QVector3D>& nodes : curves)
     {
         QColor color = d->property.mainColor;
         if (d->property.scoreState && d->property.checked)
@@ -929,31 +1083,39 @@ QList<polygonRoi *> polygonLabel::interpolateBetween2Slices(polygonRoi *firstRoi
 
         outputRois.append(polyRoi);
     }
-    listOfNodes.clear();
     return outputRois;
 }
 
-QList<QVector<QVector3D>> polygonLabel::generateIntermediateCurves(vtkContourRepresentation* firstContour, vtkContourRepresentation* secondContour, int nb)
+void polygonLabel::deleteIntermediateRois(const QList<polygonRoi *> &rois)
 {
-    vtkSmartPointer<vtkPolyData> firstCurve = vtkSmartPointer<vtkPolyData>::New();
-    firstContour->GetNodePolyData(firstCurve);
-
-    vtkSmartPointer<vtkPolyData> secondCurve = vtkSmartPointer<vtkPolyData>::New();
-    secondContour->GetNodePolyData(secondCurve);
+    for (polygonRoi *roi : rois)
+    {
+        // Skip contours deleted meanwhile, or turned into master ones by an edit
+        if (d->rois.contains(roi) && !roi->isMasterRoi())
+        {
+            d->rois.removeOne(roi);
+            delete roi;
+        }
+    }
+}
 
-    int nbNodesFirst = firstContour->GetNumberOfNodes();
-    int nbNodesSecond = secondContour->GetNumberOfNodes();
+QList<QVector<QVector3D>> polygonLabel::generateIntermediateCurves(vtkPolyData *firstCurve, vtkPolyData *firstContour,
+                                                                   vtkPolyData *secondCurve, vtkPolyData *secondContour,
+                                                                   int nb, const double *worldToView)
+{
+    int nbNodesFirst = firstCurve->GetNumberOfPoints();
+    int nbNodesSecond = secondCurve->GetNumberOfPoints();
 
     bool curve2ToCurve1 = false;
     vtkSmartPointer<vtkPolyData> startCurve = firstCurve, endCurve = secondCurve;
-    vtkSmartPointer<vtkPolyData> poly = firstContour->GetContourRepresentationAsPolyData();
+    vtkSmartPointer<vtkPolyData> poly = firstContour;
 
     int max = nbNodesSecond-1;
     if (nbNodesFirst >= nbNodesSecond)
     {
         startCurve = secondCurve;
         endCurve = firstCurve;
-        poly = secondContour->GetContourRepresentationAsPolyData();
+        poly = secondContour;
         max = nbNodesFirst-1;
         curve2ToCurve1 = true;       
     }
@@ -963,8 +1125,8 @@ QList<QVector<QVector3D>> polygonLabel::generateIntermediateCurves(vtkContourRep
     {
         resampleCurve(startCurve, max, poly);
     }
-    reorderPolygon(startCurve);
-    reorderPolygon(endCurve);
+    reorderPolygon(startCurve, worldToView);
+    reorderPolygon(endCurve, worldToView);
 
     QList<QVector<QVector3D>> listOfNodes;
     for(int i=1; i<=nb; i++)
@@ -994,12 +1156,12 @@ QList<QVector<QVector3D>> polygonLabel::generateIntermediateCurves(vtkContourRep
     return listOfNodes;
 }
 
-void polygonLabel::reorderPolygon(vtkPolyData *poly)
+void polygonLabel::reorderPolygon(vtkPolyData *poly, const double *worldToView)
 {
-    vtkImageView2D *view2d = static_cast<medVtkViewBackend*>(d->view->backend())->view2D;
-
+    // View coordinates grow with display coordinates, so the extreme nodes
+    // are found without the renderer
     double displayPoint[3];
-    double *worldPoint;
+    double worldPoint[3];
     auto xmin = VTK_DOUBLE_MAX;
     int xminIndex = 0;
     auto ymin = VTK_DOUBLE_MAX;
@@ -1007,8 +1169,13 @@ void polygonLabel::reorderPolygon(vtkPolyData *poly)
 
     for(int i=0; i<poly->GetNumberOfPoints(); i++)
     {
-        worldPoint = poly->GetPoint(i);
-        vtkInteractorObserver::ComputeWorldToDisplay(view2d->GetRenderer(), worldPoint[0], worldPoint[1], worldPoint[2], displayPoint);
+        poly->GetPoint(i, worldPoint);
+        double w = worldToView[12]*worldPoint[0] + worldToView[13]*worldPoint[1] + worldToView[14]*worldPoint[2] + worldToView[15];
+        for (int c = 0; c < 2; c++)
+        {
+            displayPoint[c] = (worldToView[4*c]*worldPoint[0] + worldToView[4*c+1]*worldPoint[1] +
+                               worldToView[4*c+2]*worldPoint[2] + worldToView[4*c+3]) / w;
+        }
 
         if (displayPoint[0] < xmin)
         {
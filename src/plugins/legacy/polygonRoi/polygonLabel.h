@@ -21,6 +21,7 @@
 class medLabelPolygonsPrivate;
 class baseViewEvent;
 class medLabelProperty;
+struct polygonLabelInterpolation;
 
 typedef itk::Image<unsigned char, 3> UChar3ImageType;
 
@@ -84,6 +85,9 @@ public:
 public slots:
     void interpolateIfNeeded();
 
+private slots:
+    void publishInterpolation();
+
 signals:
     void enableOtherViewsVisibility(bool state);
     void sendErrorMessage(QString);
@@ -92,10 +96,16 @@ private:
     bool isSameOrientation(int orientation);
     medLabelPolygonsPrivate* const d;
 
-    QList<polygonRoi *> interpolateBetween2Slices(polygonRoi *firstRoi, polygonRoi *secondRoi);
-    QList<QVector<QVector3D> > generateIntermediateCurves( vtkContourRepresentation* firstContour,  vtkContourRepresentation* secondContour, int nb);
+    QList<polygonRoi *> createIntermediateRois(const QList<QVector<QVector3D> > &curves, unsigned int firstSlice);
+    void deleteIntermediateRois(const QList<polygonRoi *> &rois);
+    void finishInterpolation();
+    static QByteArray contourKey(polygonRoi *roi);
+    static QList<polygonLabelInterpolation> computeInterpolations(QList<polygonLabelInterpolation> jobs);
+    static QList<QVector<QVector3D> > generateIntermediateCurves(vtkPolyData *firstCurve, vtkPolyData *firstContour,
+                                                                 vtkPolyData *secondCurve, vtkPolyData *secondContour,
+                                                                 int nb, const double *worldToView);
     static void resampleCurve(vtkPolyData *poly, int nbPoints, vtkPolyData *poly2);
-    void reorderPolygon(vtkPolyData *poly);
+    static void reorderPolygon(vtkPolyData *poly, const double *worldToView);
     static bool sortRois(const polygonRoi *p1, const polygonRoi *p2);
     void connectRois();
     static double getDistance(double mousePos[2], double contourPos[2]);
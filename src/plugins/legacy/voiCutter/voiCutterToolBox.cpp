@@ -21,6 +21,7 @@
 #include <medCompositeParameterL.h>
 #include <medDataManager.h>
 #include <medPluginManager.h>
+#include <medPolygonRasterizer.h>
 #include <medStringListParameterL.h>
 #include <medTabbedViewContainers.h>
 #include <medToolBoxFactory.h>
@@ -783,7 +784,6 @@ void voiCutterToolBox::cutThroughImage(QList<vtkPolygon*>*RoiList, QList<vtkPoin
     int valOfOutside = medUtilitiesITK::minimumValue(d->input);
 
     vtkImageView3D *view3D =  static_cast<medVtkViewBackend*>(d->currentView->backend())->view3D;
-    int *dim = view3D->GetMedVtkImageInfo()->dimensions;
 
     IMAGE *inputImage = dynamic_cast<IMAGE*>((itk::Object*)(d->input->data()));
 
@@ -793,158 +793,28 @@ void voiCutterToolBox::cutThroughImage(QList<vtkPolygon*>*RoiList, QList<vtkPoin
     duplicator->Update();
     typename IMAGE::Pointer clonedImage = duplicator->GetOutput();
 
-    typename IMAGE::IndexType index;
     unsigned int x=0, y=0, z=0;
-    unsigned int bx=0, by=0;
-
-    switch (stackOrientation)
-    {
-        case 0 :
-        {
-            x = 1;
-            y = 2;
-            z = 0;
-            bx = 2;
-            by = 4;
-            break;
-        }
-        case 1 :
-        {
-            x = 0;
-            y = 2;
-            z = 1;
-            bx = 0;
-            by = 4;
-            break;
-        }
-        case 2 :
-        {
-            x = 0;
-            y = 1;
-            z = 2;
-            bx = 0;
-            by = 2;
-            break;
-        }
-    }
+    medPolygonRasterizer::sliceAxes(stackOrientation, x, y, z);
 
+    QMap<int, QVector<QPolygonF> > polygons;
+    double point[3];
     for(int stack = 0; stack<stackMax; stack++)
     {
-        double *boundsPoints;
+        vtkPoints *pointsArray = RoiList->at(stack)->GetPoints();
         int nbPoints = RoiList->at(stack)->GetNumberOfPoints();
-        boundsPoints = RoiPointList->at(stack)->GetBounds(); //(xmin,xmax, ymin,ymax, zmin,zmax)
-
-        int i, end_i, j, end_j, start_i, start_j;
-
-        if (dim[x]<=boundsPoints[bx+1])
-        {
-            end_i = dim[x]-1;
-        }
-        else
-        {
-            end_i = boundsPoints[bx+1];
-        }
-
-        if (dim[y]<=boundsPoints[by+1])
-        {
-            end_j = dim[y]-1;
-        }
-        else
-        {
-            end_j = boundsPoints[by+1];
-        }
-
-        if (boundsPoints[bx]>=0)
-        {
-            start_i = boundsPoints[bx];
-        }
-        else
-        {
-            start_i = 0;
-        }
 
-        if (boundsPoints[by]>=0)
-        {
-            start_j = boundsPoints[by];
-        }
-        else
-        {
-            start_j = 0;
-        }
-
-        // Qt rasterization
-        vtkPoints *pointsArray = RoiList->at(stack)->GetPoints();
-        
         QPolygonF polygon;
         for(int i=0; i<nbPoints; i++)
         {
-            polygon << QPointF(pointsArray->GetPoint(i)[x],
-                               pointsArray->GetPoint(i)[y]);
-        }
-
-        QPainterPath path;
-        path.addPolygon(polygon);
-
-        QBrush brush;
-        brush.setColor(Qt::white);
-        brush.setStyle(Qt::SolidPattern);
-
-        QImage imagePolygon(dim[x], dim[y], QImage::Format_RGB16);
-        imagePolygon.fill(Qt::black);
-        QPainter painter;
-        painter.begin(&imagePolygon);
-        painter.fillPath(path, brush);
-        
-        if (m == Keep)
-        {
-            for(i = 0; i<dim[x]; i++)
-            {
-                for(j = 0; j<dim[y]; j++)
-                {
-                    index[x] = i;
-                    index[y] = j;
-                    index[z] = stack;
-                    if (i >= start_i && i <= end_i)
-                    {
-                        if (j >= start_j && j <= end_j)
-                        {
-                            QRgb val = imagePolygon.pixel(i, j);
-                            if (val != qRgb(255, 255, 255))
-                            {
-                                clonedImage->SetPixel(index, valOfOutside);
-                            }
-                        }
-                        else
-                        {
-                            clonedImage->SetPixel(index, valOfOutside);
-                        }
-                    }
-                    else
-                    {
-                        clonedImage->SetPixel(index, valOfOutside);
-                    }
-                }
-            }
-        }
-        if (m == Remove)
-        {
-            for(i = start_i; i<=end_i; i++)
-            {
-                for(j = start_j; j<=end_j; j++)
-                {
-                    index[x] = i;
-                    index[y] = j;
-                    index[z] = stack;
-                    QRgb val = imagePolygon.pixel(i, j);
-                    if (val == qRgb(255, 255, 255))
-                    {
-                        clonedImage->SetPixel(index, valOfOutside);
-                    }
-                }
-            }
+            pointsArray->GetPoint(i, point);
+            polygon << QPointF(point[x], point[y]);
         }
+        polygons[stack].append(polygon);
     }
 
+    // Keep clears the voxels outside the VOI, Remove the ones inside
+    medPolygonRasterizer::fillSlices<IMAGE>(clonedImage, stackOrientation, polygons, valOfOutside, m == Keep);
+
     d->resultData = medAbstractDataFactory::instance()->createSmartPointer(d->input->identifier());
     d->resultData->setData(clonedImage);
 
@@ -49,6 +49,7 @@ vtkDataMesh4DInteractor::vtkDataMesh4DInteractor(medAbstractView* parent): vtkDa
 {
     d->view = dynamic_cast<medAbstractImageView *>(parent);
     d->data = nullptr;
+    d->sequence = nullptr;
 
     medVtkViewBackend *backend = static_cast<medVtkViewBackend*>(parent->backend());
     d->view2d = backend->view2D;
@@ -119,9 +120,24 @@ void vtkDataMesh4DInteractor::setInputData(medAbstractData *data)
     }
 }
 
+void vtkDataMesh4DInteractor::prefetchTimes (const QList<double> &times)
+{
+    if(!d->sequence)
+        return;
+
+    std::vector<unsigned int> ids;
+    for(double time : times)
+    {
+        unsigned int id = 0;
+        if(d->sequence->FindMetaDataSet(time, id))
+            ids.push_back(id);
+    }
+    d->sequence->PrefetchFrames(ids);
+}
+
 void vtkDataMesh4DInteractor::setCurrentTime (double time)
 {
-    if(d->sequence->GetTime() == time)
+    if(!d->sequence || d->sequence->GetTime() == time)
         return;
 
     d->sequence->UpdateToTime(time);
@@ -38,6 +38,7 @@ public:
 
 public slots:
     virtual void setCurrentTime (double time);
+    virtual void prefetchTimes (const QList<double> &times);
 
 private:
     static QStringList dataHandled();
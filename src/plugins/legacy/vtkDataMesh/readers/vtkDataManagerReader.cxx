@@ -184,7 +184,7 @@ vtkDataSet*vtkDataManagerReader::FileToDataSet(const char *type, const std::stri
 }
 
 //----------------------------------------------------------------------------
-vtkMetaDataSet*vtkDataManagerReader::CreateMetaDataSetFromXMLElement (vtkXMLDataElement *element)
+vtkMetaDataSet*vtkDataManagerReader::CreateMetaDataSetFromXMLElement (vtkXMLDataElement *element, bool isFrame)
 {
     vtkMetaDataSet *metadataset = nullptr;
 
@@ -289,6 +289,16 @@ vtkMetaDataSet*vtkDataManagerReader::CreateMetaDataSetFromXMLElement (vtkXMLData
             ext = fileName.substr(pos2+1);
         }
 
+        // Let the sequence read its frames only when they are needed.
+        bool lazy = isFrame && (ext == "vtk"
+                                || (ext == "vtp" && type == vtkMetaDataSet::VTK_META_SURFACE_MESH)
+                                || (ext == "vtu" && type == vtkMetaDataSet::VTK_META_VOLUME_MESH));
+        if (lazy)
+        {
+            metadataset->SetFilePath (fileName.c_str());
+            return metadataset;
+        }
+
         // Search for the reader matching this extension.
         const char *rname = 0;
         for(const vtkDataManagerReaderEntry *r =
@@ -314,11 +324,12 @@ vtkMetaDataSet*vtkDataManagerReader::CreateMetaDataSetFromXMLElement (vtkXMLData
         vtkMetaDataSetSequence *sequence = vtkMetaDataSetSequence::SafeDownCast (metadataset);
         for (unsigned int i=0; i<frames.size(); i++)
         {
-            vtkMetaDataSet *frame = this->CreateMetaDataSetFromXMLElement (frames[i]);
+            vtkMetaDataSet *frame = this->CreateMetaDataSetFromXMLElement (frames[i], true);
             if (frame)
+            {
                 sequence->AddMetaDataSet (frame);
-
-            frame->Delete();
+                frame->Delete();
+            }
         }
     }
 
@@ -62,7 +62,11 @@ protected:
   virtual vtkMetaDataSet* CreateMetaDataSetFromDataSet (vtkDataSet* dataset, const char* name);
   virtual void RestoreMetaDataSetInformation(vtkXMLDataElement* element);
 
-  virtual vtkMetaDataSet* CreateMetaDataSetFromXMLElement (vtkXMLDataElement* element);
+  /**
+     Frames of a sequence (isFrame) stored in a format their vtkMetaDataSet can read
+     are not read here, but by the sequence when they are first needed.
+  */
+  virtual vtkMetaDataSet* CreateMetaDataSetFromXMLElement (vtkXMLDataElement* element, bool isFrame = false);
   
   
 private:
@@ -16,6 +16,7 @@
 
 #include <medAbstractData.h>
 #include <medAbstractDataFactory.h>
+#include <medSettingsManager.h>
 
 #include <vtkDataManager.h>
 #include <vtkFieldData.h>
@@ -102,6 +103,9 @@ bool vtkDataMesh4DReader::read (const QString& path)
             vtkSmartPointer<vtkFieldData> newFieldData = vtkSmartPointer<vtkFieldData>::New();
             sequence->GetDataSet()->SetFieldData(newFieldData);
 
+            // frames are read when first shown; optionally, only the last ones shown are kept
+            sequence->SetMaximumNumberOfLoadedFrames(medSettingsManager::instance()->value("meshes", "maximum_loaded_frames", 0).toInt());
+
             medData->setData (sequence);
         }
         else
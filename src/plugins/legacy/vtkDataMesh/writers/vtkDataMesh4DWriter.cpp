@@ -64,9 +64,13 @@ bool vtkDataMesh4DWriter::write(const QString& path)
         return false;
     }
 
-    for(vtkMetaDataSet* dataSet : sequence->GetMetaDataSetList())
+    // all the frames are written with their metadata: none must be released meanwhile
+    int maximumNumberOfLoadedFrames = sequence->GetMaximumNumberOfLoadedFrames();
+    sequence->SetMaximumNumberOfLoadedFrames(0);
+
+    for(int i = 0; i < sequence->GetNumberOfMetaDataSets(); i++)
     {
-        addMetaDataAsFieldData(dataSet);
+        addMetaDataAsFieldData(sequence->GetMetaDataSet(i));
     }
 
     vtkDataManager* manager = vtkDataManager::New();
@@ -76,11 +80,13 @@ bool vtkDataMesh4DWriter::write(const QString& path)
     this->writer->SetInput (manager);
     this->writer->Update();
 
-    for(vtkMetaDataSet* dataSet : sequence->GetMetaDataSetList())
+    for(int i = 0; i < sequence->GetNumberOfMetaDataSets(); i++)
     {
-        clearMetaDataFieldData(dataSet);
+        clearMetaDataFieldData(sequence->GetMetaDataSet(i));
     }
 
+    sequence->SetMaximumNumberOfLoadedFrames(maximumNumberOfLoadedFrames);
+
     manager->Delete();
 
     return true;
@@ -45,8 +45,6 @@ public:
 
 private:
     typedef itk::Image<double, 3> ImageType;
-    ImageType::Pointer CastImage(medAbstractImageData *data);
-    template <class inputType> ImageType::Pointer _cast(medAbstractImageData *data);
 
 private:
     itk::SmartPointer<itk::ProcessObject> m_filter;
@@ -15,10 +15,8 @@
 
 #include <medAbstractBiasCorrectionProcess.h>
 
-#include <itkProcessObject.h>
-#include <itkSmartPointer.h>
-
 #include <medIntParameter.h>
+#include <medN4BiasCorrectionEngine.h>
 #include <medStringParameter.h>
 
 #include <medItkBiasCorrectionProcessPluginExport.h>
@@ -57,8 +55,6 @@ private:
     template <class inputType, unsigned int Dimension> medAbstractJob::medJobExitStatus _run();
     template <class inputType, unsigned int Dimension> medAbstractJob::medJobExitStatus N4BiasCorrectionCore();
 
-    float updateProgression(float &pio_rfProgression, int pi_iStepLevel = 1);
-
 private:
     medIntParameter    *m_poUIThreadNb;
     medIntParameter    *m_poUIShrinkFactors;
@@ -73,7 +69,7 @@ private:
     medDoubleParameter *m_poFInitialMeshResolutionVect2;
     medDoubleParameter *m_poFInitialMeshResolutionVect3;
 
-    itk::SmartPointer <itk::ProcessObject> m_filter;
+    medN4BiasCorrectionEngine m_engine;
     bool m_bAborting;
 };
 
@@ -3,15 +3,15 @@
 #include <dtkLog>
 
 #include <itkImage.h>
-#include <itkExtractImageFilter.h>
-#include <itkGetAverageSliceImageFilter.h>
-#include <itkMaskImageFilter.h>
-#include <itkJoinSeriesImageFilter.h>
+#include <itkMultiThreaderBase.h>
 #include <itkBrainExtractionImageFilter.h>
+#include <vnl/vnl_det.h>
 
 #include <medAbstractImageData.h>
 #include <medAbstractDataFactory.h>
 
+#include <algorithm>
+#include <vector>
 
 itkDWIBrainMaskCalculatorProcess::itkDWIBrainMaskCalculatorProcess(QObject *parent)
     : medAbstractDWIMaskingProcess(parent)
@@ -110,69 +110,94 @@ medAbstractJob::medJobExitStatus itkDWIBrainMaskCalculatorProcess::_run()
     typedef itk::Image<unsigned char, 3> MaskImageType;
 
     typename ImageType::Pointer inData = dynamic_cast<ImageType *>((itk::Object*)(this->input()->data()));
-    typename ImageType::Pointer inImage = dynamic_cast<ImageType *>((itk::Object*)(this->input()->data()));
 
     if (inData.IsNull())
         return medAbstractJob::MED_JOB_EXIT_FAILURE;
 
     try
     {
-        // first, average all images except b0
-        {
-            typedef itk::ExtractImageFilter<ImageType, ImageType> Extract4DFilterType;
-            typename ImageType::RegionType region = inData->GetLargestPossibleRegion();
-            typename ImageType::SizeType     size = region.GetSize();
-            typename ImageType::IndexType   index = region.GetIndex();
-            size[3] -= m_offset->value();
-            index[3] = m_offset->value();
-            region.SetSize  (size);
-            region.SetIndex (index);
-
-            typename Extract4DFilterType::Pointer extractor = Extract4DFilterType::New();
-            extractor->SetInput (inData);
-            extractor->SetExtractionRegion (region);
-            extractor->SetDirectionCollapseToGuess();
-
-            extractor->Update();
-
-            inData = extractor->GetOutput();
-            inData->DisconnectPipeline();
-        }
-
-        {
-            typedef itk::GetAverageSliceImageFilter<ImageType, ImageType> FilterType;
-            typename FilterType::Pointer filter = FilterType::New();
-            filter->SetInput (inData);
-            filter->SetAveragedOutDimension (3);
-
-            filter->Update();
-
-            inData = filter->GetOutput();
-            inData->DisconnectPipeline();
-            // Correct bug in ITK accumulate filter that is not keeping direction matrix
-            inData->SetDirection(inImage->GetDirection());
-        }
-
+        // first, average all images except b0, reading them straight from the
+        // 4D buffer: no extracted 4D or 3D copy is made
         typename Image3DType::Pointer auxImage = nullptr;
         {
-            typedef itk::ExtractImageFilter<ImageType, Image3DType> ExtractFilterType;
-            typename ImageType::RegionType region = inData->GetLargestPossibleRegion();
-            typename ImageType::SizeType     size = region.GetSize();
-            typename ImageType::IndexType index = region.GetIndex();
-            size[3] = 0;
-            index[3] = 0;
-            region.SetSize  (size);
-            region.SetIndex (index);
-
-            typename ExtractFilterType::Pointer extractor = ExtractFilterType::New();
-            extractor->SetInput (inData);
-            extractor->SetExtractionRegion (region);
-            extractor->SetDirectionCollapseToGuess();
-
-            extractor->Update();
-
-            auxImage = extractor->GetOutput();
-            auxImage->DisconnectPipeline();
+            const typename ImageType::RegionType region = inData->GetBufferedRegion();
+            const itk::SizeValueType nbVolumes = region.GetSize(3);
+            const itk::SizeValueType firstVolume = m_offset->value();
+
+            if (firstVolume >= nbVolumes)
+            {
+                qDebug() << "No volume to average after offset" << firstVolume;
+                return medAbstractJob::MED_JOB_EXIT_FAILURE;
+            }
+
+            // same geometry as the extraction filter, directions collapsed to guess
+            typename Image3DType::RegionType region3D;
+            typename Image3DType::SpacingType spacing;
+            typename Image3DType::PointType origin;
+            typename Image3DType::DirectionType direction;
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                region3D.SetIndex(i, region.GetIndex(i));
+                region3D.SetSize(i, region.GetSize(i));
+                spacing[i] = inData->GetSpacing()[i];
+                origin[i] = inData->GetOrigin()[i];
+                for (unsigned int j = 0; j < 3; ++j)
+                {
+                    direction(i, j) = inData->GetDirection()(i, j);
+                }
+            }
+            if (vnl_det(direction.GetVnlMatrix()) == 0.0)
+            {
+                direction.SetIdentity();
+            }
+
+            auxImage = Image3DType::New();
+            auxImage->SetRegions(region3D);
+            auxImage->SetSpacing(spacing);
+            auxImage->SetOrigin(origin);
+            auxImage->SetDirection(direction);
+            auxImage->Allocate();
+
+            const itk::SizeValueType volumeSize = region3D.GetNumberOfPixels();
+            const inputType *volumes = inData->GetBufferPointer() + firstVolume * volumeSize;
+            const itk::SizeValueType nbAveraged = nbVolumes - firstVolume;
+
+            // each thread streams its scanlines through all the volumes
+            itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+            multiThreader->ParallelizeImageRegion<3>(region3D, [&](const typename Image3DType::RegionType &subRegion)
+            {
+                const itk::SizeValueType length = subRegion.GetSize(0);
+                std::vector<double> sum(length);
+
+                typename Image3DType::IndexType index = subRegion.GetIndex();
+                const itk::IndexValueType yBegin = index[1];
+                const itk::IndexValueType yEnd = yBegin + static_cast<itk::IndexValueType>(subRegion.GetSize(1));
+                const itk::IndexValueType zEnd = index[2] + static_cast<itk::IndexValueType>(subRegion.GetSize(2));
+
+                for (; index[2] < zEnd; ++index[2])
+                {
+                    for (index[1] = yBegin; index[1] < yEnd; ++index[1])
+                    {
+                        const itk::OffsetValueType lineOffset = auxImage->ComputeOffset(index);
+                        std::fill(sum.begin(), sum.end(), 0.0);
+
+                        for (itk::SizeValueType t = 0; t < nbAveraged; ++t)
+                        {
+                            const inputType *line = volumes + t * volumeSize + lineOffset;
+                            for (itk::SizeValueType i = 0; i < length; ++i)
+                            {
+                                sum[i] += line[i];
+                            }
+                        }
+
+                        inputType *out = auxImage->GetBufferPointer() + lineOffset;
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                        {
+                            out[i] = static_cast<inputType>(sum[i] / nbAveraged);
+                        }
+                    }
+                }
+            }, nullptr);
         }
 
         // now, extract brain mask
@@ -22,6 +22,7 @@
 
 #include <medAbstractImageData.h>
 #include <medAbstractDataFactory.h>
+#include <medImageTypedView.h>
 #include <medIntParameter.h>
 
 
@@ -150,7 +151,11 @@ medAbstractJob::medJobExitStatus medItkMaskImageProcess::_run()
     if(this->mask()->Dimension() == Dimension - 1)
     {
         typedef itk::Image<unsigned char, Dimension - 1> SmallMaskType;
-        typename SmallMaskType::Pointer sma = dynamic_cast<SmallMaskType *>((itk::Object*)(this->mask()->data()));
+        typename SmallMaskType::Pointer sma = medImageTypedView<unsigned char, Dimension - 1>::mask(this->mask());
+        if (in.IsNull() || sma.IsNull())
+        {
+            return medAbstractJob::MED_JOB_EXIT_FAILURE;
+        }
         ma = MaskType::New();
         ma->Initialize();
         ma->SetRegions(in->GetLargestPossibleRegion());
@@ -174,7 +179,8 @@ medAbstractJob::medJobExitStatus medItkMaskImageProcess::_run()
     }
     else
     {
-        ma = dynamic_cast<MaskType *>((itk::Object*)(this->mask()->data()));
+        // masks of any pixel type, converted once per mask data
+        ma = medImageTypedView<unsigned char, Dimension>::mask(this->mask());
     }
 
     if(in.IsNotNull() && ma.IsNotNull())
@@ -17,7 +17,6 @@
 
 #include <itkImage.h>
 #include <itkGrayscaleMorphologicalClosingImageFilter.h>
-#include <itkBinaryBallStructuringElement.h>
 #include <itkCommand.h>
 
 
@@ -25,6 +24,8 @@
 #include <medAbstractDataFactory.h>
 #include <medIntParameter.h>
 
+#include <medItkMorphomathKernel.h>
+
 medItkClosingImageProcess::medItkClosingImageProcess(QObject *parent)
     : medAbstractClosingImageProcess(parent)
 
@@ -108,14 +109,12 @@ medAbstractJob::medJobExitStatus medItkClosingImageProcess::_run()
 
     if(in.IsNotNull())
     {
-        typedef itk::BinaryBallStructuringElement<inputType, 3> KernelType;
+        typedef medItkMorphomathKernelType KernelType;
         typedef itk::GrayscaleMorphologicalClosingImageFilter<ImageType, ImageType, KernelType> FilterType;
         typename FilterType::Pointer filter = FilterType::New();
         m_filter = filter;
 
-        KernelType kernel;
-        kernel.SetRadius(this->kernelRadius()->value());
-        kernel.CreateStructuringElement();
+        KernelType kernel = medItkMorphomathBallKernel(this->kernelRadius()->value());
 
         filter->SetKernel(kernel);
         filter->SetInput(in);
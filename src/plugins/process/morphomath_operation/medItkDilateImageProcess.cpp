@@ -17,13 +17,14 @@
 
 #include <itkImage.h>
 #include <itkGrayscaleDilateImageFilter.h>
-#include <itkBinaryBallStructuringElement.h>
 #include <itkCommand.h>
 
 #include <medAbstractImageData.h>
 #include <medAbstractDataFactory.h>
 #include <medIntParameter.h>
 
+#include <medItkMorphomathKernel.h>
+
 
 medItkDilateImageProcess::medItkDilateImageProcess(QObject *parent)
     : medAbstractDilateImageProcess(parent)
@@ -107,14 +108,12 @@ medAbstractJob::medJobExitStatus medItkDilateImageProcess::_run()
 
     if(in.IsNotNull())
     {
-        typedef itk::BinaryBallStructuringElement<inputType, 3> KernelType;
+        typedef medItkMorphomathKernelType KernelType;
         typedef itk::GrayscaleDilateImageFilter<ImageType, ImageType, KernelType> FilterType;
         typename FilterType::Pointer filter = FilterType::New();
         m_filter = filter;
 
-        KernelType kernel;
-        kernel.SetRadius(this->kernelRadius()->value());
-        kernel.CreateStructuringElement();
+        KernelType kernel = medItkMorphomathBallKernel(this->kernelRadius()->value());
 
         filter->SetKernel(kernel);
         filter->SetInput(in);
@@ -17,13 +17,14 @@
 
 #include <itkImage.h>
 #include <itkGrayscaleErodeImageFilter.h>
-#include <itkBinaryBallStructuringElement.h>
 #include <itkCommand.h>
 
 #include <medAbstractImageData.h>
 #include <medAbstractDataFactory.h>
 #include <medIntParameter.h>
 
+#include <medItkMorphomathKernel.h>
+
 medItkErodeImageProcess::medItkErodeImageProcess(QObject *parent)
     : medAbstractErodeImageProcess(parent)
 
@@ -106,14 +107,12 @@ medAbstractJob::medJobExitStatus medItkErodeImageProcess::_run()
 
     if(in.IsNotNull())
     {
-        typedef itk::BinaryBallStructuringElement<inputType, 3> KernelType;
+        typedef medItkMorphomathKernelType KernelType;
         typedef itk::GrayscaleErodeImageFilter<ImageType, ImageType, KernelType> FilterType;
         typename FilterType::Pointer filter = FilterType::New();
         m_filter = filter;
 
-        KernelType kernel;
-        kernel.SetRadius(this->kernelRadius()->value());
-        kernel.CreateStructuringElement();
+        KernelType kernel = medItkMorphomathBallKernel(this->kernelRadius()->value());
 
         filter->SetKernel(kernel);
         filter->SetInput(in);
@@ -0,0 +1,38 @@
+#pragma once
+/*=========================================================================
+
+ medInria
+
+ Copyright (c) INRIA 2013 - 2018. All rights reserved.
+ See LICENSE.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.
+
+=========================================================================*/
+
+#include <itkFlatStructuringElement.h>
+
+typedef itk::FlatStructuringElement<3> medItkMorphomathKernelType;
+
+/**
+ * @brief Ball structuring element shared by the morphomath processes.
+ *
+ * Small radii use the exact ball. Larger ones use a polyhedral approximation
+ * that decomposes into line segments. The grayscale morphology filters then
+ * pick the multi-threaded van Herk/Gil-Werman algorithm, whose cost does not
+ * depend on the radius.
+ */
+inline medItkMorphomathKernelType medItkMorphomathBallKernel(unsigned int radius)
+{
+    medItkMorphomathKernelType::RadiusType kernelRadius;
+    kernelRadius.Fill(radius);
+
+    if (radius <= 2)
+    {
+        return medItkMorphomathKernelType::Ball(kernelRadius);
+    }
+    // 20 lines: icosahedral approximation of the ball
+    return medItkMorphomathKernelType::Polygon(kernelRadius, 20);
+}
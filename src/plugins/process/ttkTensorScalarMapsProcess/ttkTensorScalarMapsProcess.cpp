@@ -27,15 +27,103 @@
 #include <itkTensorToLambdaFunction.h>
 
 #include <itkCommand.h>
+#include <itkMultiThreaderBase.h>
 #include <medMetaDataKeys.h>
 
 #include <vtkSmartPointer.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    enum TensorMap { FA, LogFA, ADC, Cl, Cp, Cs, RA, VR, Lambda1, Lambda2, Lambda3, ColorFA };
+
+    const char * const tensorMapNames[] = { "FA", "LogFA", "ADC", "Cl", "Cp", "Cs", "RA", "VR", "Lambda1", "Lambda2", "Lambda3", "ColorFA" };
+
+    /**
+     * Eigenvalues of the symmetric matrix [xx xy xz; xy yy yz; xz yz zz], in
+     * ascending order, from the closed-form solution of its characteristic
+     * polynomial (trigonometric method).
+     */
+    inline void symmetricEigenvalues(double xx, double xy, double xz, double yy, double yz, double zz,
+                                     double &l0, double &l1, double &l2)
+    {
+        const double offDiagonal = xy * xy + xz * xz + yz * yz;
+        const double q = (xx + yy + zz) / 3.0;
+
+        if (offDiagonal == 0.0)
+        {
+            double d[3] = { xx, yy, zz };
+            std::sort(d, d + 3);
+            l0 = d[0]; l1 = d[1]; l2 = d[2];
+            return;
+        }
+
+        const double dxx = xx - q, dyy = yy - q, dzz = zz - q;
+        const double p = std::sqrt((dxx * dxx + dyy * dyy + dzz * dzz + 2.0 * offDiagonal) / 6.0);
+
+        // determinant of A - qI
+        const double det = dxx * (dyy * dzz - yz * yz) - xy * (xy * dzz - yz * xz) + xz * (xy * yz - dyy * xz);
+        const double r = std::max(-1.0, std::min(1.0, det / (2.0 * p * p * p)));
+        const double phi = std::acos(r) / 3.0;
+
+        l2 = q + 2.0 * p * std::cos(phi);
+        l0 = q + 2.0 * p * std::cos(phi + 2.0943951023931957); // phi + 2 pi / 3
+        l1 = 3.0 * q - l0 - l2;
+    }
+
+    /**
+     * Unit eigenvector of the symmetric matrix for the eigenvalue l: the largest
+     * cross product of two rows of A - lI.
+     */
+    inline void symmetricEigenvector(double xx, double xy, double xz, double yy, double yz, double zz,
+                                     double l, double v[3])
+    {
+        const double r0[3] = { xx - l, xy, xz };
+        const double r1[3] = { xy, yy - l, yz };
+        const double r2[3] = { xz, yz, zz - l };
+
+        const double *rows[3][2] = { { r0, r1 }, { r0, r2 }, { r1, r2 } };
+        double best = 0.0;
+        v[0] = 1.0; v[1] = 0.0; v[2] = 0.0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const double *a = rows[k][0];
+            const double *b = rows[k][1];
+            const double c[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+            const double norm = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+            if (norm > best)
+            {
+                best = norm;
+                v[0] = c[0]; v[1] = c[1]; v[2] = c[2];
+            }
+        }
+        if (best > 0.0)
+        {
+            best = std::sqrt(best);
+            v[0] /= best; v[1] /= best; v[2] /= best;
+        }
+    }
+
+    inline double fractionalAnisotropy(double l0, double l1, double l2)
+    {
+        const double squares = l0 * l0 + l1 * l1 + l2 * l2;
+        if (squares <= 0.0)
+            return 0.0;
+        const double m = (l0 + l1 + l2) / 3.0;
+        return std::sqrt(1.5 * ((l0 - m) * (l0 - m) + (l1 - m) * (l1 - m) + (l2 - m) * (l2 - m)) / squares);
+    }
+}
+
 ttkTensorScalarMapsProcess::ttkTensorScalarMapsProcess(QObject *parent)
     : medAbstractDiffusionScalarMapsProcess(parent)
 {
     m_filter = 0;
+    m_cancelRequested = false;
     m_scalarMapRequested = "fa";
+    m_scalarMapsRequested << m_scalarMapRequested;
 }
 
 ttkTensorScalarMapsProcess::~ttkTensorScalarMapsProcess()
@@ -55,23 +143,48 @@ QString ttkTensorScalarMapsProcess::description() const
 void ttkTensorScalarMapsProcess::selectRequestedScalarMap(QString mapRequested)
 {
     m_scalarMapRequested = mapRequested;
+    m_scalarMapsRequested = QStringList() << mapRequested;
+}
+
+/**
+ * @brief Request several maps at once. They are computed in a single pass over
+ * the tensors, each tensor being decomposed once for all of them.
+ */
+void ttkTensorScalarMapsProcess::selectRequestedScalarMaps(QStringList mapsRequested)
+{
+    m_scalarMapsRequested = mapsRequested;
+    if (!mapsRequested.isEmpty())
+        m_scalarMapRequested = mapsRequested.first();
+}
+
+/**
+ * @brief The maps computed by the last run, in the requested order. The first
+ * one is also output().
+ */
+QList<medAbstractImageData *> ttkTensorScalarMapsProcess::outputs() const
+{
+    return m_outputs;
 }
 
 medAbstractJob::medJobExitStatus ttkTensorScalarMapsProcess::run()
 {
     medAbstractJob::medJobExitStatus jobExitSatus = medAbstractJob::MED_JOB_EXIT_FAILURE;
 
+    m_outputs.clear();
+    m_cancelRequested = false;
+
     if(this->input())
     {
         QString id =  this->input()->identifier();
+        bool allMaps = m_scalarMapsRequested.size() > 1;
 
         if ( id == "itkDataTensorImageFloat3" )
         {
-            jobExitSatus = this->_run<float>();
+            jobExitSatus = allMaps ? this->_runAllMaps<float>() : this->_run<float>();
         }
         else if ( id == "itkDataTensorImageDouble3" )
         {
-            jobExitSatus = this->_run<double>();
+            jobExitSatus = allMaps ? this->_runAllMaps<double>() : this->_run<double>();
         }
     }
 
@@ -125,6 +238,7 @@ medAbstractJob::medJobExitStatus ttkTensorScalarMapsProcess::_run()
 
         output->setMetaData(medMetaDataKeys::SeriesDescription.key(), this->input()->metadata(medMetaDataKeys::SeriesDescription.key()) + " " + m_scalarMapRequested);
         this->setOutput(output);
+        m_outputs << output;
         return medAbstractJob::MED_JOB_EXIT_SUCCESS;
     }
 
@@ -187,6 +301,239 @@ medAbstractJob::medJobExitStatus ttkTensorScalarMapsProcess::_run()
     output->setMetaData(medMetaDataKeys::SeriesDescription.key(), this->input()->metadata(medMetaDataKeys::SeriesDescription.key()) + " " + m_scalarMapRequested);
 
     this->setOutput(output);
+    m_outputs << output;
+
+    return medAbstractJob::MED_JOB_EXIT_SUCCESS;
+}
+
+/**
+ * Computes all the requested maps in one multi-threaded pass over the tensors.
+ * The eigenvalues of each tensor are solved in closed form once, a scanline
+ * at a time, and every map is then derived from them in its own loop over the
+ * scanline. The definitions are the ones of the single map functions.
+ */
+template <class inputType>
+medAbstractJob::medJobExitStatus ttkTensorScalarMapsProcess::_runAllMaps()
+{
+    typedef itk::Tensor<inputType, 3> TensorType;
+    typedef itk::Image<TensorType, 3> TensorImageType;
+    typedef itk::Image<inputType, 3> ImageType;
+    typedef itk::RGBAPixel<unsigned char> ColorType;
+    typedef itk::Image<ColorType, 3> ColorImageType;
+    typedef typename TensorImageType::RegionType RegionType;
+
+    typename TensorImageType::Pointer inData = dynamic_cast<TensorImageType *>((itk::Object*)(this->input()->data()));
+    if (!inData)
+        return medAbstractJob::MED_JOB_EXIT_FAILURE;
+
+    const RegionType region = inData->GetBufferedRegion();
+    const int nbMapNames = sizeof(tensorMapNames) / sizeof(tensorMapNames[0]);
+
+    QStringList names;
+    std::vector<int> maps;
+    std::vector<typename ImageType::Pointer> scalarImages;
+    typename ColorImageType::Pointer colorImage;
+    for (const QString &name : m_scalarMapsRequested)
+    {
+        int map = 0;
+        while (map < nbMapNames && name != tensorMapNames[map])
+            ++map;
+
+        if (map == nbMapNames)
+        {
+            dtkWarn() << "ttkTensorScalarMapsProcess: unknown scalar map" << name;
+            continue;
+        }
+        if (names.contains(name))
+            continue;
+
+        names << name;
+        if (map == ColorFA)
+        {
+            colorImage = ColorImageType::New();
+            colorImage->CopyInformation(inData);
+            colorImage->SetRegions(region);
+            colorImage->Allocate();
+        }
+        else
+        {
+            typename ImageType::Pointer image = ImageType::New();
+            image->CopyInformation(inData);
+            image->SetRegions(region);
+            image->Allocate();
+            maps.push_back(map);
+            scalarImages.push_back(image);
+        }
+    }
+
+    if (names.isEmpty())
+        return medAbstractJob::MED_JOB_EXIT_FAILURE;
+
+    const typename TensorImageType::DirectionType direction = inData->GetDirection();
+    const TensorType *tensors = inData->GetBufferPointer();
+
+    auto computeMaps = [&](const RegionType &subRegion)
+    {
+        const itk::SizeValueType length = subRegion.GetSize(0);
+        std::vector<double> l0(length), l1(length), l2(length);
+        std::vector<double> fa;
+
+        typename TensorImageType::IndexType index = subRegion.GetIndex();
+        const itk::IndexValueType yEnd = index[1] + static_cast<itk::IndexValueType>(subRegion.GetSize(1));
+        const itk::IndexValueType zEnd = index[2] + static_cast<itk::IndexValueType>(subRegion.GetSize(2));
+        const itk::IndexValueType yBegin = index[1];
+
+        for (; index[2] < zEnd; ++index[2])
+        {
+            for (index[1] = yBegin; index[1] < yEnd; ++index[1])
+            {
+                const itk::OffsetValueType offset = inData->ComputeOffset(index);
+                const TensorType *tensor = tensors + offset;
+
+                for (itk::SizeValueType i = 0; i < length; ++i)
+                {
+                    const TensorType &t = tensor[i];
+                    symmetricEigenvalues(t.GetComponent(0, 0), t.GetComponent(0, 1), t.GetComponent(0, 2),
+                                         t.GetComponent(1, 1), t.GetComponent(1, 2), t.GetComponent(2, 2),
+                                         l0[i], l1[i], l2[i]);
+                }
+
+                for (unsigned int k = 0; k < maps.size(); ++k)
+                {
+                    inputType *out = scalarImages[k]->GetBufferPointer() + offset;
+                    switch (maps[k])
+                    {
+                    case FA:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = static_cast<inputType>(fractionalAnisotropy(l0[i], l1[i], l2[i]));
+                        break;
+                    case LogFA:
+                        // anisotropy of the logarithm of the tensor
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = (l0[i] > 0.0) ? static_cast<inputType>(fractionalAnisotropy(std::log(l0[i]), std::log(l1[i]), std::log(l2[i]))) : 0;
+                        break;
+                    case ADC:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = static_cast<inputType>((l0[i] + l1[i] + l2[i]) / 3.0);
+                        break;
+                    case Cl:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = (l2[i] > 0.0) ? static_cast<inputType>((l2[i] - l1[i]) / l2[i]) : 0;
+                        break;
+                    case Cp:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = (l2[i] > 0.0) ? static_cast<inputType>((l1[i] - l0[i]) / l2[i]) : 0;
+                        break;
+                    case Cs:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = (l2[i] > 0.0) ? static_cast<inputType>(l0[i] / l2[i]) : 0;
+                        break;
+                    case RA:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                        {
+                            const double m = (l0[i] + l1[i] + l2[i]) / 3.0;
+                            const double deviation = (l0[i] - m) * (l0[i] - m) + (l1[i] - m) * (l1[i] - m) + (l2[i] - m) * (l2[i] - m);
+                            out[i] = (m > 0.0) ? static_cast<inputType>(std::sqrt(deviation / 3.0) / m) : 0;
+                        }
+                        break;
+                    case VR:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                        {
+                            const double m = (l0[i] + l1[i] + l2[i]) / 3.0;
+                            out[i] = (m > 0.0) ? static_cast<inputType>(l0[i] * l1[i] * l2[i] / (m * m * m)) : 0;
+                        }
+                        break;
+                    case Lambda1:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = static_cast<inputType>(l2[i]);
+                        break;
+                    case Lambda2:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = static_cast<inputType>(l1[i]);
+                        break;
+                    case Lambda3:
+                        for (itk::SizeValueType i = 0; i < length; ++i)
+                            out[i] = static_cast<inputType>(l0[i]);
+                        break;
+                    }
+                }
+
+                if (colorImage)
+                {
+                    // principal direction in physical space, weighted by the anisotropy
+                    ColorType *out = colorImage->GetBufferPointer() + offset;
+                    for (itk::SizeValueType i = 0; i < length; ++i)
+                    {
+                        const TensorType &t = tensor[i];
+                        double v[3];
+                        symmetricEigenvector(t.GetComponent(0, 0), t.GetComponent(0, 1), t.GetComponent(0, 2),
+                                             t.GetComponent(1, 1), t.GetComponent(1, 2), t.GetComponent(2, 2),
+                                             l2[i], v);
+
+                        const double anisotropy = fractionalAnisotropy(l0[i], l1[i], l2[i]);
+                        ColorType color;
+                        for (unsigned int c = 0; c < 3; ++c)
+                        {
+                            const double component = direction(c, 0) * v[0] + direction(c, 1) * v[1] + direction(c, 2) * v[2];
+                            color[c] = static_cast<unsigned char>(std::min(255.0, std::fabs(component) * anisotropy * 255.0));
+                        }
+                        color[3] = 255;
+                        out[i] = color;
+                    }
+                }
+            }
+        }
+    };
+
+    // slabs of slices, to report progress and check for cancellation in between
+    itk::MultiThreaderBase::Pointer multiThreader = itk::MultiThreaderBase::New();
+    const itk::IndexValueType zBegin = region.GetIndex(2);
+    const itk::IndexValueType zEnd = zBegin + static_cast<itk::IndexValueType>(region.GetSize(2));
+    const itk::IndexValueType slab = std::max<itk::IndexValueType>(1, (zEnd - zBegin) / 20);
+
+    for (itk::IndexValueType z = zBegin; z < zEnd; z += slab)
+    {
+        if (m_cancelRequested)
+            return medAbstractJob::MED_JOB_EXIT_CANCELLED;
+
+        RegionType slabRegion = region;
+        slabRegion.SetIndex(2, z);
+        slabRegion.SetSize(2, std::min(slab, zEnd - z));
+        multiThreader->ParallelizeImageRegion<3>(slabRegion, computeMaps, nullptr);
+
+        this->progression()->setValue(100 * (z + slabRegion.GetSize(2) - zBegin) / (zEnd - zBegin));
+    }
+
+    const QString seriesDescription = this->input()->metadata(medMetaDataKeys::SeriesDescription.key());
+    QString floatType = this->input()->identifier().contains("Double") ? "itkDataImageDouble3" : "itkDataImageFloat3";
+
+    unsigned int scalarImage = 0;
+    for (const QString &name : names)
+    {
+        medAbstractImageData *output;
+        if (name == tensorMapNames[ColorFA])
+        {
+            output = qobject_cast <medAbstractImageData *> (medAbstractDataFactory::instance()->create ("itkDataImageRGBA3"));
+            output->setData(colorImage.GetPointer());
+        }
+        else
+        {
+            output = qobject_cast <medAbstractImageData *> (medAbstractDataFactory::instance()->create (floatType));
+            output->setData(scalarImages[scalarImage++].GetPointer());
+        }
+
+        // the metadata of the input, as setOutput() gives them to its output
+        for (const QString &metaData : this->input()->metaDataList())
+            output->setMetaData(metaData, this->input()->metaDataValues(metaData));
+        for (const QString &property : this->input()->propertyList())
+            output->addProperty(property, this->input()->propertyValues(property));
+
+        m_outputs << output;
+    }
+    this->setOutput(m_outputs.first());
+
+    for (int i = 0; i < m_outputs.size(); ++i)
+        m_outputs[i]->setMetaData(medMetaDataKeys::SeriesDescription.key(), seriesDescription + " " + names[i]);
 
     return medAbstractJob::MED_JOB_EXIT_SUCCESS;
 }
@@ -195,6 +542,7 @@ void ttkTensorScalarMapsProcess::cancel()
 {
     if(this->isRunning())
     {
+        m_cancelRequested = true;
         if (m_filter.IsNotNull())
             m_filter->AbortGenerateDataOn();
     }
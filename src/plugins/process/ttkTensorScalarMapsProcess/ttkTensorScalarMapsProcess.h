@@ -2,6 +2,8 @@
 
 #include <medAbstractDiffusionScalarMapsProcess.h>
 
+#include <atomic>
+
 #include <itkProcessObject.h>
 #include <itkSmartPointer.h>
 
@@ -30,16 +32,23 @@ public:
     virtual QString caption() const;
     virtual QString description() const;
 
+    QList<medAbstractImageData *> outputs() const;
+
 public slots:
     void selectRequestedScalarMap(QString mapRequested);
+    void selectRequestedScalarMaps(QStringList mapsRequested);
 
 private:
     template <class inputType> medAbstractJob::medJobExitStatus _run();
+    template <class inputType> medAbstractJob::medJobExitStatus _runAllMaps();
 
 private:
     itk::SmartPointer<itk::ProcessObject> m_filter;
+    std::atomic<bool> m_cancelRequested;
 
     QString m_scalarMapRequested;
+    QStringList m_scalarMapsRequested;
+    QList<medAbstractImageData *> m_outputs;
 };
 
 inline medAbstractDiffusionScalarMapsProcess* ttkTensorScalarMapsProcessCreator()
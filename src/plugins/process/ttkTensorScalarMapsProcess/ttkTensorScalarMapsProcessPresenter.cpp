@@ -1,5 +1,7 @@
 #include "ttkTensorScalarMapsProcessPresenter.h"
 
+#include <medAbstractImageData.h>
+#include <medDataManager.h>
 #include <medJobManager.h>
 
 #include <medIntParameterPresenter.h>
@@ -11,12 +13,19 @@
 #include <QGroupBox>
 #include <QSlider>
 #include <QSignalMapper>
+#include <QCheckBox>
 
 ttkTensorScalarMapsProcessPresenter::ttkTensorScalarMapsProcessPresenter(medAbstractDiffusionScalarMapsProcess *parent)
     : medAbstractDiffusionScalarMapsProcessPresenter(parent)
 {
     m_process = qobject_cast <ttkTensorScalarMapsProcess *> (parent);
     m_progressionPresenter = new medIntParameterPresenter(m_process->progression());
+    m_severalMapsCheckBox = nullptr;
+    m_computeSelectedButton = nullptr;
+
+    connect(m_process, &ttkTensorScalarMapsProcess::finished,
+            this, &ttkTensorScalarMapsProcessPresenter::importOtherOutputs,
+            Qt::QueuedConnection);
 }
 
 medAbstractDiffusionScalarMapsProcess* ttkTensorScalarMapsProcessPresenter::process() const
@@ -122,6 +131,22 @@ QWidget* ttkTensorScalarMapsProcessPresenter::buildToolBoxWidget()
 
     tbGlobalLayout->addWidget(tensorToScalarBox);
 
+    // Several maps are computed in a single pass over the tensors
+    m_severalMapsCheckBox = new QCheckBox(tr("Compute several maps at once"), tbWidget);
+    m_severalMapsCheckBox->setToolTip(tr("Select the maps, then compute them together"));
+    m_computeSelectedButton = new QPushButton(tr("Compute selected maps"), tbWidget);
+    m_computeSelectedButton->setEnabled(false);
+    tbGlobalLayout->addWidget(m_severalMapsCheckBox);
+    tbGlobalLayout->addWidget(m_computeSelectedButton);
+
+    m_mapButtons = QList<QPushButton *>() << faButton << facButton << raButton << l1Button << l2Button << l3Button
+                                          << clButton << cpButton << csButton << adcButton << vrButton << falButton;
+    m_mapButtonNames = QStringList() << "FA" << "ColorFA" << "RA" << "Lambda1" << "Lambda2" << "Lambda3"
+                                     << "Cl" << "Cp" << "Cs" << "ADC" << "VR" << "LogFA";
+
+    connect(m_severalMapsCheckBox, SIGNAL(toggled(bool)), this, SLOT(setSeveralMapsMode(bool)));
+    connect(m_computeSelectedButton, SIGNAL(clicked()), this, SLOT(requestSelectedScalarMaps()));
+
     // Setting button mappings
     m_mapper = new QSignalMapper (this);
 
@@ -159,6 +184,52 @@ QWidget* ttkTensorScalarMapsProcessPresenter::buildToolBoxWidget()
 
 void ttkTensorScalarMapsProcessPresenter::requestScalarMap(QString mapRequested)
 {
+    // in several maps mode, the buttons only select the maps
+    if (m_severalMapsCheckBox && m_severalMapsCheckBox->isChecked())
+        return;
+
     m_process->selectRequestedScalarMap(mapRequested);
     medJobManager::instance()->startJobInThread(this->process());
 }
+
+void ttkTensorScalarMapsProcessPresenter::requestSelectedScalarMaps()
+{
+    QStringList maps;
+    for (int i = 0; i < m_mapButtons.size(); ++i)
+    {
+        if (m_mapButtons[i]->isChecked())
+            maps << m_mapButtonNames[i];
+    }
+
+    if (maps.isEmpty())
+        return;
+
+    m_process->selectRequestedScalarMaps(maps);
+    medJobManager::instance()->startJobInThread(this->process());
+}
+
+void ttkTensorScalarMapsProcessPresenter::setSeveralMapsMode(bool severalMaps)
+{
+    for (QPushButton *button : m_mapButtons)
+    {
+        button->setChecked(false);
+        button->setCheckable(severalMaps);
+    }
+    m_computeSelectedButton->setEnabled(severalMaps);
+}
+
+/**
+ * The first map is imported and shown by the parent presenter, the other ones
+ * are only imported.
+ */
+void ttkTensorScalarMapsProcessPresenter::importOtherOutputs(medAbstractJob::medJobExitStatus jobExitStatus)
+{
+    if (jobExitStatus != medAbstractJob::MED_JOB_EXIT_SUCCESS)
+        return;
+
+    QList<medAbstractImageData *> outputs = m_process->outputs();
+    for (int i = 1; i < outputs.size(); ++i)
+    {
+        medDataManager::instance()->importData(outputs[i]);
+    }
+}
@@ -6,6 +6,8 @@
 #include "ttkTensorScalarMapsProcessPluginExport.h"
 
 class medIntParameterPresenter;
+class QCheckBox;
+class QPushButton;
 class QSignalMapper;
 class TTKTENSORSCALARMAPSPROCESSPLUGIN_EXPORT ttkTensorScalarMapsProcessPresenter: public medAbstractDiffusionScalarMapsProcessPresenter
 {
@@ -19,11 +21,20 @@ public:
 
 public slots:
     void requestScalarMap(QString mapRequested);
+    void requestSelectedScalarMaps();
+
+private slots:
+    void setSeveralMapsMode(bool severalMaps);
+    void importOtherOutputs(medAbstractJob::medJobExitStatus jobExitStatus);
 
 private:
     ttkTensorScalarMapsProcess *m_process;
     medIntParameterPresenter *m_progressionPresenter;
     QSignalMapper *m_mapper;
+    QCheckBox *m_severalMapsCheckBox;
+    QPushButton *m_computeSelectedButton;
+    QList<QPushButton *> m_mapButtons;
+    QStringList m_mapButtonNames;
 };
 
 MED_DECLARE_PROCESS_PRESENTER_CREATOR(medAbstractDiffusionScalarMapsProcess, ttkTensorScalarMapsProcess)
@@ -24,6 +24,8 @@ ttkTensorTractographyProcess::ttkTensorTractographyProcess(QObject *parent)
     m_logerfilter = 0;
     m_tractographyfilter = 0;
     m_converterfilter = 0;
+    m_logTensorSource = nullptr;
+    m_logTensorSourceMTime = 0;
 
     m_faThreshold = new medIntParameter("fa_threshold", this);
     m_faThreshold->setCaption("Starting FA threshold");
@@ -132,22 +134,32 @@ medAbstractJob::medJobExitStatus ttkTensorTractographyProcess::_run()
     typedef itk::FiberTrackingImageFilter<TensorImageType, FiberImageType> FiberTrackingFilterType;
     typedef itk::FiberImageToVtkPolyData<FiberImageType> FiberImageToVtkPolyDataType;
 
-    typename LogFilterType::Pointer logFilter = LogFilterType::New();
-    logFilter->SetInput(inData);
-    m_logerfilter = logFilter;
-
-    try
-    {
-        logFilter->Update();
-    }
-    catch(itk::ProcessAborted &e)
+    typename TensorImageType::Pointer logTensorImage = dynamic_cast<TensorImageType *>(m_logTensorImage.GetPointer());
+    if (!logTensorImage || m_logTensorSource != inData.GetPointer() || m_logTensorSourceMTime != inData->GetMTime())
     {
-        return medAbstractJob::MED_JOB_EXIT_CANCELLED;
+        typename LogFilterType::Pointer logFilter = LogFilterType::New();
+        logFilter->SetInput(inData);
+        m_logerfilter = logFilter;
+
+        try
+        {
+            logFilter->Update();
+        }
+        catch(itk::ProcessAborted &e)
+        {
+            return medAbstractJob::MED_JOB_EXIT_CANCELLED;
+        }
+
+        logTensorImage = logFilter->GetOutput();
+        logTensorImage->DisconnectPipeline();
+        m_logTensorImage = logTensorImage;
+        m_logTensorSource = inData.GetPointer();
+        m_logTensorSourceMTime = inData->GetMTime();
     }
 
     typename FiberTrackingFilterType::Pointer trackerFilter = FiberTrackingFilterType::New();
     trackerFilter->SetInput(inData);
-    trackerFilter->SetLogTensorImage (logFilter->GetOutput());
+    trackerFilter->SetLogTensorImage (logTensorImage);
 
     trackerFilter->SetIntegrationMethod (2);
     trackerFilter->SetUseTriLinearInterpolation (1);
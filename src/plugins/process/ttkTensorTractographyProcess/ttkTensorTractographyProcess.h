@@ -2,6 +2,7 @@
 
 #include <medAbstractTractographyProcess.h>
 
+#include <itkDataObject.h>
 #include <itkProcessObject.h>
 #include <itkSmartPointer.h>
 
@@ -44,6 +45,12 @@ private:
     itk::SmartPointer<itk::ProcessObject> m_tractographyfilter;
     itk::SmartPointer<itk::ProcessObject> m_converterfilter;
 
+    // The log-tensor image only depends on the input, it is kept to be
+    // reused when the tracking parameters are tweaked.
+    itk::SmartPointer<itk::DataObject> m_logTensorImage;
+    const itk::DataObject *m_logTensorSource;
+    itk::ModifiedTimeType m_logTensorSourceMTime;
+
     medIntParameter *m_faThreshold;
     medIntParameter *m_faThreshold2;
     medIntParameter *m_smoothness;